@@ -67,6 +67,15 @@ static inline u64 msb(u64 x)
     }
 }
 
+static inline u64 lsb(u64 x)
+{
+    unsigned int low = x & 0xffffffff;
+    if (low)
+	return __builtin_ctz(low);
+    unsigned int high = x >> 32;
+    return high ? 32 + __builtin_ctz(high) : -1ull;
+}
+
 static inline void print_frame_trace_from_here()
 {
     // empty for now
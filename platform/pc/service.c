@@ -26,6 +26,7 @@
 #define BOOT_PARAM_OFFSET_E820_TABLE    0x02D0
 
 //#define SMP_DUMP_FRAME_RETURN_COUNT
+//#define SMP_DUMP_IDLE_STATS
 
 //#define INIT_DEBUG
 //#define MM_DEBUG
@@ -145,6 +146,18 @@ void vm_exit(u8 code)
     }
 #endif
 
+#ifdef SMP_DUMP_IDLE_STATS
+    rprintf("cpu\tidle us\tpolled\thalted\twakeups\tavg wakeup ns\tmax wakeup ns\n");
+    cpuinfo ici;
+    vector_foreach(cpuinfos, ici) {
+        struct cpu_idle_stats *st = &ici->idle_stats;
+        rprintf("%d\t%ld\t%ld\t%ld\t%ld\t%ld\t%ld\n", i, usec_from_timestamp(st->residency),
+                st->poll_wakeups, st->halt_wakeups, st->wakeups,
+                st->wakeups ? nsec_from_timestamp(st->wakeup_latency) / st->wakeups : 0,
+                nsec_from_timestamp(st->wakeup_latency_max));
+    }
+#endif
+
 #ifdef DUMP_MEM_STATS
     buffer b = allocate_buffer(heap_general(get_kernel_heaps()), 512);
     if (b != INVALID_ADDRESS) {
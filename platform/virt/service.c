@@ -146,6 +146,18 @@ void vm_exit(u8 code)
     }
 #endif
 
+#ifdef SMP_DUMP_IDLE_STATS
+    rprintf("cpu\tidle us\tpolled\thalted\twakeups\tavg wakeup ns\tmax wakeup ns\n");
+    cpuinfo ici;
+    vector_foreach(cpuinfos, ici) {
+        struct cpu_idle_stats *st = &ici->idle_stats;
+        rprintf("%d\t%ld\t%ld\t%ld\t%ld\t%ld\t%ld\n", i, usec_from_timestamp(st->residency),
+                st->poll_wakeups, st->halt_wakeups, st->wakeups,
+                st->wakeups ? nsec_from_timestamp(st->wakeup_latency) / st->wakeups : 0,
+                nsec_from_timestamp(st->wakeup_latency_max));
+    }
+#endif
+
 #ifdef DUMP_MEM_STATS
     buffer b = allocate_buffer(heap_general(get_kernel_heaps()), 512);
     if (b != INVALID_ADDRESS) {
@@ -181,9 +193,29 @@ void halt(char *format, ...)
 u64 total_processors = 1;
 u64 present_processors = 1;
 
+#ifdef SMP_ENABLE
+static void new_cpu(void)
+{
+    if (platform_timer_percpu_init)
+        apply(platform_timer_percpu_init);
+
+    while (1)
+        kernel_sleep();
+}
+
+void start_secondary_cores(kernel_heaps kh)
+{
+    memory_barrier();
+    init_debug("starting APs\n");
+    allocate_apboot((heap)heap_page_backed(kh), new_cpu);
+    present_processors = start_cpus();
+    deallocate_apboot((heap)heap_page_backed(kh));
+}
+#else
 void start_secondary_cores(kernel_heaps kh)
 {
 }
+#endif
 
 static void init_kernel_heaps(void)
 {
@@ -229,6 +261,8 @@ static void __attribute__((noinline)) init_service_new_stack(void)
     init_tuples(allocate_tagged_region(kh, tag_table_tuple));
     init_symbols(allocate_tagged_region(kh, tag_symbol), heap_general(kh));
     init_management(allocate_tagged_region(kh, tag_function_tuple), heap_general(kh));
+    init_debug("init cpu features\n");
+    init_cpu_features();
     init_debug("calling runtime init\n");
     kernel_runtime_init(kh);
     while(1);
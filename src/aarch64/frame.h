@@ -49,7 +49,7 @@ https://developer.arm.com/cache-speculation-vulnerability-firmware-specification
 #define FRAME_STACK_TOP     37
 #define FRAME_RUN           38
 #define FRAME_EL            39
-#define FRAME_QUEUE         40
+#define FRAME_CPU           40
 #define FRAME_FULL          41
 #define FRAME_THREAD        42
 #define FRAME_HEAP          43
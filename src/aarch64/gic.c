@@ -44,16 +44,16 @@ void gic_clear_pending_int(int irq)
         int w = 32 / GICD_INTS_PER_ ## type ## _REG;                    \
         int r = irq / GICD_INTS_PER_ ## type ## _REG;                   \
         u32 i;                                                          \
-        if (!gicc_v3_iface || r)                                        \
+        if (!gicc_v3_iface || irq >= GIC_SPI_INTS_START)                \
             i = mmio_read_32(GICD_ ## type ## R(r));                    \
         else                                                            \
-            i = mmio_read_32(GICR_ ## type ## R);                       \
+            i = mmio_read_32(GICR_ ## type ## R + 4 * r);               \
         int s = (irq % GICD_INTS_PER_ ## type ## _REG) * w;             \
         u32 n = (i & ~(MASK32(w) << s)) | (v << s);                     \
-        if (!gicc_v3_iface || r)                                        \
+        if (!gicc_v3_iface || irq >= GIC_SPI_INTS_START)                \
             mmio_write_32(GICD_ ## type ## R(r), n);                    \
         else                                                            \
-            mmio_write_32(GICR_ ## type ## R, n);                       \
+            mmio_write_32(GICR_ ## type ## R + 4 * r, n);               \
         gic_debug("irq %d, v %d, reg was 0x%x, now 0x%x\n", irq, v, i, n); \
     }
 
@@ -85,11 +85,7 @@ static void init_gicd(void)
     for (int i = 0; i < GIC_MAX_INT / GICD_INTS_PER_IPRIORITY_REG; i++)
         mmio_write_32(GICD_IPRIORITYR(i), MASK(32));
 
-    /* set all to group 1, non-secure */
-    if (gicc_v3_iface)
-        mmio_write_32(GICR_IGROUPR, MASK(32));
-    else
-        mmio_write_32(GICD_IGROUPR(0), MASK(32));
+    /* set all to group 1, non-secure (SGIs and PPIs in init_gic_cpu()) */
     for (int i = GIC_SPI_INTS_START / GICD_INTS_PER_IGROUP_REG;
          i < GIC_SPI_INTS_END / GICD_INTS_PER_IGROUP_REG; i++)
         mmio_write_32(GICD_IGROUPR(i), MASK(32));
@@ -127,7 +123,12 @@ static void init_gicd(void)
 
 u64 gic_dispatch_int(void)
 {
-    u64 v = (gicc_v3_iface ? read_psr_s(ICC_IAR1_EL1) : mmio_read_32(GICC_IAR)) & gic_intid_mask;
+    u64 iar = gicc_v3_iface ? read_psr_s(ICC_IAR1_EL1) : mmio_read_32(GICC_IAR);
+    u64 v = iar & gic_intid_mask;
+
+    /* a GICv2 SGI is completed along with the id of the cpu that sent it */
+    if (!gicc_v3_iface && v < GIC_SGI_INTS_END)
+        current_cpu()->m.gic_sgi_source = iar & ~gic_intid_mask;
     gic_debug("intid %ld\n", v);
     return v;
 }
@@ -135,9 +136,32 @@ u64 gic_dispatch_int(void)
 void gic_eoi(int irq)
 {
     gic_debug("irq %d\n", irq);
+    if (!gicc_v3_iface && irq < GIC_SGI_INTS_END)
+        irq |= current_cpu()->m.gic_sgi_source;
     gicc_write(EOIR1, irq);
 }
 
+void gic_send_sgi(cpuinfo ci, int irq)
+{
+    gic_debug("cpu %d, irq %d\n", ci->id, irq);
+
+    /* stores made before the ipi must be visible to the target */
+    asm volatile("dsb ishst" ::: "memory");
+    if (gicc_v3_iface) {
+        u64 mpidr = ci->m.mpidr;
+        u64 v = u64_from_field(ICC_SGI1R_EL1_AFF3, field_from_u64(mpidr, MPIDR_AFF3)) |
+            u64_from_field(ICC_SGI1R_EL1_AFF2, field_from_u64(mpidr, MPIDR_AFF2)) |
+            u64_from_field(ICC_SGI1R_EL1_AFF1, field_from_u64(mpidr, MPIDR_AFF1)) |
+            u64_from_field(ICC_SGI1R_EL1_INTID, irq) |
+            U64_FROM_BIT(field_from_u64(mpidr, MPIDR_AFF0));
+        write_psr_s(ICC_SGI1R_EL1, v);
+        asm volatile("isb");
+    } else {
+        mmio_write_32(GICD_SGIR, u64_from_field(GICD_SGIR_TargetList, ci->m.gic_cpu_mask) |
+                      u64_from_field(GICD_SGIR_INTID, irq));
+    }
+}
+
 void msi_format(u32 *address, u32 *data, int vector)
 {
     *address = DEV_BASE_GIC_V2M + GIC_V2M_MSI_SETSPI_NS;
@@ -179,6 +203,52 @@ static void init_gicc(void)
     }
 }
 
+/* The redistributors are laid out in a contiguous array of frames; find
+   the one whose affinity matches the cpu. */
+static u64 gic_find_rdist(u64 mpidr)
+{
+    u64 aff = (field_from_u64(mpidr, MPIDR_AFF3) << 24) | (mpidr & MASK(24));
+    u64 rd = mmio_base_addr(GIC_REDIST);
+    while (1) {
+        u64 typer = mmio_read_64(GICR_TYPER(rd));
+        if ((typer >> GICR_TYPER_AFF_SHIFT) == aff)
+            return rd;
+        if (typer & GICR_TYPER_Last)
+            return INVALID_PHYSICAL;
+        rd += (typer & GICR_TYPER_VLPIS) ? GICR_V4_FRAME_SIZE : GICR_FRAME_SIZE;
+    }
+}
+
+/* Per-cpu setup of the banked SGI and PPI state and the cpu interface. */
+void init_gic_cpu(void)
+{
+    cpuinfo ci = current_cpu();
+    if (gicc_v3_iface) {
+        u64 rd = gic_find_rdist(ci->m.mpidr);
+        if (rd == INVALID_PHYSICAL)
+            halt("%s: no redistributor for cpu %d, mpidr 0x%lx\n", __func__, ci->id, ci->m.mpidr);
+        ci->m.gic_rdist_base = rd;
+        gic_debug("cpu %d, redistributor 0x%lx\n", ci->id, rd);
+
+        /* wake up the redistributor */
+        mmio_write_32(GICR_WAKER(rd), mmio_read_32(GICR_WAKER(rd)) & ~GICR_WAKER_ProcessorSleep);
+        while (mmio_read_32(GICR_WAKER(rd)) & GICR_WAKER_ChildrenAsleep)
+            kern_pause();
+
+        mmio_write_32(GICR_ICENABLER, MASK(32));
+        mmio_write_32(GICR_ICPENDR, MASK(32));
+        mmio_write_32(GICR_IGROUPR, MASK(32));
+    } else {
+        mmio_write_32(GICD_ICENABLER(0), MASK(32));
+        mmio_write_32(GICD_ICPENDR(0), MASK(32));
+        mmio_write_32(GICD_IGROUPR(0), MASK(32));
+
+        /* the banked targets of private interrupts name this cpu's interface */
+        ci->m.gic_cpu_mask = mmio_read_32(GICD_ITARGETSR(0)) & 0xff;
+    }
+    init_gicc();
+}
+
 u16 gic_msi_vector_base;
 u16 gic_msi_vector_num;
 
@@ -213,5 +283,5 @@ void init_gic(void)
     }
 
     init_gicd();
-    init_gicc();
+    init_gic_cpu();
 }
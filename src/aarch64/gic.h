@@ -48,6 +48,15 @@
 
 #define ICC_IGRPENx_ENABLE 1
 
+#define ICC_SGI1R_EL1_AFF3_BITS   8
+#define ICC_SGI1R_EL1_AFF3_SHIFT  48
+#define ICC_SGI1R_EL1_AFF2_BITS   8
+#define ICC_SGI1R_EL1_AFF2_SHIFT  32
+#define ICC_SGI1R_EL1_INTID_BITS  4
+#define ICC_SGI1R_EL1_INTID_SHIFT 24
+#define ICC_SGI1R_EL1_AFF1_BITS   8
+#define ICC_SGI1R_EL1_AFF1_SHIFT  16
+
 #define INTID_NO_PENDING 1023
 
 /* GIC Distributor */
@@ -86,10 +95,26 @@
 #define GICD_IGRPMODR(n)            (GICD_CTLR + 0x0d00)
 #define GICD_NSACR(n)               (GICD_CTLR + 0x0e00)
 #define GICD_SGIR                   (GICD_CTLR + 0x0f00)
+#define GICD_SGIR_TargetList_BITS   8
+#define GICD_SGIR_TargetList_SHIFT  16
+#define GICD_SGIR_INTID_BITS        4
+#define GICD_SGIR_INTID_SHIFT       0
 #define GICD_CPENDSGIR(n)           (GICD_CTLR + 0x0f10)
 #define GICD_SPENDSGIR(n)           (GICD_CTLR + 0x0f20)
 
-#define _GICR_OFFSET                (mmio_base_addr(GIC_REDIST) + 0x10000)
+/* Redistributor frames, one per cpu: the RD frame and then the SGI frame
+   holding the banked SGI and PPI registers of that cpu */
+#define GICR_FRAME_SIZE             0x20000
+#define GICR_V4_FRAME_SIZE          0x40000
+#define GICR_TYPER(rd)              ((rd) + 0x0008)
+#define GICR_TYPER_VLPIS            U64_FROM_BIT(1)
+#define GICR_TYPER_Last             U64_FROM_BIT(4)
+#define GICR_TYPER_AFF_SHIFT        32
+#define GICR_WAKER(rd)              ((rd) + 0x0014)
+#define GICR_WAKER_ProcessorSleep   U32_FROM_BIT(1)
+#define GICR_WAKER_ChildrenAsleep   U32_FROM_BIT(2)
+
+#define _GICR_OFFSET                (current_cpu()->m.gic_rdist_base + 0x10000)
 #define GICR_IGROUPR                (_GICR_OFFSET + 0x0080)
 #define GICR_INTS_PER_IGROUP_REG    32
 #define GICR_ISENABLER              (_GICR_OFFSET + 0x0100)
@@ -160,7 +185,9 @@ void gic_set_int_config(int irq, u32 cfg);
 boolean gic_int_is_pending(int irq);
 u64 gic_dispatch_int(void);
 void gic_eoi(int irq);
+void gic_send_sgi(cpuinfo ci, int irq);
 void init_gic(void);
+void init_gic_cpu(void);
 
 #define _GIC_SET_INTFIELD(name, type) void gic_set_int_##name(int irq, u32 v);
 _GIC_SET_INTFIELD(priority, IPRIORITY)
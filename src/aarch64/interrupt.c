@@ -267,6 +267,9 @@ void irq_handler(void)
 
     int_debug("%s: enter\n", __func__);
 
+    /* if we were idle, we are no longer */
+    bitmap_set_atomic(idle_cpu_mask, ci->id, 0);
+
     /* re-enqueue interrupted user thread */
     if (ci->state == cpu_user && !shutting_down) {
         int_debug("int sched %F\n", f[FRAME_RUN]);
@@ -387,6 +390,7 @@ closure_function(0, 0, void, arm_timer)
     // This assert failed once under KVM...not clear if it's a valid assumption...
     // assert(read_psr(CNTV_CTL_EL0) & CNTV_CTL_EL0_ISTATUS);
     write_psr(CNTV_CTL_EL0, 0);
+    current_cpu()->timer_interrupts++;
 }
 
 closure_struct(arm_timer, _timer);
@@ -431,3 +435,19 @@ void init_interrupts(kernel_heaps kh)
     gic_set_int_target(GIC_TIMER_IRQ, 1);
     register_interrupt(GIC_TIMER_IRQ, init_closure(&_timer, arm_timer), "arm timer");
 }
+
+/* Interrupt setup for a secondary cpu: SGIs and PPIs are banked per cpu,
+   so those registered on the boot cpu are enabled here as well. */
+void init_interrupts_cpu(void)
+{
+    register u64 v = u64_from_pointer(&exception_vectors);
+    asm volatile("dsb sy; msr vbar_el1, %0" :: "r"(v));
+    init_gic_cpu();
+    for (int i = 0; i < GIC_SPI_INTS_START; i++) {
+        if (list_empty(&handlers[i]))
+            continue;
+        gic_set_int_priority(i, 0);
+        gic_clear_pending_int(i);
+        gic_enable_int(i);
+    }
+}
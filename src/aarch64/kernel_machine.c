@@ -54,11 +54,26 @@ heap allocate_tagged_region(kernel_heaps kh, u64 tag)
     return &th->h;
 }
 
+u8 arm_lse_atomics;
+
+void init_cpu_features(void)
+{
+    u64 isar0 = read_psr(ID_AA64ISAR0_EL1);
+    if (field_from_u64(isar0, ID_AA64ISAR0_EL1_ATOMIC) >= ID_AA64ISAR0_EL1_ATOMIC_LSE)
+        arm_lse_atomics = 1;
+}
+
 void cpu_init(int cpu)
 {
     cpuinfo ci = cpuinfo_from_id(cpu);
     register u64 a = u64_from_pointer(ci);
     asm volatile("mov x18, %0; msr tpidr_el1, %0" ::"r"(a));
+    ci->m.mpidr = read_psr(MPIDR_EL1) & MPIDR_AFF_MASK;
+}
+
+void send_ipi(u64 cpu, u8 vector)
+{
+    gic_send_sgi(cpuinfo_from_id(cpu), vector);
 }
 
 void init_cpuinfo_machine(cpuinfo ci, heap backed)
@@ -78,7 +93,6 @@ void interrupt_exit(void)
 
 void psci_shutdown(void)
 {
-    u32 psci_fn = 0x84000000 /* fn base */ + 0x8 /* system off */;
-    arm_hvc(psci_fn, 0, 0, 0);
+    arm_hvc(PSCI_FN_BASE + PSCI_FN_SYSTEM_OFF, 0, 0, 0);
 }
 
@@ -123,6 +123,32 @@
 #define ID_AA64ISAR0_EL1_RNDR_BITS        4
 #define ID_AA64ISAR0_EL1_RNDR_SHIFT       60
 #define ID_AA64ISAR0_EL1_RNDR_IMPLEMENTED 1 /* RNDR, RNDRRS MSRs */
+#define ID_AA64ISAR0_EL1_ATOMIC_BITS      4
+#define ID_AA64ISAR0_EL1_ATOMIC_SHIFT     20
+#define ID_AA64ISAR0_EL1_ATOMIC_LSE       2 /* CAS, LDADD, LDSET, ... */
+
+#define CTR_EL0_DMINLINE_BITS  4
+#define CTR_EL0_DMINLINE_SHIFT 16
+
+#define MPIDR_AFF0_BITS  8
+#define MPIDR_AFF0_SHIFT 0
+#define MPIDR_AFF1_BITS  8
+#define MPIDR_AFF1_SHIFT 8
+#define MPIDR_AFF2_BITS  8
+#define MPIDR_AFF2_SHIFT 16
+#define MPIDR_AFF3_BITS  8
+#define MPIDR_AFF3_SHIFT 32
+#define MPIDR_AFF_MASK   0xff00ffffffull
+
+/* PSCI 0.2 functions, SMC64 calling convention */
+#define PSCI_FN_BASE            0x84000000
+#define PSCI_FN64_BASE          0xc4000000
+#define PSCI_FN_CPU_ON          0x3
+#define PSCI_FN_AFFINITY_INFO   0x4
+#define PSCI_FN_SYSTEM_OFF      0x8
+
+#define PSCI_SUCCESS            0
+#define PSCI_AFFINITY_OFF       1
 
 #define ID_AA64PFR0_EL1_GIC_BITS                4
 #define ID_AA64PFR0_EL1_GIC_SHIFT               24
@@ -186,6 +212,18 @@ static inline void wait_for_interrupt(void)
     enable_interrupts();
 }
 
+/* Called with interrupts disabled: sleeps, with interrupts enabled, until
+   the exclusive monitor armed on p is cleared by a write, unless *p has
+   changed from v already. */
+static inline boolean wait_for_update(volatile u64 *p, u64 v)
+{
+    u64 w;
+    asm volatile("ldxr %0, %1" : "=r"(w) : "Q"(*p) : "memory");
+    if (w == v)
+        asm volatile("msr daifclr, #2; wfe; msr daifset, #2" ::: "memory");
+    return true;
+}
+
 /* locking constructs */
 #include <lock.h>
 
@@ -241,6 +279,15 @@ struct cpuinfo_machine {
     /* Default frame and stack installed at kernel entry points (init,
        syscall) and calls to runloop. +8 */
     kernel_context kernel_context;
+
+    /* affinity of this cpu, from MPIDR_EL1 */
+    u64 mpidr;
+
+    /* GICv3 redistributor, or GICv2 cpu interface mask and the source of
+       the SGI being handled */
+    u64 gic_rdist_base;
+    u32 gic_cpu_mask;
+    u32 gic_sgi_source;
 };
 
 typedef struct cpuinfo *cpuinfo;
@@ -391,9 +438,15 @@ void deallocate_msi_interrupt(u64 v);
 u64 allocate_mmio_interrupt(void);
 void deallocate_mmio_interrupt(u64 v);
 
-void arm_hvc(u64 x0, u64 x1, u64 x2, u64 x3);
+u64 arm_hvc(u64 x0, u64 x1, u64 x2, u64 x3);
 void angel_shutdown(u64 x0);
 void psci_shutdown(void);
 
-#define send_ipi(cpu, vector)
+void init_cpu_features(void);
+void init_interrupts_cpu(void);
+void send_ipi(u64 cpu, u8 vector);
+
+int start_cpus(void);
+void allocate_apboot(heap stackheap, void (*ap_entry)());
+void deallocate_apboot(heap stackheap);
 #endif /* __ASSEMBLY__ */
@@ -1,6 +1,83 @@
+/* struct spinlock defined in machine.h */
+
+#if (defined(KERNEL) || defined(KLIB)) && defined(SMP_ENABLE)
+/* Queued spinlocks, as on x86_64: the low byte of the lock word is the
+   lock itself, and bits 16-31 hold the tail of a queue of waiting cpus
+   (see kernel/lock.c). The byte stores that release a lock use store-release
+   so that accesses in the critical section stay inside it. */
+#define SPIN_LOCKED         1
+#define SPIN_LOCKED_SLOW    3   /* paravirtual: a halted waiter needs a kick */
+
+#define RW_WLOCKED          0xff
+#define RW_WAITING          0x100
+#define RW_WMASK            (RW_WLOCKED | RW_WAITING)
+#define RW_READER           0x200
+
+extern boolean spin_lock_pv;
+void spin_lock_slowpath(spinlock l);
+void spin_unlock_slowpath(spinlock l);
+void spin_rlock_slowpath(rw_spinlock l);
+void spin_wlock_slowpath(rw_spinlock l);
+
+static inline void spin_halt(void)
+{
+    /* with interrupts masked, a pending interrupt still ends the wait */
+    asm volatile("dsb sy; wfi" ::: "memory");
+}
+
+static inline void spin_release_byte(word *w)
+{
+    asm volatile("stlrb wzr, %0" : "=Q"(*(u8 *)w) :: "memory");
+}
+
+static inline boolean spin_try(spinlock l) {
+    if (compare_and_swap_64(&l->w, 0, SPIN_LOCKED))
+        return true;
+    kern_pause();
+    return false;
+}
+
+static inline void spin_lock(spinlock l) {
+    if (!compare_and_swap_64(&l->w, 0, SPIN_LOCKED))
+        spin_lock_slowpath(l);
+}
+
+static inline void spin_unlock(spinlock l) {
+    if (spin_lock_pv) {
+        if (!__sync_bool_compare_and_swap((u8 *)&l->w, SPIN_LOCKED, 0))
+            spin_unlock_slowpath(l);
+        return;
+    }
+    spin_release_byte(&l->w);
+}
+
+static inline void spin_rlock(rw_spinlock l) {
+    if ((fetch_and_add(&l->readers, RW_READER) + RW_READER) & RW_WMASK)
+        spin_rlock_slowpath(l);
+}
+
+static inline void spin_runlock(rw_spinlock l) {
+    fetch_and_add(&l->readers, -RW_READER);
+}
+
+static inline void spin_wlock(rw_spinlock l) {
+    if (!compare_and_swap_64(&l->readers, 0, RW_WLOCKED))
+        spin_wlock_slowpath(l);
+}
+
+static inline void spin_wunlock(rw_spinlock l) {
+    spin_release_byte(&l->readers);
+}
+
+#else
 #define spin_try(x) (true)
 #define spin_lock(x) ((void)x)
 #define spin_unlock(x) ((void)x)
+#define spin_wlock(x) ((void)x)
+#define spin_wunlock(x) ((void)x)
+#define spin_rlock(x) ((void)x)
+#define spin_runlock(x) ((void)x)
+#endif
 
 static inline u64 spin_lock_irq(spinlock l)
 {
@@ -15,7 +92,39 @@ static inline void spin_unlock_irq(spinlock l, u64 flags)
     irq_restore(flags);
 }
 
+static inline u64 spin_wlock_irq(rw_spinlock l)
+{
+    u64 flags = irq_disable_save();
+    spin_wlock(l);
+    return flags;
+}
+
+static inline void spin_wunlock_irq(rw_spinlock l, u64 flags)
+{
+    spin_wunlock(l);
+    irq_restore(flags);
+}
+
+static inline u64 spin_rlock_irq(rw_spinlock l)
+{
+    u64 flags = irq_disable_save();
+    spin_rlock(l);
+    return flags;
+}
+
+static inline void spin_runlock_irq(rw_spinlock l, u64 flags)
+{
+    spin_runlock(l);
+    irq_restore(flags);
+}
+
 static inline void spin_lock_init(spinlock l)
 {
     *&l->w = 0;
 }
+
+static inline void spin_rw_lock_init(rw_spinlock l)
+{
+    spin_lock_init(&l->l);
+    l->readers = 0;
+}
@@ -132,6 +132,11 @@ typedef struct spinlock {
     word w;
 } *spinlock;
 
+typedef struct rw_spinlock {
+    struct spinlock l;
+    u64 readers;
+} *rw_spinlock;
+
 /* returns -1 if x == 0, caller must check */
 static inline __attribute__((always_inline)) u64 msb(u64 x)
 {
@@ -163,35 +168,37 @@ static inline __attribute__((always_inline)) void memory_barrier(void)
     asm volatile("dmb sy" ::: "memory");
 }
 
-/* XXX something b0rked with ldset here...ordering, or asm constraints? */
+/* ARMv8.1 LSE atomics are used when the cpu implements them (see
+   init_cpu_features()); otherwise the builtins fall back to load / store
+   exclusive loops. */
+#if defined(KERNEL) && !defined(BUILD_VDSO)
+extern u8 arm_lse_atomics;
+#define ARM_LSE arm_lse_atomics
+#else
+#define ARM_LSE 0
+#endif
+#define LSE(x) ".arch_extension lse\n" x
+
 static inline __attribute__((always_inline)) int atomic_test_and_set_bit(u64 *target, u64 bit)
 {
-#if 0
-    register u64 a = u64_from_pointer(target);
-    register u64 tmp, v = 1ull << bit;
-    asm volatile("ldset %0, %2, [%1]" : "=&r"(tmp) : "r"(a), "r"(v) : "memory");
-    return tmp >> bit;
-#else
     u64 mask = 1ull << bit;
-    u64 w = *target;
-    *target = w | mask;
+    u64 w;
+    if (ARM_LSE)
+        asm volatile(LSE("ldsetal %2, %0, %1") : "=r"(w), "+Q"(*target) : "r"(mask) : "memory");
+    else
+        w = __sync_fetch_and_or(target, mask);
     return (w & mask) != 0;
-#endif
 }
 
 static inline __attribute__((always_inline)) int atomic_test_and_clear_bit(u64 *target, u64 bit)
 {
-#if 0
-    register u64 a = u64_from_pointer(target);
-    register u64 tmp, v = 1ull << bit;
-    asm volatile("ldclr %0, %2, [%1]" : "=&r"(tmp) : "r"(a), "r"(v) : "memory");
-    return tmp >> bit;
-#else
     u64 mask = 1ull << bit;
-    u64 w = *target;
-    *target = w & ~mask;
+    u64 w;
+    if (ARM_LSE)
+        asm volatile(LSE("ldclral %2, %0, %1") : "=r"(w), "+Q"(*target) : "r"(mask) : "memory");
+    else
+        w = __sync_fetch_and_and(target, ~mask);
     return (w & mask) != 0;
-#endif
 }
 
 static inline __attribute__((always_inline)) void atomic_set_bit(u64 *target, u64 bit)
@@ -206,19 +213,64 @@ static inline __attribute__((always_inline)) void atomic_clear_bit(u64 *target,
 
 static inline __attribute__((always_inline)) word fetch_and_add(word *target, word num)
 {
+    if (ARM_LSE) {
+        word w;
+        asm volatile(LSE("ldaddal %2, %0, %1") : "=r"(w), "+Q"(*target) : "r"(num) : "memory");
+        return w;
+    }
     asm volatile("prfm pstl1strm, %0" :: "Q" (*target));
     return __sync_fetch_and_add(target, num);
 }
 
 static inline __attribute__((always_inline)) u8 compare_and_swap_32(u32 *p, u32 old, u32 new)
 {
+    if (ARM_LSE) {
+        u32 w = old;
+        asm volatile(LSE("casal %w0, %w2, %1") : "+r"(w), "+Q"(*p) : "r"(new) : "memory");
+        return w == old;
+    }
     asm volatile("prfm pstl1strm, %0" :: "Q" (*p));
     return __sync_bool_compare_and_swap(p, old, new);
 }
 
+static inline __attribute__((always_inline)) u8 compare_and_swap_64(u64 *p, u64 old, u64 new)
+{
+    if (ARM_LSE) {
+        u64 w = old;
+        asm volatile(LSE("casal %0, %2, %1") : "+r"(w), "+Q"(*p) : "r"(new) : "memory");
+        return w == old;
+    }
+    asm volatile("prfm pstl1strm, %0" :: "Q" (*p));
+    return __sync_bool_compare_and_swap(p, old, new);
+}
+
+/* A waiter spinning on a plain load would not be woken from wfe by the
+   store that releases it, so only hint the core (or hypervisor) here. */
 static inline __attribute__((always_inline)) void kern_pause(void)
 {
-    asm volatile("dsb sy; wfe" ::: "memory");
+    asm volatile("yield" ::: "memory");
+}
+
+/* Add nblocks 64-byte blocks at p into a one's complement sum. The wide
+   accumulator absorbs carries, which are folded back in at the end. */
+static inline __attribute__((always_inline)) u64 ip_csum_blocks(const void *p, u64 nblocks, u64 sum)
+{
+    const u64 *w = p;
+    unsigned __int128 acc = sum;
+    while (nblocks--) {
+        acc += w[0];
+        acc += w[1];
+        acc += w[2];
+        acc += w[3];
+        acc += w[4];
+        acc += w[5];
+        acc += w[6];
+        acc += w[7];
+        w += 8;
+    }
+    u64 lo = acc, hi = acc >> 64;
+    lo += hi;
+    return lo + (lo < hi);
 }
 
 /* XXX make names generic */
@@ -0,0 +1,135 @@
+//#define MP_DEBUG
+
+#include <kernel.h>
+#include <gic.h>
+
+#ifdef MP_DEBUG
+#define mp_debug(x, ...) do {rprintf("MP: " x, ##__VA_ARGS__);} while(0)
+#else
+#define mp_debug(x, ...)
+#endif
+
+/* Read with the mmu off by ap_start_vector in crt0.S; keep the layout in
+   sync. */
+static struct ap_start_info {
+    u64 mair;
+    u64 tcr;
+    u64 ttbr0;
+    u64 ttbr1;
+    u64 sctlr;
+    u64 stack;
+    u64 entry;
+} ap_start_info;
+
+extern u8 ap_start_vector, ap_start_vector_end;
+static range ap_start_range;
+static int ap_id;
+static heap ap_heap;
+static void (*start_callback)();
+
+#define AP_START_TIMEOUT_MS 200
+
+/* Aff0 is encoded as a bit in an SGI target list. */
+#define MP_MAX_AFF0 16
+#define MP_MAX_AFF1 256
+
+static void __attribute__((noinline)) ap_start(void)
+{
+    cpu_init(ap_id);
+    cpuinfo ci = current_cpu();
+    set_running_frame(ci, frame_from_kernel_context(get_kernel_context(ci)));
+    write_psr(MDSCR_EL1, 0);
+    init_interrupts_cpu();
+    mp_debug("cpu %d up, mpidr 0x%lx\n", ci->id, ci->m.mpidr);
+    memory_barrier();
+    fetch_and_add(&total_processors, 1);
+    start_callback();
+}
+
+/* The starting cpu reads ap_start_info before its caches are on. */
+static void clean_dcache_range(void *p, bytes length)
+{
+    u64 line = 4 << field_from_u64(read_psr(CTR_EL0), CTR_EL0_DMINLINE);
+    for (u64 a = u64_from_pointer(p) & ~(line - 1); a < u64_from_pointer(p) + length; a += line)
+        asm volatile("dc cvac, %0" :: "r"(a) : "memory");
+    asm volatile("dsb sy" ::: "memory");
+}
+
+static s64 psci_affinity_info(u64 mpidr)
+{
+    return arm_hvc(PSCI_FN64_BASE + PSCI_FN_AFFINITY_INFO, mpidr, 0, 0);
+}
+
+static void start_cpu(int index, u64 mpidr)
+{
+    cpuinfo ci = init_cpuinfo(ap_heap, index);
+    if (ci == INVALID_ADDRESS) {
+        msg_err("unable to allocate cpuinfo for cpu %d\n", index);
+        return;
+    }
+    ap_id = index;
+    ap_start_info.stack = u64_from_pointer(stack_from_kernel_context(get_kernel_context(ci)));
+    clean_dcache_range(&ap_start_info, sizeof(ap_start_info));
+
+    int nproc = total_processors;
+    s64 rv = arm_hvc(PSCI_FN64_BASE + PSCI_FN_CPU_ON, mpidr,
+                     physical_from_virtual(&ap_start_vector),
+                     physical_from_virtual(&ap_start_info));
+    if (rv != PSCI_SUCCESS) {
+        msg_err("PSCI CPU_ON for mpidr 0x%lx failed: %ld\n", mpidr, rv);
+        return;
+    }
+    for (u64 to = 0; total_processors != nproc + 1 && to < AP_START_TIMEOUT_MS; to++)
+        kernel_delay(milliseconds(1));
+}
+
+/* Without a device tree, the firmware is asked about each affinity in
+   turn: cores count up from 0 in Aff0 within clusters counting up from 0
+   in Aff1. Returns the number of processors present. */
+int start_cpus(void)
+{
+    u64 self = current_cpu()->m.mpidr;
+    int present = 1;
+    for (u64 aff1 = 0; aff1 < MP_MAX_AFF1; aff1++) {
+        u64 aff0;
+        for (aff0 = 0; aff0 < MP_MAX_AFF0; aff0++) {
+            u64 mpidr = u64_from_field(MPIDR_AFF1, aff1) | u64_from_field(MPIDR_AFF0, aff0);
+            if (mpidr == self)
+                continue;
+            s64 state = psci_affinity_info(mpidr);
+            if (state < 0)
+                break;
+            present++;
+            if (state == PSCI_AFFINITY_OFF)
+                start_cpu(total_processors, mpidr);
+        }
+        if (aff0 == 0)
+            break;
+    }
+    return present;
+}
+
+void allocate_apboot(heap stackheap, void (*ap_entry)())
+{
+    start_callback = ap_entry;
+    ap_heap = stackheap;
+
+    /* identity map the entry code for the switch to the kernel tables */
+    u64 start = physical_from_virtual(&ap_start_vector);
+    ap_start_range = irange(start & ~PAGEMASK,
+                            pad(start + (&ap_start_vector_end - &ap_start_vector), PAGESIZE));
+    map(ap_start_range.start, ap_start_range.start, range_span(ap_start_range),
+        pageflags_exec(pageflags_memory()));
+
+    ap_start_info.mair = read_psr(MAIR_EL1);
+    ap_start_info.tcr = read_psr(TCR_EL1);
+    ap_start_info.ttbr0 = user_tablebase;
+    ap_start_info.ttbr1 = kernel_tablebase;
+    ap_start_info.sctlr = read_psr(SCTLR_EL1);
+    ap_start_info.entry = u64_from_pointer(ap_start);
+}
+
+void deallocate_apboot(heap stackheap)
+{
+    unmap(ap_start_range.start, range_span(ap_start_range));
+}
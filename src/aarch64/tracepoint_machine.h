@@ -0,0 +1,38 @@
+/* A site is a NOP, patched to a direct branch when enabled. Both are
+   single naturally aligned instructions, so the update is a single-copy
+   atomic store followed by cache maintenance. */
+#define TRACEPOINT_INSN_SIZE 4
+#define TRACEPOINT_INSN_NOP  0xd503201f
+#define TRACEPOINT_INSN_B    0x14000000
+
+static inline __attribute__((always_inline)) boolean tracepoint_branch(tracepoint tp)
+{
+    asm goto("1: nop\n"
+             ".pushsection .tracepoint_sites, \"a\"\n"
+             ".balign 8\n"
+             ".quad 1b, %l[enabled], %c0\n"
+             ".popsection\n"
+             : : "i" (tp) : : enabled);
+    return false;
+  enabled:
+    return true;
+}
+
+/* alias is a writable mapping of the instruction at code */
+static inline void tracepoint_patch_site(void *alias, u64 code, u64 target, boolean enable)
+{
+    u32 insn = TRACEPOINT_INSN_NOP;
+    if (enable) {
+        s64 rel = target - code;
+        assert((rel & 3) == 0 && rel >= -(1ll << 27) && rel < (1ll << 27));
+        insn = TRACEPOINT_INSN_B | ((rel >> 2) & MASK(26));
+    }
+    *(volatile u32 *)alias = insn;
+    asm volatile("dc cvau, %0; dsb ish; ic ivau, %1; dsb ish; isb" ::
+                 "r" (alias), "r" (code) : "memory");
+}
+
+static inline void tracepoint_sync_core(void)
+{
+    asm volatile("isb" ::: "memory");
+}
@@ -465,6 +465,7 @@ static int ena_setup_rx_resources(struct ena_adapter *adapter, unsigned int qid)
 
     rx_ring->next_to_clean = 0;
     rx_ring->next_to_use = 0;
+    netif_gro_init(&rx_ring->gro, &adapter->ifp);
 
     return 0;
 
@@ -1411,6 +1412,11 @@ static err_t ena_init(struct netif *netif)
     netif->linkoutput = ena_linkoutput;
     netif->hwaddr_len = ETHARP_HWADDR_LEN;
     netif->mtu = sizeof(struct ip_hdr) + sizeof(struct tcp_hdr) + TCP_MSS;
+    if (adapter->tx_offloads & (ENA_ADMIN_FEATURE_OFFLOAD_DESC_TX_L4_IPV4_CSUM_PART_MASK |
+                                ENA_ADMIN_FEATURE_OFFLOAD_DESC_TX_L4_IPV6_CSUM_PART_MASK))
+        netif_tx_csum_offload(netif);
+    for (int i = 0; i < adapter->num_io_queues; i++)
+        ena_tx_batch_init(&adapter->tx_ring[i]);
     return ERR_OK;
 }
 
@@ -2057,6 +2063,9 @@ static boolean ena_attach(heap general, heap page_allocator, pci_dev d)
 
     adapter->max_mtu = get_feat_ctx.dev_attr.max_mtu;
 
+    adapter->tx_offloads = get_feat_ctx.offload.tx;
+    adapter->rx_offloads = get_feat_ctx.offload.rx_supported;
+
     adapter->reset_reason = ENA_REGS_RESET_NORMAL;
 
     /*
@@ -254,6 +254,9 @@ struct ena_stats_rx {
 declare_closure_struct(1, 0, void, ena_enqueue_task,
         struct ena_ring *, ring);
 
+declare_closure_struct(1, 0, void, ena_tx_flush,
+        struct ena_ring *, tx_ring);
+
 struct ena_ring {
     /* Holds the empty requests for TX/RX out of order completions */
     union {
@@ -314,6 +317,13 @@ struct ena_ring {
     /* How many packets are sent in one Tx loop, used for doorbells */
     uint32_t acum_pkts;
 
+    /* Tx only: doorbells for frames posted by ena_linkoutput() */
+    struct netif_tx_batch tx_batch;
+    closure_struct(ena_tx_flush, tx_flush);
+
+    /* Rx only */
+    struct netif_gro gro;
+
     /* Used for LLQ */
     uint8_t *push_buf_intermediate_buf;
 } ____cacheline_aligned;
@@ -363,6 +373,10 @@ struct ena_adapter {
 
     uint32_t max_mtu;
 
+    /* device stateless offload capabilities (ena_admin_feature_offload_desc) */
+    uint32_t tx_offloads;
+    uint32_t rx_offloads;
+
     uint32_t num_io_queues;
     uint32_t max_num_io_queues;
 
@@ -44,8 +44,11 @@ static int ena_rx_cleanup(struct ena_ring *);
 static inline int validate_tx_req_id(struct ena_ring *, uint16_t);
 static struct pbuf *ena_rx_mbuf(struct ena_ring *, struct ena_com_rx_buf_info *,
                                 struct ena_com_rx_ctx *, uint16_t *);
+static boolean ena_rx_checksum(struct ena_ring *, struct ena_com_rx_ctx *);
+static void ena_tx_csum(struct ena_adapter *, struct ena_com_tx_ctx *, struct pbuf *);
 static int ena_xmit_mbuf(struct ena_ring *, struct pbuf **);
 static void ena_start_xmit(struct ena_ring *);
+static void ena_tx_doorbell(struct ena_ring *);
 
 /*********************************************************************
  *  Global functions
@@ -104,10 +107,31 @@ void ena_deferred_mq_start(void *arg, int pending)
     while (!queue_empty(tx_ring->br) && tx_ring->running && netif_is_flag_set(netif, NETIF_FLAG_UP)) {
         ENA_RING_MTX_LOCK(tx_ring);
         ena_start_xmit(tx_ring);
+        if (tx_ring->acum_pkts != 0)
+            ena_tx_doorbell(tx_ring);
         ENA_RING_MTX_UNLOCK(tx_ring);
     }
 }
 
+/* Frames posted from ena_linkoutput() are left for the device until the
+   batch is flushed. */
+define_closure_function(1, 0, void, ena_tx_flush,
+                        struct ena_ring *, tx_ring)
+{
+    struct ena_ring *tx_ring = bound(tx_ring);
+
+    ENA_RING_MTX_LOCK(tx_ring);
+    if (tx_ring->acum_pkts != 0)
+        ena_tx_doorbell(tx_ring);
+    ENA_RING_MTX_UNLOCK(tx_ring);
+}
+
+void ena_tx_batch_init(struct ena_ring *tx_ring)
+{
+    netif_tx_batch_init(&tx_ring->tx_batch, &tx_ring->adapter->ifp,
+                        init_closure(&tx_ring->tx_flush, ena_tx_flush, tx_ring));
+}
+
 err_t ena_linkoutput(struct netif *netif, struct pbuf *p)
 {
     struct ena_adapter *adapter = netif->state;
@@ -360,7 +384,6 @@ static int ena_rx_cleanup(struct ena_ring *rx_ring)
     struct ena_com_io_cq *io_cq;
     struct ena_com_io_sq *io_sq;
     enum ena_regs_reset_reason_types reset_reason;
-    struct netif *ifp;
     uint16_t ena_qid;
     uint16_t next_to_clean;
     uint32_t refill_required;
@@ -370,7 +393,6 @@ static int ena_rx_cleanup(struct ena_ring *rx_ring)
     int budget = RX_BUDGET;
 
     adapter = rx_ring->que->adapter;
-    ifp = &adapter->ifp;
     qid = rx_ring->que->id;
     ena_qid = ENA_IO_RXQ_IDX(qid);
     io_cq = &adapter->ena_dev->io_cq_queues[ena_qid];
@@ -394,6 +416,7 @@ static int ena_rx_cleanup(struct ena_ring *rx_ring)
                 rx_ring->rx_stats.bad_req_id++;
                 reset_reason = ENA_REGS_RESET_INV_RX_REQ_ID;
             }
+            netif_gro_flush(&rx_ring->gro);
             ena_trigger_reset(adapter, reset_reason);
             return (0);
         }
@@ -421,12 +444,13 @@ static int ena_rx_cleanup(struct ena_ring *rx_ring)
         adapter->hw_stats.rx_bytes += mbuf->tot_len;
 
         ena_trace(NULL, ENA_DBG | ENA_RXPTH, "calling if_input() with mbuf %p\n", mbuf);
-        (*ifp->input)(mbuf, ifp);
+        netif_gro_receive(&rx_ring->gro, mbuf, ena_rx_checksum(rx_ring, &ena_rx_ctx));
 
         rx_ring->rx_stats.cnt++;
         adapter->hw_stats.rx_packets++;
     } while (--budget);
 
+    netif_gro_flush(&rx_ring->gro);
     rx_ring->next_to_clean = next_to_clean;
 
     refill_required = ena_com_free_q_entries(io_sq);
@@ -463,6 +487,56 @@ static int ena_tx_map_mbuf(struct ena_ring *tx_ring, struct ena_tx_buffer *tx_in
     return (0);
 }
 
+/**
+ * ena_rx_checksum - whether the device verified the L4 checksum
+ * @rx_ring: ring the packet was received on
+ * @ena_rx_ctx: metadata for the packet
+ *
+ **/
+static boolean ena_rx_checksum(struct ena_ring *rx_ring, struct ena_com_rx_ctx *ena_rx_ctx)
+{
+    struct ena_adapter *adapter = rx_ring->adapter;
+    uint32_t offload = ena_rx_ctx->l3_proto == ENA_ETH_IO_L3_PROTO_IPV6 ?
+        ENA_ADMIN_FEATURE_OFFLOAD_DESC_RX_L4_IPV6_CSUM_MASK :
+        ENA_ADMIN_FEATURE_OFFLOAD_DESC_RX_L4_IPV4_CSUM_MASK;
+    return (adapter->rx_offloads & offload) &&
+        (ena_rx_ctx->l4_proto == ENA_ETH_IO_L4_PROTO_TCP ||
+         ena_rx_ctx->l4_proto == ENA_ETH_IO_L4_PROTO_UDP) &&
+        ena_rx_ctx->l4_csum_checked && !ena_rx_ctx->l4_csum_err && !ena_rx_ctx->frag;
+}
+
+/**
+ * ena_tx_csum - set up checksum offload for a packet
+ * @adapter: device the packet is sent on
+ * @ena_tx_ctx: transmit context to fill
+ * @mbuf: the packet
+ *
+ * The checksum is completed in software if the device cannot offload it
+ * for the packet's IP version.
+ **/
+static void ena_tx_csum(struct ena_adapter *adapter, struct ena_com_tx_ctx *ena_tx_ctx,
+                        struct pbuf *mbuf)
+{
+    struct netif_csum_info ci;
+    if (!netif_tx_csum_prepare(&adapter->ifp, mbuf, &ci))
+        return;
+    uint32_t offload = ci.ipv6 ? ENA_ADMIN_FEATURE_OFFLOAD_DESC_TX_L4_IPV6_CSUM_PART_MASK :
+        ENA_ADMIN_FEATURE_OFFLOAD_DESC_TX_L4_IPV4_CSUM_PART_MASK;
+    if (!(adapter->tx_offloads & offload)) {
+        netif_tx_csum_complete(mbuf, &ci);
+        return;
+    }
+    struct ena_com_tx_meta *ena_meta = &ena_tx_ctx->ena_meta;
+    ena_tx_ctx->l3_proto = ci.ipv6 ? ENA_ETH_IO_L3_PROTO_IPV6 : ENA_ETH_IO_L3_PROTO_IPV4;
+    ena_tx_ctx->l4_proto = ENA_ETH_IO_L4_PROTO_TCP;
+    ena_tx_ctx->l4_csum_enable = 1;
+    ena_tx_ctx->l4_csum_partial = 1;
+    ena_meta->l3_hdr_offset = ci.l3_offset;
+    ena_meta->l3_hdr_len = ci.l4_offset - ci.l3_offset;
+    ena_meta->l4_hdr_len = ci.l4_hdr_len / 4;
+    ena_tx_ctx->meta_valid = 1;
+}
+
 static int ena_xmit_mbuf(struct ena_ring *tx_ring, struct pbuf **mbuf)
 {
     struct ena_adapter *adapter;
@@ -499,15 +573,14 @@ static int ena_xmit_mbuf(struct ena_ring *tx_ring, struct pbuf **mbuf)
     ena_tx_ctx.num_bufs = tx_info->num_of_bufs;
     ena_tx_ctx.req_id = req_id;
     ena_tx_ctx.header_len = 0;
+    ena_tx_csum(adapter, &ena_tx_ctx, *mbuf);
 
     if (tx_ring->acum_pkts == DB_THRESHOLD ||
             ena_com_is_doorbell_needed(tx_ring->ena_com_io_sq, &ena_tx_ctx)) {
         ena_trace(NULL, ENA_DBG | ENA_TXPTH,
             "llq tx max burst size of queue %d achieved, writing doorbell to send burst\n",
             tx_ring->que->id);
-        ena_com_write_sq_doorbell(tx_ring->ena_com_io_sq);
-        tx_ring->tx_stats.doorbells++;
-        tx_ring->acum_pkts = 0;
+        ena_tx_doorbell(tx_ring);
     }
 
     /* Prepare the packet's descriptors and send them to device */
@@ -569,13 +642,21 @@ dma_error:
     return (rc);
 }
 
+static void ena_tx_doorbell(struct ena_ring *tx_ring)
+{
+    /* Trigger the dma engine */
+    ena_com_write_sq_doorbell(tx_ring->ena_com_io_sq);
+    tx_ring->tx_stats.doorbells++;
+    tx_ring->acum_pkts = 0;
+    netif_tx_doorbell(&tx_ring->tx_batch);
+}
+
+/* Posts queued frames; the doorbell is left to the caller. */
 static void ena_start_xmit(struct ena_ring *tx_ring)
 {
     struct pbuf *mbuf;
     struct ena_adapter *adapter = tx_ring->adapter;
     struct netif *netif = &adapter->ifp;
-    struct ena_com_io_sq *io_sq;
-    int ena_qid;
     int ret = 0;
 
     if (unlikely(!netif_is_flag_set(netif, NETIF_FLAG_UP)))
@@ -584,9 +665,6 @@ static void ena_start_xmit(struct ena_ring *tx_ring)
     if (unlikely(!ENA_FLAG_ISSET(ENA_FLAG_LINK_UP, adapter)))
         return;
 
-    ena_qid = ENA_IO_TXQ_IDX(tx_ring->que->id);
-    io_sq = &adapter->ena_dev->io_sq_queues[ena_qid];
-
     while (tx_ring->running && ((mbuf = dequeue(tx_ring->br)) != INVALID_ADDRESS)) {
         ena_trace(NULL, ENA_DBG | ENA_TXPTH, "\ndequeued mbuf %p\n", mbuf);
 
@@ -606,13 +684,7 @@ static void ena_start_xmit(struct ena_ring *tx_ring)
             return;
 
         tx_ring->acum_pkts++;
-    }
-
-    if (likely(tx_ring->acum_pkts != 0)) {
-        /* Trigger the dma engine */
-        ena_com_write_sq_doorbell(io_sq);
-        tx_ring->tx_stats.doorbells++;
-        tx_ring->acum_pkts = 0;
+        netif_tx_batch_add(&tx_ring->tx_batch);
     }
 
     if (unlikely(!tx_ring->running))
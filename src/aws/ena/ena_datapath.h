@@ -33,6 +33,7 @@
 
 void ena_cleanup(void *arg, int pending);
 err_t ena_linkoutput(struct netif *netif, struct pbuf *p);
+void ena_tx_batch_init(struct ena_ring *tx_ring);
 void ena_deferred_mq_start(void *arg, int pending);
 
 #endif /* ENA_TXRX_H */
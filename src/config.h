@@ -20,6 +20,18 @@
 /* runloop timer minimum and maximum */
 #define RUNLOOP_TIMER_MAX_PERIOD_US     100000
 #define RUNLOOP_TIMER_MIN_PERIOD_US     1000
+#define RUNLOOP_TIMER_SLACK_US          50
+
+/* scheduler time slices: SCHED_OTHER at nice 0 (scaled by the weight of
+   the nice level, within the minimum and maximum) and SCHED_RR */
+#define SCHED_TIMESLICE_US              10000
+#define SCHED_TIMESLICE_MIN_US          1000
+#define SCHED_TIMESLICE_MAX_US          1000000
+#define SCHED_RR_TIMESLICE_US           100000
+
+/* a thread waking up preempts the thread running on its cpu if behind it
+   in vruntime by more than this */
+#define SCHED_WAKEUP_GRANULARITY_US     1000
 
 /* length of thread scheduling queue */
 #define MAX_THREADS 8192
@@ -45,6 +57,9 @@
 /* mm stuff */
 #define PAGECACHE_DRAIN_CUTOFF (64 * MB)
 #define PAGECACHE_SCAN_PERIOD_SECONDS 5
+#define PAGECACHE_WRITEBACK_DELAY_SECONDS 1
+#define PAGECACHE_WRITEBACK_DIRTY_MAX (4 * MB)
+#define PAGECACHE_WRITEBACK_CLUSTER_PAGES 256
 
 /* don't go below this minimum amount of physical memory when inflating balloon */
 #define BALLOON_MEMORY_MINIMUM (16 * MB)
@@ -58,6 +73,9 @@
 /* ftrace buffer size */
 #define DEFAULT_TRACE_ARRAY_SIZE        (512ULL << 20)
 
+/* per-cpu tracepoint event buffer, must be a power of 2 */
+#define TRACEPOINT_BUFFER_EVENTS        4096
+
 /* on-disk log dump section */
 #define KLOG_DUMP_SIZE  (4 * KB)
 
@@ -25,6 +25,15 @@ static kernel_heaps init_heaps;
 static struct kernel_heaps heaps;
 static vector shutdown_completions;
 
+closure_function(2, 1, void, block_io_trace_complete,
+                 range, blocks, status_handler, sh,
+                 status, s)
+{
+    trace_event(block_complete, range_span(bound(blocks)), bound(blocks).start, s);
+    apply(bound(sh), s);
+    closure_finish();
+}
+
 closure_function(2, 3, void, offset_block_io,
                  u64, offset, block_io, io,
                  void *, dest, range, blocks, status_handler, sh)
@@ -33,6 +42,12 @@ closure_function(2, 3, void, offset_block_io,
     u64 ds = bound(offset) >> SECTOR_OFFSET;
     blocks.start += ds;
     blocks.end += ds;
+    trace_event(block_submit, range_span(blocks), blocks.start, dest);
+    if (tracepoint_enabled(block_complete)) {
+        status_handler tsh = closure(heap_locked(init_heaps), block_io_trace_complete, blocks, sh);
+        if (tsh != INVALID_ADDRESS)
+            sh = tsh;
+    }
 
     // split I/O to storage driver to PAGESIZE requests
     merge m = allocate_merge(heap_locked(init_heaps), sh);
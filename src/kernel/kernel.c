@@ -12,6 +12,7 @@
 
 static kernel_context spare_kernel_context;
 struct mm_stats mm_stats;
+struct pv_ops pv_ops;
 
 context allocate_frame(heap h)
 {
@@ -100,8 +101,28 @@ cpuinfo init_cpuinfo(heap backed, int cpu)
     ci->have_kernel_lock = false;
     ci->thread_queue = allocate_queue(backed, MAX_THREADS);
     assert(ci->thread_queue != INVALID_ADDRESS);
-    ci->last_timer_update = 0;
+    spin_lock_init(&ci->rt_queue.lock);
+    ci->rt_queue.count = 0;
+    zero(ci->rt_queue.active, sizeof(ci->rt_queue.active));
+    for (int i = 0; i <= SCHED_RT_PRIO_MAX; i++)
+        list_init(&ci->rt_queue.levels[i]);
+    init_fair_queue(&ci->fair_queue);
+    ci->sched_thread = 0;
+    ci->sched_prio = 0;
+    ci->sched_weight = 0;
+    ci->timer_deadline = 0;
+    ci->timer_interrupts = 0;
     ci->frcount = 0;
+    ci->direct_returns = 0;
+    ci->lock_nest = 0;
+    for (int i = 0; i < SPIN_LOCK_NODES; i++)
+        ci->lock_nodes[i].cpu = cpu;
+    ci->idle_polling = false;
+    ci->idle_halted = false;
+    ci->idle_poll_limit = 0;
+    ci->idle_start = 0;
+    ci->wakeup_time = 0;
+    zero(&ci->idle_stats, sizeof(ci->idle_stats));
 
     init_cpuinfo_machine(ci, backed);
 
@@ -5,17 +5,78 @@
 #include <management.h>
 #include <page.h>
 #include "klib.h"
+#include <tracepoint.h>
+
+/* scheduling policies, with the values of the Linux ABI */
+#define SCHED_OTHER     0
+#define SCHED_FIFO      1
+#define SCHED_RR        2
+#define SCHED_BATCH     3
+#define SCHED_IDLE      5
+
+#define SCHED_RT_PRIO_MAX       99
+#define SCHED_NICE_MIN          (-20)
+#define SCHED_NICE_MAX          19
 
 typedef struct nanos_thread {
     thunk pause;
+    bitmap affinity;            /* cpus the thread may run on */
+    u8 policy;
+    u8 rt_priority;             /* 1 to SCHED_RT_PRIO_MAX for SCHED_FIFO and SCHED_RR */
+    s8 nice;
+    boolean yielding;           /* to be queued behind threads of equal priority */
+    u32 weight;                 /* share of the cpu under SCHED_OTHER, from nice */
+    timestamp slice_end;        /* of the SCHED_RR time slice in progress */
+    timestamp vruntime;         /* run time, scaled by the inverse of weight */
+    struct list rt_l;           /* queued in the rt_queue of a cpu... */
+    u8 rt_queued_priority;      /* ...at this priority */
+    struct rbnode fair_n;       /* or else in the fair_queue of a cpu... */
+    context queued_frame;       /* ...with this frame */
 } *nanos_thread;
 
+static inline boolean sched_thread_rt(nanos_thread nt)
+{
+    return nt && (nt->policy == SCHED_FIFO || nt->policy == SCHED_RR);
+}
+
 #define cpu_not_present 0
 #define cpu_idle 1
 #define cpu_kernel 2
 #define cpu_interrupt 3
 #define cpu_user 4
 
+/* entry of a cpu in the queue of a contended spinlock; there is one per
+   level of nesting (kernel, interrupt, fault in interrupt...) */
+#define SPIN_LOCK_NODES 4
+
+typedef struct spin_lock_node {
+    struct spin_lock_node *next;
+    u32 locked;                 /* set by the previous waiter on handoff */
+    u32 halted;                 /* paravirtual: waiting for a kick */
+    u32 cpu;
+} *spin_lock_node;
+
+/* The run queues hold spinlocks, which the boot stages don't have; klibs
+   see them for the cpuinfo layout to match that of the kernel. */
+#if defined(KERNEL) || defined(KLIB)
+/* threads of real-time policies waiting to run on a cpu, one list per
+   priority */
+struct rt_queue {
+    struct spinlock lock;
+    u64 count;
+    u64 active[2];              /* bit set for each non-empty list */
+    struct list levels[SCHED_RT_PRIO_MAX + 1];
+};
+
+/* threads of other policies waiting to run on a cpu, by vruntime */
+struct fair_queue {
+    struct spinlock lock;
+    u64 count;
+    struct rbtree threads;
+    timestamp min_vruntime;     /* only increases, as the queue is served */
+};
+#endif
+
 /* per-cpu, architecture-independent invariants */
 typedef struct cpuinfo {
     struct cpuinfo_machine m;
@@ -23,9 +84,39 @@ typedef struct cpuinfo {
     int state;
     boolean have_kernel_lock;
     queue thread_queue;
-    timestamp last_timer_update;
+#if defined(KERNEL) || defined(KLIB)
+    struct rt_queue rt_queue;
+    struct fair_queue fair_queue;
+#endif
+    nanos_thread sched_thread;  /* last dispatched, until the cpu reenters the runloop */
+    u8 sched_prio;              /* real-time priority of the last dispatched thread */
+    u32 sched_weight;           /* of the last dispatched thread if not real-time, or else 0... */
+    timestamp sched_vruntime;   /* ...its vruntime... */
+    timestamp sched_start;      /* ...and when it was dispatched */
+    timestamp timer_deadline;   /* platform timer armed for, if in the future */
+    u64 timer_interrupts;
     u64 frcount;
+    u64 direct_returns;         /* syscalls returned through sched_direct_return() */
     u64 inval_gen; /* Generation number for invalidates */
+    u32 lock_nest;
+    struct spin_lock_node lock_nodes[SPIN_LOCK_NODES];
+
+    /* idle polling (see kernel_sleep()) */
+    boolean idle_polling;       /* watching idle_cpu_mask, no wakeup ipi needed */
+    boolean idle_halted;
+    timestamp idle_poll_limit;
+    timestamp idle_start;
+    timestamp wakeup_time;
+    struct cpu_idle_stats {
+        timestamp residency;
+        u64 poll_wakeups;
+        u64 halt_wakeups;
+        u64 wakeups;
+        timestamp wakeup_latency;
+        timestamp wakeup_latency_max;
+    } idle_stats;
+
+    void *lwip_pools;           /* free lists of lwIP pool objects (see net.c) */
 
 #ifdef CONFIG_FTRACE
     int graph_idx;
@@ -50,6 +141,27 @@ static inline cpuinfo cpuinfo_from_id(int cpu)
     return vector_get(cpuinfos, cpu);
 }
 
+/* Paravirtual cpu interfaces, filled in by the platform where the
+   hypervisor offers them (see kvm_platform.c). */
+struct pv_ops {
+    timestamp (*steal_time)(cpuinfo ci);        /* time the vcpu was runnable but not running */
+    boolean (*preempted)(cpuinfo ci);           /* vcpu scheduled out by the host */
+    boolean (*defer_tlb_flush)(cpuinfo ci);     /* preempted vcpu to flush its TLB on reentry */
+    void (*yield_to)(cpuinfo ci);               /* give up the time slice to a preempted vcpu */
+};
+
+extern struct pv_ops pv_ops;
+
+static inline timestamp cpu_steal_time(cpuinfo ci)
+{
+    return pv_ops.steal_time ? pv_ops.steal_time(ci) : 0;
+}
+
+static inline boolean cpu_preempted(cpuinfo ci)
+{
+    return pv_ops.preempted && pv_ops.preempted(ci);
+}
+
 static inline boolean is_current_kernel_context(context f)
 {
     return f == current_cpu()->m.kernel_context->frame;
@@ -267,8 +379,10 @@ void register_shirq(int vector, thunk t, const char *name);
 void kern_lock(void);
 boolean kern_try_lock(void);
 void kern_unlock(void);
+void spin_lock_pv_init(void (*kick)(int cpu));
 void init_scheduler(heap);
 void init_scheduler_cpus(heap h);
+void init_isolated_cpus(heap h, tuple root);
 void mm_service(void);
 
 typedef closure_type(balloon_deflater, u64, u64);
@@ -286,15 +400,26 @@ boolean first_boot(void);
 extern void interrupt_exit(void);
 extern char **state_strings;
 
-// static inline void schedule_frame(context f) stupid header deps
-#define schedule_frame(___f)  do { context __f = ___f; assert((__f)[FRAME_QUEUE] != INVALID_PHYSICAL); if ((__f)[FRAME_THREAD]) apply(((nanos_thread)(__f)[FRAME_THREAD])->pause); assert(enqueue_irqsafe((queue)pointer_from_u64((__f)[FRAME_QUEUE]), pointer_from_u64((__f)[FRAME_RUN]))); } while(0)
+/* Thread queues hold frames, so that the scheduler can check the affinity
+   and policy of their threads; the frame's FRAME_RUN thunk is applied to
+   run it. schedule_frame() queues a frame on the cpu in FRAME_CPU. */
+void schedule_frame(context f);
+void sched_direct_return(context f);
+void sched_thread_init(nanos_thread nt);
+void sched_set_policy(nanos_thread nt, int policy, int priority);
+void sched_set_nice(nanos_thread nt, int nice);
+void sched_thread_charge(nanos_thread nt, timestamp run);
+timestamp sched_thread_timeslice(nanos_thread nt);
+#if defined(KERNEL) || defined(KLIB)
+void init_fair_queue(struct fair_queue *fq);
+#endif
 
 void kernel_unlock();
 
 extern bitmap idle_cpu_mask;
+extern bitmap isolated_cpu_mask;
 extern u64 total_processors;
 extern u64 present_processors;
-extern void xsave(context f);
 
 void cpu_init(int cpu);
 void start_secondary_cores(kernel_heaps kh);
@@ -306,6 +431,7 @@ void add_shutdown_completion(shutdown_handler h);
 extern int shutdown_vector;
 extern boolean shutting_down;
 void wakeup_or_interrupt_cpu_all();
+void wakeup_cpu_runnable(u64 cpu);
 
 typedef closure_type(halt_handler, void, int);
 extern halt_handler vm_halt;
@@ -17,6 +17,27 @@
 #define KVM_CPUID_FEATURES  0x40000001
 #define KVM_MSR_SYSTEM_TIME 0x4b564d01
 #define KVM_MSR_WALL_CLOCK  0x4b564d00
+#define KVM_MSR_STEAL_TIME  0x4b564d03
+#define KVM_MSR_PV_EOI_EN   0x4b564d04
+#define KVM_MSR_ENABLED     1
+
+#define KVM_FEATURE_STEAL_TIME      5
+#define KVM_FEATURE_PV_EOI          6
+#define KVM_FEATURE_PV_UNHALT       7
+#define KVM_FEATURE_PV_TLB_FLUSH    9
+#define KVM_FEATURE_PV_SEND_IPI     11
+#define KVM_FEATURE_PV_SCHED_YIELD  13
+#define KVM_HINTS_REALTIME          0   /* vcpus are never preempted */
+
+#define KVM_HC_KICK_CPU         5
+#define KVM_HC_SEND_IPI         10
+#define KVM_HC_SCHED_YIELD      11
+
+#define KVM_VCPU_PREEMPTED      (1 << 0)
+#define KVM_VCPU_FLUSH_TLB      (1 << 1)
+
+#define CPUID_VENDOR_AMD        0x68747541  /* "Auth" */
+#define CPUID_VENDOR_HYGON      0x6f677948  /* "Hygo" */
 
 void halt(char *format, ...)
 {
@@ -56,6 +77,137 @@ static boolean probe_kvm_pvclock(kernel_heaps kh)
     return true;
 }
 
+static boolean kvm_vmmcall;
+static u32 kvm_features;
+static u32 kvm_hints;
+
+static inline boolean kvm_has_feature(int f)
+{
+    return (kvm_features & U64_FROM_BIT(f)) != 0;
+}
+
+#ifdef SMP_ENABLE
+static u64 kvm_hypercall(u64 nr, u64 a0, u64 a1, u64 a2, u64 a3)
+{
+    u64 ret;
+    if (kvm_vmmcall)
+        asm volatile("vmmcall" : "=a"(ret) :
+                     "a"(nr), "b"(a0), "c"(a1), "d"(a2), "S"(a3) : "memory");
+    else
+        asm volatile("vmcall" : "=a"(ret) :
+                     "a"(nr), "b"(a0), "c"(a1), "d"(a2), "S"(a3) : "memory");
+    return ret;
+}
+
+/* wakes a vcpu halted in a spinlock */
+static void kvm_kick_cpu(int cpu)
+{
+    kvm_hypercall(KVM_HC_KICK_CPU, 0, apicid_from_cpuid(cpu), 0, 0);
+}
+
+static void probe_kvm_pv_spinlocks(void)
+{
+    if (!kvm_has_feature(KVM_FEATURE_PV_UNHALT) || (kvm_hints & U64_FROM_BIT(KVM_HINTS_REALTIME))) {
+        kvm_debug("no paravirtual spinlocks");
+        return;
+    }
+    spin_lock_pv_init(kvm_kick_cpu);
+    kvm_debug("paravirtual spinlocks enabled");
+}
+
+/* The flag is cleared by the hypervisor when the vcpu is scheduled in, so
+   setting it succeeds only while the vcpu is still out. */
+static boolean kvm_defer_tlb_flush(cpuinfo ci)
+{
+    u8 *p = &ci->m.steal_time.preempted;
+    u8 state = *(volatile u8 *)p;
+    return (state & KVM_VCPU_PREEMPTED) &&
+        __sync_bool_compare_and_swap(p, state, state | KVM_VCPU_FLUSH_TLB);
+}
+
+static void kvm_yield_to(cpuinfo ci)
+{
+    kvm_hypercall(KVM_HC_SCHED_YIELD, apicid_from_cpuid(ci->id), 0, 0, 0);
+}
+
+static void kvm_send_ipi(u64 mask_lo, u64 mask_hi, u32 min, u64 icr)
+{
+    kvm_hypercall(KVM_HC_SEND_IPI, mask_lo, mask_hi, min, icr);
+}
+#endif
+
+#ifdef KERNEL
+/* The hypervisor updates the steal time area of a vcpu, with the version
+   odd meanwhile, each time it schedules the vcpu in. */
+static timestamp kvm_steal_time(cpuinfo ci)
+{
+    volatile struct pv_steal_time *st = &ci->m.steal_time;
+    u32 version;
+    u64 steal;
+    do {
+        version = st->version;
+        read_barrier();
+        steal = st->steal;
+        read_barrier();
+    } while ((version & 1) || version != st->version);
+    return nanoseconds(steal);
+}
+
+static boolean kvm_preempted(cpuinfo ci)
+{
+    return (*(volatile u8 *)&ci->m.steal_time.preempted & KVM_VCPU_PREEMPTED) != 0;
+}
+
+/* Registers the shared areas of the calling cpu. */
+static void kvm_pv_cpu_init(void)
+{
+    cpuinfo ci = current_cpu();
+    if (pv_ops.steal_time)
+        write_msr(KVM_MSR_STEAL_TIME, physical_from_virtual(&ci->m.steal_time) | KVM_MSR_ENABLED);
+    if (kvm_has_feature(KVM_FEATURE_PV_EOI)) {
+        ci->m.pv_eoi = 0;
+        write_msr(KVM_MSR_PV_EOI_EN, physical_from_virtual(&ci->m.pv_eoi) | KVM_MSR_ENABLED);
+    }
+}
+
+closure_function(1, 0, void, kvm_percpu_init,
+                 thunk, timer_init)
+{
+    if (bound(timer_init))
+        apply(bound(timer_init));
+    kvm_pv_cpu_init();
+}
+
+/* Halts and preemptions of vcpus, and the IPIs that undo them, are all VM
+   exits: with steal time, other vcpus can tell that a vcpu is preempted
+   and leave its TLB flushes to the hypervisor, or yield to it when
+   waiting on it. */
+static void probe_kvm_pv_features(void)
+{
+    if (kvm_has_feature(KVM_FEATURE_STEAL_TIME)) {
+        pv_ops.steal_time = kvm_steal_time;
+        pv_ops.preempted = kvm_preempted;
+        kvm_debug("steal time enabled");
+    }
+#ifdef SMP_ENABLE
+    boolean realtime = (kvm_hints & U64_FROM_BIT(KVM_HINTS_REALTIME)) != 0;
+    if (pv_ops.preempted && kvm_has_feature(KVM_FEATURE_PV_TLB_FLUSH) && !realtime) {
+        pv_ops.defer_tlb_flush = kvm_defer_tlb_flush;
+        kvm_debug("paravirtual TLB flush enabled");
+    }
+    if (kvm_has_feature(KVM_FEATURE_PV_SCHED_YIELD) && !realtime) {
+        pv_ops.yield_to = kvm_yield_to;
+        kvm_debug("paravirtual yield enabled");
+    }
+    if (kvm_has_feature(KVM_FEATURE_PV_SEND_IPI)) {
+        apic_pv_ipi = kvm_send_ipi;
+        kvm_debug("paravirtual IPIs enabled");
+    }
+#endif
+    kvm_pv_cpu_init();
+}
+#endif
+
 boolean kvm_detect(kernel_heaps kh)
 {
     kvm_debug("probing for KVM...");
@@ -73,6 +225,17 @@ boolean kvm_detect(kernel_heaps kh)
         msg_err("unable to probe pvclock\n");
         return false;
     }
+    cpuid(KVM_CPUID_FEATURES, 0, v);
+    kvm_features = v[0];
+    kvm_hints = v[3];
+    cpuid(0, 0, v);
+    kvm_vmmcall = v[1] == CPUID_VENDOR_AMD || v[1] == CPUID_VENDOR_HYGON;
+#ifdef SMP_ENABLE
+    probe_kvm_pv_spinlocks();
+#endif
+#ifdef KERNEL
+    probe_kvm_pv_features();
+#endif
 
     clock_timer ct;
     thunk per_cpu_init;
@@ -84,6 +247,9 @@ boolean kvm_detect(kernel_heaps kh)
         halt("%s: no timer available\n", __func__);
     }
 
+#ifdef KERNEL
+    per_cpu_init = closure(heap_general(kh), kvm_percpu_init, per_cpu_init);
+#endif
     register_platform_clock_timer(ct, per_cpu_init);
     return true;
 }
@@ -0,0 +1,181 @@
+#include <kernel.h>
+
+/* Queued spinlocks
+
+   A cpu that finds a spinlock taken appends its queue entry to the tail
+   recorded in the lock word, then spins on its own entry until the waiter
+   ahead of it hands over the head of the queue. Only the head spins on the
+   lock word itself, so a release causes a single cache line transfer, and
+   the lock is granted in arrival order.
+
+   When paravirtual spinlocks are enabled, a waiter that has spun for a
+   while halts its vcpu instead of burning the time slice of a possibly
+   preempted lock holder. A waiter halted inside the queue is kicked by the
+   waiter that hands it the head; the halted head marks the lock word as
+   slow and records itself there, so that the unlock takes the slow path
+   and kicks it. */
+
+#define SPIN_LOCK_MASK      0xffull
+#define SPIN_TAIL_SHIFT     16
+#define SPIN_TAIL_MASK      (0xffffull << SPIN_TAIL_SHIFT)
+#define SPIN_HEAD_SHIFT     32  /* paravirtual: cpu + 1 of the halted head */
+#define SPIN_HEAD_MASK      (0xffffffffull << SPIN_HEAD_SHIFT)
+
+#define SPIN_THRESHOLD      (1 << 12)   /* spins before halting */
+
+boolean spin_lock_pv;
+static void (*spin_lock_kick)(int cpu);
+
+static inline u64 spin_tail(cpuinfo ci, u32 idx)
+{
+    return ((((u64)ci->id + 1) << 2) | idx) << SPIN_TAIL_SHIFT;
+}
+
+static inline spin_lock_node spin_tail_node(u64 tail)
+{
+    tail >>= SPIN_TAIL_SHIFT;
+    return &cpuinfo_from_id((tail >> 2) - 1)->lock_nodes[tail & 3];
+}
+
+/* Waits for the previous waiter to hand over the head of the queue. */
+static void spin_wait_node(spin_lock_node node)
+{
+    while (1) {
+        for (int i = 0; i < SPIN_THRESHOLD; i++) {
+            if (*(volatile u32 *)&node->locked)
+                return;
+            kern_pause();
+        }
+        if (!spin_lock_pv)
+            continue;
+        node->halted = 1;
+        memory_barrier();
+        if (!*(volatile u32 *)&node->locked)
+            spin_halt();
+        node->halted = 0;
+    }
+}
+
+static void spin_kick_node(spin_lock_node node)
+{
+    *(volatile u32 *)&node->locked = 1;
+    if (spin_lock_pv) {
+        memory_barrier();
+        if (*(volatile u32 *)&node->halted)
+            spin_lock_kick(node->cpu);
+    }
+}
+
+/* As the head of the queue, waits for the lock to be released and takes
+   it; returns the lock word as it was before. */
+static u64 spin_wait_head(spinlock l, cpuinfo ci, u64 tail)
+{
+    while (1) {
+        for (int i = 0; i < SPIN_THRESHOLD; i++) {
+            u64 w = *(volatile word *)&l->w;
+            if ((w & SPIN_LOCK_MASK) == 0) {
+                /* the last waiter empties the queue */
+                u64 new = (w & SPIN_TAIL_MASK) == tail ? SPIN_LOCKED : w | SPIN_LOCKED;
+                if (__sync_bool_compare_and_swap(&l->w, w, new))
+                    return w;
+                continue;
+            }
+            kern_pause();
+        }
+        if (!spin_lock_pv)
+            continue;
+        u64 w = *(volatile word *)&l->w;
+        if ((w & SPIN_LOCK_MASK) == SPIN_LOCKED) {
+            u64 slow = (w & ~SPIN_LOCK_MASK) | SPIN_LOCKED_SLOW |
+                (((u64)ci->id + 1) << SPIN_HEAD_SHIFT);
+            if (!__sync_bool_compare_and_swap(&l->w, w, slow))
+                continue;
+        } else if ((w & SPIN_LOCK_MASK) != SPIN_LOCKED_SLOW) {
+            continue;
+        }
+        spin_halt();
+    }
+}
+
+void spin_lock_slowpath(spinlock l)
+{
+    cpuinfo ci = current_cpu();
+    if (!ci) {
+        /* cpu still being brought up: no queue entry to wait on */
+        while (1) {
+            u64 w = *(volatile word *)&l->w;
+            if ((w & SPIN_LOCK_MASK) == 0 &&
+                __sync_bool_compare_and_swap(&l->w, w, w | SPIN_LOCKED))
+                return;
+            kern_pause();
+        }
+    }
+    u32 idx = ci->lock_nest++;
+    assert(idx < SPIN_LOCK_NODES);
+    spin_lock_node node = &ci->lock_nodes[idx];
+    node->next = 0;
+    node->locked = 0;
+    node->halted = 0;
+    u64 tail = spin_tail(ci, idx);
+    u64 w;
+    do {
+        w = *(volatile word *)&l->w;
+    } while (!__sync_bool_compare_and_swap(&l->w, w, (w & ~SPIN_TAIL_MASK) | tail));
+    if (w & SPIN_TAIL_MASK) {
+        spin_lock_node prev = spin_tail_node(w & SPIN_TAIL_MASK);
+        *(spin_lock_node volatile *)&prev->next = node;
+        spin_wait_node(node);
+    }
+    w = spin_wait_head(l, ci, tail);
+    if ((w & SPIN_TAIL_MASK) != tail) {
+        spin_lock_node next;
+        while (!(next = *(spin_lock_node volatile *)&node->next))
+            kern_pause();
+        spin_kick_node(next);
+    }
+    ci->lock_nest--;
+}
+
+/* The lock was marked slow by a halted head of the queue. */
+void spin_unlock_slowpath(spinlock l)
+{
+    u64 w;
+    do {
+        w = *(volatile word *)&l->w;
+    } while (!__sync_bool_compare_and_swap(&l->w, w, w & ~(SPIN_LOCK_MASK | SPIN_HEAD_MASK)));
+    assert((w & SPIN_LOCK_MASK) == SPIN_LOCKED_SLOW);
+    spin_lock_kick((w >> SPIN_HEAD_SHIFT) - 1);
+}
+
+void spin_rlock_slowpath(rw_spinlock l)
+{
+    /* queue behind the waiting writer */
+    __sync_fetch_and_sub(&l->readers, RW_READER);
+    spin_lock(&l->l);
+    __sync_fetch_and_add(&l->readers, RW_READER);
+    while (*(volatile u64 *)&l->readers & RW_WLOCKED)
+        kern_pause();
+    spin_unlock(&l->l);
+}
+
+void spin_wlock_slowpath(rw_spinlock l)
+{
+    spin_lock(&l->l);
+    if (!__sync_bool_compare_and_swap(&l->readers, 0, RW_WLOCKED)) {
+        /* new readers now queue up behind us */
+        __sync_fetch_and_or(&l->readers, RW_WAITING);
+        do {
+            while (*(volatile u64 *)&l->readers != RW_WAITING)
+                kern_pause();
+        } while (!__sync_bool_compare_and_swap(&l->readers, RW_WAITING, RW_WLOCKED));
+    }
+    spin_unlock(&l->l);
+}
+
+/* Called by the platform before other cpus are started. */
+void spin_lock_pv_init(void (*kick)(int cpu))
+{
+    spin_lock_kick = kick;
+    write_barrier();
+    spin_lock_pv = true;
+}
@@ -15,6 +15,7 @@
 typedef void *nanos_thread;
 #define get_current_thread()    0
 #define set_current_thread(t)
+#define trace_event(n, a0, a1, a2)
 #endif
 
 #include <pagecache.h>
@@ -113,6 +114,7 @@ static inline void pagecache_unlock_node(pagecache_node pn)
 static inline void change_page_state_locked(pagecache pc, pagecache_page pp, int state)
 {
     int old_state = page_state(pp);
+    trace_event(pagecache_state, state, page_offset(pp), old_state);
     switch (state) {
     case PAGECACHE_PAGESTATE_FREE:
         if (old_state == PAGECACHE_PAGESTATE_NEW) {
@@ -150,6 +152,8 @@ static inline void change_page_state_locked(pagecache pc, pagecache_page pp, int
             pagelist_move(&pc->new, &pc->active, pp);
         } else if (old_state == PAGECACHE_PAGESTATE_WRITING) {
             pagelist_move(&pc->new, &pc->writing, pp);
+        } else if (old_state == PAGECACHE_PAGESTATE_DIRTY) {
+            pagelist_move(&pc->new, &pc->dirty, pp);
         } else {
             assert(old_state == PAGECACHE_PAGESTATE_READING);
             pagelist_enqueue(&pc->new, pp);
@@ -164,9 +168,12 @@ static inline void change_page_state_locked(pagecache pc, pagecache_page pp, int
             pagelist_move(&pc->dirty, &pc->new, pp);
         } else if (old_state == PAGECACHE_PAGESTATE_ACTIVE) {
             pagelist_move(&pc->dirty, &pc->active, pp);
-        } else {
-            assert(old_state == PAGECACHE_PAGESTATE_WRITING);
+        } else if (old_state == PAGECACHE_PAGESTATE_WRITING) {
             pagelist_move(&pc->dirty, &pc->writing, pp);
+        } else {
+            /* delayed allocation write to a newly-allocated page */
+            assert(old_state == PAGECACHE_PAGESTATE_ALLOC);
+            pagelist_enqueue(&pc->dirty, pp);
         }
         break;
     default:
@@ -380,7 +387,6 @@ static pagecache_page allocate_page_nodelocked(pagecache_node pn, u64 offset)
     if (pp == INVALID_ADDRESS)
         goto fail_dealloc_contiguous;
 
-    init_rbnode(&pp->rbnode);
     init_refcount(&pp->refcount, 1, init_closure(&pp->free, pagecache_page_free, pc, pp));
     assert((offset >> PAGECACHE_PAGESTATE_SHIFT) == 0);
     pp->state_offset = ((u64)PAGECACHE_PAGESTATE_ALLOC << PAGECACHE_PAGESTATE_SHIFT) | offset;
@@ -394,14 +400,64 @@ static pagecache_page allocate_page_nodelocked(pagecache_node pn, u64 offset)
 #endif
     list_init(&pp->bh_completions);
     list_init(&pp->rq_completions);
-    assert(rbtree_insert_node(&pn->pages, &pp->rbnode));
+    if (!radix_insert(&pn->pages, offset, pp))
+        goto fail_dealloc_page;
     fetch_and_add(&pc->total_pages, 1); /* decrement happens without cache lock */
     return pp;
+  fail_dealloc_page:
+    deallocate(pc->h, pp, sizeof(struct pagecache_page));
   fail_dealloc_contiguous:
     deallocate(pc->contiguous, p, pagesize);
     return INVALID_ADDRESS;
 }
 
+/* Pages are never removed from a node's index, so a lookup may be
+   made without holding the node lock. */
+static inline pagecache_page page_lookup(pagecache_node pn, u64 n)
+{
+    return radix_lookup(&pn->pages, n);
+}
+
+/* Batched walk over the pages of a node, fetched from the index by
+   gang lookup. Indices must be visited in ascending order; pages
+   allocated behind the walk position are not seen. */
+#define PAGE_WALK_BATCH 16
+
+typedef struct page_walk {
+    pagecache_node pn;
+    u64 end;
+    int n, i;
+    boolean done;
+    pagecache_page batch[PAGE_WALK_BATCH];
+} *page_walk;
+
+static inline void page_walk_init(page_walk w, pagecache_node pn, u64 end)
+{
+    w->pn = pn;
+    w->end = end;
+    w->n = w->i = 0;
+    w->done = false;
+}
+
+/* returns the page at index pi, or INVALID_ADDRESS if none is cached */
+static pagecache_page page_walk_get(page_walk w, u64 pi)
+{
+    while (w->i < w->n && page_offset(w->batch[w->i]) < pi)
+        w->i++;
+    if (w->i == w->n) {
+        if (w->done)
+            return INVALID_ADDRESS;
+        w->n = radix_gang_lookup(&w->pn->pages, irange(pi, w->end), (void **)w->batch,
+                                 PAGE_WALK_BATCH);
+        w->i = 0;
+        w->done = w->n < PAGE_WALK_BATCH;
+        if (w->n == 0)
+            return INVALID_ADDRESS;
+    }
+    pagecache_page pp = w->batch[w->i];
+    return page_offset(pp) == pi ? pp : INVALID_ADDRESS;
+}
+
 #ifndef PAGECACHE_READ_ONLY
 static u64 evict_from_list_locked(pagecache pc, struct pagelist *pl, vector evictlist, u64 pages)
 {
@@ -445,16 +501,9 @@ static void balance_page_lists_locked(pagecache pc)
     }
 }
 
-static pagecache_page page_lookup_nodelocked(pagecache_node pn, u64 n)
-{
-    struct pagecache_page k;
-    k.state_offset = n;
-    return (pagecache_page)rbtree_lookup(&pn->pages, &k.rbnode);
-}
-
 static pagecache_page page_lookup_or_alloc_nodelocked(pagecache_node pn, u64 n)
 {
-    pagecache_page pp = page_lookup_nodelocked(pn, n);
+    pagecache_page pp = page_lookup(pn, n);
     if (pp == INVALID_ADDRESS) {
         pp = allocate_page_nodelocked(pn, n);
     } else if (page_state(pp) == PAGECACHE_PAGESTATE_FREE) {
@@ -477,8 +526,14 @@ static pagecache_page touch_or_fill_page_by_num_nodelocked(pagecache_node pn, u6
     return pp;
 }
 
-closure_function(6, 1, void, pagecache_write_sg_finish,
-                 nanos_thread, t, pagecache_node, pn, range, q, sg_list, sg, status_handler, completion, boolean, complete,
+#ifdef KERNEL
+static void pagecache_schedule_writeback(pagecache pc);
+#else
+static void pagecache_schedule_writeback(pagecache pc) {}
+#endif
+
+closure_function(7, 1, void, pagecache_write_sg_finish,
+                 nanos_thread, t, pagecache_node, pn, range, q, sg_list, sg, status_handler, completion, boolean, delalloc, boolean, complete,
                  status, s)
 {
     pagecache_node pn = bound(pn);
@@ -490,11 +545,12 @@ closure_function(6, 1, void, pagecache_write_sg_finish,
     u64 end = (q.end + MASK(pc->page_order)) >> page_order;
     sg_list sg = bound(sg);
 
-    pagecache_debug("%s: pn %p, q %R, sg %p, complete %d, status %v\n", __func__, pn, q,
-                    sg, bound(complete), s);
+    pagecache_debug("%s: pn %p, q %R, sg %p, delalloc %d, complete %d, status %v\n", __func__,
+                    pn, q, sg, bound(delalloc), bound(complete), s);
 
+    struct page_walk w;
+    page_walk_init(&w, pn, end);
     pagecache_lock_node(pn);
-    pagecache_page pp = page_lookup_nodelocked(pn, pi);
     if (!is_ok(s) || bound(complete)) {
         /* TODO: We handle storage errors after the syscall write
            completion has been applied. This means that storage
@@ -515,7 +571,8 @@ closure_function(6, 1, void, pagecache_write_sg_finish,
 
         if (bound(complete)) {
             do {
-                assert(pp != INVALID_ADDRESS && page_offset(pp) == pi);
+                pagecache_page pp = page_walk_get(&w, pi);
+                assert(pp != INVALID_ADDRESS);
                 pagecache_lock_state(pc);
                 assert(pp->write_count > 0);
                 if (pp->write_count-- == 1) {
@@ -526,7 +583,6 @@ closure_function(6, 1, void, pagecache_write_sg_finish,
                 pagecache_unlock_state(pc);
                 refcount_release(&pp->refcount);
                 pi++;
-                pp = (pagecache_page)rbnode_get_next((rbnode)pp);
             } while (pi < end);
         }
         pagecache_unlock_node(pn);
@@ -534,6 +590,32 @@ closure_function(6, 1, void, pagecache_write_sg_finish,
         return;
     }
 
+    if (bound(delalloc)) {
+        /* Copy to cache and leave pages dirty; storage is allocated and
+           written when the pages are committed. */
+        u64 offset = q.start & MASK(page_order);
+        set_current_thread(bound(t));
+        do {
+            pagecache_page pp = page_walk_get(&w, pi);
+            assert(pp != INVALID_ADDRESS);
+            u64 copy_len = MIN(q.end - (pi << page_order), cache_pagesize(pc)) - offset;
+            u64 res = sg_copy_to_buf(pp->kvirt + offset, sg, copy_len);
+            assert(res == copy_len);
+            pagecache_lock_state(pc);
+            if (page_state(pp) != PAGECACHE_PAGESTATE_DIRTY)
+                change_page_state_locked(pc, pp, PAGECACHE_PAGESTATE_DIRTY);
+            pagecache_unlock_state(pc);
+            refcount_release(&pp->refcount);
+            offset = 0;
+            pi++;
+        } while (pi < end);
+        pagecache_unlock_node(pn);
+        pagecache_schedule_writeback(pc);
+        apply(bound(completion), STATUS_OK);
+        closure_finish();
+        return;
+    }
+
     /* apply writes, allocating pages as needed */
     u64 offset = q.start & MASK(page_order);
     u64 block_offset = q.start & MASK(block_order);
@@ -552,7 +634,8 @@ closure_function(6, 1, void, pagecache_write_sg_finish,
     }
     set_current_thread(bound(t));
     do {
-        assert(pp != INVALID_ADDRESS && page_offset(pp) == pi);
+        pagecache_page pp = page_walk_get(&w, pi);
+        assert(pp != INVALID_ADDRESS);
         u64 copy_len = MIN(q.end - (pi << page_order), cache_pagesize(pc)) - offset;
         u64 req_len = pad(copy_len + block_offset, U64_FROM_BIT(block_order));
         if (write_sg) {
@@ -568,12 +651,16 @@ closure_function(6, 1, void, pagecache_write_sg_finish,
             zero(pp->kvirt + offset, copy_len);
         }
         pagecache_lock_state(pc);
-        change_page_state_locked(pc, pp, PAGECACHE_PAGESTATE_WRITING);
+        if (page_state(pp) == PAGECACHE_PAGESTATE_DIRTY) {
+            /* other dirty data in the page remains to be committed */
+            pp->write_count++;
+        } else {
+            change_page_state_locked(pc, pp, PAGECACHE_PAGESTATE_WRITING);
+        }
         pagecache_unlock_state(pc);
         offset = 0;
         block_offset = 0;
         pi++;
-        pp = (pagecache_page)rbnode_get_next((rbnode)pp);
     } while (pi < end);
     pagecache_unlock_node(pn);
 
@@ -607,27 +694,37 @@ closure_function(1, 3, void, pagecache_write_sg,
         return;
     }
 
-    /* extend node length if writing past current end */
-    if (q.end > pn->length)
-        pn->length = q.end;
+#ifdef KERNEL
+    /* Appending writes defer storage allocation until the dirty pages
+       are committed, so that small appends coalesce into a single
+       extent reservation and storage write. */
+    boolean delalloc = sg && pn->fs_reserve && q.start >= pn->length;
+#else
+    boolean delalloc = false;
+#endif
 
     u64 start_offset = q.start & MASK(pc->page_order);
     u64 end_offset = q.end & MASK(pc->page_order);
     range r = range_rshift(q, pc->page_order);
     pagecache_lock_node(pn);
-    /* attempt to reserve disk space for the write */
+    /* attempt to reserve disk space for the write; with delayed
+       allocation, only the space is reserved here */
     if (pn->fs_reserve && sg) {
         status ss;
-        if ((ss = apply(pn->fs_reserve, q)) != STATUS_OK) {
+        if ((ss = apply(pn->fs_reserve, q, delalloc)) != STATUS_OK) {
             pagecache_unlock_node(pn);
             apply(completion, ss);
             return;
         }
     }
 
+    /* extend node length if writing past current end */
+    if (q.end > pn->length)
+        pn->length = q.end;
+
     /* prepare pages for writing */
     merge m = allocate_merge(pc->h, closure(pc->h, pagecache_write_sg_finish,
-        get_current_thread(), pn, q, sg, completion, false));
+        get_current_thread(), pn, q, sg, completion, delalloc, false));
     status_handler sh = apply_merge(m);
 
     /* initiate reads for rmw start and/or end */
@@ -652,8 +749,10 @@ closure_function(1, 3, void, pagecache_write_sg,
     }
 
     /* prepare whole pages, blocking for any pending reads */
+    struct page_walk w;
+    page_walk_init(&w, pn, r.end);
     for (u64 pi = r.start; pi < r.end; pi++) {
-        pagecache_page pp = page_lookup_nodelocked(pn, pi);
+        pagecache_page pp = page_walk_get(&w, pi);
         if (pp == INVALID_ADDRESS) {
             pp = allocate_page_nodelocked(pn, pi);
             if (pp == INVALID_ADDRESS) {
@@ -733,6 +832,147 @@ u64 pagecache_drain(u64 drain_bytes)
     return evicted << pc->page_order;
 }
 
+closure_function(3, 1, void, pagecache_commit_complete,
+                 pagecache, pc, pagecache_node, pn, range, pages,
+                 status, s)
+{
+    pagecache pc = bound(pc);
+    pagecache_node pn = bound(pn);
+    pagecache_debug("%s: pn %p, pages %R, s %v\n", __func__, pn, bound(pages), s);
+    if (!is_ok(s)) {
+        pagecache_debug("%s: write_error now %v\n", __func__, s);
+        pn->pv->write_error = s;
+    }
+    pagecache_lock_state(pc);
+    for (u64 pi = bound(pages).start; pi < bound(pages).end; pi++) {
+        pagecache_page pp = page_lookup(pn, pi);
+        assert(pp != INVALID_ADDRESS);
+        assert(pp->write_count > 0);
+        if (pp->write_count-- == 1) {
+            if (page_state(pp) != PAGECACHE_PAGESTATE_DIRTY)
+                change_page_state_locked(pc, pp, PAGECACHE_PAGESTATE_NEW);
+            pagecache_page_queue_completions_locked(pc, pp, s);
+        }
+    }
+    pagecache_unlock_state(pc);
+    closure_finish();
+}
+
+static inline boolean page_is_dirty(pagecache_page pp)
+{
+    return pp != INVALID_ADDRESS && page_state(pp) == PAGECACHE_PAGESTATE_DIRTY;
+}
+
+/* Commit the run of contiguous dirty pages around pp as a single storage
+   write, which also allows pages written with delayed allocation to be
+   covered by one extent. The state lock is dropped while the write is
+   issued. */
+static void pagecache_commit_dirty_run_locked(pagecache pc, pagecache_page pp)
+{
+    pagecache_node pn = pp->node;
+    u64 block_size = U64_FROM_BIT(pn->pv->block_order);
+
+    /* find the start of the run, then gather pages forward */
+    u64 start = page_offset(pp);
+    while (start > 0 && page_is_dirty(page_lookup(pn, start - 1)))
+        start--;
+    u64 length = pn->length;
+    u64 pi = start;
+    sg_list sg = allocate_sg_list();
+    assert(sg != INVALID_ADDRESS);
+    while (pi - start < PAGECACHE_WRITEBACK_CLUSTER_PAGES &&
+           page_is_dirty(pp = page_lookup(pn, pi))) {
+        assert(pp->kvirt != INVALID_ADDRESS);
+        u64 page_start = pi << pc->page_order;
+        if (page_start < length) {
+            u64 size = MIN(cache_pagesize(pc), pad(length - page_start, block_size));
+            sg_buf sgb = sg_list_tail_add(sg, size);
+            sgb->buf = pp->kvirt;
+            sgb->offset = 0;
+            sgb->size = size;
+            sgb->refcount = &pp->refcount;
+            refcount_reserve(&pp->refcount);
+        }
+        change_page_state_locked(pc, pp, PAGECACHE_PAGESTATE_WRITING);
+        pi++;
+    }
+    pagecache_unlock_state(pc);
+
+    /* don't write (or extend the node) past its end */
+    range pages = irange(start, pi);
+    range r = range_intersection(range_lshift(pages, pc->page_order), irange(0, length));
+    status_handler sh = closure(pc->h, pagecache_commit_complete, pc, pn, pages);
+    pagecache_debug("   pn %p, pages %R, write %R\n", pn, pages, r);
+    if (range_span(r) > 0) {
+        apply(pn->fs_write, sg, r, sh);
+    } else {
+        sg_list_release(sg);
+        deallocate_sg_list(sg);
+        apply(sh, STATUS_OK);
+    }
+    pagecache_lock_state(pc);
+}
+
+#ifdef KERNEL
+/* commit all dirty pages in the cache */
+static void pagecache_commit_dirty_pages(pagecache pc)
+{
+    pagecache_debug("%s\n", __func__);
+    pagecache_lock_state(pc);
+    list l;
+    while ((l = list_get_next(&pc->dirty.l)))
+        pagecache_commit_dirty_run_locked(pc, struct_from_list(l, pagecache_page, l));
+    pagecache_unlock_state(pc);
+}
+#endif
+
+closure_function(1, 2, boolean, pagecache_commit_dirty_page,
+                 pagecache, pc,
+                 u64, key, void *, p)
+{
+    pagecache pc = bound(pc);
+    pagecache_page pp = p;
+    pagecache_lock_state(pc);
+    if (page_state(pp) == PAGECACHE_PAGESTATE_DIRTY)
+        pagecache_commit_dirty_run_locked(pc, pp);
+    pagecache_unlock_state(pc);
+    return true;
+}
+
+void pagecache_commit_dirty_node(pagecache_node pn)
+{
+    pagecache_debug("%s: pn %p\n", __func__, pn);
+    radix_traverse(&pn->pages, stack_closure(pagecache_commit_dirty_page, pn->pv->pc));
+}
+
+void pagecache_commit_dirty_volume(pagecache_volume pv)
+{
+    pagecache_debug("%s: pv %p\n", __func__, pv);
+    list_foreach(&pv->nodes, l)
+        pagecache_commit_dirty_node(struct_from_list(l, pagecache_node, l));
+}
+
+closure_function(1, 2, boolean, pagecache_discard_dirty_page,
+                 pagecache, pc,
+                 u64, key, void *, p)
+{
+    pagecache_page pp = p;
+    if (page_state(pp) == PAGECACHE_PAGESTATE_DIRTY && pp->write_count == 0)
+        change_page_state_locked(bound(pc), pp, PAGECACHE_PAGESTATE_NEW);
+    return true;
+}
+
+/* drop pending writeback for a node that is going away */
+static void pagecache_discard_dirty_pages(pagecache_node pn)
+{
+    pagecache pc = pn->pv->pc;
+    pagecache_lock_node(pn);
+    pagecache_lock_state(pc);
+    radix_traverse(&pn->pages, stack_closure(pagecache_discard_dirty_page, pc));
+    pagecache_unlock_state(pc);
+    pagecache_unlock_node(pn);
+}
+
 /* TODO could encode completion to indicate completion on transition
    to new rather than writing - otherwise we're completing on storage
    request issuance, not completion - just for sync use */
@@ -794,15 +1034,15 @@ closure_function(1, 3, void, pagecache_read_sg,
 
     merge m = allocate_merge(pc->h, completion);
     status_handler sh = apply_merge(m);
-    struct pagecache_page k;
     if (q.end > pn->length)
         q.end = pn->length;
-    k.state_offset = q.start >> pc->page_order;
     u64 end = (q.end + MASK(pc->page_order)) >> pc->page_order;
+    struct page_walk w;
+    page_walk_init(&w, pn, end);
     pagecache_lock_node(pn);
-    pagecache_page pp = (pagecache_page)rbtree_lookup(&pn->pages, &k.rbnode);
-    for (u64 pi = k.state_offset; pi < end; pi++) {
-        if (pp == INVALID_ADDRESS || page_offset(pp) > pi) {
+    for (u64 pi = q.start >> pc->page_order; pi < end; pi++) {
+        pagecache_page pp = page_walk_get(&w, pi);
+        if (pp == INVALID_ADDRESS) {
             pp = allocate_page_nodelocked(pn, pi);
             if (pp == INVALID_ADDRESS) {
                 pagecache_unlock_node(pn);
@@ -826,7 +1066,6 @@ closure_function(1, 3, void, pagecache_read_sg,
         refcount_reserve(&pp->refcount);
 
         touch_or_fill_page_nodelocked(pn, pp, m, false /* complete on runqueue */);
-        pp = (pagecache_page)rbnode_get_next((rbnode)pp);
     }
     pagecache_unlock_node(pn);
 
@@ -850,7 +1089,7 @@ closure_function(3, 3, boolean, pagecache_check_dirty_page,
         pagecache_debug("   dirty: vaddr 0x%lx, pi 0x%lx\n", vaddr, pi);
         pt_pte_clean(entry);
         page_invalidate(bound(fe), vaddr);
-        pagecache_page pp = page_lookup_nodelocked(sm->pn, pi);
+        pagecache_page pp = page_lookup(sm->pn, pi);
         assert(pp != INVALID_ADDRESS);
         pagecache_lock_state(pc);
         if (page_state(pp) != PAGECACHE_PAGESTATE_DIRTY)
@@ -888,58 +1127,7 @@ static void pagecache_scan_node(pagecache_node pn)
         pagecache_scan_shared_map(pn->pv->pc, sm, fe);
     }
     page_invalidate_sync(fe, 0);
-}
-
-closure_function(2, 1, void, pagecache_commit_complete,
-                 pagecache, pc, pagecache_page, pp,
-                 status, s)
-{
-    pagecache pc = bound(pc);
-    pagecache_page pp = bound(pp);
-    pagecache_debug("%s: pp %p, s %v\n", __func__, pp, s);
-    if (!is_ok(s)) {
-        pagecache_debug("%s: write_error now %v\n", __func__, s);
-        pp->node->pv->write_error = s;
-    }
-    pagecache_lock_state(pc);
-    assert(pp->write_count > 0);
-    if (pp->write_count-- == 1) {
-        if (page_state(pp) != PAGECACHE_PAGESTATE_DIRTY)
-            change_page_state_locked(pc, pp, PAGECACHE_PAGESTATE_NEW);
-        pagecache_page_queue_completions_locked(pc, pp, s);
-    }
-    pagecache_unlock_state(pc);
-    closure_finish();
-}
-
-static void pagecache_commit_dirty_pages(pagecache pc)
-{
-    pagecache_debug("%s\n", __func__);
-    pagecache_lock_state(pc);
-
-    /* It might be more efficient to move these to a temporary list,
-       issue writes and then resolve on merge completion... */
-    list_foreach(&pc->dirty.l, l) {
-        pagecache_page pp = struct_from_list(l, pagecache_page, l);
-        sg_list sg = allocate_sg_list();
-        assert(sg != INVALID_ADDRESS);
-        sg_buf sgb = sg_list_tail_add(sg, cache_pagesize(pc));
-        assert(pp->kvirt != INVALID_ADDRESS);
-        sgb->buf = pp->kvirt;
-        sgb->offset = 0;
-        sgb->size = cache_pagesize(pc);
-        sgb->refcount = &pp->refcount;
-        refcount_reserve(&pp->refcount);
-        change_page_state_locked(pc, pp, PAGECACHE_PAGESTATE_WRITING);
-        pagecache_unlock_state(pc);
-
-        apply(pp->node->fs_write, sg,
-              irangel(page_offset(pp) << pc->page_order, cache_pagesize(pc)),
-              closure(pc->h, pagecache_commit_complete, pc, pp));
-
-        pagecache_lock_state(pc);
-    }
-    pagecache_unlock_state(pc);
+    pagecache_commit_dirty_node(pn);
 }
 
 static void pagecache_scan(pagecache pc)
@@ -949,6 +1137,7 @@ static void pagecache_scan(pagecache pc)
     pc->scan_in_progress = true;
     pagecache_scan_shared_mappings(pc);
     pagecache_commit_dirty_pages(pc);
+    pc->scan_in_progress = false;
 }
 
 define_closure_function(1, 1, void, pagecache_scan_timer,
@@ -958,6 +1147,41 @@ define_closure_function(1, 1, void, pagecache_scan_timer,
     pagecache_scan(bound(pc));
 }
 
+define_closure_function(1, 1, void, pagecache_writeback_timer,
+                        pagecache, pc,
+                        u64, overruns /* ignored */)
+{
+    pagecache pc = bound(pc);
+    pagecache_lock_state(pc);
+    pc->writeback_pending = false;
+    pagecache_unlock_state(pc);
+    pagecache_commit_dirty_pages(pc);
+}
+
+/* Pages written with delayed allocation are left dirty so that
+   successive small writes can be gathered into large, contiguous
+   storage writes. Writeback is deferred until either the dirty page
+   threshold is exceeded or the writeback delay expires. */
+static void pagecache_schedule_writeback(pagecache pc)
+{
+    pagecache_lock_state(pc);
+    if ((pc->dirty.pages << pc->page_order) >= PAGECACHE_WRITEBACK_DIRTY_MAX) {
+        pagecache_unlock_state(pc);
+        pagecache_commit_dirty_pages(pc);
+        return;
+    }
+    boolean schedule = !pc->writeback_pending;
+    pc->writeback_pending = true;
+    pagecache_unlock_state(pc);
+
+    /* the timer is registered without the state lock held, as it takes
+       the lock of the timer queue */
+    if (schedule)
+        register_timer(runloop_timers, CLOCK_ID_MONOTONIC,
+                       seconds(PAGECACHE_WRITEBACK_DELAY_SECONDS), false, 0,
+                       (timer_handler)&pc->do_writeback_timer);
+}
+
 void pagecache_node_add_shared_map(pagecache_node pn, range q /* bytes */, u64 node_offset)
 {
     pagecache pc = pn->pv->pc;
@@ -1044,7 +1268,7 @@ void pagecache_node_scan_and_commit_shared_pages(pagecache_node pn, range q /* b
     flush_entry fe = get_page_flush_entry();
     rangemap_range_lookup(pn->shared_maps, q,
                           stack_closure(scan_shared_pages_intersection, pn->pv->pc, fe));
-    pagecache_commit_dirty_pages(pn->pv->pc);
+    pagecache_commit_dirty_node(pn);
     page_invalidate_sync(fe, 0);
 }
 
@@ -1057,7 +1281,7 @@ boolean pagecache_node_do_page_cow(pagecache_node pn, u64 node_offset, u64 vaddr
     if (paddr == INVALID_PHYSICAL)
         return false;
     pagecache_lock_node(pn);
-    pagecache_page pp = page_lookup_nodelocked(pn, node_offset >> pc->page_order);
+    pagecache_page pp = page_lookup(pn, node_offset >> pc->page_order);
     assert(pp != INVALID_ADDRESS);
     assert(pageflags_is_writable(flags));
     assert(page_state(pp) != PAGECACHE_PAGESTATE_FREE);
@@ -1079,13 +1303,13 @@ void pagecache_node_fetch_pages(pagecache_node pn, range r)
     status_handler sh = apply_merge(m);
     if (r.end > pn->length)
         r.end = pn->length;
-    struct pagecache_page k;
-    k.state_offset = r.start >> pc->page_order;
     u64 end = (r.end + MASK(pc->page_order)) >> pc->page_order;
+    struct page_walk w;
+    page_walk_init(&w, pn, end);
     pagecache_lock_node(pn);
-    pagecache_page pp = (pagecache_page)rbtree_lookup(&pn->pages, &k.rbnode);
-    for (u64 pi = k.state_offset; pi < end; pi++) {
-        if (pp == INVALID_ADDRESS || page_offset(pp) > pi) {
+    for (u64 pi = r.start >> pc->page_order; pi < end; pi++) {
+        pagecache_page pp = page_walk_get(&w, pi);
+        if (pp == INVALID_ADDRESS) {
             pagecache_debug(" allocating page at index %ld\n", pi);
             pp = allocate_page_nodelocked(pn, pi);
             if (pp == INVALID_ADDRESS) {
@@ -1094,7 +1318,6 @@ void pagecache_node_fetch_pages(pagecache_node pn, range r)
             }
         }
         touch_or_fill_page_nodelocked(pn, pp, m, false /* ignored */);
-        pp = (pagecache_page)rbnode_get_next((rbnode)pp);
     }
     pagecache_unlock_node(pn);
     apply(sh, STATUS_OK);
@@ -1148,7 +1371,7 @@ boolean pagecache_map_page_if_filled(pagecache_node pn, u64 node_offset, u64 vad
 {
     boolean mapped = false;
     pagecache_lock_node(pn);
-    pagecache_page pp = page_lookup_nodelocked(pn, node_offset >> pn->pv->pc->page_order);
+    pagecache_page pp = page_lookup(pn, node_offset >> pn->pv->pc->page_order);
     pagecache_debug("%s: pn %p, node_offset 0x%lx, vaddr 0x%lx, flags 0x%lx, pp %p\n",
                     __func__, pn, node_offset, vaddr, flags.w, pp);
     if (pp == INVALID_ADDRESS)
@@ -1174,7 +1397,7 @@ closure_function(4, 3, boolean, pagecache_unmap_page_nodelocked,
         pagecache_debug("   vaddr 0x%lx, pi 0x%lx\n", vaddr, pi);
         pte_set(entry, 0);
         page_invalidate(bound(fe), vaddr);
-        pagecache_page pp = page_lookup_nodelocked(bound(pn), pi);
+        pagecache_page pp = page_lookup(bound(pn), pi);
         assert(pp != INVALID_ADDRESS);
         u64 phys = page_from_pte(old_entry);
         if (phys == pp->phys) {
@@ -1203,22 +1426,6 @@ void pagecache_node_unmap_pages(pagecache_node pn, range v /* bytes */, u64 node
 }
 #endif
 
-closure_function(1, 1, boolean, pagecache_page_print_key,
-                 pagecache, pc,
-                 rbnode, n)
-{
-    rprintf(" 0x%lx", page_offset((pagecache_page)n) << cache_pagesize(bound(pc)));
-    return true;
-}
-
-closure_function(0, 2, int, pagecache_page_compare,
-                 rbnode, a, rbnode, b)
-{
-    u64 oa = page_offset((pagecache_page)a);
-    u64 ob = page_offset((pagecache_page)b);
-    return oa == ob ? 0 : (oa < ob ? -1 : 1);
-}
-
 void pagecache_set_node_length(pagecache_node pn, u64 length)
 {
     pn->length = length;
@@ -1231,6 +1438,9 @@ u64 pagecache_get_node_length(pagecache_node pn)
 
 void pagecache_deallocate_node(pagecache_node pn)
 {
+#ifndef PAGECACHE_READ_ONLY
+    pagecache_discard_dirty_pages(pn);
+#endif
     /* TODO: We probably need to add a refcount to the node with a
        reference for every page in the cache. This would need to:
 
@@ -1270,8 +1480,7 @@ pagecache_node pagecache_allocate_node(pagecache_volume pv, sg_io fs_read, sg_io
     spin_lock_init(&pn->pages_lock);
 #endif
     list_insert_before(&pv->nodes, &pn->l);
-    init_rbtree(&pn->pages, closure(h, pagecache_page_compare),
-                closure(h, pagecache_page_print_key, pv->pc));
+    init_radix_tree(&pn->pages, h);
     pn->length = 0;
     pn->cache_read = closure(h, pagecache_read_sg, pn);
 #ifndef PAGECACHE_READ_ONLY
@@ -1376,6 +1585,8 @@ void init_pagecache(heap general, heap contiguous, heap physical, u64 pagesize)
     pc->scan_in_progress = false;
     pc->scan_timer = 0;
     init_closure(&pc->do_scan_timer, pagecache_scan_timer, pc);
+    pc->writeback_pending = false;
+    init_closure(&pc->do_writeback_timer, pagecache_writeback_timer, pc);
 #endif
     global_pagecache = pc;
 }
@@ -2,7 +2,7 @@ typedef struct pagecache_volume *pagecache_volume;
 
 typedef struct pagecache_node *pagecache_node;
 
-typedef closure_type(pagecache_node_reserve, status, range);
+typedef closure_type(pagecache_node_reserve, status, range, boolean /* delalloc */);
 
 void pagecache_set_node_length(pagecache_node pn, u64 length);
 
@@ -14,6 +14,10 @@ void pagecache_sync_node(pagecache_node pn, status_handler complete);
 
 void pagecache_sync_volume(pagecache_volume pv, status_handler complete);
 
+void pagecache_commit_dirty_node(pagecache_node pn);
+
+void pagecache_commit_dirty_volume(pagecache_volume pv);
+
 void *pagecache_get_zero_page(void);
 
 int pagecache_get_page_order(void);
@@ -7,6 +7,10 @@ declare_closure_struct(1, 1, void, pagecache_scan_timer,
                        struct pagecache *, pc,
                        u64, overruns /* ignored */);
 
+declare_closure_struct(1, 1, void, pagecache_writeback_timer,
+                       struct pagecache *, pc,
+                       u64, overruns /* ignored */);
+
 struct pagecache_completion_queue;
 
 declare_closure_struct(2, 0, void, pagecache_service_completions,
@@ -55,6 +59,8 @@ typedef struct pagecache {
     boolean scan_in_progress;
     timer scan_timer;
     closure_struct(pagecache_scan_timer, do_scan_timer);
+    boolean writeback_pending;  /* delayed allocation writeback timer registered */
+    closure_struct(pagecache_writeback_timer, do_writeback_timer);
 } *pagecache;
 
 typedef struct pagecache_volume {
@@ -70,12 +76,13 @@ typedef struct pagecache_node {
     struct list l;              /* volume-wide node list */
     pagecache_volume pv;
 
-    /* pages_lock covers traversal, insertions and removals - consider
-       changing to a rw lock or semaphore */
+    /* pages_lock serializes insertions into the page index and page
+       state transitions initiated by node operations; pages are never
+       removed from the index, so lookups may be made without it */
 #ifdef KERNEL
     struct spinlock pages_lock;
 #endif
-    struct rbtree pages;
+    struct radix_tree pages;    /* page index -> pagecache_page */
     rangemap shared_maps;       /* shared mappings associated with this node */
     u64 length;
 
@@ -110,16 +117,15 @@ declare_closure_struct(2, 0, void, pagecache_page_free,
                        pagecache, pc, pagecache_page, pp);
 
 struct pagecache_page {
-    struct rbnode rbnode;
-    struct refcount refcount;   /* 24 */
-    u64 state_offset;           /* 40 - state and offset in pages */
-    void *kvirt;                /* 48 */
-    int write_count;            /* 56 */
-    int pad0;                   /* 60 */
+    struct refcount refcount;   /* 0 */
+    u64 state_offset;           /* 16 - state and offset in pages */
+    void *kvirt;                /* 24 */
+    int write_count;            /* 32 */
+    int pad0;                   /* 36 */
+    pagecache_node node;        /* 40 */
+    struct list l;              /* 48 */
     /* end of first cacheline */
 
-    pagecache_node node;
-    struct list l;
     u64 phys;                   /* physical address */
     struct list bh_completions; /* default for non-kernel use */
     struct list rq_completions; /* kernel only */
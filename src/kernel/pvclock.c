@@ -53,6 +53,11 @@ closure_function(0, 1, void, tsc_deadline_timer,
     write_msr(TSC_DEADLINE_MSR, rdtsc() + count);
 }
 
+closure_function(0, 0, void, tsc_deadline_timer_int)
+{
+    current_cpu()->timer_interrupts++;
+}
+
 closure_function(1, 0, void, tsc_deadline_percpu_init,
                  int, irq)
 {
@@ -69,7 +74,7 @@ boolean init_tsc_deadline_timer(clock_timer *ct, thunk *per_cpu_init)
 
     *ct = closure(pvclock_heap, tsc_deadline_timer);
     int irq = allocate_interrupt();
-    register_interrupt(irq, ignore, "tsc deadline timer");
+    register_interrupt(irq, closure(pvclock_heap, tsc_deadline_timer_int), "tsc deadline timer");
     *per_cpu_init = closure(pvclock_heap, tsc_deadline_percpu_init, irq);
     apply(*per_cpu_init);
     return true;
@@ -27,10 +27,30 @@ queue runqueue;                 /* kernel space from ?*/
 queue bhqueue;                  /* kernel from interrupt */
 timerheap runloop_timers;
 bitmap idle_cpu_mask;
-timestamp last_timer_update;
+
+/* Tickless timers
+
+   Each cpu arms its own platform timer, and only for what it needs: the
+   cpu that last updated it arms the expiry of the earliest runloop timer,
+   and a cpu running a thread arms the scheduler tick only while other
+   threads are waiting in its queue. When there are none, the cpu sets its
+   bit in tickless_cpu_mask instead, and a cpu that later finds threads in
+   that queue interrupts it (see kick_tickless_cpus()), which preempts the
+   running thread as any interrupt from user mode does.
+
+   A runloop timer deadline may be deferred by a slack of up to 1/8 of the
+   time left, within RUNLOOP_TIMER_SLACK_US, and a platform timer already
+   armed to go off by then is left as is, so that nearby expirations are
+   serviced by the same interrupt. */
+static bitmap tickless_cpu_mask;
+static timestamp runloop_timer_next;    /* runloop timer expiry last armed */
+static timestamp *runloop_timer_armed;  /* ...on this timer */
+static timestamp runloop_timer_deadline;/* ...for this deadline */
+static timestamp global_timer_deadline; /* for a platform timer not per-cpu */
 
 static timestamp runloop_timer_min;
 static timestamp runloop_timer_max;
+static timestamp runloop_timer_slack;
 
 static struct spinlock kernel_lock;
 
@@ -83,18 +103,192 @@ static void run_thunk(thunk t)
     //    halt("handler returned %d", cpustate);
 }
 
+static inline timestamp *timer_deadline(cpuinfo ci)
+{
+    return platform_timer_percpu_init ? &ci->timer_deadline : &global_timer_deadline;
+}
+
+/* Arm the platform timer of this cpu to go off by deadline, unless it is
+   already armed to go off before that. */
+static void set_cpu_timer(cpuinfo ci, timestamp here, timestamp deadline)
+{
+    timestamp *d = timer_deadline(ci);
+    if (*d > here && *d <= deadline)
+        return;
+    timestamp timeout = deadline > here ? MAX(deadline - here, runloop_timer_min) : runloop_timer_min;
+    sched_debug("set platform timer: timeout %T\n", timeout);
+    *d = here + timeout;
+    runloop_timer(timeout);
+}
+
 /* called with kernel lock held */
-static inline boolean update_timer(void)
+static inline void update_timer(cpuinfo ci, timestamp here)
 {
     timestamp next = timer_check(runloop_timers);
-    if (last_timer_update && next == last_timer_update)
-        return false;
-    s64 delta = next - now(CLOCK_ID_MONOTONIC_RAW);
-    timestamp timeout = delta > (s64)runloop_timer_min ? MIN(delta, runloop_timer_max) : runloop_timer_min;
-    sched_debug("set platform timer: delta %lx, timeout %lx\n", delta, timeout);
-    last_timer_update = current_cpu()->last_timer_update = next + timeout - delta;
-    runloop_timer(timeout);
-    return true;
+    /* still armed, unless since replaced by an earlier deadline */
+    if (next == runloop_timer_next && runloop_timer_armed &&
+        *runloop_timer_armed == runloop_timer_deadline && runloop_timer_deadline > here)
+        return;
+    runloop_timer_next = next;
+    if (next == infinity)
+        return;
+    s64 delta = next - here;
+    if (delta > (s64)runloop_timer_max)
+        next = here + runloop_timer_max;
+    else if (delta > 0)
+        next += MIN(delta >> 3, runloop_timer_slack);
+    set_cpu_timer(ci, here, next);
+    runloop_timer_armed = timer_deadline(ci);
+    runloop_timer_deadline = *runloop_timer_armed;
+}
+
+/* Priorities and time slices
+
+   Threads of the real-time policies (SCHED_FIFO and SCHED_RR) wait in the
+   rt_queue of a cpu, in one list per priority, and run before any other
+   thread queued there; queueing one on a cpu that runs a thread of lower
+   or equal priority interrupts that cpu (see rt_enqueue()). A real-time
+   thread preempted while running goes back to the head of its list, and
+   to the tail when it yields, wakes up or, under SCHED_RR, has used up
+   its time slice. A SCHED_FIFO thread has no time slice.
+
+   Other threads wait in the fair_queue of a cpu, after the CFS of Linux:
+   the run time of a thread is charged to its vruntime in inverse
+   proportion to the weight of its nice level (see sched_thread_charge(),
+   called on every switch), and the thread of least vruntime runs next,
+   for a time slice in proportion to that weight, so that cpu-bound
+   threads sharing a cpu get their weighted share of it. A thread waking
+   up is placed no further than half a time slice behind the least
+   vruntime on the cpu, so that sleeping doesn't bank cpu time, but runs
+   ahead of the cpu-bound threads there, and preempts the running one if
+   behind it by more than sched_wakeup_granularity: an I/O-bound thread
+   gets the cpu shortly after its wakeup. The vruntime of a thread moving
+   to another cpu keeps its lag relative to the least one there. */
+static timestamp sched_timeslice;
+static timestamp sched_timeslice_min;
+static timestamp sched_timeslice_max;
+static timestamp sched_rr_slice;
+static timestamp sched_wakeup_granularity;
+
+#define SCHED_WEIGHT_NICE_0     1024
+#define SCHED_WEIGHT_IDLE       3
+
+/* weights of nice levels -20 to 19, as in Linux: each level gets about
+   10% more cpu time than the next */
+static const u32 sched_nice_weights[SCHED_NICE_MAX - SCHED_NICE_MIN + 1] = {
+ /* -20 */ 88761, 71755, 56483, 46273, 36291,
+ /* -15 */ 29154, 23254, 18705, 14949, 11916,
+ /* -10 */  9548,  7620,  6100,  4904,  3906,
+ /*  -5 */  3121,  2501,  1991,  1586,  1277,
+ /*   0 */  1024,   820,   655,   526,   423,
+ /*   5 */   335,   272,   215,   172,   137,
+ /*  10 */   110,    87,    70,    56,    45,
+ /*  15 */    36,    29,    23,    18,    15,
+};
+
+void sched_thread_init(nanos_thread nt)
+{
+    nt->policy = SCHED_OTHER;
+    nt->rt_priority = 0;
+    nt->nice = 0;
+    nt->yielding = false;
+    nt->weight = SCHED_WEIGHT_NICE_0;
+    nt->slice_end = 0;
+    nt->vruntime = 0;
+    list_init(&nt->rt_l);
+    nt->rt_queued_priority = 0;
+    init_rbnode(&nt->fair_n);
+    nt->queued_frame = 0;
+}
+
+/* Takes effect the next time the thread is queued. */
+void sched_set_policy(nanos_thread nt, int policy, int priority)
+{
+    nt->policy = policy;
+    nt->rt_priority = priority;
+    nt->slice_end = 0;
+    sched_set_nice(nt, nt->nice);
+}
+
+void sched_set_nice(nanos_thread nt, int nice)
+{
+    nt->nice = MAX(MIN(nice, SCHED_NICE_MAX), SCHED_NICE_MIN);
+    nt->weight = nt->policy == SCHED_IDLE ? SCHED_WEIGHT_IDLE :
+        sched_nice_weights[nt->nice - SCHED_NICE_MIN];
+}
+
+/* Account for run time of a thread, which must not be queued. */
+void sched_thread_charge(nanos_thread nt, timestamp run)
+{
+    nt->vruntime += run * SCHED_WEIGHT_NICE_0 / nt->weight;
+}
+
+timestamp sched_thread_timeslice(nanos_thread nt)
+{
+    if (nt && nt->policy == SCHED_FIFO)
+        return 0;
+    if (nt && nt->policy == SCHED_RR)
+        return sched_rr_slice;
+    if (!nt)
+        return sched_timeslice;
+    timestamp slice = sched_timeslice * nt->weight / SCHED_WEIGHT_NICE_0;
+    return MAX(MIN(slice, sched_timeslice_max), sched_timeslice_min);
+}
+
+static inline u64 rt_queue_count(cpuinfo ci)
+{
+    return *(volatile u64 *)&ci->rt_queue.count;
+}
+
+static inline u64 fair_queue_count(cpuinfo ci)
+{
+    return *(volatile u64 *)&ci->fair_queue.count;
+}
+
+static inline boolean cpu_has_threads(cpuinfo ci)
+{
+    return rt_queue_count(ci) || fair_queue_count(ci) || !queue_empty(ci->thread_queue);
+}
+
+/* Arm the scheduler tick for the end of the time slice of the thread about
+   to run if threads are waiting behind it, or else go tickless. Only a
+   SCHED_RR thread is sliced among real-time threads, and none goes
+   tickless: threads of other policies must not interrupt them. */
+static void sched_tick(cpuinfo ci, nanos_thread nt)
+{
+    timestamp here;
+    if (sched_thread_rt(nt)) {
+        if (nt->policy == SCHED_FIFO || !rt_queue_count(ci))
+            return;
+        here = now(CLOCK_ID_MONOTONIC_RAW);
+        set_cpu_timer(ci, here, nt->slice_end);
+        return;
+    }
+    if (total_processors > 1) {
+        bitmap_set_atomic(tickless_cpu_mask, ci->id, 1);
+        /* pairs with the barrier in kick_tickless_cpus() */
+        memory_barrier();
+    }
+    if (!cpu_has_threads(ci))
+        return;
+    if (total_processors > 1)
+        bitmap_set_atomic(tickless_cpu_mask, ci->id, 0);
+    here = now(CLOCK_ID_MONOTONIC_RAW);
+    set_cpu_timer(ci, here, here + sched_thread_timeslice(nt));
+}
+
+/* Interrupt the tickless cpus that have threads waiting for them. */
+static void kick_tickless_cpus(cpuinfo ci)
+{
+    memory_barrier();
+    bitmap_foreach_set(tickless_cpu_mask, cpu) {
+        if (cpu == ci->id || !cpu_has_threads(cpuinfo_from_id(cpu)))
+            continue;
+        if (bitmap_test_and_set_atomic(tickless_cpu_mask, cpu, 0)) {
+            sched_debug("kicking tickless CPU %d\n", cpu);
+            send_ipi(cpu, wakeup_vector);
+        }
+    }
 }
 
 static inline void sched_thread_pause(void)
@@ -108,6 +302,102 @@ static inline void sched_thread_pause(void)
     }
 }
 
+/* Idle polling, after the guest haltpoll governor of Linux
+
+   A halt is a VM exit, and waking a halted vcpu costs another exit and
+   reentry on top of the IPI, so an idle cpu first polls its bit in
+   idle_cpu_mask (cleared by wakeup_cpu()) and its thread queue for up to
+   idle_poll_limit. A cpu that is polling doesn't need the IPI. The limit
+   grows while wakeups arrive shortly after the halt, and shrinks once idle
+   periods outlast the maximum window. Where memory can be monitored
+   (MWAIT, or WFE on the exclusive monitor), the cpu then waits for a write
+   to its bitmap word rather than halting, and keeps saving wakers the IPI. */
+#define IDLE_POLL_MAX_US        200
+#define IDLE_POLL_GROW_START_US 50
+#define IDLE_POLL_SPINS         64      /* between clock reads */
+
+static timestamp idle_poll_max;
+static timestamp idle_poll_grow_start;
+
+/* called with interrupts disabled; returns true if woken up without an
+   interrupt */
+static boolean idle_poll(cpuinfo ci)
+{
+    volatile u64 *w = bitmap_base(idle_cpu_mask) + (ci->id >> 6);
+    u64 bit = U64_FROM_BIT(ci->id & 63);
+    ci->idle_polling = true;
+    memory_barrier();
+    if (ci->idle_poll_limit) {
+        timestamp end = ci->idle_start + ci->idle_poll_limit;
+        enable_interrupts();
+        do {
+            for (int i = 0; i < IDLE_POLL_SPINS; i++) {
+                if (!(*w & bit) || cpu_has_threads(ci))
+                    goto woken;
+                kern_pause();
+            }
+        } while (now(CLOCK_ID_MONOTONIC_RAW) < end);
+        disable_interrupts();
+    }
+    while (1) {
+        u64 v = *w;
+        if (!(v & bit) || cpu_has_threads(ci))
+            goto woken;
+        /* waiting on the monitor adjusts the poll window as a halt does,
+           whether it ends here or in an interrupt */
+        ci->idle_halted = true;
+        if (!wait_for_update(w, v)) {
+            ci->idle_halted = false;
+            break;
+        }
+    }
+    ci->idle_polling = false;
+    memory_barrier();
+    if (!(*w & bit) || cpu_has_threads(ci))
+        goto woken;
+    ci->idle_halted = true;
+    return false;
+  woken:
+    disable_interrupts();
+    ci->idle_polling = false;
+    bitmap_set_atomic(idle_cpu_mask, ci->id, 0);
+    return true;
+}
+
+/* Account for the idle period ending and adjust the poll window. */
+static void idle_exit(cpuinfo ci)
+{
+    timestamp here = now(CLOCK_ID_MONOTONIC_RAW);
+    timestamp idle = here - ci->idle_start;
+    struct cpu_idle_stats *st = &ci->idle_stats;
+    ci->idle_start = 0;
+    ci->idle_polling = false;
+    st->residency += idle;
+    if (ci->idle_halted) {
+        ci->idle_halted = false;
+        st->halt_wakeups++;
+        if (idle > idle_poll_max) {
+            ci->idle_poll_limit /= 2;
+            if (ci->idle_poll_limit < idle_poll_grow_start)
+                ci->idle_poll_limit = 0;
+        } else if (idle > ci->idle_poll_limit) {
+            ci->idle_poll_limit = ci->idle_poll_limit ?
+                MIN(ci->idle_poll_limit * 2, idle_poll_max) : idle_poll_grow_start;
+        }
+    } else {
+        st->poll_wakeups++;
+    }
+    timestamp t = ci->wakeup_time;
+    if (t) {
+        ci->wakeup_time = 0;
+        if (here > t) {
+            st->wakeups++;
+            st->wakeup_latency += here - t;
+            st->wakeup_latency_max = MAX(st->wakeup_latency_max, here - t);
+        }
+    }
+}
+
 NOTRACE void __attribute__((noreturn)) kernel_sleep(void)
 {
     // we're going to cover up this race by checking the state in the interrupt
@@ -115,8 +405,12 @@ NOTRACE void __attribute__((noreturn)) kernel_sleep(void)
     cpuinfo ci = current_cpu();
     sched_debug("sleep\n");
     ci->state = cpu_idle;
-    if (idle_cpu_mask)
+    if (idle_cpu_mask) {
+        ci->idle_start = now(CLOCK_ID_MONOTONIC_RAW);
         bitmap_set_atomic(idle_cpu_mask, ci->id, 1);
+        if (idle_poll(ci))
+            runloop();
+    }
 
     while (1) {
         wait_for_interrupt();
@@ -136,29 +430,407 @@ void wakeup_or_interrupt_cpu_all()
 
 static void wakeup_cpu(u64 cpu)
 {
+    if (!bitmap_get(idle_cpu_mask, cpu))
+        return;
+    cpuinfo ci = cpuinfo_from_id(cpu);
+    ci->wakeup_time = now(CLOCK_ID_MONOTONIC_RAW);
     if (bitmap_test_and_set_atomic(idle_cpu_mask, cpu, 0)) {
         sched_debug("waking up CPU %d\n", cpu);
-        send_ipi(cpu, wakeup_vector);
+        if (!*(volatile boolean *)&ci->idle_polling)
+            send_ipi(cpu, wakeup_vector);
+    } else {
+        ci->wakeup_time = 0;
+    }
+}
+
+/* Wake an idle cpu which has threads queued, so that they run there rather
+   than being migrated to the cpu that made them runnable when it next goes
+   looking for work. */
+void wakeup_cpu_runnable(u64 cpu)
+{
+    if (cpu != current_cpu()->id && cpu_has_threads(cpuinfo_from_id(cpu)))
+        wakeup_cpu(cpu);
+}
+
+/* Affinity and isolated cpus
+
+   A thread only runs on the cpus in its affinity mask, and is only queued
+   on one of those: a frame dequeued by a cpu it may not run on is put
+   back, or, from the cpu's own queue (where it lands after an affinity
+   change), forwarded to a cpu it may run on. Threads get an affinity that
+   excludes the cpus in isolated_cpu_mask unless pinned there. Isolated
+   cpus don't run bottom halves, the runqueue or timers either, and leave
+   them to the other cpus (see kick_housekeeping()); cpu 0, which takes
+   device interrupts, can't be isolated. */
+bitmap isolated_cpu_mask;
+
+static inline boolean frame_cpu_allowed(context f, u64 cpu)
+{
+    nanos_thread nt = pointer_from_u64(f[FRAME_THREAD]);
+    return !nt || !nt->affinity || bitmap_get(nt->affinity, cpu);
+}
+
+static inline boolean cpu_isolated(cpuinfo ci)
+{
+    return isolated_cpu_mask && bitmap_get(isolated_cpu_mask, ci->id);
+}
+
+/* Take the first frame in q that may run on cpu, putting back those that
+   may not; the queue is scanned at most once. */
+static context dequeue_allowed(queue q, u64 cpu)
+{
+    for (u64 n = queue_length(q); n > 0; n--) {
+        context f = dequeue(q);
+        if (f == INVALID_ADDRESS)
+            break;
+        if (frame_cpu_allowed(f, cpu))
+            return f;
+        assert(enqueue(q, f));
+    }
+    return INVALID_ADDRESS;
+}
+
+/* called with the rt_queue lock held */
+static void rt_queue_insert(struct rt_queue *rq, nanos_thread nt, context f, boolean head)
+{
+    u8 prio = nt->rt_priority;
+    nt->queued_frame = f;
+    nt->rt_queued_priority = prio;
+    if (head)
+        list_insert_after(&rq->levels[prio], &nt->rt_l);
+    else
+        list_insert_before(&rq->levels[prio], &nt->rt_l);
+    rq->active[prio >> 6] |= U64_FROM_BIT(prio & 63);
+    rq->count++;
+}
+
+/* called with the rt_queue lock held */
+static void rt_queue_remove(struct rt_queue *rq, nanos_thread nt)
+{
+    u8 prio = nt->rt_queued_priority;
+    list_delete(&nt->rt_l);
+    if (list_empty(&rq->levels[prio]))
+        rq->active[prio >> 6] &= ~U64_FROM_BIT(prio & 63);
+    rq->count--;
+}
+
+/* Queue the frame of a real-time thread on cpu ci, and interrupt that cpu
+   if it may be running a thread of no higher priority. */
+static void rt_enqueue(cpuinfo ci, nanos_thread nt, context f, boolean head)
+{
+    struct rt_queue *rq = &ci->rt_queue;
+    u64 flags = spin_lock_irq(&rq->lock);
+    rt_queue_insert(rq, nt, f, head);
+    spin_unlock_irq(&rq->lock, flags);
+    if (ci == current_cpu())
+        return;
+    /* pairs with the barrier in kernel_sleep() setting the idle bit */
+    memory_barrier();
+    if (bitmap_get(idle_cpu_mask, ci->id)) {
+        wakeup_cpu(ci->id);
+    } else if (ci->sched_prio <= nt->rt_priority) {
+        sched_debug("preempting CPU %d for priority %d\n", ci->id, nt->rt_priority);
+        send_ipi(ci->id, wakeup_vector);
+    }
+}
+
+/* Take the frame of highest priority in the rt_queue of ci that may run on
+   cpu. If stray is given, frames that may not are moved there, to be
+   forwarded once the lock is released. */
+static context rt_dequeue(cpuinfo ci, u64 cpu, struct list *stray)
+{
+    struct rt_queue *rq = &ci->rt_queue;
+    context f = INVALID_ADDRESS;
+    if (!rt_queue_count(ci))
+        return f;
+    u64 flags = spin_lock_irq(&rq->lock);
+    for (int w = 1; w >= 0 && f == INVALID_ADDRESS; w--) {
+        u64 active = rq->active[w];
+        while (active && f == INVALID_ADDRESS) {
+            u64 bit = msb(active);
+            active &= ~U64_FROM_BIT(bit);
+            list_foreach(&rq->levels[(w << 6) + bit], l) {
+                nanos_thread nt = struct_from_list(l, nanos_thread, rt_l);
+                boolean allowed = !nt->affinity || bitmap_get(nt->affinity, cpu);
+                if (!allowed && !stray)
+                    continue;
+                rt_queue_remove(rq, nt);
+                if (allowed) {
+                    f = nt->queued_frame;
+                    break;
+                }
+                list_push_back(stray, &nt->rt_l);
+            }
+        }
+    }
+    spin_unlock_irq(&rq->lock, flags);
+    return f;
+}
+
+closure_function(0, 2, int, fair_compare,
+                 rbnode, a, rbnode, b)
+{
+    nanos_thread ta = struct_from_field(a, nanos_thread, fair_n);
+    nanos_thread tb = struct_from_field(b, nanos_thread, fair_n);
+    if (ta->vruntime != tb->vruntime)
+        return ta->vruntime < tb->vruntime ? -1 : 1;
+    return ta == tb ? 0 : (ta < tb ? -1 : 1);
+}
+
+static struct _closure_fair_compare fair_compare_closure;
+
+void init_fair_queue(struct fair_queue *fq)
+{
+    spin_lock_init(&fq->lock);
+    fq->count = 0;
+    init_rbtree(&fq->threads, init_closure(&fair_compare_closure, fair_compare), 0);
+    fq->min_vruntime = 0;
+}
+
+static inline nanos_thread fair_thread(rbnode n)
+{
+    return struct_from_field(n, nanos_thread, fair_n);
+}
+
+/* Estimate the vruntime of the thread running on ci, or 0 if the cpu isn't
+   running a thread of a fair policy. */
+static timestamp cpu_running_vruntime(cpuinfo ci)
+{
+    u32 weight = ci->sched_weight;
+    if (!weight)
+        return 0;
+    timestamp start = ci->sched_start;
+    timestamp here = now(CLOCK_ID_MONOTONIC_RAW);
+    return ci->sched_vruntime + (here > start ? here - start : 0) * SCHED_WEIGHT_NICE_0 / weight;
+}
+
+/* Queue the frame of a thread of a fair policy on cpu ci, and if the
+   thread is waking up and far enough behind the one running on that cpu,
+   interrupt it. A thread yielding goes behind all others queued there. */
+static void fair_enqueue(cpuinfo ci, nanos_thread nt, context f, boolean wakeup, boolean yielding)
+{
+    struct fair_queue *fq = &ci->fair_queue;
+    timestamp running = 0;
+    u64 flags = spin_lock_irq(&fq->lock);
+    if (wakeup) {
+        /* the least vruntime on the cpu, counting the running thread */
+        running = cpu_running_vruntime(ci);
+        if (running) {
+            rbnode n = rbtree_find_first(&fq->threads);
+            timestamp least = n == INVALID_ADDRESS ? running : MIN(running, fair_thread(n)->vruntime);
+            fq->min_vruntime = MAX(fq->min_vruntime, least);
+        }
+        timestamp credit = sched_timeslice / 2;
+        if (fq->min_vruntime > credit)
+            nt->vruntime = MAX(nt->vruntime, fq->min_vruntime - credit);
+    } else if (yielding) {
+        struct nanos_thread k;
+        k.vruntime = infinity;
+        rbnode n = rbtree_lookup_max_lte(&fq->threads, &k.fair_n);
+        if (n != INVALID_ADDRESS)
+            nt->vruntime = MAX(nt->vruntime, fair_thread(n)->vruntime + 1);
+    }
+    nt->queued_frame = f;
+    init_rbnode(&nt->fair_n);
+    assert(rbtree_insert_node(&fq->threads, &nt->fair_n));
+    fq->count++;
+    spin_unlock_irq(&fq->lock, flags);
+    /* a cpu running a thread goes through the runloop on return from the
+       interrupt or syscall at hand */
+    if (ci == current_cpu() || !running ||
+        nt->vruntime + sched_wakeup_granularity >= running)
+        return;
+    sched_debug("preempting CPU %d for waking thread\n", ci->id);
+    send_ipi(ci->id, wakeup_vector);
+}
+
+/* Take the frame of least vruntime in the fair_queue of ci that may run on
+   cpu, moving frames that may not to stray if given, as rt_dequeue(). */
+static context fair_dequeue(cpuinfo ci, u64 cpu, struct list *stray)
+{
+    struct fair_queue *fq = &ci->fair_queue;
+    context f = INVALID_ADDRESS;
+    if (!fair_queue_count(ci))
+        return f;
+    u64 flags = spin_lock_irq(&fq->lock);
+    rbnode n = rbtree_find_first(&fq->threads);
+    while (n != INVALID_ADDRESS) {
+        nanos_thread nt = fair_thread(n);
+        boolean allowed = !nt->affinity || bitmap_get(nt->affinity, cpu);
+        if (!allowed && !stray) {
+            n = rbnode_get_next(n);
+            continue;
+        }
+        rbtree_remove_node(&fq->threads, n);
+        fq->count--;
+        if (allowed) {
+            if (cpu == ci->id)
+                fq->min_vruntime = MAX(fq->min_vruntime, nt->vruntime);
+            f = nt->queued_frame;
+            break;
+        }
+        list_push_back(stray, &nt->rt_l);
+        n = rbtree_find_first(&fq->threads);
+    }
+    spin_unlock_irq(&fq->lock, flags);
+    return f;
+}
+
+/* Carry the vruntime of a thread of a fair policy moving from cpu "from"
+   to cpu "to" over, keeping its lag relative to the least vruntime. */
+static void fair_migrate(context f, cpuinfo from, cpuinfo to)
+{
+    nanos_thread nt = pointer_from_u64(f[FRAME_THREAD]);
+    if (!nt || sched_thread_rt(nt) || from == to)
+        return;
+    s64 lag = nt->vruntime - from->fair_queue.min_vruntime;
+    timestamp min = to->fair_queue.min_vruntime;
+    nt->vruntime = lag >= 0 || -lag < min ? min + lag : 0;
+}
+
+/* Take a frame queued on cpu ci that may run on cpu, real-time first. */
+static context dequeue_from(cpuinfo ci, u64 cpu)
+{
+    context f = rt_dequeue(ci, cpu, 0);
+    if (f != INVALID_ADDRESS)
+        return f;
+    f = fair_dequeue(ci, cpu, 0);
+    if (f != INVALID_ADDRESS) {
+        fair_migrate(f, ci, cpuinfo_from_id(cpu));
+        return f;
+    }
+    return dequeue_allowed(ci->thread_queue, cpu);
+}
+
+/* Queue a frame taken from another queue on cpu ci. */
+static void requeue_frame(cpuinfo ci, context f)
+{
+    nanos_thread nt = pointer_from_u64(f[FRAME_THREAD]);
+    f[FRAME_CPU] = ci->id;
+    if (sched_thread_rt(nt)) {
+        rt_enqueue(ci, nt, f, false);
+        return;
+    }
+    if (nt)
+        fair_enqueue(ci, nt, f, false, false);
+    else
+        assert(enqueue(ci->thread_queue, f));
+    wakeup_cpu(ci->id);
+}
+
+/* Move a frame from the queue of its cpu to the queue of a cpu it may run
+   on, preferably idle. */
+static void forward_frame(context f)
+{
+    bitmap affinity = ((nanos_thread)pointer_from_u64(f[FRAME_THREAD]))->affinity;
+    u64 target = INVALID_PHYSICAL;
+    for (u64 cpu = 0; cpu < total_processors; cpu++) {
+        if (!bitmap_get(affinity, cpu))
+            continue;
+        if (target == INVALID_PHYSICAL)
+            target = cpu;
+        if (bitmap_get(idle_cpu_mask, cpu)) {
+            target = cpu;
+            break;
+        }
+    }
+    assert(target != INVALID_PHYSICAL);
+    sched_debug("forwarding thread to CPU %d\n", target);
+    cpuinfo ci = cpuinfo_from_id(target);
+    fair_migrate(f, cpuinfo_from_id(f[FRAME_CPU]), ci);
+    requeue_frame(ci, f);
+}
+
+void schedule_frame(context f)
+{
+    assert(f[FRAME_CPU] != INVALID_PHYSICAL);
+    nanos_thread nt = pointer_from_u64(f[FRAME_THREAD]);
+    cpuinfo ci = cpuinfo_from_id(f[FRAME_CPU]);
+    if (!nt) {
+        assert(enqueue_irqsafe(ci->thread_queue, f));
+        return;
+    }
+    apply(nt->pause);
+    boolean yielding = nt->yielding;
+    nt->yielding = false;
+    /* the thread running on this cpu is being preempted or yields, or else
+       wakes up */
+    boolean running = ci == current_cpu() && ci->sched_thread == nt;
+    if (!frame_cpu_allowed(f, ci->id)) {
+        if (sched_thread_rt(nt))
+            nt->slice_end = 0;
+        forward_frame(f);
+    } else if (!sched_thread_rt(nt)) {
+        fair_enqueue(ci, nt, f, !running, yielding);
+    } else {
+        boolean head = running && !yielding &&
+            (nt->policy == SCHED_FIFO || now(CLOCK_ID_MONOTONIC_RAW) < nt->slice_end);
+        if (!head)
+            nt->slice_end = 0;
+        rt_enqueue(ci, nt, f, head);
+    }
+}
+
+static context dequeue_self(cpuinfo ci)
+{
+    struct list stray;
+    list_init(&stray);
+    context f = rt_dequeue(ci, ci->id, &stray);
+    if (f == INVALID_ADDRESS)
+        f = fair_dequeue(ci, ci->id, &stray);
+    list_foreach(&stray, l) {
+        list_delete(l);
+        forward_frame(struct_from_list(l, nanos_thread, rt_l)->queued_frame);
+    }
+    if (f != INVALID_ADDRESS)
+        return f;
+    while ((f = dequeue(ci->thread_queue)) != INVALID_ADDRESS) {
+        if (frame_cpu_allowed(f, ci->id))
+            break;
+        forward_frame(f);
+    }
+    return f;
+}
+
+/* An isolated cpu leaves kernel work to the others: when there is some,
+   or the runloop timers need arming, wake one of them up to do it. */
+static void kick_housekeeping(cpuinfo ci)
+{
+    boolean work = !queue_empty(bhqueue) || !queue_empty(runqueue);
+    if (!work && kern_try_lock()) {
+        work = timer_check(runloop_timers) != runloop_timer_next;
+        kern_unlock();
+    }
+    if (!work)
+        return;
+    u64 cpu;
+    for (cpu = 0; cpu < total_processors; cpu++) {
+        if (!bitmap_get(isolated_cpu_mask, cpu) && bitmap_get(idle_cpu_mask, cpu)) {
+            wakeup_cpu(cpu);
+            return;
+        }
     }
+    /* all busy: interrupt cpu 0, in case it runs a thread tickless */
+    send_ipi(0, wakeup_vector);
 }
 
-static thunk migrate_to_self(thunk t, u64 first_cpu, u64 ncpus)
+static context migrate_to_self(cpuinfo ci, context f, u64 first_cpu, u64 ncpus)
 {
     u64 cpu;
     while ((ncpus > 0) &&
             ((cpu = bitmap_range_get_first(idle_cpu_mask, first_cpu, ncpus)) != INVALID_PHYSICAL)) {
         cpuinfo cpui = cpuinfo_from_id(cpu);
-        if (t == INVALID_ADDRESS) {
-            t = dequeue(cpui->thread_queue);
-            if (t != INVALID_ADDRESS)
+        if (f == INVALID_ADDRESS) {
+            f = dequeue_from(cpui, ci->id);
+            if (f != INVALID_ADDRESS)
                 sched_debug("migrating thread from idle CPU %d to self\n", cpu);
         }
-        if ((t != INVALID_ADDRESS) && !queue_empty(cpui->thread_queue))
+        if (cpu_has_threads(cpui))
             wakeup_cpu(cpu);
         ncpus -= cpu - first_cpu + 1;
         first_cpu = cpu + 1;
     }
-    return t;
+    return f;
 }
 
 static void migrate_from_self(cpuinfo ci, u64 first_cpu, u64 ncpus)
@@ -167,25 +839,76 @@ static void migrate_from_self(cpuinfo ci, u64 first_cpu, u64 ncpus)
     while ((ncpus > 0) &&
             ((cpu = bitmap_range_get_first(idle_cpu_mask, first_cpu, ncpus)) != INVALID_PHYSICAL)) {
         cpuinfo cpui = cpuinfo_from_id(cpu);
-        thunk t;
-        if (!queue_empty(cpui->thread_queue)) {
+        context f;
+        if (cpu_has_threads(cpui)) {
             wakeup_cpu(cpu);
-        } else if ((t = dequeue(ci->thread_queue)) != INVALID_ADDRESS) {
+        } else if ((f = dequeue_from(ci, cpu)) != INVALID_ADDRESS) {
             sched_debug("migrating thread from self to idle CPU %d\n", cpu);
-            enqueue(cpui->thread_queue, t);
-            wakeup_cpu(cpu);
+            requeue_frame(cpui, f);
         }
         ncpus -= cpu - first_cpu + 1;
         first_cpu = cpu + 1;
     }
 }
 
+/* Direct return
+
+   A thread whose syscall completed without blocking would be queued on
+   its cpu and dispatched again by the runloop, which, with nothing else to
+   do there, picks it right back up. sched_direct_return() runs the frame
+   of the thread at once instead, skipping the trip through the queues and
+   the runloop, when the latter would make the same choice: no other
+   thread is waiting for the cpu, the thread may still run there under the
+   policy it was dispatched with, and there is no kernel work pending or
+   timer expired. The current thread is left running, so its time in the
+   syscall is charged on return to user (see thread_enter_user()).
+   Called with the kernel lock held; it returns only if the frame must go
+   the usual way, through schedule_frame(). */
+void sched_direct_return(context f)
+{
+    cpuinfo ci = current_cpu();
+    nanos_thread nt = pointer_from_u64(f[FRAME_THREAD]);
+    disable_interrupts();
+    if (shutting_down || !nt || ci->sched_thread != nt || f[FRAME_CPU] != ci->id ||
+        nt->yielding || get_current_thread() != nt || cpu_has_threads(ci) ||
+        !frame_cpu_allowed(f, ci->id))
+        return;
+    if (sched_thread_rt(nt) ? ci->sched_prio != nt->rt_priority : ci->sched_weight != nt->weight)
+        return;
+    if (!queue_empty(bhqueue) || !queue_empty(runqueue))
+        return;
+    timestamp next = timer_check(runloop_timers);
+    if (cpu_isolated(ci)) {
+        /* left to the housekeeping cpus, which the runloop would kick */
+        if (next != runloop_timer_next)
+            return;
+    } else {
+        timestamp here = now(CLOCK_ID_MONOTONIC_RAW);
+        if (next <= here)
+            return;
+        update_timer(ci, here);
+    }
+    sched_debug("direct return to thread %p\n", nt);
+    ci->direct_returns++;
+    page_invalidate_flush();
+    /* threads made runnable by the syscall on other cpus */
+    if (ci->id + 1 < total_processors)
+        migrate_from_self(ci, ci->id + 1, total_processors - ci->id - 1);
+    if (ci->id > 0)
+        migrate_from_self(ci, 0, ci->id);
+    if (total_processors > 1)
+        kick_tickless_cpus(ci);
+    kern_unlock();
+    run_thunk(pointer_from_u64(f[FRAME_RUN]));
+    halt("%s: return from thread frame\n", __func__);
+}
+
 // should we ever be in the user frame here? i .. guess so?
 NOTRACE void __attribute__((noreturn)) runloop_internal()
 {
     cpuinfo ci = current_cpu();
     thunk t;
-    boolean timer_updated = false;
+    context f;
 
     sched_thread_pause();
     disable_interrupts();
@@ -193,9 +916,20 @@ NOTRACE void __attribute__((noreturn)) runloop_internal()
                 queue_length(bhqueue), queue_length(runqueue), queue_length(ci->thread_queue),
                 ci->have_kernel_lock ? " locked" : "");
     ci->state = cpu_kernel;
+    ci->sched_thread = 0;
+    ci->sched_weight = 0;
+    if (ci->idle_start)
+        idle_exit(ci);
+    if (tickless_cpu_mask && bitmap_get(tickless_cpu_mask, ci->id))
+        bitmap_set_atomic(tickless_cpu_mask, ci->id, 0);
     /* Make sure TLB entries are appropriately flushed before doing any work */
     page_invalidate_flush();
 
+    if (cpu_isolated(ci)) {
+        kick_housekeeping(ci);
+        goto threads;
+    }
+
     /* bhqueue is for operations outside the realm of the kernel lock,
        e.g. storage I/O completions */
     while ((t = dequeue(bhqueue)) != INVALID_ADDRESS)
@@ -211,21 +945,28 @@ NOTRACE void __attribute__((noreturn)) runloop_internal()
 
         /* should be a list of per-runloop checks - also low-pri background */
         mm_service();
-        timer_updated = update_timer();
+        update_timer(ci, now(CLOCK_ID_MONOTONIC_RAW));
         kern_unlock();
+    } else {
+        /* The cpu holding the lock may have updated the timers before they
+           expired here; come back for them shortly. */
+        timestamp here = now(CLOCK_ID_MONOTONIC_RAW);
+        if (runloop_timer_next <= here)
+            set_cpu_timer(ci, here, here + runloop_timer_min);
     }
 
+  threads:
     if (!shutting_down) {
-        t = dequeue(ci->thread_queue);
-        if (t == INVALID_ADDRESS) {
+        f = dequeue_self(ci);
+        if (f == INVALID_ADDRESS) {
             /* Try to steal a thread from an idle CPU (so that it doesn't
              * have to be woken up), and wake up CPUs that have a non-empty
              * thread queue). */
             if (ci->id + 1 < total_processors)
-                t = migrate_to_self(t, ci->id + 1, total_processors - ci->id - 1);
+                f = migrate_to_self(ci, f, ci->id + 1, total_processors - ci->id - 1);
             if (ci->id > 0)
-                t = migrate_to_self(t, 0, ci->id);
-            if (t == INVALID_ADDRESS) {
+                f = migrate_to_self(ci, f, 0, ci->id);
+            if (f == INVALID_ADDRESS) {
                 /* No threads found in idle CPUs: try to steal a thread from a
                  * CPU that is currently running another thread. */
                 for (u64 cpu = ci->id + 1; ; cpu++) {
@@ -234,9 +975,11 @@ NOTRACE void __attribute__((noreturn)) runloop_internal()
                     if (cpu == ci->id)
                         break;
                     cpuinfo cpui = cpuinfo_from_id(cpu);
-                    if (cpui->state == cpu_user) {
-                        t = dequeue(cpui->thread_queue);
-                        if (t != INVALID_ADDRESS) {
+                    /* the queue of a vcpu preempted by the host isn't
+                       being served either */
+                    if (cpui->state == cpu_user || cpu_preempted(cpui)) {
+                        f = dequeue_from(cpui, ci->id);
+                        if (f != INVALID_ADDRESS) {
                             sched_debug("migrating thread from CPU %d to self\n", cpu);
                             break;
                         }
@@ -251,17 +994,21 @@ NOTRACE void __attribute__((noreturn)) runloop_internal()
             if (ci->id > 0)
                 migrate_from_self(ci, 0, ci->id);
         }
-        if (t != INVALID_ADDRESS) {
-            if (!timer_updated && (total_processors > 1)) {
-                timestamp here = now(CLOCK_ID_MONOTONIC_RAW);
-                s64 timeout = ci->last_timer_update - here;
-                if ((timeout < 0) || (timeout > runloop_timer_max)) {
-                    sched_debug("setting CPU scheduler timer\n");
-                    runloop_timer(runloop_timer_max);
-                    ci->last_timer_update = here + runloop_timer_max;
-                }
+        if (total_processors > 1)
+            kick_tickless_cpus(ci);
+        if (f != INVALID_ADDRESS) {
+            nanos_thread nt = pointer_from_u64(f[FRAME_THREAD]);
+            ci->sched_thread = nt;
+            ci->sched_prio = sched_thread_rt(nt) ? nt->rt_priority : 0;
+            if (nt && !sched_thread_rt(nt)) {
+                ci->sched_vruntime = nt->vruntime;
+                ci->sched_start = now(CLOCK_ID_MONOTONIC_RAW);
+                ci->sched_weight = nt->weight;
             }
-            run_thunk(t);
+            if (nt && nt->policy == SCHED_RR && !nt->slice_end)
+                nt->slice_end = now(CLOCK_ID_MONOTONIC_RAW) + sched_rr_slice;
+            sched_tick(ci, nt);
+            run_thunk(pointer_from_u64(f[FRAME_RUN]));
         }
     }
 
@@ -279,6 +1026,15 @@ void init_scheduler(heap h)
     spin_lock_init(&kernel_lock);
     runloop_timer_min = microseconds(RUNLOOP_TIMER_MIN_PERIOD_US);
     runloop_timer_max = microseconds(RUNLOOP_TIMER_MAX_PERIOD_US);
+    runloop_timer_slack = microseconds(RUNLOOP_TIMER_SLACK_US);
+    runloop_timer_next = infinity;
+    sched_timeslice = microseconds(SCHED_TIMESLICE_US);
+    sched_timeslice_min = microseconds(SCHED_TIMESLICE_MIN_US);
+    sched_timeslice_max = microseconds(SCHED_TIMESLICE_MAX_US);
+    sched_rr_slice = microseconds(SCHED_RR_TIMESLICE_US);
+    sched_wakeup_granularity = microseconds(SCHED_WAKEUP_GRANULARITY_US);
+    idle_poll_max = microseconds(IDLE_POLL_MAX_US);
+    idle_poll_grow_start = microseconds(IDLE_POLL_GROW_START_US);
     wakeup_vector = allocate_ipi_interrupt();
 
     register_interrupt(wakeup_vector, ignore, "wakeup ipi");
@@ -298,4 +1054,29 @@ void init_scheduler_cpus(heap h)
     idle_cpu_mask = allocate_bitmap(h, h, total_processors);
     assert(idle_cpu_mask != INVALID_ADDRESS);
     bitmap_alloc(idle_cpu_mask, total_processors);
+    tickless_cpu_mask = allocate_bitmap(h, h, total_processors);
+    assert(tickless_cpu_mask != INVALID_ADDRESS);
+    bitmap_alloc(tickless_cpu_mask, total_processors);
+}
+
+/* "isolated_cpus" in the manifest lists the cpus to isolate, e.g.
+   isolated_cpus:[2 3] */
+void init_isolated_cpus(heap h, tuple root)
+{
+    tuple cpus = get_tuple(root, sym(isolated_cpus));
+    if (!cpus)
+        return;
+    bitmap b = allocate_bitmap(h, h, total_processors);
+    assert(b != INVALID_ADDRESS);
+    bitmap_alloc(b, total_processors);
+    value v;
+    for (int i = 0; (v = get(cpus, intern_u64(i))); i++) {
+        u64 cpu;
+        if (!u64_from_value(v, &cpu) || cpu == 0 || cpu >= total_processors) {
+            msg_err("invalid isolated cpu %v; ignored\n", v);
+            continue;
+        }
+        bitmap_set(b, cpu, 1);
+    }
+    isolated_cpu_mask = b;
 }
@@ -119,6 +119,8 @@ closure_function(6, 0, void, startup,
     tuple root = bound(root);
     filesystem fs = bound(fs);
 
+    init_isolated_cpus(heap_general(kh), root);
+
     /* kernel process is used as a handle for unix */
     process kp = init_unix(kh, root, fs);
     if (kp == INVALID_ADDRESS) {
@@ -133,6 +135,7 @@ closure_function(6, 0, void, startup,
     /* register root tuple with management and kick off interfaces, if any */
     init_management_root(root);
     init_kernel_heaps_management(root);
+    init_tracepoints(kh, root);
 #if 0
     http_listener hl = allocate_http_listener(general, 9090);
     assert(hl != INVALID_ADDRESS);
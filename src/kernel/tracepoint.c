@@ -0,0 +1,237 @@
+#include <kernel.h>
+
+//#define TRACEPOINT_DEBUG
+#ifdef TRACEPOINT_DEBUG
+#define tracepoint_debug(x, ...) do {rprintf("TP: " x "\n", ##__VA_ARGS__);} while(0)
+#else
+#define tracepoint_debug(x, ...)
+#endif
+
+#define _TRACEPOINT_INIT(n) [TRACEPOINT_ ## n] = { .name = #n },
+struct tracepoint tracepoints[TRACEPOINT_MAX] = {
+    TRACEPOINTS(_TRACEPOINT_INIT)
+};
+#undef _TRACEPOINT_INIT
+
+/* from linker script */
+extern struct tracepoint_site tracepoint_sites_start[];
+extern struct tracepoint_site tracepoint_sites_end[];
+
+typedef struct trace_buffer {
+    word next;
+    struct trace_event events[TRACEPOINT_BUFFER_EVENTS];
+} *trace_buffer;
+
+static struct {
+    heap h;
+    heap backed;
+    struct spinlock lock;
+    u64 alias;                  /* virtual page for writable text aliases */
+    int sync_vector;
+    volatile word sync_cpus;    /* cpus held in tracepoint_sync_handler */
+    volatile boolean sync_release;
+    int nbuffers;
+    trace_buffer *buffers;      /* indexed by cpu id */
+    buffer events;
+} tp;
+
+void tracepoint_record(int id, u64 a0, u64 a1, u64 a2)
+{
+    cpuinfo ci = current_cpu();
+    if (ci->id >= tp.nbuffers)
+        return;
+    trace_buffer tb = tp.buffers[ci->id];
+    if (!tb)
+        return;
+    /* only contended by interrupts on this cpu */
+    word n = fetch_and_add(&tb->next, 1);
+    trace_event e = &tb->events[n & (TRACEPOINT_BUFFER_EVENTS - 1)];
+    e->ts = now(CLOCK_ID_MONOTONIC_RAW);
+    e->id = id;
+    e->reserved = 0;
+    e->a0 = a0;
+    e->a1 = a1;
+    e->a2 = a2;
+}
+
+/* Sites are rewritten with every other cpu held in an ipi handler, so
+   that none can be fetching an instruction while it is being replaced;
+   each serializes its instruction stream before it resumes. */
+closure_function(0, 0, void, tracepoint_sync_handler)
+{
+    fetch_and_add((word *)&tp.sync_cpus, 1);
+    while (!tp.sync_release)
+        kern_pause();
+    tracepoint_sync_core();
+    fetch_and_add((word *)&tp.sync_cpus, (word)-1);
+}
+
+/* Kernel text is mapped read-only, so sites are patched through a
+   temporary writable mapping of the underlying physical page. The alias
+   is mapped and unmapped with the other cpus running, as the unmap
+   invalidates it on all of them. */
+static void tracepoint_patch(tracepoint_site s, boolean enable)
+{
+    u64 page = s->code & ~PAGEMASK;
+    physical p = physical_from_virtual(pointer_from_u64(page));
+    assert(p != INVALID_PHYSICAL);
+    map(tp.alias, p, PAGESIZE, pageflags_writable(pageflags_memory()));
+
+    cpuinfo ci = current_cpu();
+    context f = get_running_frame(ci);
+    word ncpus = 0;
+    tp.sync_release = false;
+    for (int i = 0; i < total_processors; i++) {
+        if (i == ci->id || cpuinfo_from_id(i)->state == cpu_not_present)
+            continue;
+        send_ipi(i, tp.sync_vector);
+        ncpus++;
+    }
+
+    /* allow interrupt handling while waiting for the other cpus, as in kern_lock() */
+    u64 flags = irq_enable_save();
+    frame_enable_interrupts(f);
+    while (tp.sync_cpus < ncpus)
+        kern_pause();
+    disable_interrupts();
+    tracepoint_patch_site(pointer_from_u64(tp.alias + (s->code & PAGEMASK)),
+                          s->code, s->target, enable);
+    tracepoint_sync_core();
+    write_barrier();
+    tp.sync_release = true;
+    while (tp.sync_cpus > 0)
+        kern_pause();
+    irq_restore(flags);
+    frame_disable_interrupts(f);
+
+    unmap(tp.alias, PAGESIZE);
+}
+
+static boolean tracepoint_allocate_buffers(void)
+{
+    for (int i = 0; i < tp.nbuffers; i++) {
+        if (tp.buffers[i])
+            continue;
+        trace_buffer tb = allocate_zero(tp.backed, sizeof(struct trace_buffer));
+        if (tb == INVALID_ADDRESS) {
+            msg_err("unable to allocate trace buffer for cpu %d\n", i);
+            return false;
+        }
+        tp.buffers[i] = tb;
+    }
+    return true;
+}
+
+boolean tracepoint_set(int id, boolean enable)
+{
+    if (id < 0 || id >= TRACEPOINT_MAX)
+        return false;
+    tracepoint t = &tracepoints[id];
+    boolean result = true;
+    spin_lock(&tp.lock);
+    if (t->enabled == enable)
+        goto out;
+    if (enable && !tracepoint_allocate_buffers()) {
+        result = false;
+        goto out;
+    }
+    int nsites = 0;
+    for (tracepoint_site s = tracepoint_sites_start; s < tracepoint_sites_end; s++) {
+        if (s->tp != t)
+            continue;
+        tracepoint_patch(s, enable);
+        nsites++;
+    }
+    t->enabled = enable;
+    tracepoint_debug("%s %s, %d sites", t->name, enable ? "enabled" : "disabled", nsites);
+  out:
+    spin_unlock(&tp.lock);
+    return result;
+}
+
+static void tracepoint_format_events(buffer b)
+{
+    buffer_clear(b);
+    for (int cpu = 0; cpu < tp.nbuffers; cpu++) {
+        trace_buffer tb = tp.buffers[cpu];
+        if (!tb)
+            continue;
+        word next = tb->next;
+        word n = MIN(next, TRACEPOINT_BUFFER_EVENTS);
+        for (word i = next - n; i < next; i++) {
+            trace_event e = &tb->events[i & (TRACEPOINT_BUFFER_EVENTS - 1)];
+            if (e->id >= TRACEPOINT_MAX)
+                continue;
+            bprintf(b, "%d %T %s %d 0x%lx 0x%lx\n", cpu, e->ts, tracepoints[e->id].name,
+                    e->a0, e->a1, e->a2);
+        }
+    }
+}
+
+static void tracepoint_clear_events(void)
+{
+    for (int cpu = 0; cpu < tp.nbuffers; cpu++) {
+        trace_buffer tb = tp.buffers[cpu];
+        if (tb)
+            tb->next = 0;
+    }
+}
+
+static boolean tracepoint_value_enabled(value v)
+{
+    if (!v)
+        return false;
+    if (is_string(v) && (buffer_compare_with_cstring(v, "false") ||
+                         buffer_compare_with_cstring(v, "0")))
+        return false;
+    return true;
+}
+
+closure_function(1, 1, boolean, tracepoint_set_notify,
+                 int, id,
+                 value, v)
+{
+    return tracepoint_set(bound(id), tracepoint_value_enabled(v));
+}
+
+closure_function(0, 0, value, tracepoint_events_get)
+{
+    tracepoint_format_events(tp.events);
+    return tp.events;
+}
+
+closure_function(0, 1, boolean, tracepoint_events_set,
+                 value, v)
+{
+    /* writing any value discards recorded events */
+    tracepoint_clear_events();
+    return false;
+}
+
+void init_tracepoints(kernel_heaps kh, tuple root)
+{
+    tp.h = heap_general(kh);
+    tp.backed = (heap)heap_page_backed(kh);
+    spin_lock_init(&tp.lock);
+    tp.alias = allocate_u64((heap)heap_virtual_page(kh), PAGESIZE);
+    assert(tp.alias != INVALID_PHYSICAL);
+    tp.sync_vector = allocate_ipi_interrupt();
+    assert(tp.sync_vector != INVALID_PHYSICAL);
+    register_interrupt(tp.sync_vector, closure(tp.h, tracepoint_sync_handler), "tracepoint sync ipi");
+    tp.nbuffers = total_processors;
+    tp.buffers = allocate_zero(tp.h, tp.nbuffers * sizeof(trace_buffer));
+    assert(tp.buffers != INVALID_ADDRESS);
+    tp.events = allocate_buffer(tp.h, 64);
+    assert(tp.events != INVALID_ADDRESS);
+
+    tuple t = find_or_allocate_tuple(root, sym(tracepoints));
+    set(t, sym(events), tp.events);
+    tuple_notifier tn = tuple_notifier_wrap(t);
+    assert(tn != INVALID_ADDRESS);
+    for (int i = 0; i < TRACEPOINT_MAX; i++)
+        tuple_notifier_register_set_notify(tn, sym_this(tracepoints[i].name),
+                                           closure(tp.h, tracepoint_set_notify, i));
+    tuple_notifier_register_get_notify(tn, sym(events), closure(tp.h, tracepoint_events_get));
+    tuple_notifier_register_set_notify(tn, sym(events), closure(tp.h, tracepoint_events_set));
+    set(root, sym(tracepoints), tn);
+}
@@ -0,0 +1,74 @@
+/* Static tracepoints
+
+   Each tracepoint site is compiled as a single no-op instruction which is
+   patched into a jump to the out-of-line recording code when the
+   tracepoint is enabled, so a disabled tracepoint costs only the NOP.
+   Sites are collected by the linker into the .tracepoint_sites table,
+   which records the address of the patchable instruction, the jump
+   target and the tracepoint it belongs to.
+
+   Enabled tracepoints record fixed-size binary events into per-cpu ring
+   buffers, overwriting the oldest events when a buffer wraps. Tracepoints
+   are controlled through the "tracepoints" management tuple; setting
+   e.g. "tracepoints:(syscall_enter:t)" in the manifest enables a
+   tracepoint from boot. Sites are only patched within the kernel image
+   itself; klibs are not instrumented. */
+
+#define TRACEPOINTS(_)                                                  \
+    _(syscall_enter)    /* syscall number, arg0, arg1 */                \
+    _(syscall_exit)     /* syscall number, return value */              \
+    _(block_submit)     /* sector count, first sector, buffer */        \
+    _(block_complete)   /* sector count, first sector, status */        \
+    _(page_fault)       /* cpu state, fault address, pc */              \
+    _(context_switch)   /* tid, previous thread, next thread */         \
+    _(net_rx)           /* length, pbuf */                              \
+    _(net_tx)           /* length, pbuf */                              \
+    _(pagecache_state)  /* new state, page offset, old state */
+
+#define _TRACEPOINT_ENUM(n) TRACEPOINT_ ## n,
+enum {
+    TRACEPOINTS(_TRACEPOINT_ENUM)
+    TRACEPOINT_MAX
+};
+#undef _TRACEPOINT_ENUM
+
+typedef struct tracepoint {
+    const char *name;
+    boolean enabled;
+} *tracepoint;
+
+typedef struct tracepoint_site {
+    u64 code;                   /* address of patchable instruction */
+    u64 target;                 /* address of enabled path */
+    tracepoint tp;
+} *tracepoint_site;
+
+typedef struct trace_event {
+    timestamp ts;
+    u16 id;
+    u16 reserved;
+    u32 a0;
+    u64 a1;
+    u64 a2;
+} *trace_event;
+
+#if defined(KERNEL) && !defined(BUILD_VDSO)
+extern struct tracepoint tracepoints[TRACEPOINT_MAX];
+
+#include <tracepoint_machine.h>
+
+void tracepoint_record(int id, u64 a0, u64 a1, u64 a2);
+
+#define tracepoint_enabled(n)   tracepoint_branch(&tracepoints[TRACEPOINT_ ## n])
+
+#define trace_event(n, a0, a1, a2) do {                                 \
+        if (tracepoint_enabled(n))                                      \
+            tracepoint_record(TRACEPOINT_ ## n, (u64)(a0), (u64)(a1), (u64)(a2)); \
+    } while (0)
+
+boolean tracepoint_set(int id, boolean enable);
+void init_tracepoints(kernel_heaps kh, tuple root);
+#else
+#define tracepoint_enabled(n)       false
+#define trace_event(n, a0, a1, a2)
+#endif
@@ -118,6 +118,7 @@ static void direct_conn_send_internal(direct_conn dc, qbuf q)
             break;
 
         err = tcp_output(dc->p);
+        netif_tx_flush_all();
         if (err != ERR_OK) {
             msg_err("tcp_output failed with %d\n", err);
             break;
@@ -224,6 +225,7 @@ static direct_conn direct_conn_alloc(direct d, struct tcp_pcb *pcb)
     tcp_err(pcb, direct_conn_err);
     tcp_recv(pcb, direct_conn_input);
     tcp_sent(pcb, direct_conn_sent);
+    tcp_demux_add(pcb);
     return dc;
   fail_dealloc:
     deallocate(d->h, dc, sizeof(struct direct_conn));
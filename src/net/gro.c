@@ -0,0 +1,260 @@
+#include <kernel.h>
+#include <lwip.h>
+#include <lwip/prot/ethernet.h>
+#include <lwip/prot/tcp.h>
+
+//#define GRO_DEBUG
+#ifdef GRO_DEBUG
+#define gro_debug(x, ...) do {rprintf("GRO: " x, ##__VA_ARGS__);} while(0)
+#else
+#define gro_debug(x, ...)
+#endif
+
+/* Generic receive offload
+
+   Bulk TCP transfers arrive as long runs of full-sized, in-order segments
+   of one flow. Rather than passing each of them through the stack (and
+   acknowledging every other one), a driver hands the frames of a receive
+   batch to netif_gro_receive(), which appends the payload of each segment
+   that continues a held flow to the frame at its head. The merged frame
+   is delivered with its IP length fixed up when the flow can no longer
+   grow or at the latest when the driver calls netif_gro_flush() at the end
+   of the batch, so no frame is held across batches.
+
+   Only segments carrying nothing but payload and an ACK are merged, and
+   only while the options, the acknowledgment and the window match those
+   of the head segment; anything else first flushes the flow it belongs
+   to, which keeps the stack's view of each flow in order. As the merged
+   frame is handed over with its transport checksum marked as verified,
+   segments not verified by the device are checked here. */
+
+#define GRO_MAX_LEN     0xffff  /* pbuf tot_len */
+
+typedef struct gro_segment {
+    u16 l3_offset;
+    u16 l4_offset;
+    u16 len;                    /* payload */
+    boolean ipv6;
+    struct tcp_hdr *tcph;
+} *gro_segment;
+
+static boolean gro_parse(struct pbuf *p, gro_segment s)
+{
+    u8 *f = p->payload;
+    u16 off = SIZEOF_ETH_HDR;
+    if (p->len < off)
+        return false;
+    u16 type = ((struct eth_hdr *)f)->type;
+    if (type == PP_HTONS(ETHTYPE_VLAN)) {
+        off += SIZEOF_VLAN_HDR;
+        if (p->len < off)
+            return false;
+        type = ((struct eth_vlan_hdr *)(f + SIZEOF_ETH_HDR))->tpid;
+    }
+    s->l3_offset = off;
+    u16 l3len;
+    if (type == PP_HTONS(ETHTYPE_IP)) {
+        struct ip_hdr *iph = (struct ip_hdr *)(f + off);
+        if (p->len < off + IP_HLEN || IPH_V(iph) != 4 || IPH_HL_BYTES(iph) != IP_HLEN ||
+            IPH_PROTO(iph) != IP_PROTO_TCP ||
+            (IPH_OFFSET(iph) & PP_HTONS(IP_OFFMASK | IP_MF)))
+            return false;
+        l3len = lwip_ntohs(IPH_LEN(iph));
+        off += IP_HLEN;
+        s->ipv6 = false;
+    } else if (type == PP_HTONS(ETHTYPE_IPV6)) {
+        struct ip6_hdr *ip6h = (struct ip6_hdr *)(f + off);
+        if (p->len < off + IP6_HLEN || IP6H_V(ip6h) != 6 || IP6H_NEXTH(ip6h) != IP6_NEXTH_TCP)
+            return false;
+        l3len = IP6_HLEN + IP6H_PLEN(ip6h);
+        off += IP6_HLEN;
+        s->ipv6 = true;
+    } else {
+        return false;
+    }
+    if (p->len < off + TCP_HLEN)
+        return false;
+    s->l4_offset = off;
+    s->tcph = (struct tcp_hdr *)(f + off);
+    u16 hlen = TCPH_HDRLEN_BYTES(s->tcph);
+    if (hlen < TCP_HLEN || p->len < off + hlen || l3len < off - s->l3_offset + hlen)
+        return false;
+    /* drop any link-layer padding */
+    u32 flen = s->l3_offset + l3len;
+    if (p->tot_len < flen)
+        return false;
+    if (p->tot_len > flen)
+        pbuf_realloc(p, flen);
+    s->len = flen - off - hlen;
+    return true;
+}
+
+static boolean gro_same_flow(struct pbuf *p, gro_segment s, netif_gro_flow f)
+{
+    if (s->ipv6 != f->ipv6)
+        return false;
+    struct tcp_hdr *th = f->tcph;
+    if (s->tcph->src != th->src || s->tcph->dest != th->dest)
+        return false;
+    void *l3 = p->payload + s->l3_offset;
+    if (s->ipv6)
+        return !runtime_memcmp(&((struct ip6_hdr *)l3)->src, &((struct ip6_hdr *)f->l3)->src,
+                               2 * sizeof(ip6_addr_p_t));
+    return !runtime_memcmp(&((struct ip_hdr *)l3)->src, &((struct ip_hdr *)f->l3)->src,
+                           2 * sizeof(ip4_addr_p_t));
+}
+
+/* whether the network and transport headers allow appending s to f */
+static boolean gro_can_merge(struct pbuf *p, gro_segment s, netif_gro_flow f)
+{
+    struct tcp_hdr *th = f->tcph;
+    void *l3 = p->payload + s->l3_offset;
+    if (s->ipv6) {
+        struct ip6_hdr *ip6h = l3, *fip6h = f->l3;
+        if (ip6h->_v_tc_fl != fip6h->_v_tc_fl || IP6H_HOPLIM(ip6h) != IP6H_HOPLIM(fip6h))
+            return false;
+    } else {
+        struct ip_hdr *iph = l3, *fiph = f->l3;
+        if (IPH_TOS(iph) != IPH_TOS(fiph) || IPH_TTL(iph) != IPH_TTL(fiph) ||
+            IPH_OFFSET(iph) != IPH_OFFSET(fiph))
+            return false;
+    }
+    u16 hlen = TCPH_HDRLEN_BYTES(s->tcph);
+    return lwip_ntohl(s->tcph->seqno) == f->next_seq &&
+        s->tcph->ackno == th->ackno && s->tcph->wnd == th->wnd &&
+        hlen == TCPH_HDRLEN_BYTES(th) &&
+        !runtime_memcmp(s->tcph + 1, th + 1, hlen - TCP_HLEN) &&
+        s->len <= f->seg_len && f->p->tot_len + s->len <= GRO_MAX_LEN;
+}
+
+/* segments eligible for merging carry data and no flags other than ACK or PSH */
+static boolean gro_mergeable(gro_segment s)
+{
+    return s->len > 0 && (TCPH_FLAGS(s->tcph) & ~TCP_PSH) == TCP_ACK;
+}
+
+/* The IPv4 header checksum of a merged frame is recomputed, so the headers
+   of all segments are checked first. */
+static boolean gro_verify(struct pbuf *p, gro_segment s, boolean csum_verified)
+{
+    void *l3 = p->payload + s->l3_offset;
+    if (!s->ipv6 && ip_csum(l3, IP_HLEN))
+        return false;
+    if (csum_verified)
+        return true;
+    u64 sum;
+    if (s->ipv6)
+        sum = ip_csum_partial(&((struct ip6_hdr *)l3)->src, 2 * sizeof(ip6_addr_p_t), 0);
+    else
+        sum = ip_csum_partial(&((struct ip_hdr *)l3)->src, 2 * sizeof(ip4_addr_p_t), 0);
+    u16 l4len = p->tot_len - s->l4_offset;
+    sum = ip_csum_add(sum, PP_HTONS(IP_PROTO_TCP));
+    sum = ip_csum_add(sum, lwip_htons(l4len));
+    u16 skip = s->l4_offset;
+    boolean odd = false;
+    for (struct pbuf *q = p; q; q = q->next) {
+        if (skip >= q->len) {
+            skip -= q->len;
+            continue;
+        }
+        u16 len = q->len - skip;
+        u16 c = ip_csum_fold(ip_csum_partial(q->payload + skip, len, 0));
+        sum = ip_csum_add(sum, odd ? SWAP_BYTES_IN_WORD(c) : c);
+        odd ^= len & 1;
+        skip = 0;
+    }
+    return ip_csum_fold(sum) == 0xffff;
+}
+
+static void gro_deliver(netif_gro g, struct pbuf *p, boolean csum_verified)
+{
+    netif_rx_csum_verified(g->n, csum_verified);
+    if (g->n->input(p, g->n) != ERR_OK)
+        pbuf_free(p);
+}
+
+static void gro_flush_flow(netif_gro g, netif_gro_flow f)
+{
+    struct pbuf *p = f->p;
+    if (f->segs > 1) {
+        u16 l3len = p->tot_len - (f->l3 - p->payload);
+        if (f->ipv6) {
+            IP6H_PLEN_SET((struct ip6_hdr *)f->l3, l3len - IP6_HLEN);
+        } else {
+            struct ip_hdr *iph = f->l3;
+            IPH_LEN_SET(iph, lwip_htons(l3len));
+            IPH_CHKSUM_SET(iph, 0);
+            IPH_CHKSUM_SET(iph, ip_csum(iph, IP_HLEN));
+        }
+        if (f->psh)
+            TCPH_SET_FLAG(f->tcph, TCP_PSH);
+        gro_debug("%s: %d segments, %d bytes\n", __func__, f->segs, p->tot_len);
+    }
+    gro_deliver(g, p, true);
+}
+
+void netif_gro_init(netif_gro g, struct netif *n)
+{
+    g->n = n;
+    g->nflows = 0;
+}
+
+static void gro_remove_flow(netif_gro g, netif_gro_flow f)
+{
+    gro_flush_flow(g, f);
+    *f = g->flows[--g->nflows];
+}
+
+void netif_gro_receive(netif_gro g, struct pbuf *p, boolean csum_verified)
+{
+    struct gro_segment s;
+    if (!gro_parse(p, &s)) {
+        gro_deliver(g, p, csum_verified);
+        return;
+    }
+    netif_gro_flow f = 0;
+    for (int i = 0; i < g->nflows; i++) {
+        if (gro_same_flow(p, &s, &g->flows[i])) {
+            f = &g->flows[i];
+            break;
+        }
+    }
+    boolean merge = gro_mergeable(&s) && gro_verify(p, &s, csum_verified);
+    boolean psh = (TCPH_FLAGS(s.tcph) & TCP_PSH) != 0;
+    if (f) {
+        if (merge && gro_can_merge(p, &s, f)) {
+            pbuf_remove_header(p, s.l4_offset + TCPH_HDRLEN_BYTES(s.tcph));
+            pbuf_cat(f->p, p);
+            f->segs++;
+            f->next_seq += s.len;
+            f->psh = psh;
+            /* a short segment or a push ends the run */
+            if (s.len < f->seg_len || psh || f->p->tot_len + f->seg_len > GRO_MAX_LEN)
+                gro_remove_flow(g, f);
+            return;
+        }
+        gro_remove_flow(g, f);
+    }
+    if (!merge || psh) {
+        gro_deliver(g, p, merge || csum_verified);
+        return;
+    }
+    if (g->nflows == NETIF_GRO_FLOWS)
+        netif_gro_flush(g);
+    f = &g->flows[g->nflows++];
+    f->p = p;
+    f->l3 = p->payload + s.l3_offset;
+    f->tcph = s.tcph;
+    f->next_seq = lwip_ntohl(s.tcph->seqno) + s.len;
+    f->seg_len = s.len;
+    f->segs = 1;
+    f->ipv6 = s.ipv6;
+    f->psh = false;
+}
+
+void netif_gro_flush(netif_gro g)
+{
+    for (int i = 0; i < g->nflows; i++)
+        gro_flush_flow(g, &g->flows[i]);
+    g->nflows = 0;
+}
@@ -26,4 +26,102 @@ u16 ifflags_from_netif(struct netif *netif);
 boolean ifflags_to_netif(struct netif *netif, u16 flags);
 void netif_name_cpy(char *dest, struct netif *netif);
 
+typedef struct netif_csum_info {
+    u16 l3_offset;              /* IP header */
+    u16 l4_offset;              /* TCP header, where checksumming starts */
+    u16 csum_offset;            /* checksum field, relative to l4_offset */
+    u8 l4_hdr_len;
+    boolean ipv6;
+} *netif_csum_info;
+
+void netif_tx_csum_offload(struct netif *n);
+void netif_rx_csum_verified(struct netif *n, boolean verified);
+boolean netif_tx_csum_prepare(struct netif *n, struct pbuf *p, netif_csum_info ci);
+void netif_tx_csum_complete(struct pbuf *p, netif_csum_info ci);
+void netif_loop_poll_all(void);
+
+/* transmit batching state, embedded in each transmit queue of a driver */
+typedef struct netif_tx_batch {
+    struct list l;              /* on the list of batches to flush */
+    struct list all;
+    struct netif *n;
+    thunk flush;                /* rings the doorbell for posted frames */
+    boolean pending;
+    u64 packets;
+    u64 doorbells;
+} *netif_tx_batch;
+
+void netif_tx_batch_init(netif_tx_batch b, struct netif *n, thunk flush);
+void netif_tx_batch_add(netif_tx_batch b);
+void netif_tx_doorbell(netif_tx_batch b);
+void netif_tx_flush_all(void);
+
+/* AF_XDP sockets: drivers register the receive queues that can be bound,
+   and hand frames over ahead of receive offload and lwIP */
+void xdp_init(kernel_heaps kh);
+void netif_xsk_enable(struct netif *n, u32 queues);
+boolean netif_xsk_receive(struct netif *n, u32 queue, struct pbuf *p);
+void netif_xsk_receive_flush(struct netif *n);
+
+#define NETIF_GRO_FLOWS 8
+
+typedef struct netif_gro_flow {
+    struct pbuf *p;             /* head segment, with payload of the rest chained */
+    void *l3;
+    struct tcp_hdr *tcph;
+    u32 next_seq;
+    u16 seg_len;
+    u16 segs;
+    boolean ipv6;
+    boolean psh;
+} *netif_gro_flow;
+
+/* receive offload state, embedded in each receive queue of a driver */
+typedef struct netif_gro {
+    struct netif *n;
+    int nflows;
+    struct netif_gro_flow flows[NETIF_GRO_FLOWS];
+} *netif_gro;
+
+void netif_gro_init(netif_gro g, struct netif *n);
+void netif_gro_receive(netif_gro g, struct pbuf *p, boolean csum_verified);
+void netif_gro_flush(netif_gro g);
+
+#define TCP_CC_NAME_MAX 16
+
+/* congestion control state of a connection, updated as data is acked */
+typedef struct tcp_cc {
+    const struct tcp_cc_ops *ops;
+    u32 cwnd;                   /* last window set or seen, bytes */
+    u32 ssthresh;               /* last seen lwIP ssthresh, to spot loss events */
+    u32 w_max;                  /* window before the last reduction */
+    u32 w_est;                  /* Reno-equivalent window */
+    u32 origin;
+    u64 k;                      /* ms from the epoch start to reach origin */
+    timestamp epoch_start;
+} *tcp_cc;
+
+typedef struct tcp_cc_ops {
+    const char *name;
+    void (*init)(tcp_cc cc, struct tcp_pcb *pcb);
+    void (*acked)(tcp_cc cc, struct tcp_pcb *pcb, u16 len);
+} *tcp_cc_ops;
+
+void tcp_cc_init(tcp_cc cc, struct tcp_pcb *pcb, tcp_cc parent);
+const char *tcp_cc_name(tcp_cc cc);
+boolean tcp_cc_select(tcp_cc cc, struct tcp_pcb *pcb, const char *name, int len);
+void tcp_cc_acked(tcp_cc cc, struct tcp_pcb *pcb, u16 len);
+boolean tcp_cc_set_default(const char *name, int len);
+
+void init_tcp_demux(heap h);
+void tcp_demux_add(struct tcp_pcb *pcb);
+void tcp_demux_remove(struct tcp_pcb *pcb);
+void tcp_tw_set_max(u64 max);
+void tcp_tw_limit(void);
+
+void netsock_zc_pcb_free(struct tcp_pcb *pcb);
+
+void netif_loop_netem(struct netif *n, tuple t);
+boolean netif_loop_emulated(void);
+
 #define netif_is_loopback(netif)    (((netif)->name[0] == 'l') && ((netif)->name[1] == 'o'))
@@ -48,7 +48,19 @@
 #define LWIP_NO_LIMITS_H 1
 #define LWIP_NO_CTYPE_H 1
 
-#define LWIP_CHKSUM_ALGORITHM   3
+/* Checksums are computed by the runtime (see lwip_chksum in net.c), and
+   TCP and UDP payloads are checksummed while being copied into pbufs. */
+#define LWIP_CHKSUM             lwip_chksum
+#define LWIP_CHECKSUM_ON_COPY   1
+#define LWIP_CHKSUM_COPY_ALGORITHM  2   /* lwip_chksum_copy in net.c */
+
+/* Drivers for devices with checksum offload clear the generate and check
+   flags on their netif (see netif_tx_csum_offload). */
+#define LWIP_CHECKSUM_CTRL_PER_NETIF    1
+
+/* headroom in front of the link header for a device header, e.g. the
+   virtio net header (struct virtio_net_hdr_mrg_rxbuf) */
+#define PBUF_LINK_ENCAPSULATION_HLEN    12
 
 #define LWIP_WND_SCALE 1
 #define TCP_MSS 1460            /* Assuming ethernet; may want to derive this */
@@ -58,6 +70,15 @@
 #define TCP_OVERSIZE TCP_MSS
 #define TCP_QUEUE_OOSEQ 1
 
+/* Advertise out-of-sequence data held in the ooseq queue, so that a
+   sender can retransmit just the holes after a loss. */
+#define LWIP_TCP_SACK_OUT 1
+#define LWIP_TCP_MAX_SACK_NUM 4
+
+/* The fast timer bounds how long an ACK may be delayed; the default of
+   250ms stalls request/response exchanges that defeat piggybacking. */
+#define TCP_TMR_INTERVAL 100
+
 #define TCP_RCV_SCALE 0         /* XXX check */
 #define TCP_LISTEN_BACKLOG 1
 #define LWIP_DHCP 1
@@ -136,6 +157,8 @@ extern u32_t lwip_rand(void);
 extern void net_debug(char *format, ...);
 extern void *lwip_allocate(unsigned long long size);
 extern void lwip_deallocate(void *z);
+extern void *lwip_memp_allocate(int type, unsigned long long size);
+extern void lwip_memp_deallocate(int type, void *x);
 
 static inline void *lwip_malloc(size_t b)
 {
@@ -150,6 +173,13 @@ static inline void lwip_free(void *x)
     lwip_deallocate(x);
 }
 
+/* TCP connection lookup ahead of lwIP (see tcp_demux.c) */
+struct pbuf;
+int tcp_demux_input(struct pbuf *p, int ipv6);
+#define LWIP_HOOK_IP4_INPUT(pbuf, input_netif)  tcp_demux_input(pbuf, 0)
+#define LWIP_HOOK_IP6_INPUT(pbuf, input_netif)  tcp_demux_input(pbuf, 1)
+
+u16_t lwip_chksum(const void *dataptr, int len);
 int lwip_atoi(const char *p);
 void lwip_memcpy(void *a, const void *b, unsigned long len);
 int lwip_strlen(char *a);
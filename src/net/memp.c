@@ -0,0 +1,74 @@
+/* This takes the place of lwIP's core/memp.c. lwIP is built with
+   MEMP_MEM_MALLOC, with which pool objects would be allocated through
+   mem_malloc() by size alone, indistinguishable from other allocations of
+   the same size; here they are handed to lwip_memp_allocate() along with
+   their pool type. */
+#include <lwip/opt.h>
+#include <lwip/mem.h>
+#include <lwip/memp.h>
+#include <lwip/sys.h>
+#include <lwip/stats.h>
+
+/* for the pool object sizes, as in lwIP's memp.c */
+#include <lwip/pbuf.h>
+#include <lwip/raw.h>
+#include <lwip/udp.h>
+#include <lwip/tcp.h>
+#include <lwip/priv/tcp_priv.h>
+#include <lwip/altcp.h>
+#include <lwip/ip4_frag.h>
+#include <lwip/netbuf.h>
+#include <lwip/api.h>
+#include <lwip/priv/tcpip_priv.h>
+#include <lwip/priv/api_msg.h>
+#include <lwip/priv/sockets_priv.h>
+#include <lwip/etharp.h>
+#include <lwip/igmp.h>
+#include <lwip/timeouts.h>
+#include <netif/ppp/ppp_opts.h>
+#include <lwip/netdb.h>
+#include <lwip/dns.h>
+#include <lwip/priv/nd6_priv.h>
+#include <lwip/ip6_frag.h>
+#include <lwip/mld6.h>
+
+#define LWIP_MEMPOOL(name,num,size,desc) LWIP_MEMPOOL_DECLARE(name,num,size,desc)
+#include <lwip/priv/memp_std.h>
+
+const struct memp_desc *const memp_pools[MEMP_MAX] = {
+#define LWIP_MEMPOOL(name,num,size,desc) &memp_ ## name,
+#include <lwip/priv/memp_std.h>
+};
+
+void memp_init_pool(const struct memp_desc *desc)
+{
+}
+
+void memp_init(void)
+{
+}
+
+/* private pools (LWIP_MEMPOOL_ALLOC) have no type */
+void *memp_malloc_pool(const struct memp_desc *desc)
+{
+    return mem_malloc(MEMP_ALIGN_SIZE(desc->size));
+}
+
+void memp_free_pool(const struct memp_desc *desc, void *mem)
+{
+    if (mem)
+        mem_free(mem);
+}
+
+void *memp_malloc(memp_t type)
+{
+    LWIP_ERROR("memp_malloc: type < MEMP_MAX", (type < MEMP_MAX), return NULL;);
+    return lwip_memp_allocate(type, MEMP_ALIGN_SIZE(memp_pools[type]->size));
+}
+
+void memp_free(memp_t type, void *mem)
+{
+    LWIP_ERROR("memp_free: type < MEMP_MAX", (type < MEMP_MAX), return;);
+    if (mem)
+        lwip_memp_deallocate(type, mem);
+}
@@ -1,6 +1,10 @@
 #include <kernel.h>
 #include <lwip.h>
 #include <lwip/priv/tcp_priv.h>
+#include <lwip/priv/memp_priv.h>
+#include <lwip/prot/ethernet.h>
+#include <lwip/prot/tcp.h>
+#include <lwip/inet_chksum.h>
 
 /* Network interface flags */
 #define IFF_UP          (1 << 0)
@@ -12,6 +16,33 @@
 
 static heap lwip_heap;
 
+/* Pool objects are allocated by type through lwip_memp_allocate() (see
+   memp.c), and the hot pool types are served from dedicated objcaches
+   fronted by per-cpu free lists. These objects are fully initialized by
+   lwIP and are not zeroed. The free lists are only touched with
+   interrupts disabled, as pbufs are also freed from driver completions. */
+#define LWIP_POOL_CPU_CACHE_MAX 128
+
+static struct lwip_pool {
+    int type;                   /* memp_t */
+    bytes size;
+    heap cache;
+} lwip_pools[] = {
+    { .type = MEMP_PBUF },
+    { .type = MEMP_PBUF_POOL },
+    { .type = MEMP_TCP_SEG },
+    { .type = MEMP_TCP_PCB },
+};
+
+#define LWIP_POOL_COUNT (sizeof(lwip_pools) / sizeof(lwip_pools[0]))
+
+typedef struct lwip_pool_cpu {
+    void *free[LWIP_POOL_COUNT];
+    u32 count[LWIP_POOL_COUNT];
+} *lwip_pool_cpu;
+
+static heap lwip_pool_meta;
+
 /* Pretty silly. LWIP offers lwip_cyclic_timers for use elsewhere, but
    says to use LWIP_ARRAYSIZE(), which isn't possible with an
    incomplete type. Plus there's no terminator to the array. So we
@@ -25,8 +56,17 @@ struct net_lwip_timer {
     char * name;
 };
 
+/* lwIP's own timeouts stop the TCP timer while there are no pcbs to service */
+static void net_tcp_tmr(void)
+{
+    if (!tcp_active_pcbs && !tcp_tw_pcbs)
+        return;
+    tcp_tmr();
+    tcp_tw_limit();
+}
+
 static struct net_lwip_timer net_lwip_timers[] = {
-    {TCP_TMR_INTERVAL, tcp_tmr, "tcp"},
+    {TCP_TMR_INTERVAL, net_tcp_tmr, "tcp"},
     {IP_TMR_INTERVAL, ip_reass_tmr, "ip"},
     {ARP_TMR_INTERVAL, etharp_tmr, "arp"},
     {DHCP_COARSE_TIMER_MSECS, dhcp_coarse_tmr, "dhcp coarse"},
@@ -68,6 +108,61 @@ void lwip_debug(char * format, ...)
     log_vprintf("LWIP", format, &a);
 }
 
+/* called with interrupts disabled */
+static lwip_pool_cpu lwip_get_pool_cpu(void)
+{
+    cpuinfo ci = current_cpu();
+    lwip_pool_cpu pc = ci->lwip_pools;
+    if (pc)
+        return pc;
+    pc = allocate_zero(lwip_pool_meta, sizeof(struct lwip_pool_cpu));
+    if (pc == INVALID_ADDRESS)
+        return 0;
+    ci->lwip_pools = pc;
+    return pc;
+}
+
+static void *lwip_pool_allocate(int i)
+{
+    void *p;
+    u64 flags = irq_disable_save();
+    lwip_pool_cpu pc = lwip_get_pool_cpu();
+    if (pc && pc->free[i]) {
+        p = pc->free[i];
+        pc->free[i] = *(void **)p;
+        pc->count[i]--;
+    } else {
+        p = allocate(lwip_pools[i].cache, lwip_pools[i].size);
+    }
+    irq_restore(flags);
+    return p;
+}
+
+static void lwip_pool_deallocate(int i, void *x)
+{
+    struct lwip_pool *pool = &lwip_pools[i];
+    u64 flags = irq_disable_save();
+    lwip_pool_cpu pc = lwip_get_pool_cpu();
+    if (!pc) {
+        deallocate(pool->cache, x, pool->size);
+        goto out;
+    }
+    if (pc->count[i] >= LWIP_POOL_CPU_CACHE_MAX) {
+        /* return half of the cached objects to the shared cache */
+        while (pc->count[i] > LWIP_POOL_CPU_CACHE_MAX / 2) {
+            void *p = pc->free[i];
+            pc->free[i] = *(void **)p;
+            pc->count[i]--;
+            deallocate(pool->cache, p, pool->size);
+        }
+    }
+    *(void **)x = pc->free[i];
+    pc->free[i] = x;
+    pc->count[i]++;
+  out:
+    irq_restore(flags);
+}
+
 void *lwip_allocate(u64 size)
 {
     /* To maintain the malloc/free interface with mcache, allocations must stay
@@ -83,6 +178,45 @@ void lwip_deallocate(void *x)
     deallocate(lwip_heap, x, -1ull);
 }
 
+void *lwip_memp_allocate(int type, u64 size)
+{
+    for (int i = 0; i < LWIP_POOL_COUNT; i++) {
+        if (lwip_pools[i].type == type) {
+            void *p = lwip_pool_allocate(i);
+            return ((p != INVALID_ADDRESS) ? p : 0);
+        }
+    }
+    return lwip_allocate(size);
+}
+
+void lwip_memp_deallocate(int type, void *x)
+{
+    for (int i = 0; i < LWIP_POOL_COUNT; i++) {
+        if (lwip_pools[i].type == type) {
+            if (type == MEMP_TCP_PCB) {
+                tcp_demux_remove(x);
+                netsock_zc_pcb_free(x);
+            }
+            lwip_pool_deallocate(i, x);
+            return;
+        }
+    }
+    lwip_deallocate(x);
+}
+
+static void init_lwip_pools(heap h, heap backed)
+{
+    lwip_pool_meta = h;
+    for (int i = 0; i < LWIP_POOL_COUNT; i++) {
+        struct lwip_pool *pool = &lwip_pools[i];
+        pool->size = MEMP_ALIGN_SIZE(memp_pools[pool->type]->size);
+        /* shared by all cpus behind their free lists */
+        pool->cache = locking_heap_wrapper(h, allocate_objcache(h, backed, pool->size,
+                                                                PAGESIZE_2M));
+        assert(pool->cache != INVALID_ADDRESS);
+    }
+}
+
 static void lwip_ext_callback(struct netif* netif, netif_nsc_reason_t reason,
                               const netif_ext_callback_args_t* args)
 {
@@ -145,6 +279,405 @@ int lwip_strncmp(const char *x, const char *y, unsigned long len)
     return 0;
 }
 
+u16_t lwip_chksum(const void *dataptr, int len)
+{
+    return ip_csum_fold(ip_csum_partial(dataptr, len, 0));
+}
+
+u16_t lwip_chksum_copy(void *dst, const void *src, u16_t len)
+{
+    return ip_csum_fold(ip_csum_copy(dst, src, len, 0));
+}
+
+/* Checksum offload
+
+   A driver for a device that completes TCP checksums on transmit calls
+   netif_tx_csum_offload() from its netif init function, after which lwIP
+   leaves TCP checksums on that netif to the driver. For each outgoing
+   frame, netif_tx_csum_prepare() locates the checksum field and seeds it
+   with the pseudo-header sum, as devices expect for partial checksum
+   offload; netif_tx_csum_complete() finishes the checksum in software
+   for frames the device cannot handle. netif_tx_csum_prepare() returns
+   false for frames that aren't TCP, and also for TCP frames with headers
+   past the first pbuf or with IPv6 extension headers, which it
+   checksums in software itself.
+
+   On receive, such a driver reports whether the device has verified the
+   TCP or UDP checksum of each frame with netif_rx_csum_verified() before
+   passing it to the stack. IP header checksums are always verified by
+   lwIP. */
+void netif_tx_csum_offload(struct netif *n)
+{
+    NETIF_SET_CHECKSUM_CTRL(n, n->chksum_flags & ~NETIF_CHECKSUM_GEN_TCP);
+}
+
+void netif_rx_csum_verified(struct netif *n, boolean verified)
+{
+    if (verified)
+        n->chksum_flags &= ~(NETIF_CHECKSUM_CHECK_TCP | NETIF_CHECKSUM_CHECK_UDP);
+    else
+        n->chksum_flags |= NETIF_CHECKSUM_CHECK_TCP | NETIF_CHECKSUM_CHECK_UDP;
+}
+
+/* result of locating the TCP header of an outgoing frame */
+enum tx_csum_frame {
+    TX_CSUM_NOT_TCP,
+    TX_CSUM_TCP,
+    TX_CSUM_TCP_EXT,            /* TCP after IPv6 extension headers */
+    TX_CSUM_SHORT,              /* headers extend past the bytes given */
+};
+
+/* enough for the link, IP and TCP headers of any frame sent by lwIP */
+#define TX_CSUM_HDR_MAX 256
+
+/* Checksums of fragmented segments cover all the fragments and can't be
+   completed per frame; lwIP doesn't fragment TCP segments, whose MSS
+   fits the MTU. */
+static enum tx_csum_frame netif_tx_csum_parse(u8 *f, u16 len, netif_csum_info ci, u64 *sum)
+{
+    u16 off = SIZEOF_ETH_HDR;
+    if (len < off)
+        return TX_CSUM_SHORT;
+    u16 type = ((struct eth_hdr *)f)->type;
+    if (type == PP_HTONS(ETHTYPE_VLAN)) {
+        off += SIZEOF_VLAN_HDR;
+        if (len < off)
+            return TX_CSUM_SHORT;
+        type = ((struct eth_vlan_hdr *)(f + SIZEOF_ETH_HDR))->tpid;
+    }
+    ci->l3_offset = off;
+    enum tx_csum_frame frame = TX_CSUM_TCP;
+    u16 l4len;
+    if (type == PP_HTONS(ETHTYPE_IP)) {
+        struct ip_hdr *iph = (struct ip_hdr *)(f + off);
+        if (len < off + IP_HLEN)
+            return TX_CSUM_SHORT;
+        if (IPH_PROTO(iph) != IP_PROTO_TCP ||
+            (IPH_OFFSET(iph) & PP_HTONS(IP_OFFMASK | IP_MF)))
+            return TX_CSUM_NOT_TCP;
+        l4len = lwip_ntohs(IPH_LEN(iph)) - IPH_HL_BYTES(iph);
+        off += IPH_HL_BYTES(iph);
+        *sum = ip_csum_partial(&iph->src, 2 * sizeof(ip4_addr_p_t), 0);
+        ci->ipv6 = false;
+    } else if (type == PP_HTONS(ETHTYPE_IPV6)) {
+        struct ip6_hdr *ip6h = (struct ip6_hdr *)(f + off);
+        if (len < off + IP6_HLEN)
+            return TX_CSUM_SHORT;
+        u8 nexth = IP6H_NEXTH(ip6h);
+        l4len = IP6H_PLEN(ip6h);
+        off += IP6_HLEN;
+        *sum = ip_csum_partial(&ip6h->src, 2 * sizeof(ip6_addr_p_t), 0);
+        ci->ipv6 = true;
+        while (nexth != IP6_NEXTH_TCP) {
+            if (nexth != IP6_NEXTH_HOPBYHOP && nexth != IP6_NEXTH_ROUTING &&
+                nexth != IP6_NEXTH_DESTOPTS)
+                return TX_CSUM_NOT_TCP;
+            /* next header and length in units of 8 bytes, less the first */
+            u8 *ext = f + off;
+            if (len < off + 2)
+                return TX_CSUM_SHORT;
+            u16 ext_len = (ext[1] + 1) * 8;
+            nexth = ext[0];
+            off += ext_len;
+            l4len -= ext_len;
+            frame = TX_CSUM_TCP_EXT;
+        }
+    } else {
+        return TX_CSUM_NOT_TCP;
+    }
+    if (len < off + TCP_HLEN)
+        return TX_CSUM_SHORT;
+    *sum = ip_csum_add(*sum, PP_HTONS(IP_PROTO_TCP));
+    *sum = ip_csum_add(*sum, lwip_htons(l4len));
+    ci->l4_offset = off;
+    ci->csum_offset = offsetof(struct tcp_hdr *, chksum);
+    ci->l4_hdr_len = TCPH_HDRLEN_BYTES((struct tcp_hdr *)(f + off));
+    return frame;
+}
+
+/* lwIP builds the link, IP and TCP headers of a segment in its first
+   pbuf, which is all that devices are given to locate the checksum. */
+boolean netif_tx_csum_prepare(struct netif *n, struct pbuf *p, netif_csum_info ci)
+{
+    if (n->chksum_flags & NETIF_CHECKSUM_GEN_TCP)
+        return false;
+    u64 sum;
+    enum tx_csum_frame frame = netif_tx_csum_parse(p->payload, p->len, ci, &sum);
+    if (frame == TX_CSUM_TCP) {
+        *(u16 *)(p->payload + ci->l4_offset + ci->csum_offset) = ip_csum_fold(sum);
+        return true;
+    }
+    if (frame == TX_CSUM_SHORT) {
+        u8 hdr[TX_CSUM_HDR_MAX];
+        frame = netif_tx_csum_parse(hdr, pbuf_copy_partial(p, hdr, sizeof(hdr), 0), ci, &sum);
+    }
+    if (frame == TX_CSUM_NOT_TCP || frame == TX_CSUM_SHORT)
+        return false;
+
+    /* lwIP left the checksum of this TCP segment to the device, which
+       can't be given it; checksum it here instead */
+    u16 csum = ip_csum_fold(sum);
+    pbuf_take_at(p, &csum, sizeof(csum), ci->l4_offset + ci->csum_offset);
+    netif_tx_csum_complete(p, ci);
+    return false;
+}
+
+void netif_tx_csum_complete(struct pbuf *p, netif_csum_info ci)
+{
+    u64 sum = 0;
+    u16 skip = ci->l4_offset;
+    boolean odd = false;
+    for (struct pbuf *q = p; q; q = q->next) {
+        if (skip >= q->len) {
+            skip -= q->len;
+            continue;
+        }
+        u16 len = q->len - skip;
+        u16 s = ip_csum_fold(ip_csum_partial(q->payload + skip, len, 0));
+        sum = ip_csum_add(sum, odd ? SWAP_BYTES_IN_WORD(s) : s);
+        odd ^= len & 1;
+        skip = 0;
+    }
+    u16 csum = ~ip_csum_fold(sum);
+    pbuf_take_at(p, &csum, sizeof(csum), ci->l4_offset + ci->csum_offset);
+}
+
+/* Frames looped back on a netif were generated locally and, with
+   transmit offload, may carry only a partial checksum, so they are
+   accepted like frames verified by the device. */
+static void netif_loop_poll(struct netif *n)
+{
+    if (!(n->chksum_flags & NETIF_CHECKSUM_GEN_TCP))
+        netif_rx_csum_verified(n, true);
+    netif_poll(n);
+}
+
+void netif_loop_poll_all(void)
+{
+    struct netif *n;
+    NETIF_FOREACH(n)
+        netif_loop_poll(n);
+}
+
+/* Transmit batching
+
+   lwIP hands frames to linkoutput one at a time, e.g. for each segment
+   sent by tcp_output. Drivers post each frame to the device without
+   notifying it and add their batch to the pending list here; the flush,
+   run after tcp_output and once per pass of the runqueue, rings each
+   pending doorbell once for all the frames posted since. */
+static struct {
+    struct spinlock lock;
+    struct list pending;
+    struct list batches;
+    thunk flush;
+    boolean flush_queued;
+    heap h;
+} netif_tx;
+
+closure_function(0, 0, void, netif_tx_flush_task)
+{
+    netif_tx.flush_queued = false;
+    netif_tx_flush_all();
+}
+
+void netif_tx_batch_init(netif_tx_batch b, struct netif *n, thunk flush)
+{
+    b->n = n;
+    b->flush = flush;
+    b->pending = false;
+    b->packets = 0;
+    b->doorbells = 0;
+    u64 flags = spin_lock_irq(&netif_tx.lock);
+    list_push_back(&netif_tx.batches, &b->all);
+    spin_unlock_irq(&netif_tx.lock, flags);
+}
+
+void netif_tx_batch_add(netif_tx_batch b)
+{
+    fetch_and_add(&b->packets, 1);
+    u64 flags = spin_lock_irq(&netif_tx.lock);
+    if (!b->pending) {
+        b->pending = true;
+        list_push_back(&netif_tx.pending, &b->l);
+    }
+    boolean queue = !netif_tx.flush_queued;
+    netif_tx.flush_queued = true;
+    spin_unlock_irq(&netif_tx.lock, flags);
+    if (queue)
+        enqueue_irqsafe(runqueue, netif_tx.flush);
+}
+
+void netif_tx_doorbell(netif_tx_batch b)
+{
+    fetch_and_add(&b->doorbells, 1);
+}
+
+/* A batch leaves the pending list before its flush runs, so that frames
+   posted meanwhile queue it again. */
+void netif_tx_flush_all(void)
+{
+    u64 flags = spin_lock_irq(&netif_tx.lock);
+    while (!list_empty(&netif_tx.pending)) {
+        list l = list_get_next(&netif_tx.pending);
+        list_delete(l);
+        netif_tx_batch b = struct_from_list(l, netif_tx_batch, l);
+        b->pending = false;
+        spin_unlock_irq(&netif_tx.lock, flags);
+        apply(b->flush);
+        flags = spin_lock_irq(&netif_tx.lock);
+    }
+    spin_unlock_irq(&netif_tx.lock, flags);
+}
+
+/* counters of an interface, summed over its transmit queues */
+static void netif_tx_counters(struct netif *n, u64 *packets, u64 *doorbells)
+{
+    *packets = *doorbells = 0;
+    list_foreach(&netif_tx.batches, l) {
+        netif_tx_batch b = struct_from_list(l, netif_tx_batch, all);
+        if (b->n == n) {
+            *packets += b->packets;
+            *doorbells += b->doorbells;
+        }
+    }
+}
+
+closure_function(2, 0, value, netif_tx_get_packets,
+                 struct netif *, n, value, v)
+{
+    u64 packets, doorbells;
+    netif_tx_counters(bound(n), &packets, &doorbells);
+    return value_rewrite_u64(bound(v), packets);
+}
+
+closure_function(2, 0, value, netif_tx_get_doorbells,
+                 struct netif *, n, value, v)
+{
+    u64 packets, doorbells;
+    netif_tx_counters(bound(n), &packets, &doorbells);
+    return value_rewrite_u64(bound(v), doorbells);
+}
+
+closure_function(2, 0, value, netif_tx_get_packets_per_doorbell,
+                 struct netif *, n, value, v)
+{
+    u64 packets, doorbells;
+    netif_tx_counters(bound(n), &packets, &doorbells);
+    return value_rewrite_u64(bound(v), doorbells ? packets / doorbells : 0);
+}
+
+#define register_tx_stat(n, tn, t, name)                                \
+    v = value_from_u64(netif_tx.h, 0);                                  \
+    s = sym(name);                                                      \
+    set(t, s, v);                                                       \
+    tuple_notifier_register_get_notify(tn, s, closure(netif_tx.h, netif_tx_get_ ##name, n, v));
+
+/* Packets posted and doorbells rung by each interface with batching,
+   under "netif_tx" in the management tree, e.g. netif_tx/en1. */
+static void netif_tx_management(tuple root)
+{
+    tuple t = allocate_tuple();
+    assert(t != INVALID_ADDRESS);
+    list_foreach(&netif_tx.batches, l) {
+        netif_tx_batch b = struct_from_list(l, netif_tx_batch, all);
+        char ifname[4];
+        netif_name_cpy(ifname, b->n);
+        symbol ifsym = sym_this(ifname);
+        if (get(t, ifsym))
+            continue;
+        value v;
+        symbol s;
+        tuple st = allocate_tuple();
+        assert(st != INVALID_ADDRESS);
+        tuple_notifier tn = tuple_notifier_wrap(st);
+        assert(tn != INVALID_ADDRESS);
+        register_tx_stat(b->n, tn, st, packets);
+        register_tx_stat(b->n, tn, st, doorbells);
+        register_tx_stat(b->n, tn, st, packets_per_doorbell);
+        set(t, ifsym, tn);
+    }
+    set(t, sym(no_encode), null_value);
+    set(root, sym(netif_tx), t);
+}
+
+/* Network emulation on the loopback interface, for testing the transport
+   under loss and latency: each packet sent is dropped with the configured
+   probability, and the others are delivered after the configured delay.
+   Configured with a "netem" tuple under the interface name, e.g.
+   lo0:(netem:(delay:50 loss:1)) for 50ms each way and 1% loss. As local
+   connections aren't spliced while emulating, an empty tuple makes all
+   loopback traffic go through lwIP. */
+static struct {
+    timestamp delay;
+    u64 loss;                   /* percent */
+    boolean enabled;
+} loop_netem;
+
+closure_function(2, 1, void, netem_deliver,
+                 struct netif *, n, struct pbuf *, p,
+                 u64, overruns /* ignored */)
+{
+    struct netif *n = bound(n);
+    struct pbuf *p = bound(p);
+    netif_loop_output(n, p);
+    pbuf_free(p);
+    netif_loop_poll(n);
+    closure_finish();
+}
+
+static err_t netem_output(struct netif *n, struct pbuf *p)
+{
+    if (loop_netem.loss && random_u64() % 100 < loop_netem.loss)
+        return ERR_OK;
+    if (!loop_netem.delay)
+        return netif_loop_output(n, p);
+
+    /* the pbuf may be referenced by the unacked queue of a pcb */
+    struct pbuf *q = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+    if (!q)
+        return ERR_MEM;
+    timer_handler th = closure(lwip_heap, netem_deliver, n, q);
+    if (th == INVALID_ADDRESS) {
+        pbuf_free(q);
+        return ERR_MEM;
+    }
+    register_timer(runloop_timers, CLOCK_ID_MONOTONIC_RAW, loop_netem.delay, false, 0, th);
+    return ERR_OK;
+}
+
+static err_t netem_output_ip4(struct netif *n, struct pbuf *p, const ip4_addr_t *addr)
+{
+    return netem_output(n, p);
+}
+
+static err_t netem_output_ip6(struct netif *n, struct pbuf *p, const ip6_addr_t *addr)
+{
+    return netem_output(n, p);
+}
+
+void netif_loop_netem(struct netif *n, tuple t)
+{
+    u64 delay = 0, loss = 0;
+    get_u64(t, sym(delay), &delay);
+    get_u64(t, sym(loss), &loss);
+    if (loss > 100) {
+        rprintf("NET: invalid loopback loss %ld%%; ignored\n", loss);
+        loss = 0;
+    }
+    rprintf("NET: emulating %ldms delay and %ld%% loss on loopback\n", delay, loss);
+    loop_netem.delay = milliseconds(delay);
+    loop_netem.loss = loss;
+    loop_netem.enabled = true;
+    n->output = netem_output_ip4;
+    n->output_ip6 = netem_output_ip6;
+}
+
+boolean netif_loop_emulated(void)
+{
+    return loop_netem.enabled;
+}
+
 struct netif *netif_get_default(void)
 {
     return netif_default;
@@ -285,13 +818,16 @@ void init_network_iface(tuple root) {
 
     /* NETIF_FOREACH traverses interfaces in reverse order...so go by index */
     for (int i = 1; (n = netif_get_by_index(i)); i++) {
-        if (netif_is_loopback(n))
-            continue;
-
         char ifname[4];
         netif_name_cpy(ifname, n);
 
         tuple t = get_tuple(root, sym_this(ifname));
+        if (netif_is_loopback(n)) {
+            tuple netem = t ? get_tuple(t, sym(netem)) : 0;
+            if (netem)
+                netif_loop_netem(n, netem);
+            continue;
+        }
         if (!t) {
             /* If this is the first interface and there is no config tuple
                under its name, default to looking for static config at the
@@ -336,6 +872,16 @@ void init_network_iface(tuple root) {
         }
     }
 
+    u64 tw_max;
+    if (get_u64(root, sym(tcp_max_tw_buckets), &tw_max))
+        tcp_tw_set_max(tw_max);
+
+    string cc = get_string(root, sym(tcp_congestion));
+    if (cc && !tcp_cc_set_default(buffer_ref(cc, 0), buffer_length(cc)))
+        rprintf("NET: unknown TCP congestion control algorithm \"%b\"; ignored\n", cc);
+
+    netif_tx_management(root);
+
     if (default_iface) {
         netif_set_default(default_iface);
     } else {
@@ -350,6 +896,15 @@ void init_net(kernel_heaps kh)
     heap h = heap_general(kh);
     heap backed = (heap)heap_linear_backed(kh);
     lwip_heap = allocate_mcache(h, backed, 5, MAX_LWIP_ALLOC_ORDER, PAGESIZE_2M);
+    init_lwip_pools(h, backed);
+    init_tcp_demux(h);
+    spin_lock_init(&netif_tx.lock);
+    list_init(&netif_tx.pending);
+    list_init(&netif_tx.batches);
+    netif_tx.h = h;
+    netif_tx.flush = closure(h, netif_tx_flush_task);
+    assert(netif_tx.flush != INVALID_ADDRESS);
+    xdp_init(kh);
     lwip_init();
     NETIF_DECLARE_EXT_CALLBACK(netif_callback);
     netif_add_ext_callback(&netif_callback, lwip_ext_callback);
@@ -31,6 +31,7 @@ enum protocol_type {
 #define AF_INET 2
 #define AF_INET6    10
 #define AF_NETLINK  16
+#define AF_XDP      44
 
 /* ARP protocol HARDWARE identifiers */
 #define ARPHRD_ETHER    1
@@ -43,9 +44,13 @@ enum protocol_type {
 #define MSG_TRUNC       0x00000020
 #define MSG_DONTWAIT    0x00000040
 #define MSG_EOR         0x00000080
+#define MSG_CTRUNC      0x00000008
 #define MSG_CONFIRM     0x00000800
+#define MSG_ERRQUEUE    0x00002000
 #define MSG_NOSIGNAL    0x00004000
 #define MSG_MORE        0x00008000
+#define MSG_ZEROCOPY    0x04000000
+#define MSG_FASTOPEN    0x20000000
 
 // tuplify
 #define SOCK_NONBLOCK 00004000
@@ -8,6 +8,7 @@
 #include <unix_internal.h>
 #include <lwip.h>
 #include <lwip/udp.h>
+#include <lwip/priv/tcp_priv.h>
 #include <net_system_structs.h>
 #include <socket.h>
 
@@ -27,10 +28,34 @@
 #define SIOCSIFNETMASK  0x891C
 #define SIOCGIFMTU      0x8921
 #define SIOCSIFMTU      0x8922
+#define SIOCGIFHWADDR   0x8927
 #define SIOCGIFINDEX    0x8933
 
 #define MTU_MAX (32 * KB)
 
+/* When both ends of a TCP connection are sockets in this kernel, the
+   connection is "spliced": once established, data written on one end is
+   copied straight into the incoming queue of the other rather than going
+   through lwIP segmentation and the loopback interface. lwIP still owns
+   connection setup and teardown, so FIN and RST are delivered as usual
+   and always follow any spliced data. Spliced pbufs are tagged so that
+   the reader does not advance the lwIP receive window for them.
+
+   The pairing is protected by loop_splice_lock rather than the kernel
+   lock. An end that is writing to or waking its peer holds a reference
+   on the peer's fdesc, so the peer cannot be closed under it; data left
+   queued on a closed end is freed with it. */
+#define LOOPBACK_SPLICE_BUF     (256 * KB)
+#define LOOPBACK_SPLICE_CHUNK   ((32 * KB) - sizeof(struct pbuf))
+#define PBUF_FLAG_SPLICED       0x80U
+
+/* must not collide with the flags defined in lwip/pbuf.h, and fit in pbuf.flags */
+build_assert((PBUF_FLAG_SPLICED & (PBUF_FLAG_PUSH | PBUF_FLAG_IS_CUSTOM | PBUF_FLAG_MCASTLOOP |
+                                   PBUF_FLAG_LLBCAST | PBUF_FLAG_LLMCAST | PBUF_FLAG_TCP_FIN)) == 0);
+build_assert(PBUF_FLAG_SPLICED <= (u8_t)-1);
+
+static struct spinlock loop_splice_lock;
+
 #define resolve_socket(__p, __fd) ({fdesc f = resolve_fd(__p, __fd); \
     if (f->type != FDESC_TYPE_SOCKET) \
         return set_syscall_error(current, ENOTSOCK); \
@@ -99,10 +124,22 @@ typedef struct netsock {
     queue incoming;
     err_t lwip_error;           /* lwIP error code; ERR_OK if normal */
     u8 ipv6only:1;
+    u8 zerocopy:1;
+    int rx_cpu;                 /* cpu the socket was last read on */
+    u32 zc_next_id;             /* next zero-copy notification id */
+    struct list zc_sends;       /* zero-copy sends in flight */
+    struct list zc_errqueue;    /* zero-copy notifications */
     union {
 	struct {
 	    struct tcp_pcb *lw;
 	    enum tcp_socket_state state; // half open?
+	    struct netsock *loop_peer;  /* spliced local peer */
+	    word loop_queued;           /* spliced bytes in incoming */
+	    u8 nodelay:1;
+	    u8 cork:1;
+	    u8 quickack:1;
+	    int fastopen_qlen;
+	    struct tcp_cc cc;
 	} tcp;
 	struct {
 	    struct udp_pcb *lw;
@@ -127,13 +164,14 @@ static sysreturn netsock_sendmsg(struct sock *sock, const struct msghdr *msg,
                                  int flags);
 static sysreturn netsock_recvmsg(struct sock *sock, struct msghdr *msg,
                                  int flags);
+static err_t tcp_input_lower(void *z, struct tcp_pcb *pcb, struct pbuf *p, err_t err);
 
 static thunk net_loop_poll;
 static boolean net_loop_poll_queued;
 
 closure_function(0, 0, void, netsock_poll) {
     net_loop_poll_queued = false;
-    netif_poll_all();
+    netif_loop_poll_all();
 }
 
 static void netsock_check_loop(void)
@@ -153,12 +191,62 @@ static netsock get_netsock(struct sock *sock)
     return (netsock)sock;
 }
 
+/* Takes a reference on a socket unless its last one is already gone, in
+   which case it is being closed. */
+static boolean netsock_reference(netsock s)
+{
+    u64 *refcnt = &s->sock.f.refcnt;
+    u64 refs;
+    do {
+        refs = *refcnt;
+        if (refs == 0)
+            return false;
+    } while (!compare_and_swap_64(refcnt, refs, refs + 1));
+    return true;
+}
+
+/* Data may only bypass lwIP once everything previously written through it
+   has reached the peer's incoming queue, so that ordering is kept. */
+static boolean netsock_can_splice(netsock s, netsock peer)
+{
+    struct tcp_pcb *lw = s->info.tcp.lw;
+    if (!lw || !peer->info.tcp.lw)
+        return false;
+    return (lw->state == ESTABLISHED || lw->state == CLOSE_WAIT) &&
+        !lw->unsent && !lw->unacked && !peer->info.tcp.lw->refused_data;
+}
+
+/* Returns the spliced peer with a reference held, to be released with
+   fdesc_put(), or 0. With writable set, only a peer that data can
+   currently be spliced to is returned. */
+static netsock netsock_get_peer(netsock s, boolean writable)
+{
+    spin_lock(&loop_splice_lock);
+    netsock peer = s->info.tcp.loop_peer;
+    if (peer && ((writable && !netsock_can_splice(s, peer)) || !netsock_reference(peer)))
+        peer = 0;
+    spin_unlock(&loop_splice_lock);
+    return peer;
+}
+
+static u64 netsock_sndbuf(netsock s)
+{
+    netsock peer = netsock_get_peer(s, true);
+    if (peer) {
+        word queued = peer->info.tcp.loop_queued;
+        fdesc_put(&peer->sock.f);
+        return queued < LOOPBACK_SPLICE_BUF ? LOOPBACK_SPLICE_BUF - queued : 0;
+    }
+    return tcp_sndbuf(s->info.tcp.lw);
+}
+
 closure_function(1, 1, u32, socket_events,
                  netsock, s,
                  thread, t /* ignore */)
 {
     netsock s = bound(s);
     boolean in = !queue_empty(s->incoming);
+    u32 err = list_empty(&s->zc_errqueue) ? 0 : EPOLLERR;
 
     /* XXX socket state isn't giving a complete picture; needs to specify
        which transport ends are shut down */
@@ -166,18 +254,18 @@ closure_function(1, 1, u32, socket_events,
         if (s->info.tcp.state == TCP_SOCK_LISTENING) {
             return in ? EPOLLIN : 0;
         } else if (s->info.tcp.state == TCP_SOCK_OPEN) {
-            return (in ? EPOLLIN | EPOLLRDNORM : 0) |
+            return (in ? EPOLLIN | EPOLLRDNORM : 0) | err |
                 (s->info.tcp.lw->state == ESTABLISHED ?
-                (tcp_sndbuf(s->info.tcp.lw) ? EPOLLOUT | EPOLLWRNORM : 0) :
+                (netsock_sndbuf(s) ? EPOLLOUT | EPOLLWRNORM : 0) :
                 EPOLLIN | EPOLLHUP);
         } else if (s->info.tcp.state == TCP_SOCK_UNDEFINED || s->info.tcp.state == TCP_SOCK_CREATED) {
-            return EPOLLHUP;
+            return EPOLLHUP | err;
         } else {
-            return 0;
+            return err;
         }
     }
     assert(s->sock.type == SOCK_DGRAM);
-    return (in ? EPOLLIN | EPOLLRDNORM : 0) | EPOLLOUT | EPOLLWRNORM;
+    return (in ? EPOLLIN | EPOLLRDNORM : 0) | EPOLLOUT | EPOLLWRNORM | err;
 }
 
 /* May be called from irq/softirq */
@@ -202,6 +290,22 @@ static err_t get_and_clear_lwip_error(netsock s)
 #define WAKEUP_SOCK_TX          0x00000002
 #define WAKEUP_SOCK_EXCEPT      0x00000004 /* flush, and thus implies rx & tx */
 
+/* Receive flow steering
+
+   A thread blocked reading a socket (or waiting for it to become readable)
+   is queued to run on the cpu it last ran on, which is normally the cpu
+   that last read the socket. Packet processing happens on whichever cpu
+   services the device, and if the consumer's cpu sits idle until its next
+   timer interrupt, the processing cpu takes the thread over instead,
+   bouncing the socket and the thread's working set between caches. So
+   after a receive wakeup, the cpu the socket was last read on is woken
+   with an IPI if it is idle and has threads to run. */
+static inline void netsock_steer_wakeup(netsock s)
+{
+    if (s->rx_cpu >= 0)
+        wakeup_cpu_runnable(s->rx_cpu);
+}
+
 static void wakeup_sock(netsock s, int flags)
 {
     net_debug("sock %d, flags %d\n", s->sock.fd, flags);
@@ -217,6 +321,8 @@ static void wakeup_sock(netsock s, int flags)
             blockq_wake_one(s->sock.txbq);
     }
     fdesc_notify_events(&s->sock.f);
+    if (flags & (WAKEUP_SOCK_RX | WAKEUP_SOCK_EXCEPT))
+        netsock_steer_wakeup(s);
 }
 
 static inline void sockaddr_to_ip6addr(struct sockaddr_in6 *addr,
@@ -351,6 +457,8 @@ static sysreturn sock_read_bh_internal(netsock s, thread t, void * dest,
 	      s->sock.fd, t->tid, dest, length, flags, bqflags, err);
     assert(length > 0);
     assert(s->sock.type == SOCK_STREAM || s->sock.type == SOCK_DGRAM);
+    if (!(bqflags & BLOCKQ_ACTION_BLOCKED))
+        s->rx_cpu = current_cpu()->id;
 
     if (s->sock.type == SOCK_STREAM && s->info.tcp.state != TCP_SOCK_OPEN) {
         rv = 0;
@@ -394,6 +502,7 @@ static sysreturn sock_read_bh_internal(netsock s, thread t, void * dest,
     }
 
     u64 xfer_total = 0;
+    u64 spliced = 0;
     u32 pbuf_idx = 0;
 
     /* TCP: consume multiple buffers to fill request, if available. */
@@ -411,8 +520,12 @@ static sysreturn sock_read_bh_internal(netsock s, thread t, void * dest,
                 length -= xfer;
                 xfer_total += xfer;
                 dest = (char *) dest + xfer;
-                if ((s->sock.type == SOCK_STREAM) && !(flags & MSG_PEEK))
-                    tcp_recved(s->info.tcp.lw, xfer);
+                if ((s->sock.type == SOCK_STREAM) && !(flags & MSG_PEEK)) {
+                    if (pbuf->flags & PBUF_FLAG_SPLICED)
+                        spliced += xfer;
+                    else
+                        tcp_recved(s->info.tcp.lw, xfer);
+                }
             }
             if ((cur_buf->len == 0) || (flags & MSG_PEEK))
                 cur_buf = cur_buf->next;
@@ -431,6 +544,14 @@ static sysreturn sock_read_bh_internal(netsock s, thread t, void * dest,
                 fdesc_notify_events(&s->sock.f); /* reset a triggered EPOLLIN condition */
         }
     } while(s->sock.type == SOCK_STREAM && length > 0 && p != INVALID_ADDRESS); /* XXX simplify expression */
+    if (spliced) {
+        fetch_and_add(&s->info.tcp.loop_queued, -spliced);
+        netsock peer = netsock_get_peer(s, false);
+        if (peer) {
+            wakeup_sock(peer, WAKEUP_SOCK_TX);
+            fdesc_put(&peer->sock.f);
+        }
+    }
     if (s->sock.type == SOCK_STREAM)
         /* Calls to tcp_recved() may have enqueued new packets in the loopback interface. */
         netsock_check_loop();
@@ -506,11 +627,314 @@ closure_function(1, 6, sysreturn, socket_read,
         return io_complete(completion, t,
             (s->info.tcp.state == TCP_SOCK_UNDEFINED) ? 0 : -ENOTCONN);
 
+    /* try the read before allocating an action to block with */
+    sysreturn rv = sock_read_bh_internal(s, t, dest, length, 0, 0, 0, completion, 0);
+    if (rv != BLOCKQ_BLOCK_REQUIRED)
+        return rv;
     blockq_action ba = closure(s->sock.h, sock_read_bh, s, t, dest, length, 0, 0,
             0, completion);
     return blockq_check(s->sock.rxbq, t, ba, bh);
 }
 
+/* Copy as much as fits into the incoming queue of the spliced peer;
+   returns the number of bytes written, or -1 if the data is to go through
+   lwIP. */
+static s64 socket_write_splice(netsock s, void *buf, u64 remain)
+{
+    netsock peer = netsock_get_peer(s, true);
+    if (!peer)
+        return -1;
+    s64 written = 0;
+    while (remain > 0) {
+        word queued = peer->info.tcp.loop_queued;
+        if (queued >= LOOPBACK_SPLICE_BUF || queue_full(peer->incoming))
+            break;
+        u64 n = MIN(MIN(remain, LOOPBACK_SPLICE_BUF - queued), LOOPBACK_SPLICE_CHUNK);
+        struct pbuf *p = pbuf_alloc(PBUF_RAW, n, PBUF_RAM);
+        if (!p)
+            break;
+        p->flags |= PBUF_FLAG_SPLICED;
+        runtime_memcpy(p->payload, buf, n);
+        fetch_and_add(&peer->info.tcp.loop_queued, n);
+        if (!enqueue(peer->incoming, p)) {
+            fetch_and_add(&peer->info.tcp.loop_queued, -n);
+            pbuf_free(p);
+            break;
+        }
+        buf += n;
+        remain -= n;
+        written += n;
+    }
+    if (written)
+        wakeup_sock(peer, WAKEUP_SOCK_RX);
+    fdesc_put(&peer->sock.f);
+    return written;
+}
+
+/* Zero-copy transmit
+
+   With SO_ZEROCOPY set, data sent with MSG_ZEROCOPY is not copied: the
+   pages of the user buffer are pinned (see pin_user_page) and lwIP is
+   handed references to them through the linear mapping. Each such send
+   takes the next notification id, which is reported on the error queue
+   (recvmsg with MSG_ERRQUEUE) once the stack is done with the pages: for
+   TCP when the data has been acked, for UDP when the datagram has been
+   transmitted. As on Linux, consecutive ids are reported as one range,
+   and sends whose data ended up copied, e.g. from a file mapping or over
+   a spliced connection, are flagged with SO_EE_CODE_ZEROCOPY_COPIED. */
+
+typedef struct zc_send {
+    struct list l;              /* on the socket, or on zc_orphans once closed */
+    heap h;
+    netsock s;                  /* 0 once the socket is closed */
+    struct tcp_pcb *pcb;        /* TCP: pcb holding the data */
+    u32 id;
+    u32 end;                    /* TCP: sequence number following the data */
+    int refs;                   /* UDP: pbufs referencing the pages, plus the sender */
+    int npages;
+    u64 pages[0];
+} *zc_send;
+
+typedef struct zc_pbuf {
+    struct pbuf_custom p;       /* must be first */
+    zc_send zs;
+} *zc_pbuf;
+
+typedef struct zc_notification {
+    struct list l;
+    u32 lo;
+    u32 hi;
+    boolean copied;
+} *zc_notification;
+
+/* TCP sends of closed sockets, released along with their pcb */
+static struct list zc_orphans;
+
+static void netsock_zc_notify(netsock s, u32 id, boolean copied)
+{
+    if (!list_empty(&s->zc_errqueue)) {
+        zc_notification n = struct_from_list(list_end(&s->zc_errqueue)->prev,
+                                             zc_notification, l);
+        if (n->copied == copied && n->hi + 1 == id) {
+            n->hi = id;
+            return;
+        }
+    }
+    zc_notification n = allocate(s->sock.h, sizeof(*n));
+    if (n == INVALID_ADDRESS) {
+        msg_err("failed to allocate zero-copy notification\n");
+        return;
+    }
+    n->lo = n->hi = id;
+    n->copied = copied;
+    list_push_back(&s->zc_errqueue, &n->l);
+    fdesc_notify_events(&s->sock.f);
+}
+
+/* Pins the pages under buf; returns 0 if any isn't pinnable user memory. */
+static zc_send zc_send_alloc(netsock s, void *buf, u64 len)
+{
+    u64 start = u64_from_pointer(buf);
+    u64 end = start + len;
+    int npages = ((end - 1) >> PAGELOG) - (start >> PAGELOG) + 1;
+    zc_send zs = allocate(s->sock.h, sizeof(*zs) + npages * sizeof(u64));
+    if (zs == INVALID_ADDRESS)
+        return 0;
+    zs->l.prev = zs->l.next = 0;
+    zs->h = s->sock.h;
+    zs->s = s;
+    zs->pcb = 0;
+    zs->refs = 1;
+    zs->npages = 0;
+    for (u64 va = start; va < end; va = (va & ~MASK(PAGELOG)) + PAGESIZE) {
+        (void)*(volatile u8 *)pointer_from_u64(va);     /* fault in */
+        u64 phys = pin_user_page(s->p, va);
+        if (phys == INVALID_PHYSICAL) {
+            while (zs->npages > 0)
+                unpin_phys_page(zs->pages[--zs->npages]);
+            deallocate(zs->h, zs, sizeof(*zs) + npages * sizeof(u64));
+            return 0;
+        }
+        zs->pages[zs->npages++] = phys;
+    }
+    return zs;
+}
+
+static void zc_send_release(zc_send zs, boolean notify)
+{
+    for (int i = 0; i < zs->npages; i++)
+        unpin_phys_page(zs->pages[i]);
+    if (zs->l.next)
+        list_delete(&zs->l);
+    if (notify && zs->s)
+        netsock_zc_notify(zs->s, zs->id, false);
+    deallocate(zs->h, zs, sizeof(*zs) + zs->npages * sizeof(u64));
+}
+
+/* Returns the physically contiguous run of data at offset off, addressed
+   through the linear mapping. */
+static u64 zc_send_run(zc_send zs, void *buf, u64 len, u64 off, void **p)
+{
+    u64 va = u64_from_pointer(buf) + off;
+    int i = (va >> PAGELOG) - (u64_from_pointer(buf) >> PAGELOG);
+    u64 run = PAGESIZE - (va & MASK(PAGELOG));
+    *p = pointer_from_u64(virt_from_linear_backed_phys(zs->pages[i] + (va & MASK(PAGELOG))));
+    while (++i < zs->npages && zs->pages[i] == zs->pages[i - 1] + PAGESIZE)
+        run += PAGESIZE;
+    return MIN(run, len - off);
+}
+
+/* Releases the TCP sends acked up to the pcb's lastack, or all of them
+   once the pcb is gone. */
+static void netsock_zc_acked(netsock s, struct tcp_pcb *pcb)
+{
+    list_foreach(&s->zc_sends, l) {
+        zc_send zs = struct_from_list(l, zc_send, l);
+        if (pcb && !TCP_SEQ_GEQ(pcb->lastack, zs->end))
+            break;
+        zc_send_release(zs, true);
+    }
+}
+
+/* Sends outliving the socket or its pcb callbacks are left to complete
+   silently. */
+static void netsock_zc_orphan(netsock s)
+{
+    list_foreach(&s->zc_sends, l) {
+        zc_send zs = struct_from_list(l, zc_send, l);
+        list_delete(l);
+        zs->s = 0;
+        if (zs->pcb)
+            list_push_back(&zc_orphans, l);
+    }
+}
+
+static void netsock_zc_close(netsock s)
+{
+    netsock_zc_orphan(s);
+    list_foreach(&s->zc_errqueue, l) {
+        list_delete(l);
+        deallocate(s->sock.h, struct_from_list(l, zc_notification, l),
+                   sizeof(struct zc_notification));
+    }
+}
+
+/* called as lwIP frees a pcb */
+void netsock_zc_pcb_free(struct tcp_pcb *pcb)
+{
+    list_foreach(&zc_orphans, l) {
+        zc_send zs = struct_from_list(l, zc_send, l);
+        if (zs->pcb == pcb)
+            zc_send_release(zs, false);
+    }
+}
+
+/* tcp_write() of n bytes, or of as many as could be queued, by reference
+   for a zero-copy send */
+static err_t netsock_tcp_write(netsock s, void *buf, u64 *n, u8 apiflags, boolean zc)
+{
+    struct tcp_pcb *lw = s->info.tcp.lw;
+    zc_send zs = zc ? zc_send_alloc(s, buf, *n) : 0;
+    if (!zs) {
+        err_t err = tcp_write(lw, buf, *n, apiflags);
+        if (zc && err == ERR_OK)
+            netsock_zc_notify(s, s->zc_next_id++, true);
+        return err;
+    }
+    err_t err = ERR_OK;
+    u64 off = 0;
+    while (off < *n) {
+        void *p;
+        u64 run = zc_send_run(zs, buf, *n, off, &p);
+        u8 flags = apiflags & ~TCP_WRITE_FLAG_COPY;
+        if (off + run < *n)
+            flags |= TCP_WRITE_FLAG_MORE;
+        err = tcp_write(lw, p, run, flags);
+        if (err != ERR_OK)
+            break;
+        off += run;
+    }
+    if (off == 0) {
+        zc_send_release(zs, false);
+        return err;
+    }
+    *n = off;
+    zs->id = s->zc_next_id++;
+    zs->pcb = lw;
+    zs->end = lw->snd_lbb;
+    list_push_back(&s->zc_sends, &zs->l);
+    return ERR_OK;
+}
+
+static void zc_pbuf_free(struct pbuf *p)
+{
+    zc_pbuf zp = (zc_pbuf)p;
+    zc_send zs = zp->zs;
+    deallocate(zs->h, zp, sizeof(*zp));
+    if (--zs->refs == 0)
+        zc_send_release(zs, true);
+}
+
+/* a chain of pbufs referencing the pinned data of a UDP send */
+static struct pbuf *zc_send_pbufs(zc_send zs, void *buf, u64 len)
+{
+    struct pbuf *head = 0;
+    for (u64 off = 0; off < len;) {
+        void *p;
+        u64 run = zc_send_run(zs, buf, len, off, &p);
+        zc_pbuf zp = allocate(zs->h, sizeof(*zp));
+        if (zp == INVALID_ADDRESS) {
+            if (head)
+                pbuf_free(head);
+            return 0;
+        }
+        zp->zs = zs;
+        zp->p.custom_free_function = zc_pbuf_free;
+        struct pbuf *q = pbuf_alloced_custom(PBUF_RAW, run, PBUF_REF, &zp->p, p, run);
+        zs->refs++;
+        if (head)
+            pbuf_cat(head, q);
+        else
+            head = q;
+        off += run;
+    }
+    return head;
+}
+
+static sysreturn netsock_recv_errqueue(netsock s, struct msghdr *msg)
+{
+    if (list_empty(&s->zc_errqueue))
+        return -EAGAIN;
+    zc_notification n = struct_from_list(list_begin(&s->zc_errqueue), zc_notification, l);
+    struct sock_extended_err ee;
+    zero(&ee, sizeof(ee));
+    ee.ee_origin = SO_EE_ORIGIN_ZEROCOPY;
+    ee.ee_code = n->copied ? SO_EE_CODE_ZEROCOPY_COPIED : 0;
+    ee.ee_info = n->lo;
+    ee.ee_data = n->hi;
+    list_delete(&n->l);
+    deallocate(s->sock.h, n, sizeof(*n));
+
+    msg->msg_flags = MSG_ERRQUEUE;
+    struct cmsghdr *cmsg = msg->msg_control;
+    if (!cmsg || msg->msg_controllen < CMSG_LEN(sizeof(ee))) {
+        msg->msg_flags |= MSG_CTRUNC;
+        msg->msg_controllen = 0;
+        return 0;
+    }
+    cmsg->cmsg_len = CMSG_LEN(sizeof(ee));
+    if (s->sock.domain == AF_INET6) {
+        cmsg->cmsg_level = IPPROTO_IPV6;
+        cmsg->cmsg_type = IPV6_RECVERR;
+    } else {
+        cmsg->cmsg_level = SOL_IP;
+        cmsg->cmsg_type = IP_RECVERR;
+    }
+    runtime_memcpy(cmsg + 1, &ee, sizeof(ee));
+    msg->msg_controllen = MIN(msg->msg_controllen, CMSG_SPACE(sizeof(ee)));
+    return 0;
+}
+
 static sysreturn socket_write_tcp_bh_internal(netsock s, thread t, void * buf,
                                               u64 remain, int flags, io_completion completion,
                                               u64 bqflags)
@@ -536,6 +960,19 @@ static sysreturn socket_write_tcp_bh_internal(netsock s, thread t, void * buf,
         goto out;
     }
 
+    boolean zc = s->zerocopy && (flags & MSG_ZEROCOPY);
+    s64 n = socket_write_splice(s, buf, remain);
+    if (n >= 0) {
+        if (n == 0)
+            goto full;
+        if (zc)
+            netsock_zc_notify(s, s->zc_next_id++, true);
+        rv = n;
+        if (n < remain)
+            fdesc_notify_events(&s->sock.f); /* reset a triggered EPOLLOUT condition */
+        goto out;
+    }
+
     /* Note that the actual transmit window size is truncated to 16
        bits here (and tcp_write() doesn't accept more than 2^16
        anyway), so even if we have a large transmit window due to
@@ -557,19 +994,29 @@ static sysreturn socket_write_tcp_bh_internal(netsock s, thread t, void * buf,
     /* Figure actual length and flags */
     u64 n;
     u8 apiflags = TCP_WRITE_FLAG_COPY;
+    boolean more = s->info.tcp.cork || (flags & MSG_MORE);
     if (avail < remain) {
         n = avail;
         apiflags |= TCP_WRITE_FLAG_MORE;
     } else {
         n = remain;
+        if (more)
+            apiflags |= TCP_WRITE_FLAG_MORE;
     }
 
     /* XXX need to pore over lwIP error conditions here */
-    err = tcp_write(s->info.tcp.lw, buf, n, apiflags);
+    err = netsock_tcp_write(s, buf, &n, apiflags, zc);
     if (err == ERR_OK) {
-        /* XXX prob add a flag to determine whether to continuously
-           post data, e.g. if used by send/sendto... */
+        /* While more data is expected, what has been written is held back
+           until the send buffer fills, unless lwIP transmits on its own,
+           e.g. on processing an incoming segment. */
+        if (more && n < avail) {
+            net_debug(" holding %ld bytes\n", n);
+            rv = n;
+            goto out;
+        }
         err = tcp_output(s->info.tcp.lw);
+        netif_tx_flush_all();
         if (err == ERR_OK) {
             net_debug(" tcp_write and tcp_output successful for %ld bytes\n", n);
             netsock_check_loop();
@@ -607,7 +1054,7 @@ closure_function(6, 1, sysreturn, socket_write_tcp_bh,
     return rv;
 }
 
-static sysreturn socket_write_udp(netsock s, void *source, u64 length,
+static sysreturn socket_write_udp(netsock s, void *source, u64 length, int flags,
                                   struct sockaddr *dest_addr, socklen_t addrlen)
 {
     ip_addr_t ipaddr;
@@ -631,18 +1078,45 @@ static sysreturn socket_write_udp(netsock s, void *source, u64 length,
 
     /* XXX check how much we can queue, maybe make udp bh */
     /* XXX check if remote endpoint set? let LWIP check? */
-    struct pbuf * pbuf = pbuf_alloc(PBUF_TRANSPORT, length, PBUF_RAM);
-
+    boolean zc = s->zerocopy && (flags & MSG_ZEROCOPY);
+    zc_send zs = zc && length ? zc_send_alloc(s, source, length) : 0;
+    struct pbuf *pbuf = 0;
+    u16 chksum = 0;
+    if (zs) {
+        pbuf = zc_send_pbufs(zs, source, length);
+        if (!pbuf) {
+            zc_send_release(zs, false);
+            zs = 0;
+        } else {
+            chksum = ip_csum_fold(ip_csum_partial(source, length, 0));
+        }
+    }
     if (!pbuf) {
-        msg_err("failed to allocate pbuf for udp_send()\n");
-        return -ENOBUFS;
+        pbuf = pbuf_alloc(PBUF_TRANSPORT, length, PBUF_RAM);
+        if (!pbuf) {
+            msg_err("failed to allocate pbuf for udp_send()\n");
+            return -ENOBUFS;
+        }
+        chksum = ip_csum_fold(ip_csum_copy(pbuf->payload, source, length, 0));
     }
-    runtime_memcpy(pbuf->payload, source, length);
     if (dest_addr)
-        err = udp_sendto(s->info.udp.lw, pbuf, &ipaddr, port);
+        err = udp_sendto_chksum(s->info.udp.lw, pbuf, &ipaddr, port, 1, chksum);
     else
-        err = udp_send(s->info.udp.lw, pbuf);
+        err = udp_send_chksum(s->info.udp.lw, pbuf, 1, chksum);
     pbuf_free(pbuf);
+    if (zs) {
+        /* notified as the last pbuf referencing the data is freed */
+        if (err == ERR_OK) {
+            zs->id = s->zc_next_id++;
+            list_push_back(&s->zc_sends, &zs->l);
+        } else {
+            zs->s = 0;
+        }
+        if (--zs->refs == 0)
+            zc_send_release(zs, true);
+    } else if (zc && err == ERR_OK) {
+        netsock_zc_notify(s, s->zc_next_id++, true);
+    }
     if (err != ERR_OK) {
         net_debug("lwip error %d\n", err);
         return lwip_to_errno(err);
@@ -669,11 +1143,14 @@ static sysreturn socket_write_internal(struct sock *sock, void *source,
             rv = 0;
             goto out;
         }
+        rv = socket_write_tcp_bh_internal(s, t, source, length, flags, completion, 0);
+        if (rv != BLOCKQ_BLOCK_REQUIRED)
+            return rv;
         blockq_action ba = closure(sock->h, socket_write_tcp_bh, s, t,
                                    source, length, flags, completion);
         return blockq_check(sock->txbq, t, ba, bh);
     } else if (sock->type == SOCK_DGRAM) {
-        rv = socket_write_udp(s, source, length, dest_addr, addrlen);
+        rv = socket_write_udp(s, source, length, flags, dest_addr, addrlen);
     } else {
 	msg_err("socket type %d unsupported\n", sock->type);
 	rv = -EINVAL;
@@ -851,6 +1328,19 @@ closure_function(1, 2, sysreturn, netsock_ioctl,
         ifreq->ifr.ifr_ivalue = netif->num;
         return 0;
     }
+    case SIOCGIFHWADDR: {
+        struct ifreq *ifreq = varg(ap, struct ifreq *);
+        if (!validate_user_memory(ifreq, sizeof(struct ifreq), true))
+            return -EFAULT;
+        struct netif *netif = netif_find(ifreq->ifr_name);
+        if (!netif)
+            return -ENODEV;
+        struct sockaddr *addr = &ifreq->ifr.ifr_hwaddr;
+        addr->family = netif_is_loopback(netif) ? ARPHRD_LOOPBACK : ARPHRD_ETHER;
+        zero(addr->sa_data, sizeof(addr->sa_data));
+        runtime_memcpy(addr->sa_data, netif->hwaddr, MIN(netif->hwaddr_len, sizeof(addr->sa_data)));
+        return 0;
+    }
     case FIONREAD: {
         int *nbytes = varg(ap, int *);
         *nbytes = 0;
@@ -884,14 +1374,74 @@ closure_function(1, 2, sysreturn, netsock_ioctl,
 
 #define SOCK_QUEUE_LEN 128
 
+static void netsock_unsplice(netsock s)
+{
+    spin_lock(&loop_splice_lock);
+    netsock peer = s->info.tcp.loop_peer;
+    if (!peer) {
+        spin_unlock(&loop_splice_lock);
+        return;
+    }
+    net_debug("sock %d, peer %d\n", s->sock.fd, peer->sock.fd);
+    s->info.tcp.loop_peer = 0;
+    peer->info.tcp.loop_peer = 0;
+    boolean wake = netsock_reference(peer);
+    spin_unlock(&loop_splice_lock);
+
+    /* blocked writers on the peer continue through lwIP */
+    if (wake) {
+        wakeup_sock(peer, WAKEUP_SOCK_TX);
+        fdesc_put(&peer->sock.f);
+    }
+}
+
+/* Look for the connecting end of a newly accepted connection among the
+   local pcbs; the 4-tuple of a local peer is the reverse of ours. */
+static void netsock_splice_accepted(netsock sn)
+{
+    /* emulated loss and latency apply to traffic through lwIP only */
+    if (netif_loop_emulated())
+        return;
+    struct tcp_pcb *lw = sn->info.tcp.lw;
+    for (struct tcp_pcb *pcb = tcp_active_pcbs; pcb; pcb = pcb->next) {
+        if (pcb == lw || pcb->local_port != lw->remote_port ||
+            pcb->remote_port != lw->local_port ||
+            !ip_addr_cmp(&pcb->local_ip, &lw->remote_ip) ||
+            !ip_addr_cmp(&pcb->remote_ip, &lw->local_ip))
+            continue;
+
+        /* only pcbs owned by sockets */
+        if (pcb->recv != tcp_input_lower || !pcb->callback_arg)
+            return;
+        netsock peer = pcb->callback_arg;
+        spin_lock(&loop_splice_lock);
+        if (peer->info.tcp.lw == pcb && peer->info.tcp.state == TCP_SOCK_OPEN &&
+            !peer->info.tcp.loop_peer) {
+            net_debug("sock %d, peer %d\n", sn->sock.fd, peer->sock.fd);
+            sn->info.tcp.loop_peer = peer;
+            peer->info.tcp.loop_peer = sn;
+        }
+        spin_unlock(&loop_splice_lock);
+        return;
+    }
+}
+
 closure_function(1, 2, sysreturn, socket_close,
                  netsock, s,
                  thread, t, io_completion, completion)
 {
     netsock s = bound(s);
     net_debug("sock %d, type %d\n", s->sock.fd, s->sock.type);
+    netsock_zc_close(s);
     switch (s->sock.type) {
     case SOCK_STREAM:
+        netsock_unsplice(s);
+        if (s->info.tcp.state != TCP_SOCK_LISTENING) {
+            /* unread data, including any spliced by the peer */
+            struct pbuf *p;
+            while ((p = dequeue(s->incoming)) != INVALID_ADDRESS)
+                pbuf_free(p);
+        }
         /* tcp_close() doesn't really stop everything synchronously; in order to
          * prevent any lwIP callback that might be called after tcp_close() from
          * using a stale reference to the socket structure, set the callback
@@ -949,6 +1499,8 @@ static sysreturn netsock_shutdown(struct sock *sock, int how)
         if (shut_rx && shut_tx) {
             /* Shutting down both TX and RX is equivalent to calling
              * tcp_close(), so the pcb should not be referenced anymore. */
+            netsock_unsplice(s);
+            netsock_zc_orphan(s);
             s->info.tcp.lw = 0;
             s->info.tcp.state = TCP_SOCK_UNDEFINED;
         }
@@ -1037,6 +1589,11 @@ static int allocate_sock(process p, int af, int type, u32 flags, netsock *rs)
     s->sock.recvmsg = netsock_recvmsg;
     s->sock.shutdown = netsock_shutdown;
     s->ipv6only = 0;
+    s->zerocopy = 0;
+    s->rx_cpu = -1;
+    s->zc_next_id = 0;
+    list_init(&s->zc_sends);
+    list_init(&s->zc_errqueue);
     set_lwip_error(s, ERR_OK);
     *rs = s;
     return fd;
@@ -1056,6 +1613,13 @@ static int allocate_tcp_sock(process p, int af, struct tcp_pcb *pcb, u32 flags)
     if (fd >= 0) {
 	s->info.tcp.lw = pcb;
 	s->info.tcp.state = TCP_SOCK_CREATED;
+	s->info.tcp.loop_peer = 0;
+	s->info.tcp.loop_queued = 0;
+	s->info.tcp.nodelay = 0;
+	s->info.tcp.cork = 0;
+	s->info.tcp.quickack = 0;
+	s->info.tcp.fastopen_qlen = 0;
+	tcp_cc_init(&s->info.tcp.cc, pcb, 0);
     }
     return fd;
 }
@@ -1082,6 +1646,8 @@ sysreturn socket(int domain, int type, int protocol)
         return unixsock_open(type, protocol);
     case AF_NETLINK:
         return netlink_open(type, protocol);
+    case AF_XDP:
+        return xdp_open(type, protocol);
     default:
         msg_warn("domain %d not supported\n", domain);
         return -EAFNOSUPPORT;
@@ -1145,6 +1711,9 @@ static err_t tcp_input_lower(void *z, struct tcp_pcb *pcb, struct pbuf *p, err_t
 	    msg_err("incoming queue full\n");
             return ERR_BUF;     /* XXX verify */
         }
+        /* sent by tcp_input() on return */
+        if (s->info.tcp.quickack)
+            tcp_ack_now(pcb);
     }
     wakeup_sock(s, WAKEUP_SOCK_RX);
 
@@ -1202,11 +1771,13 @@ static void lwip_tcp_conn_err(void * z, err_t err) {
     }
     netsock s = z;
     net_debug("sock %d, err %d\n", s->sock.fd, err);
+    netsock_unsplice(s);
     s->info.tcp.state = TCP_SOCK_UNDEFINED;
     set_lwip_error(s, err);
 
     /* Don't try to use the pcb, it may have been deallocated already. */
     s->info.tcp.lw = 0;
+    netsock_zc_acked(s, 0);
 
     wakeup_sock(s, WAKEUP_SOCK_EXCEPT);
 }
@@ -1218,12 +1789,16 @@ static err_t lwip_tcp_sent(void * arg, struct tcp_pcb * pcb, u16 len)
     }
     netsock s = (netsock)arg;
     net_debug("fd %d, pcb %p, len %d\n", s->sock.fd, pcb, len);
+    tcp_cc_acked(&s->info.tcp.cc, pcb, len);
+    if (!list_empty(&s->zc_sends))
+        netsock_zc_acked(s, pcb);
     wakeup_sock(s, WAKEUP_SOCK_TX);
     return ERR_OK;
 }
 
-closure_function(2, 1, sysreturn, connect_tcp_bh,
-                 netsock, s, thread, t,
+/* On success, returns the data queued by a fast open, if any. */
+closure_function(3, 1, sysreturn, connect_tcp_bh,
+                 netsock, s, thread, t, sysreturn, queued,
                  u64, flags)
 {
     sysreturn rv = 0;
@@ -1245,12 +1820,14 @@ closure_function(2, 1, sysreturn, connect_tcp_bh,
 
     if (s->info.tcp.state == TCP_SOCK_IN_CONNECTION) {
         if (s->sock.f.flags & SOCK_NONBLOCK) {
-            rv = -EINPROGRESS;
+            rv = bound(queued) ? bound(queued) : -EINPROGRESS;
             goto out;
         }
         return BLOCKQ_BLOCK_REQUIRED;
     }
     assert(s->info.tcp.state == TCP_SOCK_OPEN);
+    if (rv == 0)
+        rv = bound(queued);
   out:
     closure_finish();
     return syscall_return(t, rv);
@@ -1270,12 +1847,19 @@ static err_t connect_tcp_complete(void* arg, struct tcp_pcb* tpcb, err_t err)
    assert(s->info.tcp.state == TCP_SOCK_IN_CONNECTION);
    s->info.tcp.state = TCP_SOCK_OPEN; /* XXX state handling needs fixing; this could indicate an error as well */
    set_lwip_error(s, err);
+   if (err == ERR_OK)
+       tcp_demux_add(tpcb);
    wakeup_sock(s, WAKEUP_SOCK_TX);
    return ERR_OK;
 }
 
+/* With data given, this is a fast open (MSG_FASTOPEN): the data is
+   queued behind the SYN, so that it leaves with the ACK completing the
+   handshake rather than after the application has seen the connection
+   established. lwIP doesn't carry data in a SYN, so a fast open saves the
+   connect round trip of the application but not that of the network. */
 static inline sysreturn connect_tcp(netsock s, const ip_addr_t* address,
-                                    unsigned short port)
+                                    unsigned short port, void *buf, u64 len)
 {
     net_debug("sock %d, tcp state %d, port %d\n", s->sock.fd,
             s->info.tcp.state, port);
@@ -1300,10 +1884,17 @@ static inline sysreturn connect_tcp(netsock s, const ip_addr_t* address,
     err_t err = tcp_connect(lw, address, port, connect_tcp_complete);
     if (err != ERR_OK)
         return lwip_to_errno(err);
+    sysreturn queued = 0;
+    if (len > 0) {
+        queued = MIN(len, tcp_sndbuf(lw));
+        err = tcp_write(lw, buf, queued, TCP_WRITE_FLAG_COPY);
+        if (err != ERR_OK)
+            queued = 0;     /* left to a write once connected */
+    }
     netsock_check_loop();
 
     return blockq_check(s->sock.txbq, current,
-                        closure(s->sock.h, connect_tcp_bh, s, current), false);
+                        closure(s->sock.h, connect_tcp_bh, s, current, queued), false);
 }
 
 static sysreturn netsock_connect(struct sock *sock, struct sockaddr *addr,
@@ -1326,7 +1917,7 @@ static sysreturn netsock_connect(struct sock *sock, struct sockaddr *addr,
             msg_warn("attempt to connect on listening socket fd = %d; ignored\n", sock->fd);
             err = ERR_ARG;
         } else {
-            return connect_tcp(s, &ipaddr, port);
+            return connect_tcp(s, &ipaddr, port, 0, 0);
         }
     } else if (s->sock.type == SOCK_DGRAM) {
 	/* Set remote endpoint */
@@ -1364,9 +1955,6 @@ static sysreturn sendto_prepare(struct sock *sock, int flags)
 	return -EOPNOTSUPP;
     }
 
-    if (flags & MSG_MORE)
-	msg_warn("MSG_MORE unimplemented; ignored\n");
-
     if (flags & MSG_NOSIGNAL)
 	msg_warn("MSG_NOSIGNAL unimplemented; ignored\n");
 
@@ -1383,6 +1971,18 @@ static sysreturn netsock_sendto(struct sock *sock, void *buf, u64 len,
     if (rv < 0) {
         return set_syscall_return(current, rv);
     }
+    netsock s = (netsock)sock;
+    if ((flags & MSG_FASTOPEN) && sock->type == SOCK_STREAM &&
+        s->info.tcp.state == TCP_SOCK_CREATED) {
+        ip_addr_t ipaddr;
+        u16 port;
+        if (!dest_addr)
+            return set_syscall_return(current, -EDESTADDRREQ);
+        rv = sockaddr_to_addrport(sock->domain, dest_addr, addrlen, &ipaddr, &port);
+        if (rv)
+            return set_syscall_return(current, rv);
+        return connect_tcp(s, &ipaddr, port, buf, len);
+    }
     return socket_write_internal(sock, buf, len, flags, dest_addr, addrlen, current, false,
             syscall_io_complete);
 }
@@ -1572,7 +2172,7 @@ sysreturn sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
             rv = blockq_check(sock->txbq, current, ba, false);
             break;
         case SOCK_DGRAM:
-            rv = socket_write_udp(s, buf, len, msg_hdr->msg_name,
+            rv = socket_write_udp(s, buf, len, flags, msg_hdr->msg_name,
                 msg_hdr->msg_namelen);
             break;
         }
@@ -1598,6 +2198,10 @@ static sysreturn netsock_recvfrom(struct sock *sock, void *buf, u64 len,
     if (len == 0)
         return 0;
 
+    sysreturn rv = sock_read_bh_internal(s, current, buf, len, flags, src_addr, addrlen,
+                                         syscall_io_complete, 0);
+    if (rv != BLOCKQ_BLOCK_REQUIRED)
+        return rv;
     blockq_action ba = closure(sock->h, sock_read_bh, s, current, buf, len, flags,
                                src_addr, addrlen, syscall_io_complete);
     return blockq_check(sock->rxbq, current, ba, false);
@@ -1627,6 +2231,8 @@ static sysreturn netsock_recvmsg(struct sock *sock, struct msghdr *msg,
     u8 *buf;
     netsock s = (netsock) sock;
 
+    if (flags & MSG_ERRQUEUE)
+        return set_syscall_return(current, netsock_recv_errqueue(s, msg));
     if ((sock->type == SOCK_STREAM) && (s->info.tcp.state != TCP_SOCK_OPEN)) {
         return set_syscall_error(current, (s->info.tcp.state == TCP_SOCK_UNDEFINED) ? 0 : ENOTCONN);
     }
@@ -1688,6 +2294,14 @@ static err_t accept_tcp_from_lwip(void * z, struct tcp_pcb * lw, err_t err)
     tcp_recv(lw, tcp_input_lower);
     tcp_err(lw, lwip_tcp_conn_err);
     tcp_sent(lw, lwip_tcp_sent);
+    sn->info.tcp.nodelay = s->info.tcp.nodelay;
+    if (sn->info.tcp.nodelay)
+        tcp_nagle_disable(lw);
+    sn->info.tcp.quickack = s->info.tcp.quickack;
+    sn->zerocopy = s->zerocopy;
+    tcp_cc_init(&sn->info.tcp.cc, lw, &s->info.tcp.cc);
+    tcp_demux_add(lw);
+    netsock_splice_accepted(sn);
     if (!enqueue(s->incoming, sn)) {
         msg_err("queue overrun; shouldn't happen with lwIP listen backlog\n");
         return ERR_BUF;         /* lwIP will do tcp_abort */
@@ -1864,6 +2478,67 @@ sysreturn getpeername(int sockfd, struct sockaddr *addr, socklen_t *addrlen)
     return 0;
 }
 
+/* transmit anything held back by corking */
+static void netsock_tcp_push(netsock s)
+{
+    struct tcp_pcb *lw = s->info.tcp.lw;
+    if (lw && s->info.tcp.state == TCP_SOCK_OPEN && lw->unsent) {
+        tcp_output(lw);
+        netif_tx_flush_all();
+        netsock_check_loop();
+    }
+}
+
+static sysreturn netsock_setsockopt_tcp(netsock s, int optname, void *optval, socklen_t optlen)
+{
+    struct tcp_pcb *lw = s->info.tcp.lw;
+    /* a listening pcb lacks the state of a connection */
+    boolean conn = lw && s->info.tcp.state != TCP_SOCK_LISTENING;
+    if (optname == TCP_CONGESTION) {
+        if (!tcp_cc_select(&s->info.tcp.cc, lw, optval, MIN(optlen, TCP_CC_NAME_MAX)))
+            return -ENOENT;
+        return 0;
+    }
+    if (optlen < sizeof(int))
+        return -EINVAL;
+    int val = *(int *)optval;
+    switch (optname) {
+    case TCP_NODELAY:
+        s->info.tcp.nodelay = val != 0;
+        if (conn) {
+            if (val) {
+                tcp_nagle_disable(lw);
+                netsock_tcp_push(s);
+            } else {
+                tcp_nagle_enable(lw);
+            }
+        }
+        break;
+    case TCP_CORK:
+        s->info.tcp.cork = val != 0;
+        if (!val)
+            netsock_tcp_push(s);
+        break;
+    case TCP_QUICKACK:
+        s->info.tcp.quickack = val != 0;
+        if (val && conn && s->info.tcp.state == TCP_SOCK_OPEN) {
+            tcp_ack_now(lw);
+            netsock_tcp_push(s);
+        }
+        break;
+    case TCP_FASTOPEN:
+        /* Nothing to do on a listener: data following the handshake is
+           accepted as usual. */
+        if (val < 0)
+            return -EINVAL;
+        s->info.tcp.fastopen_qlen = val;
+        break;
+    default:
+        return -ENOPROTOOPT;
+    }
+    return 0;
+}
+
 sysreturn setsockopt(int sockfd,
                      int level,
                      int optname,
@@ -1871,12 +2546,25 @@ sysreturn setsockopt(int sockfd,
                      socklen_t optlen)
 {
     struct sock *sock = resolve_socket(current->p, sockfd);
+    if (sock->domain == AF_XDP)
+        return xdp_setsockopt(sock, level, optname, optval, optlen);
     netsock s = get_netsock(sock);
     if (!s)
         return -EOPNOTSUPP;
     if (!validate_user_memory(optval, optlen, false))
         return -EFAULT;
     switch (level) {
+    case SOL_SOCKET:
+        switch (optname) {
+        case SO_ZEROCOPY:
+            if (optlen < sizeof(int))
+                return -EINVAL;
+            s->zerocopy = *((int *)optval) != 0;
+            break;
+        default:
+            goto unimplemented;
+        }
+        break;
     case IPPROTO_IPV6:
         switch (optname) {
         case IPV6_V6ONLY:
@@ -1888,6 +2576,14 @@ sysreturn setsockopt(int sockfd,
             goto unimplemented;
         }
         break;
+    case IPPROTO_TCP: {
+        if (s->sock.type != SOCK_STREAM)
+            return -ENOPROTOOPT;
+        sysreturn rv = netsock_setsockopt_tcp(s, optname, optval, optlen);
+        if (rv == -ENOPROTOOPT)
+            goto unimplemented;
+        return rv;
+    }
     default:
         goto unimplemented;
     }
@@ -1901,6 +2597,8 @@ unimplemented:
 sysreturn getsockopt(int sockfd, int level, int optname, void *optval, socklen_t *optlen)
 {
     struct sock *sock = resolve_socket(current->p, sockfd);
+    if (sock->domain == AF_XDP)
+        return xdp_getsockopt(sock, level, optname, optval, optlen);
     netsock s = get_netsock(sock);
     if (!s)
         return -EOPNOTSUPP;
@@ -1914,6 +2612,7 @@ sysreturn getsockopt(int sockfd, int level, int optname, void *optval, socklen_t
     union {
         int val;
         struct linger linger;
+        char name[TCP_CC_NAME_MAX];
     } ret_optval;
     int ret_optlen;
 
@@ -1946,6 +2645,10 @@ sysreturn getsockopt(int sockfd, int level, int optname, void *optval, socklen_t
             ret_optval.val = (s->sock.type == SOCK_STREAM) && (s->info.tcp.state == TCP_SOCK_LISTENING);
             ret_optlen = sizeof(ret_optval.val);
             break;
+        case SO_ZEROCOPY:
+            ret_optval.val = s->zerocopy;
+            ret_optlen = sizeof(ret_optval.val);
+            break;
         default:
             goto unimplemented;
         }
@@ -1960,6 +2663,34 @@ sysreturn getsockopt(int sockfd, int level, int optname, void *optval, socklen_t
             goto unimplemented;
         }
         break;
+    case IPPROTO_TCP:
+        if (s->sock.type != SOCK_STREAM)
+            return -EOPNOTSUPP;
+        ret_optlen = sizeof(ret_optval.val);
+        switch (optname) {
+        case TCP_NODELAY:
+            ret_optval.val = s->info.tcp.nodelay;
+            break;
+        case TCP_CORK:
+            ret_optval.val = s->info.tcp.cork;
+            break;
+        case TCP_QUICKACK:
+            ret_optval.val = s->info.tcp.quickack;
+            break;
+        case TCP_FASTOPEN:
+            ret_optval.val = s->info.tcp.fastopen_qlen;
+            break;
+        case TCP_CONGESTION: {
+            const char *name = tcp_cc_name(&s->info.tcp.cc);
+            zero(ret_optval.name, sizeof(ret_optval.name));
+            runtime_memcpy(ret_optval.name, name, runtime_strlen(name));
+            ret_optlen = sizeof(ret_optval.name);
+            break;
+        }
+        default:
+            goto unimplemented;
+        }
+        break;
     default:
         return -EOPNOTSUPP;
     }
@@ -2005,6 +2736,8 @@ boolean netsyscall_init(unix_heaps uh)
 	return false;
     uh->socket_cache = socket_cache;
     net_loop_poll = closure(heap_general(kh), netsock_poll);
+    list_init(&zc_orphans);
+    spin_lock_init(&loop_splice_lock);
     netlink_init();
     return true;
 }
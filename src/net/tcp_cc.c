@@ -0,0 +1,187 @@
+#include <kernel.h>
+#include <lwip.h>
+#include <lwip/priv/tcp_priv.h>
+
+//#define TCP_CC_DEBUG
+#ifdef TCP_CC_DEBUG
+#define tcp_cc_debug(x, ...) do {rprintf("TCP CC: " x, ##__VA_ARGS__);} while(0)
+#else
+#define tcp_cc_debug(x, ...)
+#endif
+
+/* Congestion control
+
+   lwIP implements NewReno: slow start, one segment per round trip in
+   congestion avoidance, and halving of the window on fast retransmit or
+   timeout. The algorithms here are layered on top of it. They run from
+   the sent callback of a connection, which lwIP invokes after it has
+   updated the window for newly acknowledged data, and they may replace
+   cwnd and ssthresh of the pcb. A loss event is recognized by lwIP having
+   changed ssthresh since the previous call. */
+
+#define TCP_CC_WND_MAX  0x3fffffff
+
+/* CUBIC (RFC 8312): the window grows as a cubic function of the time
+   since the last reduction, plateauing around the window at which the
+   loss occurred, which keeps long fat pipes full where Reno would take
+   minutes to regrow the window. Windows are in bytes and times in ms. */
+#define CUBIC_BETA      717     /* multiplicative decrease, 0.7 << 10 */
+#define CUBIC_FRIENDLY  542     /* 3 * (1 - beta) / (1 + beta), << 10 */
+#define CUBIC_MAX_T     (1ull << 20)
+
+static u64 cube_root(u64 x)
+{
+    u64 r = 0;
+    for (int s = 63; s >= 0; s -= 3) {
+        r <<= 1;
+        u64 b = 3 * r * (r + 1) + 1;
+        if ((x >> s) >= b) {
+            x -= b << s;
+            r++;
+        }
+    }
+    return r;
+}
+
+static void cubic_loss(tcp_cc cc, struct tcp_pcb *pcb)
+{
+    u32 w = cc->cwnd;
+    /* fast convergence: release bandwidth to newer flows */
+    if (w < cc->w_max)
+        cc->w_max = ((u64)w * (1024 + CUBIC_BETA)) >> 11;
+    else
+        cc->w_max = w;
+    u32 ssthresh = MAX(((u64)w * CUBIC_BETA) >> 10, 2 * pcb->mss);
+
+    /* lwIP leaves fast recovery with cwnd set to its own ssthresh, while a
+       timeout restarts slow start from one segment */
+    if (pcb->cwnd == pcb->ssthresh)
+        pcb->cwnd = ssthresh;
+    pcb->ssthresh = ssthresh;
+    cc->epoch_start = 0;
+    tcp_cc_debug("%s: pcb %p, cwnd %d, w_max %d, ssthresh %d\n", __func__, pcb, w,
+                 cc->w_max, ssthresh);
+}
+
+static void cubic_acked(tcp_cc cc, struct tcp_pcb *pcb, u16 len)
+{
+    if (cc->ssthresh == 0) {
+        cc->ssthresh = pcb->ssthresh;
+        cc->cwnd = pcb->cwnd;
+        return;
+    }
+    if (pcb->ssthresh != cc->ssthresh) {
+        cubic_loss(cc, pcb);
+        cc->ssthresh = pcb->ssthresh;
+    }
+    if (pcb->cwnd < pcb->ssthresh || (pcb->flags & TF_INFR)) {
+        cc->cwnd = pcb->cwnd;
+        return;
+    }
+
+    u32 cwnd = cc->cwnd;
+    u32 mss = pcb->mss;
+    timestamp here = now(CLOCK_ID_MONOTONIC_RAW);
+    if (!cc->epoch_start) {
+        cc->epoch_start = here;
+        if (cwnd < cc->w_max) {
+            /* K = cbrt((w_max - cwnd) / C) with C = 0.4 segments / s^3 */
+            u64 segs = (u64)(cc->w_max - cwnd) * 2500 / mss;
+            cc->k = cube_root(segs * MILLION);
+            cc->origin = cc->w_max;
+        } else {
+            cc->k = 0;
+            cc->origin = cwnd;
+        }
+        cc->w_est = cwnd;
+    }
+
+    /* the target is where the window should be one round trip from now */
+    u64 t = usec_from_timestamp(here - cc->epoch_start) / THOUSAND +
+        (pcb->sa > 0 ? pcb->sa >> 3 : 0) * TCP_SLOW_INTERVAL;
+    u64 d = t > cc->k ? t - cc->k : cc->k - t;
+    d = MIN(d, CUBIC_MAX_T);
+    u64 delta = (d * d * d / MILLION) * 4 * mss / (10 * THOUSAND);
+    u64 target;
+    if (t > cc->k)
+        target = cc->origin + delta;
+    else
+        target = cc->origin > delta ? cc->origin - delta : mss;
+
+    /* never grow slower than Reno would */
+    cc->w_est += ((u64)len * mss * CUBIC_FRIENDLY >> 10) / cwnd;
+    target = MAX(target, cc->w_est);
+
+    if (target > cwnd) {
+        u64 inc = (target - cwnd) * len / cwnd;
+        cwnd = MIN(cwnd + MIN(inc, len / 2), TCP_CC_WND_MAX);
+    }
+    pcb->cwnd = cwnd;
+    cc->cwnd = cwnd;
+}
+
+static struct tcp_cc_ops tcp_cc_algorithms[] = {
+    { .name = "reno" },
+    { .name = "cubic", .acked = cubic_acked },
+};
+
+#define TCP_CC_COUNT (sizeof(tcp_cc_algorithms) / sizeof(tcp_cc_algorithms[0]))
+
+static tcp_cc_ops tcp_cc_default = &tcp_cc_algorithms[1];
+
+static tcp_cc_ops tcp_cc_lookup(const char *name, int len)
+{
+    /* names passed by applications may or may not be terminated */
+    while (len > 0 && name[len - 1] == '\0')
+        len--;
+    for (int i = 0; i < TCP_CC_COUNT; i++) {
+        tcp_cc_ops ops = &tcp_cc_algorithms[i];
+        if (runtime_strlen(ops->name) == len && !runtime_memcmp(ops->name, name, len))
+            return ops;
+    }
+    return 0;
+}
+
+boolean tcp_cc_set_default(const char *name, int len)
+{
+    tcp_cc_ops ops = tcp_cc_lookup(name, len);
+    if (!ops)
+        return false;
+    tcp_cc_default = ops;
+    return true;
+}
+
+static void tcp_cc_start(tcp_cc cc, struct tcp_pcb *pcb, tcp_cc_ops ops)
+{
+    zero(cc, sizeof(*cc));
+    cc->ops = ops;
+    if (ops->init)
+        ops->init(cc, pcb);
+}
+
+/* a connection accepted on a listening socket inherits its algorithm */
+void tcp_cc_init(tcp_cc cc, struct tcp_pcb *pcb, tcp_cc parent)
+{
+    tcp_cc_start(cc, pcb, parent ? parent->ops : tcp_cc_default);
+}
+
+const char *tcp_cc_name(tcp_cc cc)
+{
+    return cc->ops->name;
+}
+
+boolean tcp_cc_select(tcp_cc cc, struct tcp_pcb *pcb, const char *name, int len)
+{
+    tcp_cc_ops ops = tcp_cc_lookup(name, len);
+    if (!ops)
+        return false;
+    if (ops != cc->ops)
+        tcp_cc_start(cc, pcb, ops);
+    return true;
+}
+
+void tcp_cc_acked(tcp_cc cc, struct tcp_pcb *pcb, u16 len)
+{
+    if (cc->ops->acked && len)
+        cc->ops->acked(cc, pcb, len);
+}
@@ -0,0 +1,231 @@
+#include <kernel.h>
+#include <lwip.h>
+#include <lwip/priv/tcp_priv.h>
+#include <lwip/prot/tcp.h>
+
+//#define TCP_DEMUX_DEBUG
+#ifdef TCP_DEMUX_DEBUG
+#define tcp_demux_debug(x, ...) do {rprintf("TCP DEMUX: " x, ##__VA_ARGS__);} while(0)
+#else
+#define tcp_demux_debug(x, ...)
+#endif
+
+/* Connection lookup
+
+   lwIP finds the pcb of an incoming segment by walking tcp_active_pcbs,
+   moving the match to the front of the list. With many connections
+   carrying traffic, the walk grows with their number. From the IP input
+   hook, ahead of lwIP, the 4-tuple of each TCP segment is looked up in a
+   hash table of established connections and the pcb is moved to the
+   front, so that lwIP stops at the first pcb it looks at.
+
+   The order of the list is of no consequence to lwIP otherwise. Unlinking
+   a pcb takes its predecessor, which is remembered as pcbs are moved
+   here, and trusted only while it still is a known pcb on the active list
+   that links to the one being moved. If it isn't, e.g. after lwIP added
+   or removed pcbs, the pcb is left for lwIP to find. Connections are
+   added once established and removed as lwIP frees their pcb. */
+
+typedef struct tcp_demux_key {
+    u32 local[4];
+    u32 remote[4];
+    u16 local_port;
+    u16 remote_port;
+    u32 ipv6;
+} *tcp_demux_key;
+
+typedef struct tcp_demux_entry {
+    struct tcp_demux_key key;
+    struct tcp_pcb *pcb;
+    struct tcp_pcb *prev;       /* predecessor on tcp_active_pcbs, if known */
+} *tcp_demux_entry;
+
+static struct {
+    heap h;
+    table by_tuple;
+    table by_pcb;
+    u64 tw_max;
+} tcp_demux;
+
+/* Linux default of tcp_max_tw_buckets for small machines */
+#define TCP_TW_MAX_DEFAULT  4096
+
+static key tcp_demux_key_hash(void *x)
+{
+    u32 *w = x;
+    u64 hash = 0xcbf29ce484222325;
+    for (int i = 0; i < sizeof(struct tcp_demux_key) / sizeof(u32); i++) {
+        hash ^= w[i];
+        hash *= 1099511628211;
+    }
+    return hash ^ (hash >> 32);
+}
+
+static boolean tcp_demux_key_equal(void *a, void *b)
+{
+    return !runtime_memcmp(a, b, sizeof(struct tcp_demux_key));
+}
+
+static key tcp_demux_pcb_hash(void *x)
+{
+    return (u64_from_pointer(x) * 0x9e3779b97f4a7c15ull) >> 32;
+}
+
+static void tcp_demux_pcb_key(struct tcp_pcb *pcb, tcp_demux_key k)
+{
+    zero(k, sizeof(*k));
+    if (IP_IS_V6_VAL(pcb->remote_ip)) {
+        runtime_memcpy(k->local, ip_2_ip6(&pcb->local_ip)->addr, sizeof(k->local));
+        runtime_memcpy(k->remote, ip_2_ip6(&pcb->remote_ip)->addr, sizeof(k->remote));
+        k->ipv6 = 1;
+    } else {
+        k->local[0] = ip_2_ip4(&pcb->local_ip)->addr;
+        k->remote[0] = ip_2_ip4(&pcb->remote_ip)->addr;
+    }
+    k->local_port = pcb->local_port;
+    k->remote_port = pcb->remote_port;
+}
+
+/* states of pcbs on tcp_active_pcbs */
+static boolean tcp_demux_active(struct tcp_pcb *pcb)
+{
+    return pcb->state > LISTEN && pcb->state < TIME_WAIT;
+}
+
+static void tcp_demux_set_prev(struct tcp_pcb *pcb, struct tcp_pcb *prev)
+{
+    if (!pcb)
+        return;
+    tcp_demux_entry e = table_find(tcp_demux.by_pcb, pcb);
+    if (e)
+        e->prev = prev;
+}
+
+void tcp_demux_remove(struct tcp_pcb *pcb)
+{
+    tcp_demux_entry e = table_find(tcp_demux.by_pcb, pcb);
+    if (!e)
+        return;
+    tcp_demux_debug("%s: pcb %p\n", __func__, pcb);
+    table_set(tcp_demux.by_pcb, pcb, 0);
+    if (table_find(tcp_demux.by_tuple, &e->key) == e)
+        table_set(tcp_demux.by_tuple, &e->key, 0);
+    deallocate(tcp_demux.h, e, sizeof(*e));
+}
+
+void tcp_demux_add(struct tcp_pcb *pcb)
+{
+    if (!tcp_demux_active(pcb) || table_find(tcp_demux.by_pcb, pcb))
+        return;
+    tcp_demux_entry e = allocate(tcp_demux.h, sizeof(*e));
+    if (e == INVALID_ADDRESS)
+        return;
+    tcp_demux_pcb_key(pcb, &e->key);
+    e->pcb = pcb;
+    e->prev = 0;
+    tcp_demux_entry old = table_find(tcp_demux.by_tuple, &e->key);
+    if (old)
+        tcp_demux_remove(old->pcb);
+    table_set(tcp_demux.by_tuple, &e->key, e);
+    table_set(tcp_demux.by_pcb, pcb, e);
+    tcp_demux_debug("%s: pcb %p, %d connections\n", __func__, pcb,
+                    table_elements(tcp_demux.by_pcb));
+}
+
+static void tcp_demux_promote(tcp_demux_entry e)
+{
+    struct tcp_pcb *pcb = e->pcb;
+    if (!tcp_demux_active(pcb)) {
+        /* left for TIME_WAIT */
+        tcp_demux_remove(pcb);
+        return;
+    }
+    struct tcp_pcb *head = tcp_active_pcbs;
+    if (head == pcb)
+        return;
+    struct tcp_pcb *prev = e->prev;
+    if (prev && table_find(tcp_demux.by_pcb, prev) && tcp_demux_active(prev) &&
+        prev->next == pcb) {
+        struct tcp_pcb *next = pcb->next;
+        prev->next = next;
+        pcb->next = head;
+        tcp_active_pcbs = pcb;
+        tcp_demux_set_prev(next, prev);
+    }
+    /* otherwise lwIP moves it to the front on finding it */
+    tcp_demux_set_prev(head, pcb);
+    e->prev = 0;
+}
+
+/* IP input hook; never consumes the packet */
+int tcp_demux_input(struct pbuf *p, int ipv6)
+{
+    struct tcp_demux_key k;
+    zero(&k, sizeof(k));
+    u16 off;
+    if (ipv6) {
+        struct ip6_hdr *ip6h = p->payload;
+        off = IP6_HLEN;
+        if (p->len < off + 2 * sizeof(u16) || IP6H_V(ip6h) != 6 ||
+            IP6H_NEXTH(ip6h) != IP6_NEXTH_TCP)
+            return 0;
+        runtime_memcpy(k.local, &ip6h->dest, sizeof(k.local));
+        runtime_memcpy(k.remote, &ip6h->src, sizeof(k.remote));
+        k.ipv6 = 1;
+    } else {
+        struct ip_hdr *iph = p->payload;
+        if (p->len < IP_HLEN)
+            return 0;
+        off = IPH_HL_BYTES(iph);
+        if (IPH_V(iph) != 4 || off < IP_HLEN || p->len < off + 2 * sizeof(u16) ||
+            IPH_PROTO(iph) != IP_PROTO_TCP ||
+            (IPH_OFFSET(iph) & PP_HTONS(IP_OFFMASK | IP_MF)))
+            return 0;
+        k.local[0] = iph->dest.addr;
+        k.remote[0] = iph->src.addr;
+    }
+    struct tcp_hdr *tcph = p->payload + off;
+    k.local_port = lwip_ntohs(tcph->dest);
+    k.remote_port = lwip_ntohs(tcph->src);
+    tcp_demux_entry e = table_find(tcp_demux.by_tuple, &k);
+    if (e)
+        tcp_demux_promote(e);
+    return 0;
+}
+
+void tcp_tw_set_max(u64 max)
+{
+    tcp_demux.tw_max = max;
+}
+
+/* Connections in TIME_WAIT beyond the limit are dropped, oldest first,
+   as Linux does past tcp_max_tw_buckets. lwIP keeps them newest first. */
+void tcp_tw_limit(void)
+{
+    if (!tcp_demux.tw_max)
+        return;
+    struct tcp_pcb *last = tcp_tw_pcbs;
+    for (u64 n = 1; last && n < tcp_demux.tw_max; n++)
+        last = last->next;
+    if (!last || !last->next)
+        return;
+
+    /* Abort the excess from a list of its own, where lwIP finds each
+       pcb at the head rather than at the end of the full list. */
+    struct tcp_pcb *head = tcp_tw_pcbs;
+    tcp_tw_pcbs = last->next;
+    last->next = 0;
+    while (tcp_tw_pcbs)
+        tcp_abort(tcp_tw_pcbs);
+    tcp_tw_pcbs = head;
+}
+
+void init_tcp_demux(heap h)
+{
+    tcp_demux.h = h;
+    tcp_demux.by_tuple = allocate_table(h, tcp_demux_key_hash, tcp_demux_key_equal);
+    assert(tcp_demux.by_tuple != INVALID_ADDRESS);
+    tcp_demux.by_pcb = allocate_table(h, tcp_demux_pcb_hash, pointer_equal);
+    assert(tcp_demux.by_pcb != INVALID_ADDRESS);
+    tcp_demux.tw_max = TCP_TW_MAX_DEFAULT;
+}
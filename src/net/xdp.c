@@ -0,0 +1,775 @@
+#include <net_system_structs.h>
+#include <unix_internal.h>
+#include <lwip.h>
+#include <lwip/prot/ethernet.h>
+#include <lwip/prot/ip4.h>
+#include <lwip/prot/ip6.h>
+#include <socket.h>
+
+//#define XDP_DEBUG
+#ifdef XDP_DEBUG
+#define xdp_debug(x, ...) do {rprintf("XDP %s: " x "\n", __func__, ##__VA_ARGS__);} while(0)
+#else
+#define xdp_debug(x, ...)
+#endif
+
+/* AF_XDP sockets
+
+   A socket bound to a queue of a network device receives the frames
+   arriving on that queue ahead of lwIP, and transmits frames straight to
+   the driver. Frame data lives in the UMEM, a region of process memory
+   registered with the socket and divided into equal chunks; the process
+   and the kernel exchange chunks through four single-producer rings,
+   which the process maps at the offsets of the Linux ABI:
+
+   - fill: chunks given to the kernel for receiving
+   - rx: received frames, as descriptors (address and length)
+   - tx: frames to transmit, as descriptors
+   - completion: chunks of transmitted frames, handed back
+
+   Frames are copied between driver buffers and the UMEM, as in the copy
+   mode (XDP_COPY) of Linux. The UMEM is pinned when registered and
+   accessed through the linear mapping, so that frames can be copied from
+   the receive path of the driver without faulting. Received frames are
+   posted on the rx ring as the driver processes them, and the producer
+   index is published once per batch. Transmission is started by sendto()
+   or sendmsg() and takes a single doorbell for the frames on the ring.
+
+   As there are no XDP programs, a queue is bound to at most one socket
+   and, by default, all of its frames go to the socket. A classifier set
+   with the XDP_RX_FILTER option (an extension of this kernel) selects
+   frames by ethertype, IP protocol and destination port, leaving the
+   others, e.g. ARP and DHCP, to lwIP. */
+
+#define XDP_MMAP_OFFSETS            1
+#define XDP_RX_RING                 2
+#define XDP_TX_RING                 3
+#define XDP_UMEM_REG                4
+#define XDP_UMEM_FILL_RING          5
+#define XDP_UMEM_COMPLETION_RING    6
+#define XDP_STATISTICS              7
+#define XDP_OPTIONS                 8
+#define XDP_RX_FILTER               64
+
+#define XDP_PGOFF_RX_RING               0
+#define XDP_PGOFF_TX_RING               0x80000000ull
+#define XDP_UMEM_PGOFF_FILL_RING        0x100000000ull
+#define XDP_UMEM_PGOFF_COMPLETION_RING  0x180000000ull
+
+/* sockaddr_xdp flags */
+#define XDP_SHARED_UMEM     (1 << 0)
+#define XDP_COPY            (1 << 1)
+#define XDP_ZEROCOPY        (1 << 2)
+#define XDP_USE_NEED_WAKEUP (1 << 3)
+
+#define XDP_RING_NEED_WAKEUP    (1 << 0)
+
+#define XDP_UMEM_CHUNK_MIN  2048
+#define XDP_UMEM_MAX        (4 * GB)
+#define XDP_RING_MAX        (64 * KB)
+
+struct sockaddr_xdp {
+    u16 sxdp_family;
+    u16 sxdp_flags;
+    u32 sxdp_ifindex;
+    u32 sxdp_queue_id;
+    u32 sxdp_shared_umem_fd;
+};
+
+struct xdp_ring_offset {
+    u64 producer;
+    u64 consumer;
+    u64 desc;
+    u64 flags;
+};
+
+struct xdp_mmap_offsets {
+    struct xdp_ring_offset rx;
+    struct xdp_ring_offset tx;
+    struct xdp_ring_offset fr;
+    struct xdp_ring_offset cr;
+};
+
+struct xdp_umem_reg {
+    u64 addr;
+    u64 len;
+    u32 chunk_size;
+    u32 headroom;
+    u32 flags;                  /* absent in older versions of the structure */
+};
+
+#define XDP_UMEM_REG_MIN_LEN    offsetof(struct xdp_umem_reg *, flags)
+
+struct xdp_statistics {
+    u64 rx_dropped;
+    u64 rx_invalid_descs;
+    u64 tx_invalid_descs;
+    u64 rx_ring_full;
+    u64 rx_fill_ring_empty_descs;
+    u64 tx_ring_empty_descs;
+};
+
+struct xdp_options {
+    u32 flags;
+};
+
+struct xdp_desc {
+    u64 addr;
+    u32 len;
+    u32 options;
+};
+
+/* Selects received frames for the socket; zero fields match anything.
+   Ethertype and port are in host byte order. */
+struct xdp_rx_filter {
+    u16 ethertype;
+    u8 ip_proto;
+    u8 pad;
+    u16 dst_port;
+    u16 pad2;
+};
+
+/* shared ring header; the indices are on separate cache lines and the
+   descriptors follow */
+typedef struct xsk_ring_hdr {
+    u32 producer;
+    u8 pad0[60];
+    u32 consumer;
+    u32 flags;
+    u8 pad1[56];
+} *xsk_ring_hdr;
+
+typedef struct xsk_ring {
+    xsk_ring_hdr r;
+    void *desc;
+    u32 mask;                   /* entries - 1; zero if no ring */
+    u32 cached;                 /* kernel index, published in batches */
+    u64 size;
+    void *user;                 /* reserved address in the process */
+} *xsk_ring;
+
+typedef struct xsk {
+    struct sock sock;           /* must be first */
+    process p;
+    struct spinlock tx_lock;
+    u64 umem_addr;
+    u64 umem_len;
+    u32 chunk_size;
+    u32 headroom;
+    u64 *umem_pages;            /* pinned physical pages */
+    u64 umem_npages;
+    struct xsk_ring rx, tx, fill, comp;
+    struct netif *n;
+    u32 queue_id;
+    u16 bind_flags;
+    boolean rx_pending;
+    boolean filtered;
+    struct xdp_rx_filter filter;
+    struct xdp_statistics stats;
+} *xsk;
+
+/* device queues that can be bound */
+typedef struct xsk_netif {
+    struct netif *n;
+    u32 queues;
+    xsk *bound;
+} *xsk_netif;
+
+static struct {
+    heap h;
+    backed_heap rings;
+    struct spinlock lock;       /* bindings and receive */
+    vector netifs;
+    u64 bound;
+} xdp;
+
+#define xsk_ring_entries(ring)  ((ring)->mask + 1)
+
+static xsk_netif xsk_netif_find(struct netif *n)
+{
+    xsk_netif xn;
+    vector_foreach(xdp.netifs, xn) {
+        if (xn->n == n)
+            return xn;
+    }
+    return 0;
+}
+
+/* Called by drivers as they attach, with the number of queues that frames
+   are received on. */
+void netif_xsk_enable(struct netif *n, u32 queues)
+{
+    xsk_netif xn = allocate(xdp.h, sizeof(*xn));
+    assert(xn != INVALID_ADDRESS);
+    xn->n = n;
+    xn->queues = queues;
+    xn->bound = allocate_zero(xdp.h, queues * sizeof(xsk));
+    assert(xn->bound != INVALID_ADDRESS);
+    u64 flags = spin_lock_irq(&xdp.lock);
+    vector_push(xdp.netifs, xn);
+    spin_unlock_irq(&xdp.lock, flags);
+}
+
+static boolean xsk_filter_match(xsk s, struct pbuf *p)
+{
+    struct xdp_rx_filter *f = &s->filter;
+    if (p->len < SIZEOF_ETH_HDR)
+        return false;
+    struct eth_hdr *eth = p->payload;
+    u16 type = lwip_ntohs(eth->type);
+    if (f->ethertype && type != f->ethertype)
+        return false;
+    if (!f->ip_proto && !f->dst_port)
+        return true;
+    void *l3 = p->payload + SIZEOF_ETH_HDR;
+    u8 proto;
+    u16 l4_offset;
+    if (type == ETHTYPE_IP) {
+        struct ip_hdr *iph = l3;
+        if (p->len < SIZEOF_ETH_HDR + IP_HLEN)
+            return false;
+        proto = IPH_PROTO(iph);
+        l4_offset = SIZEOF_ETH_HDR + IPH_HL_BYTES(iph);
+        if (IPH_OFFSET(iph) & PP_HTONS(IP_OFFMASK))
+            return false;       /* no header in later fragments */
+    } else if (type == ETHTYPE_IPV6) {
+        struct ip6_hdr *ip6h = l3;
+        if (p->len < SIZEOF_ETH_HDR + IP6_HLEN)
+            return false;
+        proto = IP6H_NEXTH(ip6h);
+        l4_offset = SIZEOF_ETH_HDR + IP6_HLEN;
+    } else {
+        return false;
+    }
+    if (f->ip_proto && proto != f->ip_proto)
+        return false;
+    if (f->dst_port) {
+        if ((proto != IP_PROTO_UDP && proto != IP_PROTO_TCP) ||
+            p->len < l4_offset + 2 * sizeof(u16))
+            return false;
+        u16 *ports = p->payload + l4_offset;
+        if (lwip_ntohs(ports[1]) != f->dst_port)
+            return false;
+    }
+    return true;
+}
+
+static void *xsk_umem_ptr(xsk s, u64 addr)
+{
+    return virt_from_linear_backed_phys(s->umem_pages[addr >> PAGELOG]) +
+        (addr & MASK(PAGELOG));
+}
+
+/* called with xdp.lock held */
+static void xsk_rx(xsk s, struct pbuf *p)
+{
+    u32 len = p->tot_len;
+    if (s->fill.cached == s->fill.r->producer) {
+        s->stats.rx_fill_ring_empty_descs++;
+        s->stats.rx_dropped++;
+        return;
+    }
+    if (s->rx.cached - s->rx.r->consumer > s->rx.mask) {
+        s->stats.rx_ring_full++;
+        s->stats.rx_dropped++;
+        return;
+    }
+    read_barrier();
+    u64 chunk = ((u64 *)s->fill.desc)[s->fill.cached & s->fill.mask];
+    chunk &= ~((u64)s->chunk_size - 1);
+    if (chunk >= s->umem_len || len > s->chunk_size - s->headroom) {
+        s->fill.cached++;
+        s->stats.rx_dropped++;
+        return;
+    }
+    s->fill.cached++;
+    u64 addr = chunk + s->headroom;
+    pbuf_copy_partial(p, xsk_umem_ptr(s, addr), len, 0);
+    struct xdp_desc *d = s->rx.desc + (s->rx.cached & s->rx.mask) * sizeof(*d);
+    d->addr = addr;
+    d->len = len;
+    d->options = 0;
+    s->rx.cached++;
+    s->rx_pending = true;
+}
+
+/* Called by drivers for each frame received on a queue; returns true if
+   the frame was taken, in which case the pbuf has been freed. */
+boolean netif_xsk_receive(struct netif *n, u32 queue, struct pbuf *p)
+{
+    if (!xdp.bound)
+        return false;
+    boolean taken = false;
+    u64 flags = spin_lock_irq(&xdp.lock);
+    xsk_netif xn = xsk_netif_find(n);
+    xsk s = (xn && queue < xn->queues) ? xn->bound[queue] : 0;
+    if (s && s->rx.mask && (!s->filtered || xsk_filter_match(s, p))) {
+        xsk_rx(s, p);
+        taken = true;
+    }
+    spin_unlock_irq(&xdp.lock, flags);
+    if (taken)
+        pbuf_free(p);
+    return taken;
+}
+
+/* Called by drivers at the end of a batch of received frames: publishes
+   the frames posted on each socket bound to the device. */
+void netif_xsk_receive_flush(struct netif *n)
+{
+    if (!xdp.bound)
+        return;
+    u64 flags = spin_lock_irq(&xdp.lock);
+    xsk_netif xn = xsk_netif_find(n);
+    for (u32 q = 0; xn && q < xn->queues; q++) {
+        xsk s = xn->bound[q];
+        if (!s || !s->rx_pending)
+            continue;
+        s->rx_pending = false;
+        write_barrier();
+        s->fill.r->consumer = s->fill.cached;
+        s->rx.r->producer = s->rx.cached;
+        fdesc_notify_events(&s->sock.f);
+    }
+    spin_unlock_irq(&xdp.lock, flags);
+}
+
+/* Hands the frames on the tx ring to the driver, for as long as there is
+   room on the completion ring. */
+static sysreturn xsk_tx(xsk s)
+{
+    if (!s->n)
+        return -ENXIO;
+    if (!s->tx.mask)
+        return -ENOBUFS;
+    if (!netif_is_up(s->n) || !netif_is_link_up(s->n))
+        return -ENETDOWN;
+    u32 max_len = s->n->mtu + SIZEOF_ETH_HDR;
+    u64 flags = spin_lock_irq(&s->tx_lock);
+    u32 prod = s->tx.r->producer;
+    read_barrier();
+    if (s->tx.cached == prod)
+        s->stats.tx_ring_empty_descs++;
+    sysreturn rv = 0;
+    while (s->tx.cached != prod) {
+        if (s->comp.cached - s->comp.r->consumer > s->comp.mask) {
+            rv = -EAGAIN;
+            break;
+        }
+        struct xdp_desc *d = s->tx.desc + (s->tx.cached & s->tx.mask) * sizeof(*d);
+        u64 addr = d->addr;
+        u32 len = d->len;
+        u64 offset = addr & (s->chunk_size - 1);
+        if (addr >= s->umem_len || len < SIZEOF_ETH_HDR || len > max_len ||
+            offset + len > s->chunk_size) {
+            s->stats.tx_invalid_descs++;
+            s->tx.cached++;
+            continue;
+        }
+        struct pbuf *p = pbuf_alloc(PBUF_RAW_TX, len, PBUF_RAM);
+        if (!p) {
+            rv = -EAGAIN;
+            break;
+        }
+        pbuf_take(p, xsk_umem_ptr(s, addr), len);
+        s->n->linkoutput(s->n, p);
+        pbuf_free(p);
+        s->tx.cached++;
+        ((u64 *)s->comp.desc)[s->comp.cached & s->comp.mask] = addr;
+        s->comp.cached++;
+    }
+    write_barrier();
+    s->tx.r->consumer = s->tx.cached;
+    s->comp.r->producer = s->comp.cached;
+    spin_unlock_irq(&s->tx_lock, flags);
+    netif_tx_flush_all();
+    fdesc_notify_events(&s->sock.f);
+    return rv;
+}
+
+static sysreturn xsk_ring_create(xsk s, xsk_ring ring, void *optval, socklen_t optlen,
+                                 u32 desc_size)
+{
+    if (optlen < sizeof(int))
+        return -EINVAL;
+    u32 entries = *(int *)optval;
+    if (entries == 0 || (entries & (entries - 1)) || entries > XDP_RING_MAX)
+        return -EINVAL;
+    if (ring->mask || s->n)
+        return -EBUSY;
+    u64 size = pad(sizeof(struct xsk_ring_hdr) + entries * desc_size, PAGESIZE);
+    xsk_ring_hdr r = allocate_zero((heap)xdp.rings, size);
+    if (r == INVALID_ADDRESS)
+        return -ENOMEM;
+    void *user = allocate(s->p->virtual, size);
+    if (user == INVALID_ADDRESS) {
+        deallocate((heap)xdp.rings, r, size);
+        return -ENOMEM;
+    }
+    ring->r = r;
+    ring->desc = r + 1;
+    ring->cached = 0;
+    ring->size = size;
+    ring->user = user;
+    write_barrier();
+    ring->mask = entries - 1;
+    return 0;
+}
+
+static void xsk_ring_destroy(xsk s, xsk_ring ring)
+{
+    if (!ring->mask)
+        return;
+    unmap(u64_from_pointer(ring->user), ring->size);
+    deallocate(s->p->virtual, ring->user, ring->size);
+    deallocate((heap)xdp.rings, ring->r, ring->size);
+    ring->mask = 0;
+}
+
+static void xsk_umem_release(xsk s)
+{
+    for (u64 i = 0; i < s->umem_npages; i++)
+        unpin_phys_page(s->umem_pages[i]);
+    if (s->umem_pages)
+        deallocate(xdp.h, s->umem_pages, (s->umem_len >> PAGELOG) * sizeof(u64));
+    s->umem_pages = 0;
+    s->umem_npages = 0;
+}
+
+static sysreturn xsk_umem_reg(xsk s, void *optval, socklen_t optlen)
+{
+    struct xdp_umem_reg reg;
+    if (optlen < XDP_UMEM_REG_MIN_LEN)
+        return -EINVAL;
+    zero(&reg, sizeof(reg));
+    runtime_memcpy(&reg, optval, MIN(optlen, sizeof(reg)));
+    if (s->umem_pages)
+        return -EBUSY;
+    if ((reg.addr & MASK(PAGELOG)) || reg.len == 0 || reg.len > XDP_UMEM_MAX ||
+        reg.chunk_size < XDP_UMEM_CHUNK_MIN || reg.chunk_size > PAGESIZE ||
+        (reg.chunk_size & (reg.chunk_size - 1)) || (reg.len & (reg.chunk_size - 1)) ||
+        reg.headroom >= reg.chunk_size - SIZEOF_ETH_HDR || reg.flags)
+        return -EINVAL;
+    if (!validate_user_memory(pointer_from_u64(reg.addr), reg.len, true))
+        return -EFAULT;
+    u64 npages = pad(reg.len, PAGESIZE) >> PAGELOG;
+    s->umem_pages = allocate(xdp.h, npages * sizeof(u64));
+    if (s->umem_pages == INVALID_ADDRESS) {
+        s->umem_pages = 0;
+        return -ENOMEM;
+    }
+    s->umem_len = reg.len;
+    s->umem_addr = reg.addr;
+    s->chunk_size = reg.chunk_size;
+    s->headroom = reg.headroom;
+    for (u64 va = reg.addr; va < reg.addr + reg.len; va += PAGESIZE) {
+        (void)*(volatile u8 *)pointer_from_u64(va);     /* fault in */
+        u64 phys = pin_user_page(s->p, va);
+        if (phys == INVALID_PHYSICAL) {
+            xsk_umem_release(s);
+            return -EFAULT;
+        }
+        s->umem_pages[s->umem_npages++] = phys;
+    }
+    xdp_debug("umem at 0x%lx, %ld bytes, chunk size %d", reg.addr, reg.len, reg.chunk_size);
+    return 0;
+}
+
+static void xsk_ring_offsets(struct xdp_ring_offset *off)
+{
+    off->producer = offsetof(xsk_ring_hdr, producer);
+    off->consumer = offsetof(xsk_ring_hdr, consumer);
+    off->flags = offsetof(xsk_ring_hdr, flags);
+    off->desc = sizeof(struct xsk_ring_hdr);
+}
+
+sysreturn xdp_setsockopt(struct sock *sock, int level, int optname, void *optval,
+                         socklen_t optlen)
+{
+    xsk s = (xsk)sock;
+    if (level != SOL_XDP)
+        return -ENOPROTOOPT;
+    if (!validate_user_memory(optval, optlen, false))
+        return -EFAULT;
+    switch (optname) {
+    case XDP_UMEM_REG:
+        return xsk_umem_reg(s, optval, optlen);
+    case XDP_RX_RING:
+        return xsk_ring_create(s, &s->rx, optval, optlen, sizeof(struct xdp_desc));
+    case XDP_TX_RING:
+        return xsk_ring_create(s, &s->tx, optval, optlen, sizeof(struct xdp_desc));
+    case XDP_UMEM_FILL_RING:
+        return xsk_ring_create(s, &s->fill, optval, optlen, sizeof(u64));
+    case XDP_UMEM_COMPLETION_RING:
+        return xsk_ring_create(s, &s->comp, optval, optlen, sizeof(u64));
+    case XDP_RX_FILTER: {
+        if (optlen < sizeof(struct xdp_rx_filter))
+            return -EINVAL;
+        u64 flags = spin_lock_irq(&xdp.lock);
+        runtime_memcpy(&s->filter, optval, sizeof(s->filter));
+        s->filtered = s->filter.ethertype || s->filter.ip_proto || s->filter.dst_port;
+        spin_unlock_irq(&xdp.lock, flags);
+        return 0;
+    }
+    default:
+        return -ENOPROTOOPT;
+    }
+}
+
+sysreturn xdp_getsockopt(struct sock *sock, int level, int optname, void *optval,
+                         socklen_t *optlen)
+{
+    xsk s = (xsk)sock;
+    if (level != SOL_XDP)
+        return -ENOPROTOOPT;
+    if (!validate_user_memory(optlen, sizeof(socklen_t), true) ||
+        !validate_user_memory(optval, *optlen, true))
+        return -EFAULT;
+    union {
+        struct xdp_mmap_offsets off;
+        struct xdp_statistics stats;
+        struct xdp_options opts;
+        struct xdp_rx_filter filter;
+    } ret;
+    socklen_t len;
+    switch (optname) {
+    case XDP_MMAP_OFFSETS:
+        xsk_ring_offsets(&ret.off.rx);
+        xsk_ring_offsets(&ret.off.tx);
+        xsk_ring_offsets(&ret.off.fr);
+        xsk_ring_offsets(&ret.off.cr);
+        len = sizeof(ret.off);
+        break;
+    case XDP_STATISTICS: {
+        u64 flags = spin_lock_irq(&xdp.lock);
+        runtime_memcpy(&ret.stats, &s->stats, sizeof(ret.stats));
+        spin_unlock_irq(&xdp.lock, flags);
+        len = sizeof(ret.stats);
+        break;
+    }
+    case XDP_OPTIONS:
+        ret.opts.flags = 0;     /* no zero-copy */
+        len = sizeof(ret.opts);
+        break;
+    case XDP_RX_FILTER:
+        ret.filter = s->filter;
+        len = sizeof(ret.filter);
+        break;
+    default:
+        return -ENOPROTOOPT;
+    }
+    /* older struct xdp_statistics has only the first three fields */
+    if (*optlen < len && !(optname == XDP_STATISTICS && *optlen >= 3 * sizeof(u64)))
+        return -EINVAL;
+    len = MIN(len, *optlen);
+    runtime_memcpy(optval, &ret, len);
+    *optlen = len;
+    return 0;
+}
+
+sysreturn xdp_mmap(fdesc desc, u64 len, pageflags mapflags, u64 offset)
+{
+    struct sock *sock = (struct sock *)desc;
+    if (sock->domain != AF_XDP)
+        return -ENODEV;
+    xsk s = (xsk)sock;
+    xsk_ring ring;
+    switch (offset) {
+    case XDP_PGOFF_RX_RING:
+        ring = &s->rx;
+        break;
+    case XDP_PGOFF_TX_RING:
+        ring = &s->tx;
+        break;
+    case XDP_UMEM_PGOFF_FILL_RING:
+        ring = &s->fill;
+        break;
+    case XDP_UMEM_PGOFF_COMPLETION_RING:
+        ring = &s->comp;
+        break;
+    default:
+        return -EINVAL;
+    }
+    if (!ring->mask || len > ring->size)
+        return -EINVAL;
+    u64 virt = u64_from_pointer(ring->user);
+    map(virt, physical_from_virtual(ring->r), len, mapflags);
+    return virt;
+}
+
+static sysreturn xsk_bind(struct sock *sock, struct sockaddr *addr, socklen_t addrlen)
+{
+    xsk s = (xsk)sock;
+    struct sockaddr_xdp *sxdp = (struct sockaddr_xdp *)addr;
+    if (addrlen < sizeof(*sxdp) || sxdp->sxdp_family != AF_XDP)
+        return -EINVAL;
+    u16 flags = sxdp->sxdp_flags;
+    xdp_debug("ifindex %d, queue %d, flags 0x%x", sxdp->sxdp_ifindex, sxdp->sxdp_queue_id,
+              flags);
+    if (flags & ~(XDP_SHARED_UMEM | XDP_COPY | XDP_ZEROCOPY | XDP_USE_NEED_WAKEUP))
+        return -EINVAL;
+    if (flags & (XDP_SHARED_UMEM | XDP_ZEROCOPY))
+        return -EOPNOTSUPP;
+    if (s->n)
+        return -EINVAL;
+    if (!s->umem_pages || !s->fill.mask || !s->comp.mask || (!s->rx.mask && !s->tx.mask))
+        return -EINVAL;
+    struct netif *n;
+    NETIF_FOREACH(n) {
+        if (n->num == sxdp->sxdp_ifindex)
+            break;
+    }
+    if (!n)
+        return -ENODEV;
+    sysreturn rv = 0;
+    u64 irqflags = spin_lock_irq(&xdp.lock);
+    xsk_netif xn = xsk_netif_find(n);
+    if (!xn) {
+        rv = -EOPNOTSUPP;
+    } else if (sxdp->sxdp_queue_id >= xn->queues) {
+        rv = -EINVAL;
+    } else if (xn->bound[sxdp->sxdp_queue_id]) {
+        rv = -EBUSY;
+    } else {
+        s->n = n;
+        s->queue_id = sxdp->sxdp_queue_id;
+        s->bind_flags = flags;
+        /* frames are received without a wakeup, but transmitted on one */
+        if (flags & XDP_USE_NEED_WAKEUP)
+            s->tx.r->flags = XDP_RING_NEED_WAKEUP;
+        xn->bound[s->queue_id] = s;
+        xdp.bound++;
+    }
+    spin_unlock_irq(&xdp.lock, irqflags);
+    return rv;
+}
+
+static void xsk_unbind(xsk s)
+{
+    if (!s->n)
+        return;
+    u64 flags = spin_lock_irq(&xdp.lock);
+    xsk_netif xn = xsk_netif_find(s->n);
+    if (xn && xn->bound[s->queue_id] == s) {
+        xn->bound[s->queue_id] = 0;
+        xdp.bound--;
+    }
+    spin_unlock_irq(&xdp.lock, flags);
+    s->n = 0;
+}
+
+static sysreturn xsk_getsockname(struct sock *sock, struct sockaddr *addr, socklen_t *addrlen)
+{
+    xsk s = (xsk)sock;
+    struct sockaddr_xdp sxdp;
+    zero(&sxdp, sizeof(sxdp));
+    sxdp.sxdp_family = AF_XDP;
+    if (s->n) {
+        sxdp.sxdp_flags = s->bind_flags;
+        sxdp.sxdp_ifindex = s->n->num;
+        sxdp.sxdp_queue_id = s->queue_id;
+    }
+    runtime_memcpy(addr, &sxdp, MIN(sizeof(sxdp), *addrlen));
+    *addrlen = sizeof(sxdp);
+    return 0;
+}
+
+/* sendto() and sendmsg() only start transmission, of what is on the tx
+   ring, and recvfrom() and recvmsg() have nothing to do as frames are
+   received as they come */
+static sysreturn xsk_sendto(struct sock *sock, void *buf, u64 len, int flags,
+                            struct sockaddr *dest_addr, socklen_t addrlen)
+{
+    return xsk_tx((xsk)sock);
+}
+
+static sysreturn xsk_sendmsg(struct sock *sock, const struct msghdr *msg, int flags)
+{
+    return xsk_tx((xsk)sock);
+}
+
+static sysreturn xsk_recvfrom(struct sock *sock, void *buf, u64 len, int flags,
+                              struct sockaddr *src_addr, socklen_t *addrlen)
+{
+    return ((xsk)sock)->n ? 0 : -ENXIO;
+}
+
+static sysreturn xsk_recvmsg(struct sock *sock, struct msghdr *msg, int flags)
+{
+    return ((xsk)sock)->n ? 0 : -ENXIO;
+}
+
+closure_function(1, 1, u32, xsk_events,
+                 xsk, s,
+                 thread, t /* ignore */)
+{
+    xsk s = bound(s);
+    u32 events = 0;
+    if (s->rx.mask && s->rx.r->producer != s->rx.r->consumer)
+        events |= EPOLLIN | EPOLLRDNORM;
+    if (s->tx.mask && s->tx.r->producer - s->tx.r->consumer <= s->tx.mask)
+        events |= EPOLLOUT | EPOLLWRNORM;
+    return events;
+}
+
+closure_function(1, 2, sysreturn, xsk_close,
+                 xsk, s,
+                 thread, t, io_completion, completion)
+{
+    xsk s = bound(s);
+    xdp_debug("close, fd %d", s->sock.fd);
+    xsk_unbind(s);
+    socket_flush_q(&s->sock);
+    xsk_ring_destroy(s, &s->rx);
+    xsk_ring_destroy(s, &s->tx);
+    xsk_ring_destroy(s, &s->fill);
+    xsk_ring_destroy(s, &s->comp);
+    xsk_umem_release(s);
+    deallocate_closure(s->sock.f.events);
+    deallocate_closure(s->sock.f.close);
+    socket_deinit(&s->sock);
+    deallocate(s->sock.h, s, sizeof(*s));
+    return io_complete(completion, t, 0);
+}
+
+sysreturn xdp_open(int type, int protocol)
+{
+    int flags = type & ~SOCK_TYPE_MASK;
+    if (flags & ~(SOCK_NONBLOCK | SOCK_CLOEXEC))
+        return -EINVAL;
+    type &= SOCK_TYPE_MASK;
+    if (type != SOCK_RAW)
+        return -ESOCKTNOSUPPORT;
+    if (protocol != 0)
+        return -EPROTONOSUPPORT;
+    heap h = xdp.h;
+    xsk s = allocate_zero(h, sizeof(*s));
+    if (s == INVALID_ADDRESS)
+        return -ENOMEM;
+    if (socket_init(current->p, h, AF_XDP, type, flags, &s->sock) < 0) {
+        deallocate(h, s, sizeof(*s));
+        return -ENOMEM;
+    }
+    s->p = current->p;
+    spin_lock_init(&s->tx_lock);
+    s->sock.f.events = closure(h, xsk_events, s);
+    s->sock.f.close = closure(h, xsk_close, s);
+    s->sock.bind = xsk_bind;
+    s->sock.getsockname = xsk_getsockname;
+    s->sock.sendto = xsk_sendto;
+    s->sock.recvfrom = xsk_recvfrom;
+    s->sock.sendmsg = xsk_sendmsg;
+    s->sock.recvmsg = xsk_recvmsg;
+    xdp_debug("fd %d", s->sock.fd);
+    return s->sock.fd;
+}
+
+void xdp_init(kernel_heaps kh)
+{
+    xdp.h = heap_general(kh);
+    xdp.rings = heap_linear_backed(kh);
+    spin_lock_init(&xdp.lock);
+    xdp.netifs = allocate_vector(xdp.h, 4);
+    assert(xdp.netifs != INVALID_ADDRESS);
+    xdp.bound = 0;
+}
@@ -0,0 +1,70 @@
+#include <runtime.h>
+
+static inline u64 ip_csum_tail(const u8 *p, bytes len, u64 sum)
+{
+    if (len >= sizeof(u32)) {
+        sum = ip_csum_add(sum, *(u32 *)p);
+        p += sizeof(u32);
+        len -= sizeof(u32);
+    }
+    if (len >= sizeof(u16)) {
+        sum = ip_csum_add(sum, *(u16 *)p);
+        p += sizeof(u16);
+        len -= sizeof(u16);
+    }
+    /* a trailing odd byte is the high-order byte of its (zero-padded)
+       big-endian word; both supported architectures are little-endian */
+    if (len)
+        sum = ip_csum_add(sum, *p);
+    return sum;
+}
+
+u64 ip_csum_partial(const void *buf, bytes len, u64 sum)
+{
+    const u8 *p = buf;
+    bytes nblocks = len >> 6;
+    sum = ip_csum_blocks(p, nblocks, sum);
+    p += nblocks << 6;
+    len &= 63;
+    while (len >= sizeof(u64)) {
+        sum = ip_csum_add(sum, *(u64 *)p);
+        p += sizeof(u64);
+        len -= sizeof(u64);
+    }
+    return ip_csum_tail(p, len, sum);
+}
+
+/* Checksum data while copying it, so that the data is only brought into
+   the cache once. */
+u64 ip_csum_copy(void *dst, const void *src, bytes len, u64 sum)
+{
+    const u8 *s = src;
+    u8 *d = dst;
+    while (len >= 4 * sizeof(u64)) {
+        u64 w0 = ((u64 *)s)[0];
+        u64 w1 = ((u64 *)s)[1];
+        u64 w2 = ((u64 *)s)[2];
+        u64 w3 = ((u64 *)s)[3];
+        ((u64 *)d)[0] = w0;
+        ((u64 *)d)[1] = w1;
+        ((u64 *)d)[2] = w2;
+        ((u64 *)d)[3] = w3;
+        sum = ip_csum_add(sum, w0);
+        sum = ip_csum_add(sum, w1);
+        sum = ip_csum_add(sum, w2);
+        sum = ip_csum_add(sum, w3);
+        s += 4 * sizeof(u64);
+        d += 4 * sizeof(u64);
+        len -= 4 * sizeof(u64);
+    }
+    while (len >= sizeof(u64)) {
+        u64 w = *(u64 *)s;
+        *(u64 *)d = w;
+        sum = ip_csum_add(sum, w);
+        s += sizeof(u64);
+        d += sizeof(u64);
+        len -= sizeof(u64);
+    }
+    runtime_memcpy(d, s, len);
+    return ip_csum_tail(s, len, sum);
+}
@@ -0,0 +1,33 @@
+/* Internet (RFC 1071) checksum
+
+   Sums are accumulated as 64-bit one's complement values over words
+   loaded in native byte order, which yields the checksum in network
+   byte order once folded. A sum over data starting at an odd offset
+   within a packet must be byte-swapped after folding before it is
+   combined with other sums. */
+
+u64 ip_csum_partial(const void *buf, bytes len, u64 sum);
+u64 ip_csum_copy(void *dst, const void *src, bytes len, u64 sum);
+
+static inline u16 ip_csum_fold(u64 sum)
+{
+    u32 s = (u32)sum;
+    s += (u32)(sum >> 32);
+    s += (s < (u32)(sum >> 32));
+    u16 f = (u16)s;
+    f += (u16)(s >> 16);
+    f += (f < (u16)(s >> 16));
+    return f;
+}
+
+static inline u64 ip_csum_add(u64 sum, u64 s)
+{
+    sum += s;
+    return sum + (sum < s);
+}
+
+/* checksum of a single contiguous buffer, ready to store */
+static inline u16 ip_csum(const void *buf, bytes len)
+{
+    return ~ip_csum_fold(ip_csum_partial(buf, len, 0));
+}
@@ -0,0 +1,268 @@
+#include <runtime.h>
+
+//#define RADIX_DEBUG
+#ifdef RADIX_DEBUG
+#define radix_debug(x, ...) do {rprintf("RADIX %s: " x, __func__, ##__VA_ARGS__);} while(0)
+#else
+#define radix_debug(x, ...)
+#endif
+
+#define RADIX_MASK MASK(RADIX_ORDER)
+
+/* single load of a slot or root that may be concurrently published */
+#define radix_load(p) (*(void * volatile *)&(p))
+
+static inline u64 slot_index(radix_node n, u64 key)
+{
+    return (key >> n->shift) & RADIX_MASK;
+}
+
+static inline boolean node_covers(radix_node n, u64 key)
+{
+    int bits = n->shift + RADIX_ORDER;
+    return bits >= 64 || (key >> bits) == 0;
+}
+
+static radix_node allocate_radix_node(radix_tree t, radix_node parent, int index, int shift)
+{
+    radix_node n = allocate_zero(t->h, sizeof(struct radix_node));
+    if (n == INVALID_ADDRESS)
+        return n;
+    n->parent = parent;
+    n->index = index;
+    n->shift = shift;
+    return n;
+}
+
+static inline void deallocate_radix_node(radix_tree t, radix_node n)
+{
+    deallocate(t->h, n, sizeof(struct radix_node));
+}
+
+/* add levels above the root until key is covered */
+static boolean grow_to_cover(radix_tree t, u64 key)
+{
+    radix_node r = t->root;
+    if (!r) {
+        int shift = key ? (msb(key) / RADIX_ORDER) * RADIX_ORDER : 0;
+        r = allocate_radix_node(t, 0, 0, shift);
+        if (r == INVALID_ADDRESS)
+            return false;
+        radix_debug("new root %p, shift %d\n", r, shift);
+        write_barrier();
+        t->root = r;
+        return true;
+    }
+    while (!node_covers(r, key)) {
+        radix_node n = allocate_radix_node(t, 0, 0, r->shift + RADIX_ORDER);
+        if (n == INVALID_ADDRESS)
+            return false;
+        radix_debug("grow root %p -> %p, shift %d\n", r, n, n->shift);
+        n->slots[0] = r;
+        n->present = 1;
+        r->parent = n;
+        write_barrier();
+        t->root = n;
+        r = n;
+    }
+    return true;
+}
+
+boolean radix_insert(radix_tree t, u64 key, void *p)
+{
+    radix_debug("t %p, key 0x%lx, p %p\n", t, key, p);
+    assert(p && p != INVALID_ADDRESS);
+    if (!grow_to_cover(t, key))
+        return false;
+    radix_node n = t->root;
+    while (n->shift > 0) {
+        u64 i = slot_index(n, key);
+        radix_node c = n->slots[i];
+        if (!c) {
+            c = allocate_radix_node(t, n, i, n->shift - RADIX_ORDER);
+            if (c == INVALID_ADDRESS)
+                return false;
+            write_barrier();
+            n->slots[i] = c;
+            n->present |= U64_FROM_BIT(i);
+        }
+        n = c;
+    }
+    u64 i = slot_index(n, key);
+    if (n->slots[i])
+        return false;
+    /* make item contents visible to lockless readers before the slot */
+    write_barrier();
+    n->slots[i] = p;
+    n->present |= U64_FROM_BIT(i);
+    t->count++;
+    return true;
+}
+
+static void shrink_root(radix_tree t)
+{
+    radix_node r = t->root;
+    while (r->shift > 0 && r->present == 1) {
+        radix_node c = r->slots[0];
+        radix_debug("shrink root %p -> %p\n", r, c);
+        c->parent = 0;
+        c->index = 0;
+        t->root = c;
+        deallocate_radix_node(t, r);
+        r = c;
+    }
+}
+
+void *radix_remove(radix_tree t, u64 key)
+{
+    radix_debug("t %p, key 0x%lx\n", t, key);
+    radix_node n = t->root;
+    if (!n || !node_covers(n, key))
+        return INVALID_ADDRESS;
+    while (n->shift > 0) {
+        n = n->slots[slot_index(n, key)];
+        if (!n)
+            return INVALID_ADDRESS;
+    }
+    u64 i = slot_index(n, key);
+    void *p = n->slots[i];
+    if (!p)
+        return INVALID_ADDRESS;
+    n->slots[i] = 0;
+    n->present &= ~U64_FROM_BIT(i);
+    t->count--;
+
+    /* release empty nodes up to the root */
+    while (n->present == 0) {
+        radix_node parent = n->parent;
+        if (!parent) {
+            assert(n == t->root);
+            t->root = 0;
+            deallocate_radix_node(t, n);
+            return p;
+        }
+        parent->slots[n->index] = 0;
+        parent->present &= ~U64_FROM_BIT(n->index);
+        deallocate_radix_node(t, n);
+        n = parent;
+    }
+    shrink_root(t);
+    return p;
+}
+
+void *radix_lookup(radix_tree t, u64 key)
+{
+    radix_node n = radix_load(t->root);
+    if (!n || !node_covers(n, key))
+        return INVALID_ADDRESS;
+    while (1) {
+        void *p = radix_load(n->slots[slot_index(n, key)]);
+        if (!p)
+            return INVALID_ADDRESS;
+        if (n->shift == 0)
+            return p;
+        n = p;
+    }
+}
+
+/* base is the key of the first slot in n */
+static boolean gang_lookup_node(radix_node n, u64 base, range q, void **results, u64 max,
+                                u64 *found)
+{
+    u64 w = n->present;
+    if (q.start > base)
+        w &= ~MASK(slot_index(n, q.start));
+    while (w) {
+        u64 i = lsb(w);
+        w &= ~U64_FROM_BIT(i);
+        u64 k = base | (i << n->shift);
+        if (k >= q.end)
+            return false;
+        void *p = radix_load(n->slots[i]);
+        if (!p)
+            continue;
+        if (n->shift == 0) {
+            results[(*found)++] = p;
+            if (*found == max)
+                return false;
+        } else if (!gang_lookup_node(p, k, q, results, max, found)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+u64 radix_gang_lookup(radix_tree t, range q, void **results, u64 max)
+{
+    u64 found = 0;
+    radix_node r = radix_load(t->root);
+    if (!r || max == 0 || range_empty(q) || !node_covers(r, q.start))
+        return 0;
+    gang_lookup_node(r, 0, q, results, max, &found);
+    return found;
+}
+
+static boolean traverse_node(radix_node n, u64 base, radix_handler rh)
+{
+    bitmap_word_foreach_set(n->present, bit, i, 0) {
+        void *p = n->slots[i];
+        u64 k = base | (i << n->shift);
+        if (n->shift == 0) {
+            if (!apply(rh, k, p))
+                return false;
+        } else if (!traverse_node(p, k, rh)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+boolean radix_traverse(radix_tree t, radix_handler rh)
+{
+    return t->root ? traverse_node(t->root, 0, rh) : true;
+}
+
+void init_radix_tree(radix_tree t, heap h)
+{
+    t->root = 0;
+    t->count = 0;
+    t->h = h;
+}
+
+radix_tree allocate_radix_tree(heap h)
+{
+    radix_tree t = allocate(h, sizeof(struct radix_tree));
+    if (t == INVALID_ADDRESS)
+        return t;
+    init_radix_tree(t, h);
+    return t;
+}
+
+static void destruct_node(radix_tree t, radix_node n, u64 base, radix_handler destructor)
+{
+    bitmap_word_foreach_set(n->present, bit, i, 0) {
+        void *p = n->slots[i];
+        u64 k = base | (i << n->shift);
+        if (n->shift == 0) {
+            if (destructor)
+                apply(destructor, k, p);
+        } else {
+            destruct_node(t, p, k, destructor);
+        }
+    }
+    deallocate_radix_node(t, n);
+}
+
+void destruct_radix_tree(radix_tree t, radix_handler destructor)
+{
+    if (t->root)
+        destruct_node(t, t->root, 0, destructor);
+    t->root = 0;
+    t->count = 0;
+}
+
+void deallocate_radix_tree(radix_tree t, radix_handler destructor)
+{
+    destruct_radix_tree(t, destructor);
+    deallocate(t->h, t, sizeof(struct radix_tree));
+}
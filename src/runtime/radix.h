@@ -0,0 +1,59 @@
+/* radix tree mapping u64 keys to non-null pointers
+
+   Intended for dense integer keyspaces, like page indices. Each level
+   resolves RADIX_ORDER bits of the key, and the tree grows in height
+   only as needed to cover the largest key inserted.
+
+   Insertions publish new nodes and items only after they are fully
+   initialized, so lookups (radix_lookup, radix_gang_lookup) may run
+   concurrently with a single inserter without taking a lock. Removals
+   free interior nodes and must be serialized against all readers.
+*/
+#define RADIX_ORDER 6
+#define RADIX_SLOTS U64_FROM_BIT(RADIX_ORDER)
+
+typedef struct radix_node *radix_node;
+struct radix_node {
+    void *slots[RADIX_SLOTS];
+    u64 present;                /* bitmap of occupied slots */
+    radix_node parent;
+    u8 shift;                   /* key shift for slot index at this level */
+    u8 index;                   /* slot index in parent */
+};
+
+typedef closure_type(radix_handler, boolean, u64 key, void *p);
+
+typedef struct radix_tree {
+    radix_node root;
+    u64 count;
+    heap h;
+} *radix_tree;
+
+/* returns false if the key is already occupied or on allocation failure */
+boolean radix_insert(radix_tree t, u64 key, void *p);
+
+/* returns the removed item, or INVALID_ADDRESS if not found */
+void *radix_remove(radix_tree t, u64 key);
+
+void *radix_lookup(radix_tree t, u64 key);
+
+/* fill results with up to max items with keys in range q, in key
+   order; returns the number of items found */
+u64 radix_gang_lookup(radix_tree t, range q, void **results, u64 max);
+
+/* in-order traversal; stops if handler returns false */
+boolean radix_traverse(radix_tree t, radix_handler rh);
+
+void init_radix_tree(radix_tree t, heap h);
+
+radix_tree allocate_radix_tree(heap h);
+
+/* destructor, if non-null, is applied to each item before nodes are freed */
+void destruct_radix_tree(radix_tree t, radix_handler destructor);
+
+void deallocate_radix_tree(radix_tree t, radix_handler destructor);
+
+static inline u64 radix_get_count(radix_tree t)
+{
+    return t->count;
+}
@@ -193,6 +193,7 @@ typedef closure_type(thunk, void);
 #include <pqueue.h>
 #include <rbtree.h>
 #include <range.h>
+#include <radix.h>
 #include <queue.h>
 #include <refcount.h>
 
@@ -212,6 +213,7 @@ typedef closure_type(block_flush, void, status_handler);
 typedef closure_type(storage_attach, void, block_io, block_io, block_flush, u64);
 
 #include <sg.h>
+#include <checksum.h>
 
 void print_value(buffer dest, value v, tuple attrs);
 
@@ -54,9 +54,10 @@ pagecache_volume filesystem_get_pagecache_volume(filesystem fs)
     return fs->pv;
 }
 
+/* includes data pending delayed allocation in the pagecache */
 u64 fsfile_get_length(fsfile f)
 {
-    return f->length;
+    return pagecache_get_node_length(f->cache_node);
 }
 KLIB_EXPORT(fsfile_get_length);
 
@@ -738,17 +739,91 @@ static status extents_range_handler(filesystem fs, fsfile f, range blocks, sg_li
     return STATUS_OK;
 }
 
-closure_function(2, 1, status, filesystem_check_or_reserve_extent,
+closure_function(1, 1, void, count_gap_blocks,
+                 u64 *, nblocks,
+                 range, r)
+{
+    *bound(nblocks) += range_span(r);
+}
+
+/* blocks in the given range that aren't yet covered by an extent */
+static u64 unallocated_blocks(fsfile f, range blocks)
+{
+    u64 nblocks = 0;
+    rangemap_range_find_gaps(f->extentmap, blocks, stack_closure(count_gap_blocks, &nblocks));
+    return nblocks;
+}
+
+/* Writes with delayed allocation only reserve a count of storage blocks,
+   so that running out of space is reported to the writer. Extents are
+   created when the data is written back, which consumes the
+   reservation. */
+static status delalloc_reserve(filesystem fs, fsfile f, range q)
+{
+    /* reserve whole pages, as the pagecache writes back whole pages */
+    range blocks = range_rshift_pad(q, fs->blocksize_order);
+    blocks.start &= ~MASK(fs->page_order - fs->blocksize_order);
+    blocks.start = MAX(blocks.start, f->delalloc_end);
+    if (blocks.start >= blocks.end)
+        return STATUS_OK;
+    u64 nblocks = unallocated_blocks(f, blocks);
+    tfs_debug("%s: file %p blocks %R, reserve %ld (%ld reserved)\n", __func__,
+              f, blocks, nblocks, fs->delalloc_blocks);
+    if (fs_freeblocks(fs) < fs->delalloc_blocks + nblocks)
+        return timm("result", "unable to reserve storage", "fsstatus", "%d",
+                    FS_STATUS_NOSPACE);
+    fs->delalloc_blocks += nblocks;
+    f->delalloc_blocks += nblocks;
+    f->delalloc_end = blocks.end;
+    return STATUS_OK;
+}
+
+/* reserved blocks that would be consumed by allocating storage for a range */
+static u64 delalloc_reserved_blocks(fsfile f, range blocks)
+{
+    if (f->delalloc_blocks == 0)
+        return 0;
+    blocks = range_intersection(blocks, irange(0, f->delalloc_end));
+    if (range_empty(blocks))
+        return 0;
+    return MIN(unallocated_blocks(f, blocks), f->delalloc_blocks);
+}
+
+static void delalloc_release(fsfile f, u64 nblocks)
+{
+    f->delalloc_blocks -= nblocks;
+    f->fs->delalloc_blocks -= nblocks;
+}
+
+closure_function(2, 2, status, filesystem_check_or_reserve_extent,
                  filesystem, fs, fsfile, f,
-                 range, q)
+                 range, q, boolean, delalloc)
 {
     filesystem fs = bound(fs);
     fsfile f = bound(f);
     assert(range_span(q) > 0);
+    if (delalloc)
+        return delalloc_reserve(fs, f, q);
     range blocks = range_rshift_pad(q, fs->blocksize_order);
     tfs_debug("%s: file %p range %R blocks %R\n", __func__, f, q, blocks);
 
-    return extents_range_handler(fs, f, blocks, 0, 0);
+    u64 reserved = delalloc_reserved_blocks(f, blocks);
+    status s = extents_range_handler(fs, f, blocks, 0, 0);
+    if (s == STATUS_OK)
+        delalloc_release(f, reserved);
+    return s;
+}
+
+static fs_status write_file_length(filesystem fs, fsfile f, u64 len)
+{
+    value v = value_from_u64(fs->h, len);
+    if (v == INVALID_ADDRESS)
+        return FS_STATUS_NOMEM;
+    symbol l = sym(filelength);
+    fs_status s = filesystem_write_eav(fs, f->md, l, v);
+    if (s == FS_STATUS_OK)
+        set(f->md, l, v);
+    return s;
 }
 
 closure_function(2, 3, void, filesystem_storage_write,
@@ -767,17 +842,21 @@ closure_function(2, 3, void, filesystem_storage_write,
     merge m = allocate_merge(fs->h, complete);
     status_handler sh = apply_merge(m);
 
+    u64 reserved = sg ? delalloc_reserved_blocks(f, blocks) : 0;
     status s = extents_range_handler(fs, f, blocks, sg, m);
     if (s != STATUS_OK)
         goto out;
-    if (fsfile_get_length(f) < q.end) {
+    delalloc_release(f, reserved);
+    if (f->length < q.end) {
         tfs_debug("   append; update length to %ld\n", q.end);
-        fs_status fss = filesystem_truncate(fs, f, q.end);
+        /* the node length already includes any data still pending allocation */
+        fs_status fss = write_file_length(fs, f, q.end);
         if (fss != FS_STATUS_OK) {
             s = timm("result", "unable to set file length", "fsstatus", "%d",
                 fss);
             goto out;
         }
+        f->length = q.end;
     }
   out:
     apply(sh, s);
@@ -813,15 +892,16 @@ KLIB_EXPORT(filesystem_write_linear);
 
 fs_status filesystem_truncate(filesystem fs, fsfile f, u64 len)
 {
-    value v = value_from_u64(fs->h, len);
-    if (v == INVALID_ADDRESS)
-        return FS_STATUS_NOMEM;
-    symbol l = sym(filelength);
-    fs_status s = filesystem_write_eav(fs, f->md, l, v);
-    if (s == FS_STATUS_OK) {
-        set(f->md, l, v);
-        fsfile_set_length(f, len);
+    if (f->delalloc_blocks && len < fsfile_get_length(f)) {
+        /* data pending allocation past the new end would not be written
+           back; commit it now, then drop the remaining reservation */
+        pagecache_commit_dirty_node(f->cache_node);
+        delalloc_release(f, f->delalloc_blocks);
+        f->delalloc_end = 0;
     }
+    fs_status s = write_file_length(fs, f, len);
+    if (s == FS_STATUS_OK)
+        fsfile_set_length(f, len);
     return s;
 }
 
@@ -841,8 +921,15 @@ closure_function(3, 1, void, log_flush_completed,
     }
 }
 
-void filesystem_flush(filesystem fs, status_handler completion)
+/* pn is the node being synced, or 0 for the whole filesystem */
+void filesystem_flush(filesystem fs, pagecache_node pn, status_handler completion)
 {
+    /* allocate storage for delayed writes so that their log records
+       are included in this flush */
+    if (pn)
+        pagecache_commit_dirty_node(pn);
+    else
+        pagecache_commit_dirty_volume(fs->pv);
     log_flush(fs->tl, closure(fs->h, log_flush_completed, fs, completion, false));
 }
 
@@ -899,6 +986,7 @@ void filesystem_alloc(filesystem fs, tuple t, long offset, long len,
     rangemap new_rm = allocate_rangemap(fs->h);
     assert(new_rm != INVALID_ADDRESS);
     fs_status status = FS_STATUS_OK;
+    u64 reserved = delalloc_reserved_blocks(f, blocks);
 
     u64 lastedge = blocks.start;
     rmnode curr = rangemap_first_node(f->extentmap);
@@ -925,6 +1013,7 @@ void filesystem_alloc(filesystem fs, tuple t, long offset, long len,
     status = add_extents_to_file(f, new_rm);
     if (status != FS_STATUS_OK)
         goto done;
+    delalloc_release(f, reserved);
     u64 end = offset + len;
     if (!keep_size && (end > fsfile_get_length(f))) {
         status = filesystem_truncate(fs, f, end);
@@ -1252,6 +1341,8 @@ fsfile allocate_fsfile(filesystem fs, tuple md)
     f->fs = fs;
     f->md = md;
     f->length = 0;
+    f->delalloc_blocks = 0;
+    f->delalloc_end = 0;
     table_set(fs->files, f->md, f);
     f->cache_node = pn;
     f->read = pagecache_node_get_reader(pn);
@@ -1297,6 +1388,11 @@ void filesystem_get_uuid(filesystem fs, u8 *uuid)
     runtime_memcpy(uuid, fs->uuid, UUID_LEN);
 }
 
+void filesystem_get_log_stats(filesystem fs, u64 *total_entries, u64 *obsolete_entries)
+{
+    log_get_stats(fs->tl, total_entries, obsolete_entries);
+}
+
 boolean filesystem_reserve_log_space(filesystem fs, u64 *next_offset, u64 *offset, u64 size)
 {
     if (size == 0)
@@ -1358,6 +1454,7 @@ void create_filesystem(heap h,
     }
     fs->next_extend_log_offset = INVALID_PHYSICAL;
     fs->next_new_log_offset = INVALID_PHYSICAL;
+    fs->delalloc_blocks = 0;
     fs->tl = log_create(h, fs, label != 0, closure(h, log_complete, complete, fs));
 }
 
@@ -1373,6 +1470,7 @@ closure_function(1, 1, void, dealloc_extent_node,
 void deallocate_fsfile(filesystem fs, fsfile f)
 {
     table_set(fs->files, f->md, 0);
+    fs->delalloc_blocks -= f->delalloc_blocks;
     deallocate_rangemap(f->extentmap, stack_closure(dealloc_extent_node, fs));
     pagecache_deallocate_node(f->cache_node);
     deallocate(fs->h, f, sizeof(*f));
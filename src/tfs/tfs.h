@@ -21,6 +21,7 @@ extern io_status_handler ignore_io_status;
 boolean filesystem_probe(u8 *first_sector, u8 *uuid, char *label);
 const char *filesystem_get_label(filesystem fs);
 void filesystem_get_uuid(filesystem fs, u8 *uuid);
+void filesystem_get_log_stats(filesystem fs, u64 *total_entries, u64 *obsolete_entries);
 
 void create_filesystem(heap h,
                        u64 blocksize,
@@ -44,7 +45,7 @@ void filesystem_write_sg(fsfile f, sg_list sg, range q, status_handler completio
 void filesystem_read_linear(fsfile f, void *dest, range q, io_status_handler completion);
 void filesystem_write_linear(fsfile f, void *src, range q, io_status_handler completion);
 
-void filesystem_flush(filesystem fs, status_handler completion);
+void filesystem_flush(filesystem fs, pagecache_node pn, status_handler completion);
 
 timestamp filesystem_get_atime(filesystem fs, tuple t);
 timestamp filesystem_get_mtime(filesystem fs, tuple t);
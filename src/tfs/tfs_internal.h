@@ -32,6 +32,7 @@ typedef struct filesystem {
     log temp_log;
     u64 next_extend_log_offset;
     u64 next_new_log_offset;
+    u64 delalloc_blocks;        /* reserved for writes pending allocation */
     tuple root;
 } *filesystem;
 
@@ -40,6 +41,8 @@ typedef struct fsfile {
     filesystem fs;
     pagecache_node cache_node;
     u64 length;
+    u64 delalloc_blocks;        /* reserved for writes pending allocation */
+    u64 delalloc_end;           /* end of reserved blocks */
     tuple md;
     sg_io read;
     sg_io write;
@@ -62,6 +65,7 @@ boolean log_write(log tl, tuple t);
 boolean log_write_eav(log tl, tuple e, symbol a, value v);
 void log_flush(log tl, status_handler completion);
 void log_destroy(log tl);
+void log_get_stats(log tl, u64 *total_entries, u64 *obsolete_entries);
 void flush(filesystem fs, status_handler);
 u64 filesystem_allocate_storage(filesystem fs, u64 nblocks);
 boolean filesystem_reserve_storage(filesystem fs, range storage_blocks);
@@ -949,6 +949,12 @@ log log_create(heap h, filesystem fs, boolean initialize, status_handler sh)
 #endif
 }
 
+void log_get_stats(log tl, u64 *total_entries, u64 *obsolete_entries)
+{
+    *total_entries = tl->total_entries;
+    *obsolete_entries = tl->obsolete_entries;
+}
+
 void log_destroy(log tl)
 {
     if (tl->flush_timer)
@@ -162,7 +162,7 @@ static void filesystem_sync_internal(filesystem fs, pagecache_node pn,
         apply(sh, timm("result", "cannot allocate closure"));
         return;
     }
-    filesystem_flush(fs, sync_complete);
+    filesystem_flush(fs, pn, sync_complete);
 }
 
 void filesystem_sync(filesystem fs, status_handler sh)
@@ -74,6 +74,13 @@ static int futex_wake_many(struct futex * f, int val)
     return nr_woken;
 }
 
+/* Wakes need no futex of their own: without one, there are no waiters. */
+static int futex_wake_uaddr(process p, int *uaddr, int val)
+{
+    struct futex *f = table_find(p->futices, (void *)uaddr);
+    return f ? futex_wake_many(f, val) : 0;
+}
+
 boolean futex_wake_many_by_uaddr(process p, int *uaddr, int val)
 {
     struct futex * f;
@@ -144,10 +151,6 @@ sysreturn futex(int *uaddr, int futex_op, int val,
     if (!validate_user_memory(uaddr, sizeof(int), false))
         return set_syscall_error(current, EFAULT);
 
-    f = soft_create_futex(current->p, u64_from_pointer(uaddr));
-    if (f == INVALID_ADDRESS)
-        return set_syscall_error(current, ENOMEM);
-    
     op = futex_op & 127; // chuck the private bit
     ts = get_timeout_timestamp(op, val2);
     clock_id clkid = (futex_op & FUTEX_CLOCK_REALTIME) ? CLOCK_ID_REALTIME :
@@ -162,6 +165,10 @@ sysreturn futex(int *uaddr, int futex_op, int val,
         if (*uaddr != val)
             return set_syscall_error(current, EAGAIN);
 
+        f = soft_create_futex(current->p, u64_from_pointer(uaddr));
+        if (f == INVALID_ADDRESS)
+            return set_syscall_error(current, ENOMEM);
+
         // if we resume we are woken up
         set_syscall_return(current, 0);
 
@@ -174,7 +181,7 @@ sysreturn futex(int *uaddr, int futex_op, int val,
         if (futex_verbose)
             thread_log(current, "futex_wake [%ld %p %d] %d",
                 current->tid, uaddr, *uaddr, val);
-        return set_syscall_return(current, futex_wake_many(f, val));
+        return set_syscall_return(current, futex_wake_uaddr(current->p, uaddr, val));
     }
 
     case FUTEX_CMP_REQUEUE: {
@@ -190,6 +197,9 @@ sysreturn futex(int *uaddr, int futex_op, int val,
         if (*uaddr != val3)
             return set_syscall_error(current, EAGAIN);
 
+        f = table_find(current->p->futices, uaddr);
+        if (!f)
+            return set_syscall_return(current, 0);
         woken = futex_wake_many(f, val);
 
         requeued = 0;
@@ -230,7 +240,7 @@ sysreturn futex(int *uaddr, int futex_op, int val,
         case FUTEX_OP_XOR:   *uaddr2 ^= oparg; break;
         }
 
-        wake1 = futex_wake_many(f, val);
+        wake1 = futex_wake_uaddr(current->p, uaddr, val);
         
         c = 0;
         switch (cmp) {
@@ -243,14 +253,8 @@ sysreturn futex(int *uaddr, int futex_op, int val,
         }
         
         wake2 = 0;
-        if (c) {
-            struct futex * f2 = 
-                soft_create_futex(current->p, u64_from_pointer(uaddr2));
-            if (f2 == INVALID_ADDRESS)
-                return set_syscall_error(current, ENOMEM);
-
-            wake2 = futex_wake_many(f2, val2);
-        }
+        if (c)
+            wake2 = futex_wake_uaddr(current->p, uaddr2, val2);
 
         return set_syscall_return(current, wake1 + wake2);
     }
@@ -263,6 +267,10 @@ sysreturn futex(int *uaddr, int futex_op, int val,
         if (*uaddr != val)
             return set_syscall_error(current, EAGAIN);
 
+        f = soft_create_futex(current->p, u64_from_pointer(uaddr));
+        if (f == INVALID_ADDRESS)
+            return set_syscall_error(current, ENOMEM);
+
         set_syscall_return(current, 0);
         return blockq_check_timeout(f->bq, current, 
                                     closure(f->h, futex_bh, f, current, false, ts),
@@ -34,6 +34,9 @@ static struct {
     struct list pf_freelist;
 
     kernel_context faulting_kernel_context;
+
+    struct spinlock pin_lock;
+    table pinned;
 } mmap_info;
 
 define_closure_function(0, 2, int, pending_fault_compare,
@@ -839,9 +842,89 @@ static void vmap_return_virtual(process p, vmap k)
         id_heap_set_area(v->h, r.start, range_span(r), false, false);
 }
 
+/* Pinned pages
+
+   Pages of user memory may be referenced by the kernel beyond the syscall
+   that was given them, e.g. by zero-copy socket sends, which hand the
+   physical pages to the network stack through the linear mapping. Such
+   pages are pinned; unmapping a pinned page defers its release until the
+   last pin is dropped. */
+
+/* table values: pin count scaled by PIN_COUNT, plus PIN_UNMAPPED */
+#define PIN_UNMAPPED    1
+#define PIN_COUNT       2
+
+static key pinned_page_key(void *p)
+{
+    return u64_from_pointer(p) >> PAGELOG;
+}
+
+/* Returns the physical page at vaddr, which the caller must have faulted
+   in, or INVALID_PHYSICAL if it is absent or not anonymous memory. */
+u64 pin_user_page(process p, u64 vaddr)
+{
+    u64 phys = INVALID_PHYSICAL;
+    vaddr &= ~MASK(PAGELOG);
+    vmap_lock(p);
+    vmap vm = vmap_from_vaddr_locked(p, vaddr);
+    if (vm != INVALID_ADDRESS &&
+        !(vm->flags & (VMAP_MMAP_TYPE_FILEBACKED | VMAP_MMAP_TYPE_IORING |
+                       VMAP_MMAP_TYPE_XDP))) {
+        phys = physical_from_virtual(pointer_from_u64(vaddr));
+        if (phys != INVALID_PHYSICAL) {
+            spin_lock(&mmap_info.pin_lock);
+            u64 v = u64_from_pointer(table_find(mmap_info.pinned, pointer_from_u64(phys)));
+            table_set(mmap_info.pinned, pointer_from_u64(phys), pointer_from_u64(v + PIN_COUNT));
+            spin_unlock(&mmap_info.pin_lock);
+        }
+    }
+    vmap_unlock(p);
+    return phys;
+}
+
+void unpin_phys_page(u64 phys)
+{
+    u64 flags = spin_lock_irq(&mmap_info.pin_lock);
+    u64 v = u64_from_pointer(table_find(mmap_info.pinned, pointer_from_u64(phys)));
+    assert(v >= PIN_COUNT);
+    v -= PIN_COUNT;
+    table_set(mmap_info.pinned, pointer_from_u64(phys),
+              v >= PIN_COUNT ? pointer_from_u64(v) : 0);
+    spin_unlock_irq(&mmap_info.pin_lock, flags);
+    if (v == PIN_UNMAPPED)
+        deallocate_u64((heap)mmap_info.physical, phys, PAGESIZE);
+}
+
+/* Marks the pinned pages of an unmapped range, returning true if any. */
+static boolean unmap_pinned_pages(range r)
+{
+    if (table_elements(mmap_info.pinned) == 0)
+        return false;
+    boolean pinned = false;
+    for (u64 phys = r.start; phys < r.end; phys += PAGESIZE) {
+        u64 v = u64_from_pointer(table_find(mmap_info.pinned, pointer_from_u64(phys)));
+        if (v) {
+            table_set(mmap_info.pinned, pointer_from_u64(phys), pointer_from_u64(v | PIN_UNMAPPED));
+            pinned = true;
+        }
+    }
+    return pinned;
+}
+
 closure_function(1, 1, void, dealloc_phys_page,
                  id_heap, physical, range, r)
 {
+    u64 flags = spin_lock_irq(&mmap_info.pin_lock);
+    if (unmap_pinned_pages(r)) {
+        /* release all but the pinned pages */
+        for (u64 phys = r.start; phys < r.end; phys += PAGESIZE) {
+            if (!table_find(mmap_info.pinned, pointer_from_u64(phys)))
+                id_heap_set_area(bound(physical), phys, PAGESIZE, true, false);
+        }
+        spin_unlock_irq(&mmap_info.pin_lock, flags);
+        return;
+    }
+    spin_unlock_irq(&mmap_info.pin_lock, flags);
     if (!id_heap_set_area(bound(physical), r.start, range_span(r), true, false))
         msg_err("some of physical range %R not allocated in heap\n", r);
 }
@@ -859,6 +942,7 @@ static void vmap_unmap_page_range(process p, vmap k)
         pagecache_node_unmap_pages(k->cache_node, r, k->node_offset);
         break;
     case VMAP_MMAP_TYPE_IORING:
+    case VMAP_MMAP_TYPE_XDP:
         unmap(r.start, len);
         break;
     }
@@ -1095,6 +1179,10 @@ static sysreturn mmap(void *addr, u64 length, int prot, int flags, int fd, u64 o
             vmap_mmap_type = VMAP_MMAP_TYPE_IORING;
             allowed_flags = VMAP_FLAG_WRITABLE | VMAP_FLAG_READABLE;
             break;
+        case FDESC_TYPE_SOCKET:
+            vmap_mmap_type = VMAP_MMAP_TYPE_XDP;
+            allowed_flags = VMAP_FLAG_WRITABLE | VMAP_FLAG_READABLE;
+            break;
         default:
             thread_log(current, "   fail: attempt to mmap file of invalid type %d", desc->type);
             return -EINVAL;
@@ -1142,6 +1230,18 @@ static sysreturn mmap(void *addr, u64 length, int prot, int flags, int fd, u64 o
                vmap_paint(mmap_info.h, p, (u64)ret, len, vmflags, allowed_flags, 0, 0);
         }
         break;
+    case VMAP_MMAP_TYPE_XDP:
+        thread_log(current, "   fd %d: xdp", fd);
+        if (fixed)
+            ret = -ENOMEM;
+        else {
+            vmflags |= VMAP_FLAG_PREALLOC;
+            ret = xdp_mmap(desc, len, pageflags_from_vmflags(vmflags), offset);
+            thread_log(current, "   xdp_mmap returned 0x%lx", ret);
+            if (ret > 0)
+               vmap_paint(mmap_info.h, p, (u64)ret, len, vmflags, allowed_flags, 0, 0);
+        }
+        break;
     case VMAP_MMAP_TYPE_FILEBACKED:
         thread_log(current, "   fd %d: file-backed (regular)", fd);
         file f = (file)desc;
@@ -1293,6 +1393,9 @@ void mmap_process_init(process p, boolean aslr)
                 init_closure(&mmap_info.pf_compare, pending_fault_compare),
                 init_closure(&mmap_info.pf_print, pending_fault_print));
     list_init(&mmap_info.pf_freelist);
+    spin_lock_init(&mmap_info.pin_lock);
+    mmap_info.pinned = allocate_table(h, pinned_page_key, pointer_equal);
+    assert(mmap_info.pinned != INVALID_ADDRESS);
 }
 
 void register_mmap_syscalls(struct syscall *map)
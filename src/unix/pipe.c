@@ -138,11 +138,9 @@ closure_function(1, 2, sysreturn, pipe_close,
     return io_complete(completion, t, 0);
 }
 
-closure_function(5, 1, sysreturn, pipe_read_bh,
-                 pipe_file, pf, thread, t, void *, dest, u64, length, io_completion, completion,
-                 u64, flags)
+static sysreturn pipe_read_bh_internal(pipe_file pf, thread t, void *dest, u64 length,
+                                       io_completion completion, u64 flags)
 {
-    pipe_file pf = bound(pf);
     int rv;
 
     if (flags & BLOCKQ_ACTION_NULLIFY) {
@@ -151,7 +149,7 @@ closure_function(5, 1, sysreturn, pipe_read_bh,
     }
 
     buffer b = pf->pipe->data;
-    rv = MIN(buffer_length(b), bound(length));
+    rv = MIN(buffer_length(b), length);
     if (rv == 0) {
         if (pf->pipe->files[PIPE_WRITE].fd == -1)
             goto out;
@@ -162,7 +160,7 @@ closure_function(5, 1, sysreturn, pipe_read_bh,
         return BLOCKQ_BLOCK_REQUIRED;
     }
 
-    buffer_read(b, bound(dest), rv);
+    buffer_read(b, dest, rv);
     pipe_notify_writer(pf, EPOLLOUT);
 
     // If we have consumed all of the buffer, reset it. This might prevent future writes to allocte new buffer
@@ -172,8 +170,18 @@ closure_function(5, 1, sysreturn, pipe_read_bh,
         notify_dispatch(pf->f.ns, 0); /* for edge trigger */
     }
   out:
-    blockq_handle_completion(pf->bq, flags, bound(completion), bound(t), rv);
-    closure_finish();
+    blockq_handle_completion(pf->bq, flags, completion, t, rv);
+    return rv;
+}
+
+closure_function(5, 1, sysreturn, pipe_read_bh,
+                 pipe_file, pf, thread, t, void *, dest, u64, length, io_completion, completion,
+                 u64, flags)
+{
+    sysreturn rv = pipe_read_bh_internal(bound(pf), bound(t), bound(dest), bound(length),
+                                         bound(completion), flags);
+    if (rv != BLOCKQ_BLOCK_REQUIRED)
+        closure_finish();
     return rv;
 }
 
@@ -186,24 +194,25 @@ closure_function(1, 6, sysreturn, pipe_read,
     if (length == 0)
         return io_complete(completion, t, 0);
 
+    /* an action is only needed to block with */
+    sysreturn rv = pipe_read_bh_internal(pf, t, dest, length, completion, 0);
+    if (rv != BLOCKQ_BLOCK_REQUIRED)
+        return rv;
     blockq_action ba = closure(pf->pipe->h, pipe_read_bh, pf, t, dest, length,
                                completion);
     return blockq_check(pf->bq, t, ba, bh);
 }
 
-closure_function(5, 1, sysreturn, pipe_write_bh,
-                 pipe_file, pf, thread, t, void *, dest, u64, length, io_completion, completion,
-                 u64, flags)
+static sysreturn pipe_write_bh_internal(pipe_file pf, thread t, void *dest, u64 length,
+                                        io_completion completion, u64 flags)
 {
     sysreturn rv = 0;
-    pipe_file pf = bound(pf);
 
     if (flags & BLOCKQ_ACTION_NULLIFY) {
         rv = -ERESTARTSYS;
         goto out;
     }
 
-    u64 length = bound(length);
     pipe p = pf->pipe;
     buffer b = p->data;
     u64 avail = p->max_size - buffer_length(b);
@@ -221,7 +230,7 @@ closure_function(5, 1, sysreturn, pipe_write_bh,
     }
 
     u64 real_length = MIN(length, avail);
-    assert(buffer_write(b, bound(dest), real_length));
+    assert(buffer_write(b, dest, real_length));
     if (avail == length)
         notify_dispatch(pf->f.ns, 0); /* for edge trigger */
 
@@ -229,8 +238,18 @@ closure_function(5, 1, sysreturn, pipe_write_bh,
 
     rv = real_length;
   out:
-    blockq_handle_completion(pf->bq, flags, bound(completion), bound(t), rv);
-    closure_finish();
+    blockq_handle_completion(pf->bq, flags, completion, t, rv);
+    return rv;
+}
+
+closure_function(5, 1, sysreturn, pipe_write_bh,
+                 pipe_file, pf, thread, t, void *, dest, u64, length, io_completion, completion,
+                 u64, flags)
+{
+    sysreturn rv = pipe_write_bh_internal(bound(pf), bound(t), bound(dest), bound(length),
+                                          bound(completion), flags);
+    if (rv != BLOCKQ_BLOCK_REQUIRED)
+        closure_finish();
     return rv;
 }
 
@@ -242,6 +261,9 @@ closure_function(1, 6, sysreturn, pipe_write,
         return io_complete(completion, t, 0);
 
     pipe_file pf = bound(pf);
+    sysreturn rv = pipe_write_bh_internal(pf, t, dest, length, completion, 0);
+    if (rv != BLOCKQ_BLOCK_REQUIRED)
+        return rv;
     blockq_action ba = closure(pf->pipe->h, pipe_write_bh, pf, t, dest, length,
             completion);
     return blockq_check(pf->bq, t, ba, bh);
@@ -121,14 +121,10 @@ static inline void unixsock_notify_writer(unixsock s)
     fdesc_notify_events(&s->sock.f);
 }
 
-closure_function(8, 1, sysreturn, unixsock_read_bh,
-                 unixsock, s, thread, t, void *, dest, sg_list, sg, u64, length, io_completion, completion, struct sockaddr_un *, from_addr, socklen_t *, from_length,
-                 u64, flags)
+static sysreturn unixsock_read_bh_internal(unixsock s, thread t, void *dest, sg_list sg, u64 length,
+                                           io_completion completion, struct sockaddr_un *from_addr,
+                                           socklen_t *from_length, u64 flags)
 {
-    unixsock s = bound(s);
-    void *dest = bound(dest);
-    u64 length = bound(length);
-
     sharedbuf shb;
     sysreturn rv;
 
@@ -155,7 +151,7 @@ closure_function(8, 1, sysreturn, unixsock_read_bh,
             buffer_read(b, dest, xfer);
             dest = (u8 *)dest + xfer;
         } else if (xfer > 0) {
-            sg_buf sgb = sg_list_tail_add(bound(sg), xfer);
+            sg_buf sgb = sg_list_tail_add(sg, xfer);
             if (!sgb)
                 break;
             sharedbuf_reserve(shb);
@@ -170,8 +166,6 @@ closure_function(8, 1, sysreturn, unixsock_read_bh,
         if (!buffer_length(b) || (s->sock.type == SOCK_DGRAM)) {
             assert(dequeue(s->data) == shb);
             if (s->sock.type == SOCK_DGRAM) {
-                struct sockaddr_un *from_addr = bound(from_addr);
-                socklen_t *from_length = bound(from_length);
                 if (from_addr && from_length) {
                     runtime_memcpy(from_addr, &shb->from_addr, MIN(*from_length, sizeof(shb->from_addr)));
                     *from_length = __builtin_offsetof(struct sockaddr_un, sun_path) + runtime_strlen(from_addr->sun_path) + 1;
@@ -189,9 +183,18 @@ closure_function(8, 1, sysreturn, unixsock_read_bh,
         unixsock_notify_writer(s->peer);
     }
 out:
-    blockq_handle_completion(s->sock.rxbq, flags, bound(completion), bound(t),
-            rv);
-    closure_finish();
+    blockq_handle_completion(s->sock.rxbq, flags, completion, t, rv);
+    return rv;
+}
+
+closure_function(8, 1, sysreturn, unixsock_read_bh,
+                 unixsock, s, thread, t, void *, dest, sg_list, sg, u64, length, io_completion, completion, struct sockaddr_un *, from_addr, socklen_t *, from_length,
+                 u64, flags)
+{
+    sysreturn rv = unixsock_read_bh_internal(bound(s), bound(t), bound(dest), bound(sg), bound(length),
+        bound(completion), bound(from_addr), bound(from_length), flags);
+    if (rv != BLOCKQ_BLOCK_REQUIRED)
+        closure_finish();
     return rv;
 }
 
@@ -200,6 +203,10 @@ static sysreturn unixsock_read_with_addr(unixsock s, void *dest, u64 length, u64
     if ((s->sock.type == SOCK_STREAM) && (length == 0))
         return io_complete(completion, t, 0);
 
+    /* an action is only needed to block with */
+    sysreturn rv = unixsock_read_bh_internal(s, t, dest, 0, length, completion, addr, addrlen, 0);
+    if (rv != BLOCKQ_BLOCK_REQUIRED)
+        return rv;
     blockq_action ba = closure(s->sock.h, unixsock_read_bh, s, t, dest, 0, length,
             completion, addr, addrlen);
     return blockq_check(s->sock.rxbq, t, ba, bh);
@@ -275,15 +282,11 @@ static int lookup_socket(unixsock *s, char *path)
     return 0;
 }
 
-closure_function(8, 1, sysreturn, unixsock_write_bh,
-                 unixsock, s, thread, t, void *, src, sg_list, sg, u64, length, io_completion, completion, struct sockaddr_un *, addr, socklen_t, addrlen,
-                 u64, flags)
+static sysreturn unixsock_write_bh_internal(unixsock s, thread t, void *src, sg_list sg, u64 length,
+                                            io_completion completion, struct sockaddr_un *addr,
+                                            socklen_t addrlen, u64 flags)
 {
-    unixsock s = bound(s);
-    void *src = bound(src);
-    u64 length = bound(length);
     unixsock dest;
-
     sysreturn rv;
 
     if ((flags & BLOCKQ_ACTION_NULLIFY) && (s->peer || s->sock.type == SOCK_DGRAM)) {
@@ -298,9 +301,8 @@ closure_function(8, 1, sysreturn, unixsock_write_bh,
     }
     dest = s->peer;
     if (s->sock.type == SOCK_DGRAM) {
-        struct sockaddr_un *addr = bound(addr);
-        if (addr && bound(addrlen)) {
-            if (bound(addrlen) < sizeof(struct sockaddr_un) ||
+        if (addr && addrlen) {
+            if (addrlen < sizeof(struct sockaddr_un) ||
                 addr->sun_family != AF_UNIX) {
                 rv = -EINVAL;
                 goto out;
@@ -317,7 +319,7 @@ closure_function(8, 1, sysreturn, unixsock_write_bh,
         }
     }
 
-    rv = unixsock_write_to(src, bound(sg), length, dest, s);
+    rv = unixsock_write_to(src, sg, length, dest, s);
     if ((rv == -EAGAIN) && !(s->sock.f.flags & SOCK_NONBLOCK)) {
         return BLOCKQ_BLOCK_REQUIRED;
     }
@@ -325,9 +327,18 @@ closure_function(8, 1, sysreturn, unixsock_write_bh,
         fdesc_notify_events(&s->sock.f);
     }
 out:
-    blockq_handle_completion(s->sock.txbq, flags, bound(completion), bound(t),
-            rv);
-    closure_finish();
+    blockq_handle_completion(s->sock.txbq, flags, completion, t, rv);
+    return rv;
+}
+
+closure_function(8, 1, sysreturn, unixsock_write_bh,
+                 unixsock, s, thread, t, void *, src, sg_list, sg, u64, length, io_completion, completion, struct sockaddr_un *, addr, socklen_t, addrlen,
+                 u64, flags)
+{
+    sysreturn rv = unixsock_write_bh_internal(bound(s), bound(t), bound(src), bound(sg), bound(length),
+        bound(completion), bound(addr), bound(addrlen), flags);
+    if (rv != BLOCKQ_BLOCK_REQUIRED)
+        closure_finish();
     return rv;
 }
 
@@ -337,6 +348,9 @@ static sysreturn unixsock_write_with_addr(unixsock s, void *src, u64 length, u64
     if (rv <= 0)
         return io_complete(completion, t, rv);
 
+    rv = unixsock_write_bh_internal(s, t, src, 0, length, completion, addr, addrlen, 0);
+    if (rv != BLOCKQ_BLOCK_REQUIRED)
+        return rv;
     blockq_action ba = closure(s->sock.h, unixsock_write_bh, s, t, src, 0, length,
             completion, addr, addrlen);
     return blockq_check(s->sock.txbq, t, ba, bh);
@@ -354,6 +368,9 @@ closure_function(1, 6, sysreturn, unixsock_sg_read,
                  sg_list, sg, u64, length, u64, offset, thread, t, boolean, bh, io_completion, completion)
 {
     unixsock s = bound(s);
+    sysreturn rv = unixsock_read_bh_internal(s, t, 0, sg, length, completion, 0, 0, 0);
+    if (rv != BLOCKQ_BLOCK_REQUIRED)
+        return rv;
     blockq_action ba = closure(s->sock.h, unixsock_read_bh, s, t, 0, sg, length,
         completion, 0, 0);
     if (ba == INVALID_ADDRESS)
@@ -369,6 +386,9 @@ closure_function(1, 6, sysreturn, unixsock_sg_write,
     sysreturn rv = unixsock_write_check(s, length);
     if (rv <= 0)
         return io_complete(completion, t, rv);
+    rv = unixsock_write_bh_internal(s, t, 0, sg, length, completion, 0, 0, 0);
+    if (rv != BLOCKQ_BLOCK_REQUIRED)
+        return rv;
     blockq_action ba = closure(s->sock.h, unixsock_write_bh, s, t, 0, sg, length,
         completion, 0, 0);
     if (ba == INVALID_ADDRESS)
@@ -20,6 +20,29 @@ struct msghdr {
     int msg_flags;
 };
 
+struct cmsghdr {
+    u64 cmsg_len;
+    int cmsg_level;
+    int cmsg_type;
+};
+
+#define CMSG_ALIGN(len)     pad(len, sizeof(u64))
+#define CMSG_LEN(len)       (sizeof(struct cmsghdr) + (len))
+#define CMSG_SPACE(len)     (sizeof(struct cmsghdr) + CMSG_ALIGN(len))
+
+struct sock_extended_err {
+    u32 ee_errno;
+    u8 ee_origin;
+    u8 ee_type;
+    u8 ee_code;
+    u8 ee_pad;
+    u32 ee_info;
+    u32 ee_data;
+};
+
+#define SO_EE_ORIGIN_ZEROCOPY       5
+#define SO_EE_CODE_ZEROCOPY_COPIED  1
+
 #define IFNAMSIZ    16
 
 struct ifmap {
@@ -144,3 +167,9 @@ sysreturn unixsock_open(int type, int protocol);
 
 void netlink_init(void);
 sysreturn netlink_open(int type, int family);
+
+sysreturn xdp_open(int type, int protocol);
+sysreturn xdp_setsockopt(struct sock *sock, int level, int optname, void *optval,
+                         socklen_t optlen);
+sysreturn xdp_getsockopt(struct sock *sock, int level, int optname, void *optval,
+                         socklen_t *optlen);
@@ -96,10 +96,94 @@ static u32 cpu_online_events(file f)
     return (EPOLLIN | EPOLLOUT);
 }
 
+/* Only idle and steal time are accounted, in USER_HZ units; the other
+   columns of the cpu lines read as zero. */
+#define STAT_USER_HZ    100
+
+static u64 stat_ticks(timestamp t)
+{
+    return usec_from_timestamp(t) / (MILLION / STAT_USER_HZ);
+}
+
+static timestamp cpu_idle_time(cpuinfo ci)
+{
+    timestamp t = ci->idle_stats.residency;
+    timestamp start = *(volatile timestamp *)&ci->idle_start;
+    if (start) {
+        timestamp here = now(CLOCK_ID_MONOTONIC_RAW);
+        if (here > start)
+            t += here - start;
+    }
+    return t;
+}
+
+static sysreturn stat_read(file f, void *dest, u64 length, u64 offset)
+{
+    heap h = heap_general(get_kernel_heaps());
+    buffer b = allocate_buffer(h, 64 * (total_processors + 1));
+    if (b == INVALID_ADDRESS)
+        return -ENOMEM;
+    timestamp idle = 0, steal = 0;
+    for (int i = 0; i < total_processors; i++) {
+        idle += cpu_idle_time(cpuinfo_from_id(i));
+        steal += cpu_steal_time(cpuinfo_from_id(i));
+    }
+    bprintf(b, "cpu  0 0 0 %ld 0 0 0 %ld 0 0\n", stat_ticks(idle), stat_ticks(steal));
+    for (int i = 0; i < total_processors; i++) {
+        cpuinfo ci = cpuinfo_from_id(i);
+        bprintf(b, "cpu%d 0 0 0 %ld 0 0 0 %ld 0 0\n", i, stat_ticks(cpu_idle_time(ci)),
+                stat_ticks(cpu_steal_time(ci)));
+    }
+    if (offset >= buffer_length(b)) {
+        deallocate_buffer(b);
+        return 0;
+    }
+    length = MIN(length, buffer_length(b) - offset);
+    runtime_memcpy(dest, buffer_ref(b, offset), length);
+    deallocate_buffer(b);
+    return length;
+}
+
+static u32 stat_events(file f)
+{
+    return EPOLLIN;
+}
+
+/* Only the local timer interrupts are counted, in the LOC line. */
+static sysreturn interrupts_read(file f, void *dest, u64 length, u64 offset)
+{
+    heap h = heap_general(get_kernel_heaps());
+    buffer b = allocate_buffer(h, 24 * (total_processors + 2));
+    if (b == INVALID_ADDRESS)
+        return -ENOMEM;
+    bprintf(b, "    ");
+    for (int i = 0; i < total_processors; i++)
+        bprintf(b, "       CPU%-3d", i);
+    bprintf(b, "\nLOC:");
+    for (int i = 0; i < total_processors; i++)
+        bprintf(b, " %13ld", cpuinfo_from_id(i)->timer_interrupts);
+    bprintf(b, "   Local timer interrupts\n");
+    if (offset >= buffer_length(b)) {
+        deallocate_buffer(b);
+        return 0;
+    }
+    length = MIN(length, buffer_length(b) - offset);
+    runtime_memcpy(dest, buffer_ref(b, offset), length);
+    deallocate_buffer(b);
+    return length;
+}
+
+static u32 interrupts_events(file f)
+{
+    return EPOLLIN;
+}
+
 static special_file special_files[] = {
     { "/dev/urandom", .read = urandom_read, .write = 0, .events = urandom_events },
     { "/dev/null", .read = null_read, .write = null_write, .events = null_events },
     { "/proc/self/maps", .read = maps_read, .events = maps_events, },
+    { "/proc/stat", .read = stat_read, .events = stat_events, },
+    { "/proc/interrupts", .read = interrupts_read, .events = interrupts_events, },
     { "/sys/devices/system/cpu/online", .read = cpu_online_read, .write = null_write, .events = cpu_online_events },
     FTRACE_SPECIAL_FILES
 };
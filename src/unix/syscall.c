@@ -1551,6 +1551,13 @@ sysreturn getrlimit(int resource, struct rlimit *rlim)
     case RLIMIT_AS:
         rlim->rlim_cur = rlim->rlim_max = heap_total(current->p->virtual);
         return 0;
+    case RLIMIT_NICE:
+        /* as 20 - nice: any nice level may be set */
+        rlim->rlim_cur = rlim->rlim_max = 20 - SCHED_NICE_MIN;
+        return 0;
+    case RLIMIT_RTPRIO:
+        rlim->rlim_cur = rlim->rlim_max = SCHED_RT_PRIO_MAX;
+        return 0;
     }
 
     return set_syscall_error(current, EINVAL);
@@ -2102,9 +2109,16 @@ sysreturn sched_setaffinity(int pid, u64 cpusetsize, u64 *mask)
     if (!(t = lookup_thread(pid)))
             return set_syscall_error(current, EINVAL);                
     u64 cpus = pad(MIN(total_processors, 64 * (cpusetsize / sizeof(u64))), 64);
-    runtime_memcpy(bitmap_base(t->affinity), mask, cpus / 8);
+    /* the scheduler enforces the mask, so it must allow some cpu */
+    u64 cpu;
+    for (cpu = 0; cpu < MIN(cpus, total_processors); cpu++)
+        if (mask[cpu / 64] & U64_FROM_BIT(cpu & 63))
+            break;
+    if (cpu >= MIN(cpus, total_processors))
+        return set_syscall_error(current, EINVAL);
+    runtime_memcpy(bitmap_base(t->thrd.affinity), mask, cpus / 8);
     if (cpus < total_processors)
-        bitmap_range_check_and_set(t->affinity, cpus, total_processors - cpus, false, false);
+        bitmap_range_check_and_set(t->thrd.affinity, cpus, total_processors - cpus, false, false);
     return 0;
 }
 
@@ -2117,10 +2131,174 @@ sysreturn sched_getaffinity(int pid, u64 cpusetsize, u64 *mask)
         (64 * (cpusetsize / sizeof(u64)) < total_processors))
             return set_syscall_error(current, EINVAL);                    
     cpusetsize = pad(total_processors, 64) / 8;
-    runtime_memcpy(mask, bitmap_base(t->affinity), cpusetsize);
+    runtime_memcpy(mask, bitmap_base(t->thrd.affinity), cpusetsize);
     return cpusetsize;
 }
 
+static boolean sched_policy_valid(int policy)
+{
+    switch (policy) {
+    case SCHED_OTHER:
+    case SCHED_FIFO:
+    case SCHED_RR:
+    case SCHED_BATCH:
+    case SCHED_IDLE:
+        return true;
+    }
+    return false;
+}
+
+static inline boolean sched_policy_rt(int policy)
+{
+    return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+static sysreturn set_scheduler(thread t, int policy, struct sched_param *param)
+{
+    if (!validate_user_memory(param, sizeof(*param), false))
+        return set_syscall_error(current, EFAULT);
+    int prio = param->sched_priority;
+    if (sched_policy_rt(policy) ? (prio < 1 || prio > SCHED_RT_PRIO_MAX) : prio != 0)
+        return set_syscall_error(current, EINVAL);
+    thread_log(current, "%s: tid %d, policy %d, priority %d", __func__, t->tid, policy, prio);
+    sched_set_policy(&t->thrd, policy, prio);
+    return 0;
+}
+
+sysreturn sched_setscheduler(int pid, int policy, struct sched_param *param)
+{
+    thread t;
+    if (pid < 0 || !param)
+        return set_syscall_error(current, EINVAL);
+    if (!(t = lookup_thread(pid)))
+        return set_syscall_error(current, ESRCH);
+    /* there is no fork */
+    policy &= ~SCHED_RESET_ON_FORK;
+    if (!sched_policy_valid(policy))
+        return set_syscall_error(current, EINVAL);
+    return set_scheduler(t, policy, param);
+}
+
+sysreturn sched_getscheduler(int pid)
+{
+    thread t;
+    if (pid < 0)
+        return set_syscall_error(current, EINVAL);
+    if (!(t = lookup_thread(pid)))
+        return set_syscall_error(current, ESRCH);
+    return t->thrd.policy;
+}
+
+sysreturn sched_setparam(int pid, struct sched_param *param)
+{
+    thread t;
+    if (pid < 0 || !param)
+        return set_syscall_error(current, EINVAL);
+    if (!(t = lookup_thread(pid)))
+        return set_syscall_error(current, ESRCH);
+    return set_scheduler(t, t->thrd.policy, param);
+}
+
+sysreturn sched_getparam(int pid, struct sched_param *param)
+{
+    thread t;
+    if (pid < 0 || !param)
+        return set_syscall_error(current, EINVAL);
+    if (!validate_user_memory(param, sizeof(*param), true))
+        return set_syscall_error(current, EFAULT);
+    if (!(t = lookup_thread(pid)))
+        return set_syscall_error(current, ESRCH);
+    param->sched_priority = t->thrd.rt_priority;
+    return 0;
+}
+
+sysreturn sched_get_priority_max(int policy)
+{
+    if (!sched_policy_valid(policy))
+        return set_syscall_error(current, EINVAL);
+    return sched_policy_rt(policy) ? SCHED_RT_PRIO_MAX : 0;
+}
+
+sysreturn sched_get_priority_min(int policy)
+{
+    if (!sched_policy_valid(policy))
+        return set_syscall_error(current, EINVAL);
+    return sched_policy_rt(policy) ? 1 : 0;
+}
+
+sysreturn sched_rr_get_interval(int pid, struct timespec *tp)
+{
+    thread t;
+    if (pid < 0)
+        return set_syscall_error(current, EINVAL);
+    if (!validate_user_memory(tp, sizeof(*tp), true))
+        return set_syscall_error(current, EFAULT);
+    if (!(t = lookup_thread(pid)))
+        return set_syscall_error(current, ESRCH);
+    timespec_from_time(tp, sched_thread_timeslice(&t->thrd));
+    return 0;
+}
+
+/* Nice levels are per thread, as in Linux: PRIO_PROCESS takes a thread
+   id, while the (only) process group and user cover all threads. */
+closure_function(2, 1, boolean, thread_nice_handler,
+                 int, nice, int *, min,
+                 rbnode, n)
+{
+    nanos_thread nt = &struct_from_field(n, thread, n)->thrd;
+    if (bound(min))
+        *bound(min) = MIN(*bound(min), nt->nice);
+    else
+        sched_set_nice(nt, bound(nice));
+    return true;
+}
+
+/* sets nice of the threads selected, or if min is given, gets the lowest */
+static sysreturn thread_nice(int which, int who, int nice, int *min)
+{
+    switch (which) {
+    case PRIO_PROCESS: {
+        thread t;
+        if (who < 0 || !(t = lookup_thread(who)))
+            return set_syscall_error(current, ESRCH);
+        if (min)
+            *min = t->thrd.nice;
+        else
+            sched_set_nice(&t->thrd, nice);
+        return 0;
+    }
+    case PRIO_PGRP:
+        if (who != 0 && who != current->p->pid)
+            return set_syscall_error(current, ESRCH);
+        break;
+    case PRIO_USER:
+        if (who != 0)
+            return set_syscall_error(current, ESRCH);
+        break;
+    default:
+        return set_syscall_error(current, EINVAL);
+    }
+    process p = current->p;
+    spin_lock(&p->threads_lock);
+    rbtree_traverse(p->threads, RB_INORDER, stack_closure(thread_nice_handler, nice, min));
+    spin_unlock(&p->threads_lock);
+    return 0;
+}
+
+sysreturn setpriority(int which, int who, int prio)
+{
+    thread_log(current, "%s: which %d, who %d, prio %d", __func__, which, who, prio);
+    return thread_nice(which, who, prio, 0);
+}
+
+/* returns 20 - nice, as the system call does */
+sysreturn getpriority(int which, int who)
+{
+    int nice = SCHED_NICE_MAX;
+    sysreturn rv = thread_nice(which, who, 0, &nice);
+    return rv ? rv : 20 - nice;
+}
+
 sysreturn capget(cap_user_header_t hdrp, cap_user_data_t datap)
 {
     if (datap) {
@@ -2265,6 +2443,15 @@ void register_file_syscalls(struct syscall *map)
     register_syscall(map, fchdir, fchdir);
     register_syscall(map, sched_getaffinity, sched_getaffinity);
     register_syscall(map, sched_setaffinity, sched_setaffinity);
+    register_syscall(map, sched_setscheduler, sched_setscheduler);
+    register_syscall(map, sched_getscheduler, sched_getscheduler);
+    register_syscall(map, sched_setparam, sched_setparam);
+    register_syscall(map, sched_getparam, sched_getparam);
+    register_syscall(map, sched_get_priority_max, sched_get_priority_max);
+    register_syscall(map, sched_get_priority_min, sched_get_priority_min);
+    register_syscall(map, sched_rr_get_interval, sched_rr_get_interval);
+    register_syscall(map, setpriority, setpriority);
+    register_syscall(map, getpriority, getpriority);
     register_syscall(map, getuid, syscall_ignore);
     register_syscall(map, geteuid, syscall_ignore);
     register_syscall(map, setgroups, syscall_ignore);
@@ -2336,6 +2523,7 @@ void syscall_debug(context f)
         t->syscall_enter_ts = now(CLOCK_ID_MONOTONIC_RAW);
     }
     struct syscall *s = t->p->syscalls + call;
+    trace_event(syscall_enter, call, arg0, f[SYSCALL_FRAME_ARG1]);
     if (debugsyscalls) {
         if (s->name)
             thread_log(t, s->name);
@@ -2350,6 +2538,8 @@ void syscall_debug(context f)
         sysreturn rv = h(arg0, f[SYSCALL_FRAME_ARG1], f[SYSCALL_FRAME_ARG2],
                          f[SYSCALL_FRAME_ARG3], f[SYSCALL_FRAME_ARG4], f[SYSCALL_FRAME_ARG5]);
         set_syscall_return(t, rv);
+        if (!t->syscall_complete)
+            trace_event(syscall_exit, call, rv, 0);
         if (do_syscall_stats)
             count_syscall(t, rv);
         if (debugsyscalls)
@@ -2363,8 +2553,8 @@ void syscall_debug(context f)
     if (do_syscall_stats)
         count_syscall(t, 0);
     t->syscall = -1;
-    // i dont know that we actually want to defer the syscall return...its just easier for the moment to hew
-    // to the general model and make exceptions later
+    /* back to user right away if nothing else is to run here */
+    sched_direct_return(f);
     schedule_frame(f);
   out:
     kern_unlock();
@@ -2456,6 +2646,10 @@ closure_function(0, 2, void, print_syscall_stats_cfn,
             ROUNDED_IDIV(ss->usecs, ss->calls), ss->calls, ss->errors, _linux_syscalls[ss - stats].name);
     }
     rprintf(SEPARATOR SUM_FMT, "100.00", print_usecs(tbuf, tot_usecs), 0, tot_calls, tot_errs, "total");
+    u64 direct_returns = 0;
+    for (int i = 0; i < total_processors; i++)
+        direct_returns += cpuinfo_from_id(i)->direct_returns;
+    rprintf("%ld syscalls returned directly to user\n", direct_returns);
     deallocate_pqueue(pq);
 }
 
@@ -71,6 +71,8 @@ typedef struct iovec {
 #define EDESTADDRREQ    89		/* Destination address required */
 #define EMSGSIZE        90		/* Message too long */
 #define EOPNOTSUPP      95		/* Operation not supported */
+#define ENETDOWN        100		/* Network is down */
+#define ENOBUFS         105		/* No buffer space available */
 #define EISCONN         106
 #define ENOTCONN        107
 #define ETIMEDOUT       110             /* Connection timed out */
@@ -284,6 +286,16 @@ struct rlimit {
 #define RLIMIT_RTPRIO		14	/* maximum realtime priority */
 #define RLIMIT_RTTIME		15	/* timeout for RT tasks in us */
 
+#define PRIO_PROCESS    0
+#define PRIO_PGRP       1
+#define PRIO_USER       2
+
+#define SCHED_RESET_ON_FORK     0x40000000
+
+struct sched_param {
+    int sched_priority;
+};
+
 #define RUSAGE_SELF     0
 #define RUSAGE_CHILDREN (-1)
 #define RUSAGE_BOTH     (-2)
@@ -723,8 +735,11 @@ struct io_uring_params {
 };
 
 /* Socket option levels */
+#define SOL_IP          0
 #define SOL_SOCKET      1
+#define IPPROTO_TCP     6
 #define IPPROTO_IPV6    41
+#define SOL_XDP         283
 
 /* set/getsockopt optnames */
 #define SO_DEBUG        1
@@ -736,6 +751,10 @@ struct io_uring_params {
 #define SO_PRIORITY     12
 #define SO_LINGER       13
 #define SO_ACCEPTCONN   30
+#define SO_ZEROCOPY     60
+
+#define IP_RECVERR      11
+#define IPV6_RECVERR    25
 
 #define IPV6_V6ONLY     26
 
@@ -21,7 +21,8 @@ sysreturn set_tid_address(int *a)
 sysreturn arch_prctl(int code, unsigned long addr)
 {    
     thread_log(current, "arch_prctl: code 0x%x, addr 0x%lx", code, addr);
-    if ((code == ARCH_GET_FS || code == ARCH_GET_GS) &&
+    if ((code == ARCH_GET_FS || code == ARCH_GET_GS ||
+         code == ARCH_GET_XCOMP_SUPP || code == ARCH_GET_XCOMP_PERM) &&
         !validate_user_memory((void *)addr, sizeof(u64), true))
         return set_syscall_error(current, EFAULT);
 
@@ -43,6 +44,16 @@ sysreturn arch_prctl(int code, unsigned long addr)
     case ARCH_GET_GS:
 	*(u64 *) addr = current->default_frame[FRAME_GSBASE];
         break;
+    /* all the enabled state components, AMX included, are always
+       permitted */
+    case ARCH_GET_XCOMP_SUPP:
+    case ARCH_GET_XCOMP_PERM:
+        *(u64 *) addr = xsave_xcr0;
+        break;
+    case ARCH_REQ_XCOMP_PERM:
+        if (addr >= 64 || !(xsave_xcr0 & U64_FROM_BIT(addr)))
+            return set_syscall_error(current, EINVAL);
+        break;
     default:
         return set_syscall_error(current, EINVAL);
     }
@@ -75,6 +86,9 @@ sysreturn clone(unsigned long flags, void *child_stack, int *ptid, unsigned long
         return set_syscall_error(current, EFAULT);
 
     thread t = create_thread(current->p);
+    bitmap_copy(t->thrd.affinity, current->thrd.affinity);
+    sched_set_policy(&t->thrd, current->thrd.policy, current->thrd.rt_priority);
+    sched_set_nice(&t->thrd, current->thrd.nice);
     /* clone frame processor state */
     clone_frame_pstate(t->default_frame, current->default_frame);
     thread_clone_sigmask(t, current);
@@ -159,6 +173,7 @@ static inline void run_thread_frame(thread t)
     thread old = current;
     thread_enter_user(t);
     ftrace_thread_switch(old, t);    /* ftrace needs to know about the switch event */
+    trace_event(context_switch, t->tid, old, t);
 
     /* cover wake-before-sleep situations (e.g. sched yield, fs ops that don't go to disk, etc.) */
     t->blocked_on = 0;
@@ -171,7 +186,7 @@ static inline void run_thread_frame(thread t)
     thread_frame_restore_tls(f);
     thread_frame_restore_fpsimd(f);
     frame_enable_interrupts(f);
-    f[FRAME_QUEUE] = u64_from_pointer(ci->thread_queue);
+    f[FRAME_CPU] = ci->id;
 
     thread_log(t, "run %s, cpu %d, frame %p, pc 0x%lx, sp 0x%lx, rv 0x%lx",
                f == t->sighandler_frame ? "sig handler" : "thread",
@@ -206,7 +221,7 @@ define_closure_function(1, 0, void, run_sighandler,
 static void setup_thread_frame(heap h, context frame, thread t)
 {
     frame[FRAME_FAULT_HANDLER] = u64_from_pointer(&t->fault_handler);
-    frame[FRAME_QUEUE] = u64_from_pointer(current_cpu()->thread_queue);
+    frame[FRAME_CPU] = current_cpu()->id;
 #ifdef __x86_64__
     frame[FRAME_IS_SYSCALL] = 1;
     frame[FRAME_CS] = 0x2b; // where is this defined?
@@ -247,6 +262,7 @@ void thread_yield(void)
     assert(!current->blocked_on);
     current->syscall = -1;
     set_syscall_return(current, 0);
+    current->thrd.yielding = true;
     schedule_frame(thread_frame(current));
     kern_unlock();
     runloop();
@@ -281,7 +297,9 @@ boolean thread_attempt_interrupt(thread t)
 define_closure_function(1, 0, void, free_thread,
                         thread, t)
 {
-    deallocate_bitmap(bound(t)->affinity);
+    deallocate_bitmap(bound(t)->thrd.affinity);
+    if (bound(t)->mgmt)
+        destruct_tuple(bound(t)->mgmt, true);
     deallocate(heap_general(get_kernel_heaps()), bound(t), sizeof(struct thread));
 }
 
@@ -336,10 +354,15 @@ thread create_thread(process p)
     t->sighandler_frame[FRAME_RUN] = u64_from_pointer(init_closure(&t->run_sighandler, run_sighandler, t));
 
     t->thrd.pause = init_closure(&t->pause_thread, pause_thread, t);
-    t->affinity = allocate_bitmap(h, h, total_processors);
-    if (t->affinity == INVALID_ADDRESS)
+    sched_thread_init(&t->thrd);
+    t->thrd.affinity = allocate_bitmap(h, h, total_processors);
+    if (t->thrd.affinity == INVALID_ADDRESS)
         goto fail_affinity;
-    bitmap_range_check_and_set(t->affinity, 0, total_processors, false, true);
+    bitmap_range_check_and_set(t->thrd.affinity, 0, total_processors, false, true);
+    if (isolated_cpu_mask) {
+        bitmap_foreach_set(isolated_cpu_mask, cpu)
+            bitmap_set(t->thrd.affinity, cpu, 0);
+    }
     t->blocked_on = 0;
     init_sigstate(&t->signals);
     t->dispatch_sigstate = 0;
@@ -347,7 +370,9 @@ thread create_thread(process p)
     init_closure(&t->deferred_syscall, resume_syscall, t);
     t->sysctx = false;
     t->utime = t->stime = 0;
-    t->start_time = now(CLOCK_ID_MONOTONIC_RAW);
+    t->start_time = 0;
+    t->start_steal = 0;
+    t->mgmt = 0;
     t->last_syscall = -1;
 
     list_init(&t->l_faultwait);
@@ -410,9 +435,9 @@ void exit_thread(thread t)
     t->thread_bq = INVALID_ADDRESS;
 
     t->default_frame[FRAME_RUN] = INVALID_PHYSICAL;
-    t->default_frame[FRAME_QUEUE] = INVALID_PHYSICAL;
+    t->default_frame[FRAME_CPU] = INVALID_PHYSICAL;
     t->sighandler_frame[FRAME_RUN] = INVALID_PHYSICAL;
-    t->sighandler_frame[FRAME_QUEUE] = INVALID_PHYSICAL;
+    t->sighandler_frame[FRAME_CPU] = INVALID_PHYSICAL;
     t->default_frame[FRAME_FAULT_HANDLER] = INVALID_PHYSICAL;
     deallocate_frame(t->default_frame);
     deallocate_frame(t->sighandler_frame);
@@ -88,7 +88,8 @@ const char *string_from_mmap_type(int type)
 {
     return type == VMAP_MMAP_TYPE_ANONYMOUS ? "anonymous" :
         (type == VMAP_MMAP_TYPE_FILEBACKED ? "filebacked" :
-         (type == VMAP_MMAP_TYPE_IORING ? "io_uring" : "unknown"));
+         (type == VMAP_MMAP_TYPE_IORING ? "io_uring" :
+          (type == VMAP_MMAP_TYPE_XDP ? "xdp" : "unknown")));
 }
 
 static boolean handle_protection_fault(context frame, u64 vaddr, vmap vm)
@@ -163,6 +164,7 @@ define_closure_function(1, 1, context, default_fault_handler,
         }
     } else if (is_page_fault(frame)) {
         pf_debug("page fault, vaddr 0x%lx\n", vaddr);
+        trace_event(page_fault, current_cpu()->state, vaddr, frame[SYSCALL_FRAME_PC]);
         vmap vm = vmap_from_vaddr(p, vaddr);
         if (vm == INVALID_ADDRESS) {
             if (user) {
@@ -362,8 +364,25 @@ process create_process(unix_heaps uh, tuple root, filesystem fs)
     return p;
 }
 
+/* Time run by the current thread since start_time, not counting time
+   stolen from the cpu by the hypervisor, charged to its vruntime. */
+static timestamp thread_run_time(thread t, timestamp here)
+{
+    timestamp diff = t->start_time ? here - t->start_time : 0;
+    timestamp steal = cpu_steal_time(current_cpu());
+    timestamp stolen = steal - t->start_steal;
+    t->start_time = here;
+    t->start_steal = steal;
+    diff = stolen < diff ? diff - stolen : 0;
+    sched_thread_charge(&t->thrd, diff);
+    return diff;
+}
+
 void thread_enter_user(thread in)
 {
+    /* still running after a syscall returning directly */
+    if (in->sysctx && get_current_thread() == &in->thrd)
+        in->stime += thread_run_time(in, now(CLOCK_ID_MONOTONIC_RAW));
     thread_resume(in);
     in->sysctx = false;
 }
@@ -371,10 +390,7 @@ void thread_enter_user(thread in)
 void thread_enter_system(thread t)
 {
     if (!t->sysctx) {
-        timestamp here = now(CLOCK_ID_MONOTONIC_RAW);
-        timestamp diff = here - t->start_time;
-        t->utime += diff;
-        t->start_time = here;
+        t->utime += thread_run_time(t, now(CLOCK_ID_MONOTONIC_RAW));
         t->sysctx = true;
         set_current_thread(&t->thrd);
     }
@@ -384,13 +400,14 @@ void thread_pause(thread t)
 {
     if (get_current_thread() != &t->thrd)
         return;
-    timestamp diff = now(CLOCK_ID_MONOTONIC_RAW) - t->start_time;
+    timestamp diff = thread_run_time(t, now(CLOCK_ID_MONOTONIC_RAW));
     if (t->sysctx) {
         t->stime += diff;
     }
     else {
         t->utime += diff;
     }
+    t->start_time = 0;
     context f = thread_frame(t);
     thread_frame_save_fpsimd(f);
     thread_frame_save_tls(f);
@@ -406,23 +423,31 @@ void thread_resume(thread t)
     if (get_current_thread() == &t->thrd)
         return;
     t->start_time = now(CLOCK_ID_MONOTONIC_RAW);
+    t->start_steal = cpu_steal_time(current_cpu());
     set_current_thread(&t->thrd);
 }
 
-static timestamp utime_updated(thread t)
+/* Time accounted to a thread, plus that run so far if it is running. */
+static timestamp thread_time_updated(thread t, boolean sysctx)
 {
-    timestamp ts = t->utime;
-    if (!t->sysctx)
-        ts += now(CLOCK_ID_MONOTONIC_RAW) - t->start_time;
+    timestamp ts = sysctx ? t->stime : t->utime;
+    timestamp start = t->start_time;
+    if (start && t->sysctx == sysctx) {
+        timestamp here = now(CLOCK_ID_MONOTONIC_RAW);
+        if (here > start)
+            ts += here - start;
+    }
     return ts;
 }
 
+static timestamp utime_updated(thread t)
+{
+    return thread_time_updated(t, false);
+}
+
 static timestamp stime_updated(thread t)
 {
-    timestamp ts = t->stime;
-    if (t->sysctx)
-        ts += now(CLOCK_ID_MONOTONIC_RAW) - t->start_time;
-    return ts;
+    return thread_time_updated(t, true);
 }
 
 closure_function(2, 1, boolean, count_thread_time,
@@ -462,6 +487,75 @@ timestamp thread_stime(thread t)
     return stime_updated(t);
 }
 
+/* The management tree has the cpu time accounted to each thread, in
+   nanoseconds, under threads/<tid>; the tuple of a thread is allocated on
+   the first lookup and updated on each one. */
+static tuple thread_management(thread t)
+{
+    tuple m = t->mgmt;
+    if (!m) {
+        heap h = heap_general(get_kernel_heaps());
+        m = allocate_tuple();
+        assert(m != INVALID_ADDRESS);
+        set(m, sym(utime), value_from_u64(h, 0));
+        set(m, sym(stime), value_from_u64(h, 0));
+        set(m, sym(vruntime), value_from_u64(h, 0));
+        t->mgmt = m;
+    }
+    value_rewrite_u64(get(m, sym(utime)), nsec_from_timestamp(utime_updated(t)));
+    value_rewrite_u64(get(m, sym(stime)), nsec_from_timestamp(stime_updated(t)));
+    value_rewrite_u64(get(m, sym(vruntime)), nsec_from_timestamp(t->thrd.vruntime));
+    return m;
+}
+
+closure_function(1, 1, value, threads_get,
+                 process, p,
+                 symbol, s)
+{
+    u64 tid;
+    if (s == sym(no_encode))
+        return null_value;
+    if (!u64_from_value(symbol_string(s), &tid))
+        return 0;
+    thread t = thread_from_tid(bound(p), tid);
+    return t != INVALID_ADDRESS ? thread_management(t) : 0;
+}
+
+closure_function(0, 2, void, threads_set,
+                 symbol, s, value, v)
+{
+    /* read-only */
+}
+
+closure_function(1, 1, boolean, threads_iterate_each,
+                 binding_handler, h,
+                 rbnode, n)
+{
+    thread t = struct_from_field(n, thread, n);
+    return apply(bound(h), intern_u64(t->tid), thread_management(t));
+}
+
+closure_function(1, 1, boolean, threads_iterate,
+                 process, p,
+                 binding_handler, h)
+{
+    process p = bound(p);
+    spin_lock(&p->threads_lock);
+    boolean result = rbtree_traverse(p->threads, RB_INORDER,
+                                     stack_closure(threads_iterate_each, h));
+    spin_unlock(&p->threads_lock);
+    return result;
+}
+
+static void init_threads_management(process p)
+{
+    heap h = heap_general(get_kernel_heaps());
+    tuple ft = allocate_function_tuple(closure(h, threads_get, p), closure(h, threads_set),
+                                       closure(h, threads_iterate, p));
+    assert(ft != INVALID_ADDRESS);
+    set(p->process_root, sym(threads), ft);
+}
+
 process init_unix(kernel_heaps kh, tuple root, filesystem fs)
 {
     heap h = heap_general(kh);
@@ -516,6 +610,7 @@ process init_unix(kernel_heaps kh, tuple root, filesystem fs)
     install_fallback_fault_handler((fault_handler)&dummy_thread->fault_handler);
 
     register_special_files(kernel_process);
+    init_threads_management(kernel_process);
     init_syscalls(kernel_process->process_root);
     register_file_syscalls(linux_syscalls);
 #ifdef NET
@@ -19,6 +19,7 @@
 #define VMAP_MMAP_TYPE_ANONYMOUS  0x0100
 #define VMAP_MMAP_TYPE_FILEBACKED 0x0200
 #define VMAP_MMAP_TYPE_IORING     0x0400
+#define VMAP_MMAP_TYPE_XDP        0x0800
 
 #define ACCESS_PERM_READ    VMAP_FLAG_READABLE
 #define ACCESS_PERM_WRITE   VMAP_FLAG_WRITABLE
@@ -293,7 +294,9 @@ typedef struct thread {
 
     boolean sysctx;
     timestamp utime, stime;
-    timestamp start_time;
+    timestamp start_time;       /* of the run in progress, or 0 if not running */
+    timestamp start_steal;      /* steal time of the cpu at start_time */
+    tuple mgmt;                 /* under threads in the management tree, once looked up */
     int last_syscall;
     timestamp syscall_enter_ts;
     u64 syscall_time;
@@ -307,7 +310,6 @@ typedef struct thread {
     u64 signal_stack_length;
 
     closure_struct(resume_syscall, deferred_syscall);
-    bitmap affinity;
     struct list l_faultwait;
 } *thread;
 
@@ -780,6 +782,8 @@ void vmap_iterator(process p, vmap_handler vmh);
 boolean vmap_validate_range(process p, range q);
 void truncate_file_maps(process p, fsfile f, u64 new_length);
 const char *string_from_mmap_type(int type);
+u64 pin_user_page(process p, u64 vaddr);
+void unpin_phys_page(u64 phys);
 
 void thread_log_internal(thread t, const char *desc, ...);
 #define thread_log(__t, __desc, ...) do {if (!__t || !__t->p->trace) break; thread_log_internal(__t, __desc, ##__VA_ARGS__);} while (0)
@@ -829,6 +833,7 @@ static inline sysreturn syscall_return(thread t, sysreturn val)
     set_syscall_return(t, val);
     u64 flags = irq_disable_save(); /* XXX mutex / spinlock */
     t->syscall_complete = true;
+    trace_event(syscall_exit, t->syscall, val, 0);
     if (do_syscall_stats)
         count_syscall(t, val);
     if (t->blocked_on)
@@ -877,6 +882,8 @@ sysreturn io_uring_mmap(fdesc desc, u64 len, pageflags mapflags, u64 offset);
 sysreturn io_uring_enter(int fd, unsigned int to_submit,
                          unsigned int min_complete, unsigned int flags,
                          sigset_t *sig);
+
+sysreturn xdp_mmap(fdesc desc, u64 len, pageflags mapflags, u64 offset);
 sysreturn io_uring_register(int fd, unsigned int opcode, void *arg,
                             unsigned int nr_args);
 
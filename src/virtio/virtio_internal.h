@@ -122,6 +122,7 @@ physical virtqueue_desc_paddr(struct virtqueue *vq);
 physical virtqueue_avail_paddr(struct virtqueue *vq);
 physical virtqueue_used_paddr(struct virtqueue *vq);
 u16 virtqueue_entries(virtqueue vq);
+void virtqueue_set_service_complete(virtqueue vq, thunk t);
 
 typedef struct vqmsg *vqmsg;
 
@@ -129,3 +130,5 @@ vqmsg allocate_vqmsg(virtqueue vq);
 void deallocate_vqmsg(virtqueue vq, vqmsg m);
 void vqmsg_push(virtqueue vq, vqmsg m, u64 phys_addr, u32 len, boolean write);
 void vqmsg_commit(virtqueue vq, vqmsg m, vqfinish completion);
+void vqmsg_post(virtqueue vq, vqmsg m, vqfinish completion);
+boolean virtqueue_kick(virtqueue vq);
@@ -42,6 +42,7 @@
 #include "lwip/dhcp.h"
 #include "lwip/timeouts.h"
 #include "netif/ethernet.h"
+#include <lwip.h>
 #include "virtio_internal.h"
 #include "virtio_mmio.h"
 #include "virtio_net.h"
@@ -65,6 +66,8 @@ typedef struct vnet {
     struct virtqueue *ctl;
     u64 empty_phys;
     void *empty; // just a mac..fix, from pre-heap days
+    struct netif_gro gro;
+    struct netif_tx_batch tx_batch;
 } *vnet;
 
 typedef struct xpbuf
@@ -89,18 +92,40 @@ closure_function(1, 1, void, tx_complete,
 static err_t low_level_output(struct netif *netif, struct pbuf *p)
 {
     vnet vn = netif->state;
+    trace_event(net_tx, p->tot_len, p, 0);
 
     vqmsg m = allocate_vqmsg(vn->txq);
     assert(m != INVALID_ADDRESS);
-    vqmsg_push(vn->txq, m, vn->empty_phys, vn->net_header_len, false);
+
+    /* A frame with a partial checksum gets its own header, written in
+       the headroom lwIP reserves in front of the link header. */
+    struct netif_csum_info ci;
+    boolean header = false;
+    if (netif_tx_csum_prepare(netif, p, &ci)) {
+        if (pbuf_add_header(p, vn->net_header_len) == 0) {
+            struct virtio_net_hdr *hdr = p->payload;
+            zero(hdr, vn->net_header_len);
+            hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+            hdr->csum_start = ci.l4_offset;
+            hdr->csum_offset = ci.csum_offset;
+            vqmsg_push(vn->txq, m, physical_from_virtual(hdr), vn->net_header_len, false);
+            pbuf_remove_header(p, vn->net_header_len);
+            header = true;
+        } else {
+            netif_tx_csum_complete(p, &ci);
+        }
+    }
+    if (!header)
+        vqmsg_push(vn->txq, m, vn->empty_phys, vn->net_header_len, false);
 
     pbuf_ref(p);
 
     for (struct pbuf * q = p; q != NULL; q = q->next)
         vqmsg_push(vn->txq, m, physical_from_virtual(q->payload), q->len, false);
 
-    vqmsg_commit(vn->txq, m, closure(vn->dev->general, tx_complete, p));
-    
+    vqmsg_post(vn->txq, m, closure(vn->dev->general, tx_complete, p));
+    netif_tx_batch_add(&vn->tx_batch);
+
     MIB2_STATS_NETIF_ADD(netif, ifoutoctets, p->tot_len);
     if (((u8_t *)p->payload)[0] & 1) {
         /* broadcast or multicast packet*/
@@ -116,6 +141,14 @@ static err_t low_level_output(struct netif *netif, struct pbuf *p)
     return ERR_OK;
 }
 
+closure_function(1, 0, void, tx_flush,
+                 vnet, vn)
+{
+    vnet vn = bound(vn);
+    if (virtqueue_kick(vn->txq))
+        netif_tx_doorbell(&vn->tx_batch);
+}
+
 static void receive_buffer_release(struct pbuf *p)
 {
     xpbuf x  = (void *)p;
@@ -124,54 +157,6 @@ static void receive_buffer_release(struct pbuf *p)
 
 static void post_receive(vnet vn);
 
-static u16 vnet_csum(u8 *buf, u64 len)
-{
-    u64 sum = 0;
-    while (len >= sizeof(u64)) {
-        u64 s = *(u64 *)buf;
-        sum += s;
-        if (sum < s)
-            sum++;
-        buf += sizeof(u64);
-        len -= sizeof(u64);
-    }
-    if (len >= sizeof(u32)) {
-        u32 s = *(u32 *)buf;
-        sum += s;
-        if (sum < s)
-            sum++;
-        buf += sizeof(u32);
-        len -= sizeof(u32);
-    }
-    if (len >= sizeof(u16)) {
-        u16 s = *(u16 *)buf;
-        sum += s;
-        if (sum < s)
-            sum++;
-        buf += sizeof(u16);
-        len -= sizeof(u16);
-    }
-    if (len) {
-        u8 s = *buf;
-        sum += s;
-        if (sum < s)
-            sum++;
-    }
-
-    /* Fold down to 16 bits */
-    u32 s1 = sum;
-    u32 s2 = sum >> 32;
-    s1 += s2;
-    if (s1 < s2)
-        s1++;
-    u16 s3 = s1;
-    u16 s4 = s1 >> 16;
-    s3 += s4;
-    if (s3 < s4)
-        s3++;
-    return ~s3;
-}
-
 closure_function(1, 1, void, input,
                  xpbuf, x,
                  u64, len)
@@ -183,25 +168,18 @@ closure_function(1, 1, void, input,
     // under what conditions does a virtio queue give us zero?
     if (x != NULL) {
         struct virtio_net_hdr *hdr = (struct virtio_net_hdr *)x->p.pbuf.payload;
-        boolean err = false;
         len -= vn->net_header_len;
         assert(len <= x->p.pbuf.len);
         x->p.pbuf.tot_len = x->p.pbuf.len = len;
         x->p.pbuf.payload += vn->net_header_len;
-        if (hdr->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) {
-            if (hdr->csum_start + hdr->csum_offset <= len - sizeof(u16)) {
-                u16 csum = vnet_csum(x->p.pbuf.payload + hdr->csum_start,
-                    len - hdr->csum_start);
-                *(u16 *)(x->p.pbuf.payload + hdr->csum_start +
-                        hdr->csum_offset) = csum;
-            } else
-                err = true;
-        }
-        if (!err)
-            err = (vn->n->input(&x->p.pbuf, vn->n) != ERR_OK);
-        if (err) {
-            receive_buffer_release(&x->p.pbuf);
-        }
+        trace_event(net_rx, len, &x->p.pbuf, 0);
+        /* A partial checksum comes from a sender on the same host and
+           needs no verification (nor completion, as frames are not
+           forwarded). */
+        if (!netif_xsk_receive(vn->n, 0, &x->p.pbuf))
+            netif_gro_receive(&vn->gro, &x->p.pbuf,
+                              (hdr->flags & (VIRTIO_NET_HDR_F_NEEDS_CSUM |
+                                             VIRTIO_NET_HDR_F_DATA_VALID)) != 0);
     } else {
         rprintf("virtio null\n");
     }
@@ -211,6 +189,13 @@ closure_function(1, 1, void, input,
     closure_finish();
 }
 
+/* held segments are passed on once the batch of received frames is done */
+closure_function(1, 0, void, input_complete,
+                 vnet, vn)
+{
+    netif_xsk_receive_flush(bound(vn)->n);
+    netif_gro_flush(&bound(vn)->gro);
+}
 
 static void post_receive(vnet vn)
 {
@@ -265,7 +250,13 @@ static err_t virtioif_init(struct netif *netif)
     /* device capabilities */
     /* don't set NETIF_FLAG_ETHARP if this device is not an ethernet one */
     netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP | NETIF_FLAG_UP;
+    if (vn->dev->features & VIRTIO_NET_F_CSUM)
+        netif_tx_csum_offload(netif);
 
+    netif_gro_init(&vn->gro, netif);
+    netif_tx_batch_init(&vn->tx_batch, netif, closure(vn->dev->general, tx_flush, vn));
+    virtqueue_set_service_complete(vn->rxq, closure(vn->dev->general, input_complete, vn));
+    netif_xsk_enable(netif, 1);
     for (int i = 0; i < virtqueue_entries(vn->rxq); i++)
         post_receive(vn);
     
@@ -318,7 +309,7 @@ closure_function(2, 1, boolean, vtpci_net_probe,
     if (!vtpci_probe(d, VIRTIO_ID_NETWORK))
         return false;
     vtpci dev = attach_vtpci(bound(general), bound(page_allocator), d,
-        VIRTIO_NET_F_MAC | VIRTIO_F_ANY_LAYOUT);
+        VIRTIO_NET_F_MAC | VIRTIO_F_ANY_LAYOUT | VIRTIO_NET_F_CSUM | VIRTIO_NET_F_GUEST_CSUM);
     virtio_net_attach(&dev->virtio_dev);
     return true;
 }
@@ -332,7 +323,7 @@ closure_function(2, 1, void, vtmmio_net_probe,
             sizeof(struct virtio_net_config)))
         return;
     if (attach_vtmmio(bound(general), bound(page_allocator), d,
-            VIRTIO_NET_F_MAC))
+            VIRTIO_NET_F_MAC | VIRTIO_NET_F_CSUM | VIRTIO_NET_F_GUEST_CSUM))
         virtio_net_attach(&d->virtio_dev);
 }
 
@@ -103,6 +103,7 @@ typedef struct virtqueue {
     struct list msg_queue;
     queue service_queue;
     thunk service;
+    thunk service_complete;     /* end of a batch of completions */
     queue sched_queue;
     struct spinlock lock;
     vqmsg msgs[0];
@@ -147,7 +148,7 @@ void vqmsg_push(virtqueue vq, vqmsg m, u64 phys_addr, u32 len, boolean write)
                             __func__, vq->name, m, phys_addr, len, write ? "write" : "read", m->count);
 }
 
-static void virtqueue_fill(virtqueue vq);
+static int virtqueue_fill(virtqueue vq);
 
 void vqmsg_commit(virtqueue vq, vqmsg m, vqfinish completion)
 {
@@ -160,6 +161,28 @@ void vqmsg_commit(virtqueue vq, vqmsg m, vqfinish completion)
     spin_unlock_irq(&vq->lock, irqflags);
 }
 
+/* Queues a message without notifying the device, for messages posted in
+   a batch; they are made available by the next virtqueue_kick, or by any
+   commit or interrupt on the queue meanwhile. */
+void vqmsg_post(virtqueue vq, vqmsg m, vqfinish completion)
+{
+    m->completion = completion;
+    virtqueue_debug_verbose("%s: vq %s, vqmsg %p, completion %p (%F)\n",
+                            __func__, vq->name, m, completion, completion);
+    u64 irqflags = spin_lock_irq(&vq->lock);
+    list_push_back(&vq->msg_queue, &m->l);
+    spin_unlock_irq(&vq->lock, irqflags);
+}
+
+/* returns true if the device was notified */
+boolean virtqueue_kick(virtqueue vq)
+{
+    u64 irqflags = spin_lock_irq(&vq->lock);
+    int notified = virtqueue_fill(vq);
+    spin_unlock_irq(&vq->lock, irqflags);
+    return notified != 0;
+}
+
 closure_function(1, 0, void, vq_interrupt,
                  virtqueue, vq)
 {
@@ -231,6 +254,8 @@ closure_function(1, 0, void, virtqueue_service_vqmsgs,
             deallocate_vqmsg(vq, m);
         }
     }
+    if (vq->service_complete)
+        apply(vq->service_complete);
     virtqueue_debug("%s exit\n", __func__);
 }
 
@@ -289,6 +314,11 @@ status virtqueue_alloc(vtdev dev,
     return STATUS_OK;
 }
 
+void virtqueue_set_service_complete(virtqueue vq, thunk t)
+{
+    vq->service_complete = t;
+}
+
 physical virtqueue_desc_paddr(virtqueue vq)
 {
     return physical_from_virtual(vq->ring_mem);
@@ -320,8 +350,8 @@ static int virtqueue_notify(virtqueue vq)
     return should_notify;
 }
 
-/* called with lock held */
-static void virtqueue_fill(virtqueue vq)
+/* called with lock held; returns whether the device was notified */
+static int virtqueue_fill(virtqueue vq)
 {
     virtqueue_debug("%s: ENTRY: vq %s: entries %d, desc_idx %d, avail->idx %d, avail->flags 0x%x\n",
         __func__, vq->name, vq->entries, vq->desc_idx, vq->avail->idx, vq->avail->flags);
@@ -375,6 +405,6 @@ static void virtqueue_fill(virtqueue vq)
     int notified = 0;
     if (added > 0)
         notified = virtqueue_notify(vq);
-    (void) notified;
     virtqueue_debug_verbose("   added %d, notified %d, desc_idx %d\n", added, notified, vq->desc_idx);
+    return notified;
 }
@@ -10,6 +10,7 @@
 #include "lwip/dhcp.h"
 #include <pci.h>
 #include "netif/ethernet.h"
+#include <lwip.h>
 #include "vmxnet3.h"
 #include "vmxnet3_queue.h"
 #include "vmxnet3_net.h"
@@ -29,6 +30,8 @@ typedef struct vmxnet3 {
     thunk rx_service;           /* for bhqueue processing */
     queue rx_servicequeue;
     struct netif *n;
+    struct netif_gro gro;
+    struct netif_tx_batch tx_batch;
 } *vmxnet3;
 
 typedef struct xpbuf
@@ -36,6 +39,7 @@ typedef struct xpbuf
     struct pbuf_custom p;
     vmxnet3 vn;
     struct list l;
+    boolean csum_verified;
 } *xpbuf;
 
 static void vmxnet3_interrupts_enable(vmxnet3_pci dev)
@@ -135,23 +139,33 @@ static void vmxnet3_interrupts_disable(vmxnet3_pci dev)
     pci_bar_write_4(&dev->bar0, VMXNET3_BAR0_IMASK(txq->vxtxq_intr_idx), 1);
 }
 
-static void kick_pending(vmxnet3_pci dev)
+static boolean kick_pending(vmxnet3_pci dev)
 {
     struct vmxnet3_txqueue* vmx_txq = dev->vmx_txq[0];
     if (vmx_txq->vxtxq_ts->npending) {
         vmx_txq->vxtxq_ts->npending = 0;
         pci_bar_write_4(&dev->bar0, VMXNET3_BAR0_TXH(0), vmx_txq->vxtxq_cmd_ring.vxtxr_head);
+        return true;
     }
+    return false;
+}
+
+closure_function(1, 0, void, tx_flush,
+                 vmxnet3, vn)
+{
+    vmxnet3 vn = bound(vn);
+    if (kick_pending(vn->dev))
+        netif_tx_doorbell(&vn->tx_batch);
 }
 
 static err_t low_level_output(struct netif *netif, struct pbuf *p)
 {
     vmxnet3 vn = netif->state;
 
-    err_t e = vmxnet3_isc_txd_encap(vn->dev, p);
+    err_t e = vmxnet3_isc_txd_encap(vn->dev, netif, p);
     if (e != ERR_OK)
         return e;
-    kick_pending(vn->dev)
+    netif_tx_batch_add(&vn->tx_batch);
 
     MIB2_STATS_NETIF_ADD(netif, ifoutoctets, p->tot_len);
     if (((u8_t *)p->payload)[0] & 1) {
@@ -218,6 +232,9 @@ static err_t vmxif_init(struct netif *netif)
     /* device capabilities */
     /* don't set NETIF_FLAG_ETHARP if this device is not an ethernet one */
     netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP | NETIF_FLAG_UP;
+    netif_tx_csum_offload(netif);
+    netif_gro_init(&vn->gro, netif);
+    netif_tx_batch_init(&vn->tx_batch, netif, closure(vn->dev->general, tx_flush, vn));
 
     return ERR_OK;
 }
@@ -253,13 +270,10 @@ closure_function(1, 0, void, vmxnet3_rx_service_bh,
             assert(i);
             xpbuf rxb = struct_from_list(i, xpbuf, l);
             list_delete(i);
-            err_enum_t err = vn->n->input((struct pbuf *)rxb, vn->n);
-            if (err != ERR_OK) {
-                msg_err("vmxnet3: rx drop by stack, err %d\n", err);
-                receive_buffer_release((struct pbuf *)rxb);
-            }
+            netif_gro_receive(&vn->gro, (struct pbuf *)rxb, rxb->csum_verified);
         }
     }
+    netif_gro_flush(&vn->gro);
 }
 
 void vmxnet3_newbuf(vmxnet3 vdev, int rid);
@@ -569,6 +583,8 @@ void vmxnet3_receive(vmxnet3 vdev, struct list *l)
         }
 
         if (rxcd->eop) {
+            ((struct xpbuf*)dev->currpkt_head)->csum_verified = rxcd->csum_ok &&
+                (rxcd->tcp || rxcd->udp) && !rxcd->fragment;
             list_insert_before(l, &((struct xpbuf*)dev->currpkt_head)->l);
             dev->currpkt_head = dev->currpkt_tail = NULL;
         }
@@ -4,6 +4,7 @@
 #include "lwip/def.h"
 #include "lwip/mem.h"
 #include "lwip/pbuf.h"
+#include <lwip.h>
 #include "vmxnet3_queue.h"
 #include "vmxnet3_net.h"
 #include "netif/ethernet.h"
@@ -250,7 +251,7 @@ void vmxnet3_init_shared_data(vmxnet3_pci dev)
 }
 
 int
-vmxnet3_isc_txd_encap(vmxnet3_pci dev, struct pbuf *p)
+vmxnet3_isc_txd_encap(vmxnet3_pci dev, struct netif *n, struct pbuf *p)
 {
     struct vmxnet3_txqueue *txq = dev->vmx_txq[0];
     struct vmxnet3_txring *txr = &txq->vxtxq_cmd_ring;
@@ -316,24 +317,14 @@ vmxnet3_isc_txd_encap(vmxnet3_pci dev, struct pbuf *p)
 //    }
 
     /*
-     * TSO and checksum offloads
+     * Checksum offload
      */
-#if 0
-    int hdrlen = pi->ipi_ehdrlen + pi->ipi_ip_hlen;
-    if (pi->ipi_csum_flags & CSUM_TSO) {
-        sop->offload_mode = VMXNET3_OM_TSO;
-        sop->hlen = hdrlen + pi->ipi_tcp_hlen;
-        sop->offload_pos = pi->ipi_tso_segsz;
-    } else if (pi->ipi_csum_flags & (VMXNET3_CSUM_OFFLOAD |
-        VMXNET3_CSUM_OFFLOAD_IPV6)) {
+    struct netif_csum_info ci;
+    if (netif_tx_csum_prepare(n, p, &ci)) {
         sop->offload_mode = VMXNET3_OM_CSUM;
-        sop->hlen = hdrlen;
-        sop->offload_pos = hdrlen +
-            ((pi->ipi_ipproto == IPPROTO_TCP) ?
-            offsetof(struct tcphdr, th_sum) :
-            offsetof(struct udphdr, uh_sum));
+        sop->hlen = ci.l4_offset;
+        sop->offload_pos = ci.l4_offset + ci.csum_offset;
     }
-#endif
     /* Finally, change the ownership. */
     write_barrier();
     sop->gen ^= 1;
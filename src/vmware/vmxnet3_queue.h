@@ -373,7 +373,7 @@ void vmxnet3_rx_queues_alloc(vmxnet3_pci vp);
 void vmxnet3_queues_shared_alloc(vmxnet3_pci vp);
 void vmxnet3_init_shared_data(vmxnet3_pci vp);
 
-int vmxnet3_isc_txd_encap(vmxnet3_pci vp, struct pbuf *p);
+int vmxnet3_isc_txd_encap(vmxnet3_pci vp, struct netif *n, struct pbuf *p);
 void vmxnet3_isc_txd_credits_update(vmxnet3_pci vp);
 
 void vmxnet3_set_interrupt_idx(vmxnet3_pci vp);
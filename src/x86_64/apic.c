@@ -39,23 +39,50 @@ static inline u32 apic_read(int reg)
     return apic_if->read(apic_if, reg);
 }
 
-static inline u32 apicid_from_cpuid(u32 idx)
+u32 apicid_from_cpuid(u32 idx)
 {
     if (!apic_id_map)
         return idx;
     return *(u32 *)buffer_ref(apic_id_map, idx * sizeof(u32));
 }
 
+/* Set by the platform where the hypervisor delivers an ipi to a set of
+   up to 128 apic ids, starting from min, in one call. */
+void (*apic_pv_ipi)(u64 mask_lo, u64 mask_hi, u32 min, u64 icr);
+
+/* Sends to all other cpus but those for which skip, if given, returns
+   true. */
+void apic_ipi_cpus(boolean (*skip)(cpuinfo ci), u64 flags, u8 vector)
+{
+    u32 self = current_cpu()->id;
+    u64 mask[2] = {0, 0};
+    u32 min = 0;
+    for (int i = 0; i < total_processors; i++) {
+        if (i == self || (skip && skip(cpuinfo_from_id(i))))
+            continue;
+        u32 aid = apicid_from_cpuid(i);
+        if (!apic_pv_ipi) {
+            apic_if->ipi(apic_if, aid, flags, vector);
+            continue;
+        }
+        if ((mask[0] | mask[1]) && (aid < min || aid >= min + 128)) {
+            apic_pv_ipi(mask[0], mask[1], min, flags | vector);
+            mask[0] = mask[1] = 0;
+        }
+        if (!(mask[0] | mask[1]))
+            min = aid;
+        mask[(aid - min) >> 6] |= U64_FROM_BIT((aid - min) & 63);
+    }
+    if (mask[0] | mask[1])
+        apic_pv_ipi(mask[0], mask[1], min, flags | vector);
+}
+
 void apic_ipi(u32 target, u64 flags, u8 vector)
 {
     /* Do not use native "all but self" destination as it is very slow
      * and may target processors not available */
     if (target == TARGET_EXCLUSIVE_BROADCAST) {
-        for (int i = 0; i < total_processors; i++) {
-            if (current_cpu()->id == i)
-                continue;
-            apic_if->ipi(apic_if, apicid_from_cpuid(i), flags, vector);
-        }
+        apic_ipi_cpus(0, flags, vector);
         return;
     }
     apic_if->ipi(apic_if, apicid_from_cpuid(target), flags, vector);
@@ -86,6 +113,12 @@ static void calibrate_lapic_timer(void)
 
 void lapic_eoi(void)
 {
+    /* With paravirtual EOI, the hypervisor flags interrupts that need no
+       EOI write and the exit it causes; the flag stays clear otherwise. */
+    u8 skip;
+    asm volatile("btrq $0, %0; setc %1" : "+m"(current_cpu()->m.pv_eoi), "=r"(skip) :: "memory");
+    if (skip)
+        return;
     write_barrier();
     apic_write(APIC_EOI, 0);
     write_barrier();
@@ -131,6 +164,7 @@ closure_function(0, 0, void, lapic_timer_int)
 {
     cpuinfo ci = current_cpu();
     timestamp here = now(CLOCK_ID_MONOTONIC_RAW);
+    ci->timer_interrupts++;
     if (here < ci->m.lapic_timer_expiry) {
         apic_debug("timer fired %T seconds too early\n", ci->m.lapic_timer_expiry - here);
         lapic_set_timer(ci->m.lapic_timer_expiry - here);
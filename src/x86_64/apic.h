@@ -63,9 +63,12 @@ void init_apic(kernel_heaps kh);
 void lapic_set_tsc_deadline_mode(u32 v);
 boolean init_lapic_timer(clock_timer *ct, thunk *per_cpu_init);
 void apic_ipi(u32 target, u64 flags, u8 vector);
+void apic_ipi_cpus(boolean (*skip)(cpuinfo ci), u64 flags, u8 vector);
+extern void (*apic_pv_ipi)(u64 mask_lo, u64 mask_hi, u32 min, u64 icr);
 void apic_per_cpu_init(void);
 void apic_enable(void);
 int cpuid_from_apicid(u32 aid);
+u32 apicid_from_cpuid(u32 idx);
 
 void ioapic_set_int(unsigned int gsi, u64 v);
 boolean ioapic_int_is_free(unsigned int gsi);
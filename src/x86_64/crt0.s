@@ -47,41 +47,56 @@ extern  init_service
 
 extern use_xsave
 
+;; use_xsave values, as in kernel_machine.h
+%define XSAVE_XSAVEOPT  2
+%define XSAVE_XSAVES    3
+
 %macro load_extended_registers 1
         mov al, [use_xsave]
+        cmp al, XSAVE_XSAVES
+        je %%xs
         test al, al
-        jnz %%xs
+        jnz %%x
         fxrstor [%1+FRAME_EXTENDED_SAVE*8]
         jmp %%out
-%%xs:
+%%x:
         mov edx, 0xffffffff
         mov eax, edx
         xrstor [%1+FRAME_EXTENDED_SAVE*8]
+        jmp %%out
+%%xs:
+        mov edx, 0xffffffff
+        mov eax, edx
+        xrstors [%1+FRAME_EXTENDED_SAVE*8]
 %%out:
 %endmacro
         
 %macro save_extended_registers 1
         mov al, [use_xsave]
+        cmp al, XSAVE_XSAVEOPT
+        je %%xo
+        ja %%xs
         test al, al
-        jnz %%xs
+        jnz %%x
         fxsave [%1+FRAME_EXTENDED_SAVE*8]  ; we wouldn't have to do this if we could guarantee no other user thread ran before us
         jmp %%out
-%%xs:
+%%x:
         mov edx, 0xffffffff
         mov eax, edx
         xsave [%1+FRAME_EXTENDED_SAVE*8]
+        jmp %%out
+%%xo:
+        mov edx, 0xffffffff
+        mov eax, edx
+        xsaveopt [%1+FRAME_EXTENDED_SAVE*8]
+        jmp %%out
+%%xs:
+        mov edx, 0xffffffff
+        mov eax, edx
+        xsaves [%1+FRAME_EXTENDED_SAVE*8]
 %%out:
 %endmacro
 
-        
-      
-;;;  helper so userspace can save a frame without
-;;; 
-global xsave        
-xsave:
-        save_extended_registers rdi
-        ret
-        
 ;; stack frame upon entry:
 ;;
 ;; ss
@@ -92,7 +107,8 @@ xsave:
 ;; [error code - if vec 0xe or 0xd]
 ;; vector <- rsp
 
-%macro interrupt_common_top 0
+;; argument is the offset of the saved cs once the vector is popped
+%macro interrupt_common_top 1
         push rbx
         mov rbx, [gs:8]         ; running_frame
         mov [rbx+FRAME_RAX*8], rax
@@ -116,7 +132,12 @@ xsave:
         pop rax            ; vector
         mov [rbx+FRAME_VECTOR*8], rax
         mov qword [rbx+FRAME_IS_SYSCALL*8], 0
+        ;; the kernel doesn't touch extended state, so it is left in place
+        ;; when kernel code is interrupted (see frame_return)
+        test qword [rsp + %1], 0x03
+        jz %%kernel
         save_extended_registers rbx
+%%kernel:
 %endmacro
 
 extern common_handler
@@ -152,7 +173,7 @@ xsave_features :
 global interrupt_entry_with_ec
 interrupt_entry_with_ec:
         check_swapgs 24
-        interrupt_common_top
+        interrupt_common_top 16
         pop rax
         mov [rbx+FRAME_ERROR_CODE*8], rax
         interrupt_common_bottom
@@ -161,7 +182,7 @@ interrupt_entry_with_ec:
 global interrupt_entry
 interrupt_entry:
         check_swapgs 16
-        interrupt_common_top
+        interrupt_common_top 8
         interrupt_common_bottom
         hlt                     ; no return
 
@@ -187,8 +208,8 @@ frame_return:
         load_seg_base FRAME_FSBASE
         load_seg_base FRAME_GSBASE
         swapgs
-.skip:
         load_extended_registers rdi
+.skip:
         mov rax, [rdi+FRAME_RAX*8]
         mov rbx, [rdi+FRAME_RBX*8]
         mov rcx, [rdi+FRAME_RCX*8]
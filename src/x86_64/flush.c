@@ -5,6 +5,7 @@
 #define MAX_FLUSH_ENTRIES 1024
 #define COMP_QUEUE_SIZE (MAX_FLUSH_ENTRIES*2)
 #define ENTRIES_SERVICE_THRESHOLD (MAX_FLUSH_ENTRIES/2)
+#define FLUSH_KICK_SPINS (1 << 12)
 
 static boolean initialized = false;
 static int flush_ipi;
@@ -102,6 +103,34 @@ void page_invalidate(flush_entry f, u64 p)
     }
 }
 
+/* A preempted vcpu can be left to have its whole TLB flushed by the
+   hypervisor before it runs again; it catches up with the entries, and
+   releases its references, next time it goes through _flush_handler(),
+   at the latest on the next flush ipi it gets. Until then, the entries
+   can't complete, so those with a completion, which may have a faulting
+   thread waiting, are never deferred. */
+static boolean flush_ipi_skip(cpuinfo ci)
+{
+    return pv_ops.defer_tlb_flush && pv_ops.defer_tlb_flush(ci);
+}
+
+/* Out of entries with flush ipis deferred: get the cpus still holding
+   references through _flush_handler(), giving the rest of our time slice
+   to those that are preempted. */
+static void flush_kick_laggards(void)
+{
+    cpuinfo self = current_cpu();
+    for (int i = 0; i < total_processors; i++) {
+        cpuinfo ci = cpuinfo_from_id(i);
+        if (ci == self || ci->inval_gen == inval_gen)
+            continue;
+        if (!cpu_preempted(ci))
+            apic_ipi(i, ICR_ASSERT, flush_ipi);
+        else if (pv_ops.yield_to)
+            pv_ops.yield_to(ci);
+    }
+}
+
 static void service_list(boolean trydefer)
 {
     list_foreach(&entries, l) {
@@ -184,7 +213,7 @@ void page_invalidate_sync(flush_entry f, status_handler completion)
         f->gen = fetch_and_add((word *)&inval_gen, 1) + 1;
         spin_wunlock(&flush_lock);
 
-        apic_ipi(TARGET_EXCLUSIVE_BROADCAST, ICR_ASSERT, flush_ipi);
+        apic_ipi_cpus(completion ? 0 : flush_ipi_skip, ICR_ASSERT, flush_ipi);
         _flush_handler();
         irq_restore(flags);
     } else {
@@ -208,8 +237,11 @@ flush_entry get_page_flush_entry(void)
     irq_restore(flags);
 
     /* This spins because it must succeed */
-    while ((fe = dequeue(free_flush_entries)) == INVALID_ADDRESS)
+    for (int spins = 0; (fe = dequeue(free_flush_entries)) == INVALID_ADDRESS; spins++) {
+        if (pv_ops.defer_tlb_flush && (spins % FLUSH_KICK_SPINS) == 0)
+            flush_kick_laggards();
         kern_pause();
+    }
 
     assert(fe != INVALID_ADDRESS);
     runtime_memset((void *)fe, 0, sizeof(*fe));
@@ -94,8 +94,20 @@ void init_cpuinfo_machine(cpuinfo ci, heap backed)
     install_gdt64_and_tss(&ci->m.gdt.tss_desc, &ci->m.tss, gdt, &ci->m.gdt_pointer);
 }
 
+/* legacy region of the extended save area, and the header that follows it */
+#define XSAVE_FCW       0
+#define XSAVE_MXCSR     24
+#define XSAVE_XCOMP_BV  (512 + 8)
+
+/* The extended state of a new frame is the initial state rather than a
+   copy of whatever the cpu registers hold. */
 void init_frame(context f)
 {
     assert((u64_from_pointer(f) & 63) == 0);
-    xsave(f);
+    void *x = f + FRAME_EXTENDED_SAVE;
+    zero(x, extended_frame_size);
+    *(u16 *)(x + XSAVE_FCW) = 0x37f;
+    *(u32 *)(x + XSAVE_MXCSR) = 0x1f80;
+    if (use_xsave == XSAVE_XSAVES)
+        *(u64 *)(x + XSAVE_XCOMP_BV) = U64_FROM_BIT(63) | xsave_xcr0;
 }
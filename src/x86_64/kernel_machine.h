@@ -120,6 +120,21 @@ static inline void wait_for_interrupt(void)
     asm volatile("sti; hlt" ::: "memory");
 }
 
+extern u8 use_mwait;
+
+/* Called with interrupts disabled: sleeps, with interrupts enabled, until
+   the cache line holding p is written to, unless *p has changed from v
+   already. Returns false if memory can't be monitored. */
+static inline boolean wait_for_update(volatile u64 *p, u64 v)
+{
+    if (!use_mwait)
+        return false;
+    asm volatile("monitor" :: "a"(p), "c"(0), "d"(0));
+    if (*p == v)
+        asm volatile("sti; mwait; cli" :: "a"(0), "c"(0) : "memory");
+    return true;
+}
+
 void triple_fault(void) __attribute__((noreturn));
 void start_cpu(int index);
 void allocate_apboot(heap stackheap, void (*ap_entry)());
@@ -273,6 +288,16 @@ struct cpuinfo_machine {
     /* Monotonic clock timestamp when the lapic timer is supposed to fire; used to re-arm the timer
      * when it fires too early (based on what the monotonic clock source says). */
     timestamp lapic_timer_expiry;
+
+    /* Paravirtual state shared with the hypervisor (see kvm_platform.c) */
+    u64 pv_eoi;                 /* bit 0 set: the pending EOI may be skipped */
+    struct pv_steal_time {
+        u64 steal;              /* nanoseconds */
+        u32 version;            /* odd while being updated */
+        u32 flags;
+        u8 preempted;
+        u8 pad[47];
+    } __attribute__((aligned(64))) steal_time;
 };
 
 typedef struct cpuinfo *cpuinfo;
@@ -284,6 +309,21 @@ static inline cpuinfo current_cpu(void)
     return (cpuinfo)pointer_from_u64(addr);
 }
 
+/* extended state save instructions (use_xsave) */
+#define XSAVE_FXSAVE    0
+#define XSAVE_XSAVE     1
+#define XSAVE_XSAVEOPT  2
+#define XSAVE_XSAVES    3       /* compacted layout */
+
+/* XCR0 state components beyond x87, SSE and AVX */
+#define XCR0_OPMASK     (1 << 5)
+#define XCR0_ZMM_HI256  (1 << 6)
+#define XCR0_HI16_ZMM   (1 << 7)
+#define XCR0_TILECFG    (1 << 17)
+#define XCR0_TILEDATA   (1 << 18)
+
+extern u8 use_xsave;
+extern u64 xsave_xcr0;
 extern u64 extended_frame_size;
 static inline u64 total_frame_size(void)
 {
@@ -300,7 +340,6 @@ static inline void frame_disable_interrupts(context f)
     f[FRAME_FLAGS] &= ~U64_FROM_BIT(FLAG_INTERRUPT);
 }
 
-extern void xsave(context f);
 extern void clone_frame_pstate(context dest, context src);
 extern void init_frame(context f);
 
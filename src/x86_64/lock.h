@@ -1,48 +1,72 @@
 /* struct spinlock defined in machine.h */
 
 #if (defined(KERNEL) || defined(KLIB)) && defined(SMP_ENABLE)
+/* Queued spinlocks: the low byte of the lock word is the lock itself, and
+   bits 16-31 hold the tail of a queue of waiting cpus, each spinning on
+   its own queue entry (see kernel/lock.c). Uncontended acquisitions and
+   releases stay inline. */
+#define SPIN_LOCKED         1
+#define SPIN_LOCKED_SLOW    3   /* paravirtual: a halted waiter needs a kick */
+
+/* Reader-writer locks: the low byte of readers is the writer lock, then a
+   flag for a waiting writer and the count of readers. Contending readers
+   and writers are served in turn through the queue of the spinlock. */
+#define RW_WLOCKED          0xff
+#define RW_WAITING          0x100
+#define RW_WMASK            (RW_WLOCKED | RW_WAITING)
+#define RW_READER           0x200
+
+extern boolean spin_lock_pv;
+void spin_lock_slowpath(spinlock l);
+void spin_unlock_slowpath(spinlock l);
+void spin_rlock_slowpath(rw_spinlock l);
+void spin_wlock_slowpath(rw_spinlock l);
+
+static inline void spin_halt(void)
+{
+    /* with interrupts disabled, only a kick (or an NMI) ends the halt */
+    asm volatile("hlt" ::: "memory");
+}
+
 static inline boolean spin_try(spinlock l) {
-    u64 tmp = 1;
-    /* Is it worth the compare and branch to skip a pause? */
-    asm volatile("lock xchg %0, %1; cmp $1, %1; jne 1f; pause; 1:" : "+m"(*&l->w), "+r"(tmp) :: "memory");
-    return tmp == 0 ? true:false;
+    if (__sync_bool_compare_and_swap(&l->w, 0, SPIN_LOCKED))
+        return true;
+    kern_pause();
+    return false;
 }
 
 static inline void spin_lock(spinlock l) {
-    u64 tmp = 1;
-    asm volatile("1: lock xchg %0, %1; cmp $1, %1; jne 2f; pause; jmp 1b; 2:" : "+m"(*&l->w), "+r"(tmp) :: "memory");
+    if (!__sync_bool_compare_and_swap(&l->w, 0, SPIN_LOCKED))
+        spin_lock_slowpath(l);
 }
 
 static inline void spin_unlock(spinlock l) {
+    if (spin_lock_pv) {
+        if (!__sync_bool_compare_and_swap((u8 *)&l->w, SPIN_LOCKED, 0))
+            spin_unlock_slowpath(l);
+        return;
+    }
     compiler_barrier();
-    *(volatile u64 *)&l->w = 0;
+    *(volatile u8 *)&l->w = 0;
 }
 
 static inline void spin_rlock(rw_spinlock l) {
-    while (1) {
-        if (l->l.w) {
-            kern_pause();
-            continue;
-        }
-        fetch_and_add(&l->readers, 1);
-        if (!l->l.w)
-            return;
-        fetch_and_add(&l->readers, -1);
-    }
+    if (__sync_add_and_fetch(&l->readers, RW_READER) & RW_WMASK)
+        spin_rlock_slowpath(l);
 }
 
 static inline void spin_runlock(rw_spinlock l) {
-    fetch_and_add(&l->readers, -1);
+    __sync_fetch_and_sub(&l->readers, RW_READER);
 }
 
 static inline void spin_wlock(rw_spinlock l) {
-    spin_lock(&l->l);
-    while (l->readers)
-        kern_pause();
+    if (!__sync_bool_compare_and_swap(&l->readers, 0, RW_WLOCKED))
+        spin_wlock_slowpath(l);
 }
 
 static inline void spin_wunlock(rw_spinlock l) {
-    spin_unlock(&l->l);
+    compiler_barrier();
+    *(volatile u8 *)&l->readers = 0;
 }
 
 #else
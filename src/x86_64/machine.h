@@ -82,6 +82,11 @@ static inline __attribute__((always_inline)) u8 compare_and_swap_32(u32 *p, u32
     return __sync_bool_compare_and_swap(p, old, new);
 }
 
+static inline __attribute__((always_inline)) u8 compare_and_swap_64(u64 *p, u64 old, u64 new)
+{
+    return __sync_bool_compare_and_swap(p, old, new);
+}
+
 static inline __attribute__((always_inline)) void atomic_set_bit(u64 *target, u64 bit)
 {
     asm volatile("lock btsq %1, %0": "+m"(*target): "r"(bit) : "memory");
@@ -118,3 +123,27 @@ static inline __attribute__((always_inline)) void kern_pause(void)
 {
     asm volatile("pause");
 }
+
+/* Add nblocks 64-byte blocks at p into a one's complement sum, using a
+   single add-with-carry chain (lea and dec leave the carry flag intact). */
+static inline __attribute__((always_inline)) u64 ip_csum_blocks(const void *p, u64 nblocks, u64 sum)
+{
+    if (!nblocks)
+        return sum;
+    asm("clc\n"
+        "1: adcq 0(%[p]), %[sum]\n"
+        "adcq 8(%[p]), %[sum]\n"
+        "adcq 16(%[p]), %[sum]\n"
+        "adcq 24(%[p]), %[sum]\n"
+        "adcq 32(%[p]), %[sum]\n"
+        "adcq 40(%[p]), %[sum]\n"
+        "adcq 48(%[p]), %[sum]\n"
+        "adcq 56(%[p]), %[sum]\n"
+        "lea 64(%[p]), %[p]\n"
+        "dec %[n]\n"
+        "jnz 1b\n"
+        "adcq $0, %[sum]\n"
+        : [sum] "+r" (sum), [p] "+r" (p), [n] "+r" (nblocks)
+        : : "memory", "cc");
+    return sum;
+}
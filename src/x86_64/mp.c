@@ -23,40 +23,83 @@ static void (*start_callback)();
 #define mp_debug_u64(x)
 #endif
 
+#define CPUID_MONITOR (1<<3)
 #define CPUID_XSAVE (1<<26)
 #define CPUID_AVX (1<<28)
 
+/* cpuid 0xd, sub-leaf 1, eax */
+#define CPUID_XSAVEOPT (1<<0)
+#define CPUID_XSAVES (1<<3)
+
+#define XCR0_X87 (1<<0)
 #define XCR0_SSE (1<<1)
 #define XCR0_AVX (1<<2)
+#define XCR0_AVX512 (XCR0_OPMASK | XCR0_ZMM_HI256 | XCR0_HI16_ZMM)
+#define XCR0_AMX (XCR0_TILECFG | XCR0_TILEDATA)
+
+#define IA32_XSS_MSR 0xda0
+
 u8 use_xsave;
+u8 use_mwait;
 u64 extended_frame_size = 512;
+u64 xsave_xcr0 = XCR0_X87 | XCR0_SSE;
 
+/* Also run by each cpu as it starts, while others may be saving and
+   restoring extended state: the globals are only ever set to their final
+   values. */
 void init_cpu_features()
 {
     u64 cr;
     u32 v[4];
+    u8 xsave = XSAVE_FXSAVE;
+    boolean avx;
 
     cpuid(1, 0, v);
     if (v[2] & CPUID_XSAVE)
-        use_xsave = 1;
+        xsave = XSAVE_XSAVE;
+    if (v[2] & CPUID_MONITOR)
+        use_mwait = 1;
+    avx = (v[2] & CPUID_AVX) != 0;
     mov_from_cr("cr4", cr);
     cr |= CR4_PGE | CR4_OSFXSR | CR4_OSXMMEXCPT;
-    if (use_xsave)
+    if (xsave)
         cr |= CR4_OSXSAVE;
     mov_to_cr("cr4", cr);
     mov_from_cr("cr0", cr);
     cr |= C0_MP | C0_WP;
     cr &= ~C0_EM;
     mov_to_cr("cr0", cr);
-    if (use_xsave) {
-        xgetbv(0, &v[0], &v[1]);
-        v[0] |= XCR0_SSE;
-        if (v[2] & CPUID_AVX)
-            v[0] |= XCR0_AVX;
-        xsetbv(0, v[0], v[1]);
+    if (xsave) {
+        /* enable every user state component we know how to manage */
         cpuid(0xd, 0, v);
-        extended_frame_size = v[1];
+        u64 xcr0 = XCR0_X87 | XCR0_SSE;
+        if (avx) {
+            xcr0 |= v[0] & XCR0_AVX;
+            if ((v[0] & XCR0_AVX512) == XCR0_AVX512)
+                xcr0 |= XCR0_AVX512;
+        }
+        if ((v[0] & XCR0_AMX) == XCR0_AMX)
+            xcr0 |= XCR0_AMX;
+        xsetbv(0, xcr0, xcr0 >> 32);
+        xsave_xcr0 = xcr0;
+
+        /* Prefer XSAVES, which also leaves out components in their initial
+           state from a compacted layout, then XSAVEOPT; both skip writing
+           components left unmodified since the restore from the same
+           area. */
+        cpuid(0xd, 1, v);
+        if (v[0] & CPUID_XSAVES) {
+            write_msr(IA32_XSS_MSR, 0);
+            xsave = XSAVE_XSAVES;
+            extended_frame_size = v[1];
+        } else {
+            if (v[0] & CPUID_XSAVEOPT)
+                xsave = XSAVE_XSAVEOPT;
+            cpuid(0xd, 0, v);
+            extended_frame_size = v[1];
+        }
     }
+    use_xsave = xsave;
 }
 
 void cpu_init(int cpu)
@@ -89,8 +132,13 @@ static void __attribute__((noinline)) ap_new_stack()
     start_callback();
 }
 
+/* read as the cpuinfo of a cpu being started, for locks taken until
+   cpu_init() (see spin_lock_slowpath()) */
+static u64 ap_no_cpuinfo;
+
 void ap_start()
 {
+    write_msr(GS_MSR, u64_from_pointer(&ap_no_cpuinfo));
     apic_per_cpu_init();
     init_cpu_features();
     int id = cpuid_from_apicid(apic_id());
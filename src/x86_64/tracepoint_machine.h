@@ -0,0 +1,46 @@
+/* A site is a 5-byte NOP, patched to a jmp rel32 when enabled. The
+   alignment directive keeps the instruction from straddling an 8-byte
+   boundary (padding only when it would), so that it is replaced with a
+   single store; the other cpus are held off while it is (see
+   tracepoint_patch()). */
+#define TRACEPOINT_INSN_SIZE 5
+
+static inline __attribute__((always_inline)) boolean tracepoint_branch(tracepoint tp)
+{
+    asm goto(".balign 8, , 4\n"
+             "1: .byte 0x0f, 0x1f, 0x44, 0x00, 0x00\n"
+             ".pushsection .tracepoint_sites, \"a\"\n"
+             ".balign 8\n"
+             ".quad 1b, %l[enabled], %c0\n"
+             ".popsection\n"
+             : : "i" (tp) : : enabled);
+    return false;
+  enabled:
+    return true;
+}
+
+/* alias is a writable mapping of the instruction at code */
+static inline void tracepoint_patch_site(void *alias, u64 code, u64 target, boolean enable)
+{
+    int offset = code & 7;
+    assert(offset + TRACEPOINT_INSN_SIZE <= sizeof(u64));
+    volatile u64 *w = alias - offset;
+    u64 word = *w;
+    u8 *insn = (u8 *)&word + offset;
+    if (enable) {
+        s32 rel = target - (code + TRACEPOINT_INSN_SIZE);
+        insn[0] = 0xe9;
+        runtime_memcpy(insn + 1, &rel, sizeof(rel));
+    } else {
+        static const u8 nop5[TRACEPOINT_INSN_SIZE] = { 0x0f, 0x1f, 0x44, 0x00, 0x00 };
+        runtime_memcpy(insn, nop5, TRACEPOINT_INSN_SIZE);
+    }
+    *w = word;
+    memory_barrier();
+}
+
+/* cpuid serializes, discarding any stale prefetched instructions */
+static inline void tracepoint_sync_core(void)
+{
+    asm volatile("cpuid" ::: "%rax", "%rbx", "%rcx", "%rdx", "memory");
+}
@@ -412,6 +412,7 @@ static err_t xennet_linkoutput(struct netif *netif, struct pbuf *p)
 {
     xennet_dev xd = (xennet_dev)netif->state;
     xennet_debug("%s: id %d, pbuf %p", __func__, xd->dev.if_id, p);
+    trace_event(net_tx, p->tot_len, p, 0);
 
     xennet_tx_buf txb = xennet_get_txbuf(xd);
     if (txb == INVALID_ADDRESS)
@@ -633,6 +634,7 @@ closure_function(1, 0, void, xennet_rx_service_bh,
             assert(i);
             xennet_rx_buf rxb = struct_from_list(i, xennet_rx_buf, l);
             list_delete(i);
+            trace_event(net_rx, rxb->p.pbuf.tot_len, &rxb->p, 0);
             err_enum_t err = xd->netif->input((struct pbuf *)&rxb->p, xd->netif);
             if (err != ERR_OK) {
                 msg_err("xennet: rx drop by stack, err %d\n", err);
@@ -0,0 +1,105 @@
+/* cpu affinity enforcement and isolated cpus */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#define ISOLATED_CPU    1       /* as in affinity.manifest */
+#define ROUNDS          1000
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        printf("assertion failed at line %d: %s\n", __LINE__, #expr); \
+        exit(EXIT_FAILURE); \
+    } \
+} while (0)
+
+static int ncpus;
+
+static void *pinned(void *arg)
+{
+    int cpu = (long)arg;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    test_assert(sched_setaffinity(0, sizeof(set), &set) == 0);
+    /* each yield and sleep goes back through the scheduler, which must keep
+       the thread on its cpu */
+    for (int i = 0; i < ROUNDS; i++) {
+        if (i & 1)
+            sched_yield();
+        else
+            usleep(10);
+        test_assert(sched_getcpu() == cpu);
+    }
+    return 0;
+}
+
+static void *unpinned(void *arg)
+{
+    for (int i = 0; i < ROUNDS; i++) {
+        sched_yield();
+        test_assert(sched_getcpu() != ISOLATED_CPU);
+    }
+    return 0;
+}
+
+static void *inherited(void *arg)
+{
+    cpu_set_t set;
+    test_assert(sched_getaffinity(0, sizeof(set), &set) == 0);
+    test_assert(CPU_COUNT(&set) == 1 && CPU_ISSET(0, &set));
+    test_assert(sched_getcpu() == 0);
+    return 0;
+}
+
+static void test_errors(void)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    /* no cpu at all */
+    test_assert(syscall(SYS_sched_setaffinity, 0, sizeof(set), &set) == -1 && errno == EINVAL);
+    /* only cpus that aren't there */
+    CPU_SET(CPU_SETSIZE - 1, &set);
+    test_assert(syscall(SYS_sched_setaffinity, 0, sizeof(set), &set) == -1 && errno == EINVAL);
+}
+
+int main(int argc, char **argv)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    printf("%d cpus\n", ncpus);
+    test_errors();
+
+    /* threads start out allowed everywhere except on isolated cpus */
+    cpu_set_t set;
+    test_assert(sched_getaffinity(0, sizeof(set), &set) == 0);
+    for (int cpu = 0; cpu < ncpus; cpu++)
+        test_assert(CPU_ISSET(cpu, &set) == (ncpus <= ISOLATED_CPU || cpu != ISOLATED_CPU));
+
+    pthread_t threads[ncpus + 1];
+    for (long cpu = 0; cpu < ncpus; cpu++)
+        test_assert(pthread_create(&threads[cpu], 0, pinned, (void *)cpu) == 0);
+    if (ncpus > ISOLATED_CPU)
+        test_assert(pthread_create(&threads[ncpus], 0, unpinned, 0) == 0);
+    for (int cpu = 0; cpu < ncpus; cpu++)
+        test_assert(pthread_join(threads[cpu], 0) == 0);
+    if (ncpus > ISOLATED_CPU)
+        test_assert(pthread_join(threads[ncpus], 0) == 0);
+
+    /* a new thread inherits the affinity of its creator */
+    CPU_ZERO(&set);
+    CPU_SET(0, &set);
+    test_assert(sched_setaffinity(0, sizeof(set), &set) == 0);
+    pthread_t t;
+    test_assert(pthread_create(&t, 0, inherited, 0) == 0);
+    test_assert(pthread_join(t, 0) == 0);
+
+    printf("affinity test passed\n");
+    return EXIT_SUCCESS;
+}
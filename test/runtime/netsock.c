@@ -18,6 +18,8 @@
 
 #define NETSOCK_TEST_PEEK_COUNT 8
 
+#define NETSOCK_TEST_SPLICE_COUNT   (64 * 1024)
+
 #define test_assert(expr) do { \
     if (!(expr)) { \
         printf("Error: %s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
@@ -386,6 +388,74 @@ static void netsock_test_peek(void)
     test_assert(close(fd) == 0);
 }
 
+static void *netsock_test_splice_close_thread(void *arg)
+{
+    int port = (long)arg;
+    int fd;
+    struct sockaddr_in addr;
+    uint8_t buf[NETSOCK_TEST_SPLICE_COUNT];
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    test_assert(fd > 0);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    test_assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    for (int i = 0; i < sizeof(buf); i++)
+        buf[i] = i;
+    test_assert(write(fd, buf, sizeof(buf)) == sizeof(buf));
+    return (void *)(long)fd;
+}
+
+/* Tests closing either end of a local connection while the data written on it is still queued
+ * at the other end. */
+static void netsock_test_splice_close(void)
+{
+    int fd, conn_fd, client_fd;
+    struct sockaddr_in addr;
+    const int port = 1237;
+    pthread_t pt;
+    void *thread_ret;
+    uint8_t buf[1024];
+    int ret;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    test_assert(fd > 0);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    test_assert(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    test_assert(listen(fd, 1) == 0);
+
+    /* Writer closes before anything is read: all the data, then end of file, must be received. */
+    test_assert(pthread_create(&pt, NULL, netsock_test_splice_close_thread, (void *)(long)port) == 0);
+    conn_fd = accept(fd, NULL, NULL);
+    test_assert(conn_fd > 0);
+    test_assert(pthread_join(pt, &thread_ret) == 0);
+    test_assert(close((long)thread_ret) == 0);
+    for (int total = 0; total < NETSOCK_TEST_SPLICE_COUNT; total += ret) {
+        ret = read(conn_fd, buf, sizeof(buf));
+        test_assert(ret > 0);
+        for (int i = 0; i < ret; i++)
+            test_assert(buf[i] == (uint8_t)(total + i));
+    }
+    test_assert(read(conn_fd, buf, sizeof(buf)) == 0);
+    test_assert(close(conn_fd) == 0);
+
+    /* Reader closes with the data still queued: the writer must see the connection end. */
+    test_assert(pthread_create(&pt, NULL, netsock_test_splice_close_thread, (void *)(long)port) == 0);
+    conn_fd = accept(fd, NULL, NULL);
+    test_assert(conn_fd > 0);
+    test_assert(pthread_join(pt, &thread_ret) == 0);
+    client_fd = (long)thread_ret;
+    test_assert(close(conn_fd) == 0);
+    ret = read(client_fd, buf, sizeof(buf));
+    test_assert(ret == 0 || (ret == -1 && errno == ECONNRESET));
+    test_assert(close(client_fd) == 0);
+
+    test_assert(close(fd) == 0);
+}
+
 int main(int argc, char **argv)
 {
     setbuf(stdout, NULL);
@@ -396,6 +466,7 @@ int main(int argc, char **argv)
     netsock_test_connclosed();
     netsock_test_nonblocking_connect();
     netsock_test_peek();
+    netsock_test_splice_close();
     printf("Network socket tests OK\n");
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+#
+# Boot each in-guest performance program under QEMU, collect the results
+# it prints and optionally compare them against a baseline.
+#
+# Each program is run with "make run TARGET=<program>" from the top of
+# the tree (run-noaccel with --noaccel), so the kernel, tools and image
+# are built as needed. Result lines are tagged with PERF_RESULT (see
+# test/runtime/perf.h).
+#
+# usage: perf-run.py [-o results.json] [-b baseline.json] [-t percent]
+#                    [-r repeat] [--noaccel] [--qemu-flags FLAGS]
+#                    [--timeout seconds] [program ...]
+#
+# With a baseline, metrics that are worse by more than the threshold
+# are reported and the script exits with status 1. Units ending in "/s"
+# are rates, where higher is better; for all other units lower is
+# better. When a program is run more than once, the best result for
+# each metric is kept.
+
+import argparse
+import json
+import os
+import signal
+import statistics
+import subprocess
+import sys
+
+PROGRAMS = ['perf_syscall', 'perf_ipc', 'perf_tcp', 'perf_epoll', 'perf_fs', 'perf_xdp',
+            'perf_lock', 'perf_idle', 'perf_timer', 'perf_jitter', 'perf_sched']
+TAG = 'PERF_RESULT'
+ROOTDIR = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..'))
+
+
+def higher_is_better(unit):
+    return unit.endswith('/s')
+
+
+def run_program(program, args):
+    target = 'run-noaccel' if args.noaccel else 'run'
+    cmd = ['make', '-C', ROOTDIR, target, 'TARGET=' + program]
+    # the platform makefile assigns QEMU_FLAGS, so it must be overridden
+    # on the command line rather than through the environment
+    if args.qemu_flags:
+        cmd.append('QEMU_FLAGS=' + args.qemu_flags)
+    # QEMU runs as a child of make, so a run that times out is stopped
+    # by killing its process group
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                            universal_newlines=True, errors='replace', start_new_session=True)
+    try:
+        output = proc.communicate(timeout=args.timeout)[0]
+    except subprocess.TimeoutExpired:
+        os.killpg(proc.pid, signal.SIGKILL)
+        sys.stderr.write(proc.communicate()[0])
+        sys.stderr.write('%s timed out after %d seconds\n' % (program, args.timeout))
+        return None
+    results = []
+    for line in output.splitlines():
+        line = line.strip()
+        i = line.find(TAG)
+        if i < 0:
+            continue
+        # kernel messages on the console may be interleaved with a result
+        try:
+            results.append(json.loads(line[i + len(TAG):]))
+        except ValueError:
+            sys.stderr.write('%s: ignoring malformed result: %s\n' % (program, line))
+    if proc.returncode != 0 or not results:
+        sys.stderr.write(output)
+        sys.stderr.write('%s failed (exit status %d, %d results)\n' %
+                         (program, proc.returncode, len(results)))
+        return None
+    return results
+
+
+def merge_best(best, results):
+    for r in results:
+        key = (r['program'], r['name'])
+        prev = best.get(key)
+        if prev is None:
+            best[key] = dict(r, samples=[r['value']])
+            continue
+        prev['samples'].append(r['value'])
+        if higher_is_better(r['unit']) == (r['value'] > prev['value']):
+            prev['value'] = r['value']
+
+
+def compare(baseline, results, threshold):
+    base = {(r['program'], r['name']): r for r in baseline['results']}
+    regressions = 0
+    print('%-14s %-28s %14s %14s %9s' % ('program', 'metric', 'baseline', 'current', 'change'))
+    for r in results:
+        b = base.get((r['program'], r['name']))
+        if b is None:
+            print('%-14s %-28s %14s %14.3f %9s' % (r['program'], r['name'], '-', r['value'], 'new'))
+            continue
+        change = (r['value'] - b['value']) * 100.0 / b['value'] if b['value'] else 0.0
+        worse = -change if higher_is_better(r['unit']) else change
+        flag = ''
+        if worse > threshold:
+            flag = '  REGRESSION'
+            regressions += 1
+        print('%-14s %-28s %14.3f %14.3f %+8.1f%% %s%s' %
+              (r['program'], r['name'], b['value'], r['value'], change, r['unit'], flag))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description='run in-guest performance programs')
+    parser.add_argument('-o', '--output', help='write results as JSON to this file')
+    parser.add_argument('-b', '--baseline', help='compare against results from this file')
+    parser.add_argument('-t', '--threshold', type=float, default=10.0,
+                        help='regression threshold in percent (default 10)')
+    parser.add_argument('-r', '--repeat', type=int, default=1,
+                        help='number of runs per program (default 1)')
+    parser.add_argument('--noaccel', action='store_true', help='run without KVM acceleration')
+    parser.add_argument('--qemu-flags', help='additional QEMU flags, e.g. "-smp 4"')
+    parser.add_argument('--timeout', type=int, default=900,
+                        help='seconds to allow for each run, including the build (default 900)')
+    parser.add_argument('programs', nargs='*', default=PROGRAMS)
+    args = parser.parse_args()
+
+    best = {}
+    failed = False
+    for program in args.programs:
+        for i in range(args.repeat):
+            results = run_program(program, args)
+            if results is None:
+                failed = True
+                break
+            merge_best(best, results)
+
+    results = []
+    for r in best.values():
+        samples = r.pop('samples')
+        if len(samples) > 1:
+            r['stdev'] = statistics.stdev(samples)
+        results.append(r)
+    output = {'results': results}
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(output, f, indent=2)
+    else:
+        json.dump(output, sys.stdout, indent=2)
+        print()
+
+    regressions = 0
+    if args.baseline:
+        with open(args.baseline) as f:
+            regressions = compare(json.load(f), results, args.threshold)
+        if regressions:
+            print('%d regression(s) above %.1f%%' % (regressions, args.threshold))
+    sys.exit(1 if failed or regressions else 0)
+
+
+if __name__ == '__main__':
+    main()
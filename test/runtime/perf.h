@@ -0,0 +1,73 @@
+/* common helpers for in-guest performance programs
+
+   Each result is printed on its own line, prefixed with PERF_RESULT_TAG
+   and followed by a JSON object, so that it can be picked out of the
+   console output by the runner (test/runtime/perf-run.py). Units ending
+   in "/s" are rates (higher is better); all others are latencies or
+   costs (lower is better).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PERF_RESULT_TAG "PERF_RESULT"
+
+#define MB (1ull << 20)
+
+#define perf_fail(msg) \
+    do { perror(msg); exit(EXIT_FAILURE); } while (0)
+
+static inline unsigned long long perf_nsec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline void perf_report(const char *program, const char *name, double value,
+                               const char *unit)
+{
+    printf(PERF_RESULT_TAG " {\"program\": \"%s\", \"name\": \"%s\", \"value\": %.3f, "
+           "\"unit\": \"%s\"}\n", program, name, value, unit);
+}
+
+/* report the mean cost of one of n operations taking ns in total */
+static inline void perf_report_latency(const char *program, const char *name,
+                                       unsigned long long ns, unsigned long long n)
+{
+    perf_report(program, name, (double)ns / n, "ns");
+}
+
+static inline void perf_report_rate(const char *program, const char *name,
+                                    unsigned long long ns, unsigned long long n, const char *unit)
+{
+    perf_report(program, name, ns ? n * 1e9 / ns : 0, unit);
+}
+
+static inline void perf_report_throughput(const char *program, const char *name,
+                                          unsigned long long ns, unsigned long long bytes)
+{
+    perf_report(program, name, ns ? (double)bytes / MB * 1e9 / ns : 0, "MB/s");
+}
+
+/* -s <n> scales the amount of work done by each case */
+static inline unsigned long long perf_scale(int argc, char **argv)
+{
+    int c;
+    long long scale = 1;
+    while ((c = getopt(argc, argv, "s:")) != EOF) {
+        switch (c) {
+        case 's':
+            scale = strtoll(optarg, 0, 0);
+            if (scale > 0)
+                break;
+            /* fall through */
+        default:
+            fprintf(stderr, "usage: %s [-s scale]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return scale;
+}
@@ -0,0 +1,68 @@
+/* epoll cost as the number of watched descriptors grows */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "perf.h"
+
+#define PROGRAM "perf_epoll"
+
+#define WAIT_ITERATIONS 20000ull
+#define MAX_FDS         1024
+
+static unsigned long long scale;
+
+/* With nfds eventfds registered, repeatedly signal one of them and
+   collect the event, so the cost reflects how wakeup and event
+   harvesting scale with the size of the interest set. */
+static void epoll_scale(int nfds)
+{
+    char name[64];
+    int efd = epoll_create1(0);
+    if (efd < 0)
+        perf_fail("epoll_create1");
+    int *fds = malloc(nfds * sizeof(int));
+
+    unsigned long long start = perf_nsec();
+    for (int i = 0; i < nfds; i++) {
+        fds[i] = eventfd(0, EFD_NONBLOCK);
+        if (fds[i] < 0)
+            perf_fail("eventfd");
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = i };
+        if (epoll_ctl(efd, EPOLL_CTL_ADD, fds[i], &ev) < 0)
+            perf_fail("epoll_ctl");
+    }
+    snprintf(name, sizeof(name), "epoll_ctl_add_%d", nfds);
+    perf_report_latency(PROGRAM, name, perf_nsec() - start, nfds);
+
+    unsigned long long n = WAIT_ITERATIONS * scale;
+    uint64_t v = 1;
+    struct epoll_event ev;
+    start = perf_nsec();
+    for (unsigned long long i = 0; i < n; i++) {
+        int fd = fds[i % nfds];
+        if (write(fd, &v, sizeof(v)) != sizeof(v))
+            perf_fail("eventfd write");
+        if (epoll_wait(efd, &ev, 1, -1) != 1)
+            perf_fail("epoll_wait");
+        if (read(fds[ev.data.u32], &v, sizeof(v)) != sizeof(v))
+            perf_fail("eventfd read");
+    }
+    snprintf(name, sizeof(name), "epoll_signal_wait_%d", nfds);
+    perf_report_latency(PROGRAM, name, perf_nsec() - start, n);
+
+    for (int i = 0; i < nfds; i++)
+        close(fds[i]);
+    close(efd);
+    free(fds);
+}
+
+int main(int argc, char **argv)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    scale = perf_scale(argc, argv);
+    for (int nfds = 1; nfds <= MAX_FDS; nfds *= 8)
+        epoll_scale(nfds);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+/* file I/O throughput, fsync latency and page fault rate */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "perf.h"
+
+#define PROGRAM "perf_fs"
+
+#define FILE_BYTES        (32 * MB)
+#define FILE_CHUNK        (64 * 1024)
+#define FSYNC_ITERATIONS  100ull
+#define FSYNC_CHUNK       4096
+#define ANON_MAP_BYTES    (128 * MB)
+#define PAGE_BYTES        4096
+
+static unsigned long long scale;
+
+static void file_tests(void)
+{
+    unsigned long long bytes = FILE_BYTES * scale;
+    char *buf = malloc(FILE_CHUNK);
+    memset(buf, 0x5a, FILE_CHUNK);
+    int fd = open("perf_fs.dat", O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0)
+        perf_fail("open");
+
+    unsigned long long start = perf_nsec();
+    for (unsigned long long off = 0; off < bytes; off += FILE_CHUNK) {
+        if (write(fd, buf, FILE_CHUNK) != FILE_CHUNK)
+            perf_fail("write");
+    }
+    unsigned long long written = perf_nsec();
+    if (fsync(fd) < 0)
+        perf_fail("fsync");
+    unsigned long long synced = perf_nsec();
+    perf_report_throughput(PROGRAM, "file_write", written - start, bytes);
+    perf_report_throughput(PROGRAM, "file_write_fsync", synced - start, bytes);
+
+    if (lseek(fd, 0, SEEK_SET) < 0)
+        perf_fail("lseek");
+    start = perf_nsec();
+    for (unsigned long long off = 0; off < bytes; off += FILE_CHUNK) {
+        if (read(fd, buf, FILE_CHUNK) != FILE_CHUNK)
+            perf_fail("read");
+    }
+    perf_report_throughput(PROGRAM, "file_read_cached", perf_nsec() - start, bytes);
+
+    /* mapped read faults on the cached file */
+    char *p = mmap(0, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+        perf_fail("mmap file");
+    unsigned long long sum = 0;
+    start = perf_nsec();
+    for (unsigned long long off = 0; off < bytes; off += PAGE_BYTES)
+        sum += p[off];
+    perf_report_rate(PROGRAM, "file_map_fault", perf_nsec() - start, bytes / PAGE_BYTES,
+                     "faults/s");
+    if (sum == 0)
+        printf("unexpected file contents\n");
+    munmap(p, bytes);
+    close(fd);
+
+    /* small synchronous appends */
+    fd = open("perf_fs_sync.dat", O_CREAT | O_TRUNC | O_WRONLY, S_IRUSR | S_IWUSR);
+    if (fd < 0)
+        perf_fail("open");
+    unsigned long long n = FSYNC_ITERATIONS * scale;
+    start = perf_nsec();
+    for (unsigned long long i = 0; i < n; i++) {
+        if (write(fd, buf, FSYNC_CHUNK) != FSYNC_CHUNK)
+            perf_fail("write");
+        if (fsync(fd) < 0)
+            perf_fail("fsync");
+    }
+    perf_report_latency(PROGRAM, "write_fsync_4k", perf_nsec() - start, n);
+    close(fd);
+    unlink("perf_fs.dat");
+    unlink("perf_fs_sync.dat");
+    free(buf);
+}
+
+static void anon_fault_tests(void)
+{
+    char *p = mmap(0, ANON_MAP_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        perf_fail("mmap anonymous");
+    unsigned long long start = perf_nsec();
+    for (unsigned long long off = 0; off < ANON_MAP_BYTES; off += PAGE_BYTES)
+        p[off] = 1;
+    perf_report_rate(PROGRAM, "anon_write_fault", perf_nsec() - start,
+                     ANON_MAP_BYTES / PAGE_BYTES, "faults/s");
+    start = perf_nsec();
+    if (munmap(p, ANON_MAP_BYTES) < 0)
+        perf_fail("munmap");
+    perf_report_latency(PROGRAM, "anon_unmap_128m", perf_nsec() - start, 1);
+}
+
+int main(int argc, char **argv)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    scale = perf_scale(argc, argv);
+    file_tests();
+    anon_fault_tests();
+    return EXIT_SUCCESS;
+}
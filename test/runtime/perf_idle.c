@@ -0,0 +1,133 @@
+/* idle wakeup latency: futex ping-pong between two threads with idle gaps */
+#define _GNU_SOURCE
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include "perf.h"
+
+#define PROGRAM "perf_idle"
+
+#define IDLE_ITERATIONS 5000ull
+
+/* Each thread does "gap" microseconds of work, then wakes the other one
+   and waits to be woken in turn, so on a multi-cpu instance each wakeup
+   lands on a cpu that has been idle for about the gap. The latency is
+   measured from just before the futex wake to the return from the wait
+   on the other side. Short gaps should be served by idle polling without
+   a halt; with the longest gap the poll window should shrink so that the
+   share of cpu time not idle according to /proc/stat stays low. Run with "-smp 2" or
+   more. */
+
+static unsigned long long scale;
+
+struct side {
+    volatile int word;
+    volatile unsigned long long woken_at;
+} __attribute__((aligned(64)));
+
+static struct side sides[2];
+static unsigned long long gap_ns;
+static volatile unsigned long long latency_ns;
+
+static void futex_wait(volatile int *w, int v)
+{
+    while (*w == v)
+        syscall(SYS_futex, w, FUTEX_WAIT_PRIVATE, v, 0, 0, 0);
+}
+
+static void futex_wake(volatile int *w)
+{
+    __atomic_add_fetch(w, 1, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, w, FUTEX_WAKE_PRIVATE, 1, 0, 0, 0);
+}
+
+static void busy(unsigned long long ns)
+{
+    unsigned long long end = perf_nsec() + ns;
+    while (perf_nsec() < end)
+        ;
+}
+
+/* Wakes count up the word of a side: the i-th wait of a side returns
+   once its word has moved past i. */
+static void wait_woken(struct side *me, int i)
+{
+    futex_wait(&me->word, i);
+    __atomic_add_fetch(&latency_ns, perf_nsec() - me->woken_at, __ATOMIC_RELAXED);
+}
+
+static void wake(struct side *other)
+{
+    busy(gap_ns);
+    other->woken_at = perf_nsec();
+    futex_wake(&other->word);
+}
+
+static void *partner(void *arg)
+{
+    unsigned long long n = (unsigned long long)arg;
+    for (unsigned long long i = 0; i < n; i++) {
+        wait_woken(&sides[1], i);
+        wake(&sides[0]);
+    }
+    return 0;
+}
+
+/* sum of the idle column of the cpu line, in USER_HZ ticks */
+static unsigned long long idle_ticks(void)
+{
+    unsigned long long v[4] = {0};
+    FILE *f = fopen("/proc/stat", "r");
+    if (!f)
+        return 0;
+    if (fscanf(f, "cpu %llu %llu %llu %llu", &v[0], &v[1], &v[2], &v[3]) != 4)
+        v[3] = 0;
+    fclose(f);
+    return v[3];
+}
+
+static void idle_wakeup(unsigned long long gap_us, int ncpus)
+{
+    unsigned long long n = IDLE_ITERATIONS * scale;
+    pthread_t t;
+    gap_ns = gap_us * 1000;
+    latency_ns = 0;
+    sides[0].word = sides[1].word = 0;
+
+    /* the partner starts by waiting, so that the first wake finds it asleep */
+    if (pthread_create(&t, 0, partner, (void *)n))
+        perf_fail("pthread_create");
+    busy(1000000);
+    unsigned long long idle = idle_ticks();
+    unsigned long long start = perf_nsec();
+    for (unsigned long long i = 0; i < n; i++) {
+        wake(&sides[1]);
+        wait_woken(&sides[0], i);
+    }
+    pthread_join(t, 0);
+    unsigned long long ns = perf_nsec() - start;
+    idle = idle_ticks() - idle;
+
+    char metric[64];
+    snprintf(metric, sizeof(metric), "wakeup_gap_%lluus_latency", gap_us);
+    perf_report_latency(PROGRAM, metric, latency_ns, 2 * n);
+    snprintf(metric, sizeof(metric), "wakeup_gap_%lluus_busy", gap_us);
+    /* USER_HZ ticks of 10ms against the wall time of all cpus; polling
+       counts as busy */
+    double idle_pct = ns ? 100.0 * idle * 10000000ull / ((double)ns * ncpus) : 0;
+    perf_report(PROGRAM, metric, idle_pct < 100 ? 100 - idle_pct : 0, "%");
+}
+
+int main(int argc, char **argv)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    scale = perf_scale(argc, argv);
+    int ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpus < 1)
+        ncpus = 1;
+    idle_wakeup(0, ncpus);
+    idle_wakeup(20, ncpus);
+    idle_wakeup(100, ncpus);
+    idle_wakeup(1000, ncpus);
+    return 0;
+}
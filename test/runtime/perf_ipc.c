@@ -0,0 +1,326 @@
+/* pipe, unix domain socket and TCP loopback throughput and latency */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "perf.h"
+
+#define PROGRAM "perf_ipc"
+
+#define STREAM_BYTES   (64 * MB)
+#define STREAM_CHUNK   (64 * 1024)
+#define RR_ITERATIONS  20000ull
+#define TCP_PORT       5201
+
+/* many-connection request/response: client threads each cycle through
+   their share of the connections, which are served by one epoll thread */
+#define RR_MANY_CONNS       64
+#define RR_MANY_CLIENTS     4
+#define RR_MANY_ITERATIONS  5000ull
+
+static unsigned long long scale;
+
+struct stream_args {
+    int fd;
+    unsigned long long bytes;
+};
+
+static void write_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t rv = write(fd, buf, len);
+        if (rv < 0) {
+            if (errno == EINTR)
+                continue;
+            perf_fail("write");
+        }
+        buf += rv;
+        len -= rv;
+    }
+}
+
+static void read_all(int fd, char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t rv = read(fd, buf, len);
+        if (rv < 0) {
+            if (errno == EINTR)
+                continue;
+            perf_fail("read");
+        }
+        if (rv == 0) {
+            fprintf(stderr, "unexpected end of stream\n");
+            exit(EXIT_FAILURE);
+        }
+        buf += rv;
+        len -= rv;
+    }
+}
+
+static void *stream_writer(void *arg)
+{
+    struct stream_args *sa = arg;
+    char *buf = malloc(STREAM_CHUNK);
+    memset(buf, 0xa5, STREAM_CHUNK);
+    for (unsigned long long sent = 0; sent < sa->bytes; sent += STREAM_CHUNK)
+        write_all(sa->fd, buf, STREAM_CHUNK);
+    free(buf);
+    return 0;
+}
+
+/* time the transfer of bytes from wfd to rfd, with the writer on its own thread */
+static unsigned long long stream(int rfd, int wfd, unsigned long long bytes)
+{
+    struct stream_args sa = { .fd = wfd, .bytes = bytes };
+    char *buf = malloc(STREAM_CHUNK);
+    pthread_t pt;
+    unsigned long long start = perf_nsec();
+    if (pthread_create(&pt, 0, stream_writer, &sa))
+        perf_fail("pthread_create");
+    for (unsigned long long received = 0; received < bytes; received += STREAM_CHUNK)
+        read_all(rfd, buf, STREAM_CHUNK);
+    unsigned long long ns = perf_nsec() - start;
+    pthread_join(pt, 0);
+    free(buf);
+    return ns;
+}
+
+static void *echo_server(void *arg)
+{
+    int fd = *(int *)arg;
+    char c;
+    for (unsigned long long i = 0; i < RR_ITERATIONS * scale; i++) {
+        read_all(fd, &c, 1);
+        write_all(fd, &c, 1);
+    }
+    return 0;
+}
+
+/* one-byte request/response round trips */
+static unsigned long long request_response(int fd, int peer)
+{
+    unsigned long long n = RR_ITERATIONS * scale;
+    pthread_t pt;
+    char c = 'x';
+    if (pthread_create(&pt, 0, echo_server, &peer))
+        perf_fail("pthread_create");
+    unsigned long long start = perf_nsec();
+    for (unsigned long long i = 0; i < n; i++) {
+        write_all(fd, &c, 1);
+        read_all(fd, &c, 1);
+    }
+    unsigned long long ns = perf_nsec() - start;
+    pthread_join(pt, 0);
+    return ns;
+}
+
+static void pipe_tests(void)
+{
+    int fds[2];
+    if (pipe(fds) < 0)
+        perf_fail("pipe");
+    unsigned long long bytes = STREAM_BYTES * scale;
+    perf_report_throughput(PROGRAM, "pipe_stream", stream(fds[0], fds[1], bytes), bytes);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void unix_socket_tests(void)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        perf_fail("socketpair");
+    unsigned long long bytes = STREAM_BYTES * scale;
+    perf_report_throughput(PROGRAM, "unix_stream", stream(fds[0], fds[1], bytes), bytes);
+    unsigned long long n = RR_ITERATIONS * scale;
+    perf_report_latency(PROGRAM, "unix_rr", request_response(fds[0], fds[1]), n);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/* returns a connected pair of loopback TCP sockets */
+static void tcp_pair(int fds[2])
+{
+    int one = 1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(TCP_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (lfd < 0)
+        perf_fail("socket");
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        perf_fail("bind");
+    if (listen(lfd, 1) < 0)
+        perf_fail("listen");
+    fds[0] = socket(AF_INET, SOCK_STREAM, 0);
+    if (fds[0] < 0)
+        perf_fail("socket");
+    if (connect(fds[0], (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        perf_fail("connect");
+    fds[1] = accept(lfd, 0, 0);
+    if (fds[1] < 0)
+        perf_fail("accept");
+    close(lfd);
+    for (int i = 0; i < 2; i++)
+        setsockopt(fds[i], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+static void *epoll_echo_server(void *arg)
+{
+    int *fds = arg;
+    struct epoll_event ev, events[RR_MANY_CONNS];
+    int efd = epoll_create1(0);
+    if (efd < 0)
+        perf_fail("epoll_create1");
+    for (int i = 0; i < RR_MANY_CONNS; i++) {
+        ev.events = EPOLLIN;
+        ev.data.fd = fds[i];
+        if (epoll_ctl(efd, EPOLL_CTL_ADD, fds[i], &ev) < 0)
+            perf_fail("epoll_ctl");
+    }
+    int nopen = RR_MANY_CONNS;
+    while (nopen > 0) {
+        int n = epoll_wait(efd, events, RR_MANY_CONNS, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perf_fail("epoll_wait");
+        }
+        for (int i = 0; i < n; i++) {
+            char c;
+            int fd = events[i].data.fd;
+            ssize_t rv = read(fd, &c, 1);
+            if (rv == 1) {
+                write_all(fd, &c, 1);
+            } else if (rv == 0 || (rv < 0 && errno != EAGAIN && errno != EINTR)) {
+                epoll_ctl(efd, EPOLL_CTL_DEL, fd, 0);
+                close(fd);
+                nopen--;
+            }
+        }
+    }
+    close(efd);
+    return 0;
+}
+
+struct rr_client_args {
+    int *fds;
+    unsigned long long *samples;
+    unsigned long long n;
+};
+
+static void *rr_client(void *arg)
+{
+    struct rr_client_args *ca = arg;
+    int nfds = RR_MANY_CONNS / RR_MANY_CLIENTS;
+    char c = 'x';
+    for (unsigned long long i = 0; i < ca->n; i++) {
+        int fd = ca->fds[i % nfds];
+        unsigned long long start = perf_nsec();
+        write_all(fd, &c, 1);
+        read_all(fd, &c, 1);
+        ca->samples[i] = perf_nsec() - start;
+    }
+    return 0;
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *)a;
+    unsigned long long y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void tcp_many_rr(void)
+{
+    int one = 1;
+    int cfds[RR_MANY_CONNS], sfds[RR_MANY_CONNS];
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(TCP_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (lfd < 0)
+        perf_fail("socket");
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        perf_fail("bind");
+    if (listen(lfd, RR_MANY_CONNS) < 0)
+        perf_fail("listen");
+    for (int i = 0; i < RR_MANY_CONNS; i++) {
+        cfds[i] = socket(AF_INET, SOCK_STREAM, 0);
+        if (cfds[i] < 0)
+            perf_fail("socket");
+        if (connect(cfds[i], (struct sockaddr *)&addr, sizeof(addr)) < 0)
+            perf_fail("connect");
+        sfds[i] = accept(lfd, 0, 0);
+        if (sfds[i] < 0)
+            perf_fail("accept");
+        setsockopt(cfds[i], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        setsockopt(sfds[i], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    close(lfd);
+
+    pthread_t server, clients[RR_MANY_CLIENTS];
+    struct rr_client_args ca[RR_MANY_CLIENTS];
+    unsigned long long n = RR_MANY_ITERATIONS * scale;
+    unsigned long long *samples = malloc(RR_MANY_CLIENTS * n * sizeof(*samples));
+    if (!samples)
+        perf_fail("malloc");
+    if (pthread_create(&server, 0, epoll_echo_server, sfds))
+        perf_fail("pthread_create");
+    unsigned long long start = perf_nsec();
+    for (int i = 0; i < RR_MANY_CLIENTS; i++) {
+        ca[i].fds = cfds + i * (RR_MANY_CONNS / RR_MANY_CLIENTS);
+        ca[i].samples = samples + i * n;
+        ca[i].n = n;
+        if (pthread_create(&clients[i], 0, rr_client, &ca[i]))
+            perf_fail("pthread_create");
+    }
+    for (int i = 0; i < RR_MANY_CLIENTS; i++)
+        pthread_join(clients[i], 0);
+    unsigned long long ns = perf_nsec() - start;
+    for (int i = 0; i < RR_MANY_CONNS; i++)
+        close(cfds[i]);
+    pthread_join(server, 0);
+
+    unsigned long long total = RR_MANY_CLIENTS * n;
+    qsort(samples, total, sizeof(*samples), compare_samples);
+    perf_report_rate(PROGRAM, "tcp_many_rr_rate", ns, total, "req/s");
+    perf_report(PROGRAM, "tcp_many_rr_p50", samples[total / 2], "ns");
+    perf_report(PROGRAM, "tcp_many_rr_p99", samples[total * 99 / 100], "ns");
+    free(samples);
+}
+
+static void tcp_tests(void)
+{
+    int fds[2];
+    tcp_pair(fds);
+    unsigned long long n = RR_ITERATIONS * scale;
+    perf_report_latency(PROGRAM, "tcp_loopback_rr", request_response(fds[0], fds[1]), n);
+    unsigned long long bytes = STREAM_BYTES * scale;
+    perf_report_throughput(PROGRAM, "tcp_loopback_stream", stream(fds[1], fds[0], bytes), bytes);
+    close(fds[0]);
+    close(fds[1]);
+    tcp_many_rr();
+}
+
+int main(int argc, char **argv)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    scale = perf_scale(argc, argv);
+    pipe_tests();
+    unix_socket_tests();
+    tcp_tests();
+    return EXIT_SUCCESS;
+}
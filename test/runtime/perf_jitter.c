@@ -0,0 +1,98 @@
+/* scheduling jitter of a pinned thread, after cyclictest */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include "perf.h"
+
+#define PROGRAM "perf_jitter"
+
+#define INTERVAL_NS     200000ull
+#define CYCLES          5000ull
+#define SPIN_NS         1000000000ull
+#define LOAD_THREADS    2
+#define ISOLATED_CPU    1
+
+/* A thread pinned to cpu 1 (isolated in perf_jitter.manifest) wakes
+   up at fixed absolute intervals and measures how late it runs, then spins
+   reading the clock and measures the longest gap between two reads, which
+   is the longest interruption of the thread. Meanwhile, load threads on
+   the other cpus keep the kernel busy with syscalls and timers. Run with
+   "-smp 2" or more. */
+
+static unsigned long long scale;
+static volatile int stop;
+
+static void pin(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set))
+        perf_fail("sched_setaffinity");
+}
+
+static void *load(void *arg)
+{
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 50000 };
+    while (!stop) {
+        for (int i = 0; i < 100; i++)
+            syscall(SYS_getppid);
+        nanosleep(&ts, 0);
+    }
+    return 0;
+}
+
+static void timer_latency(void)
+{
+    unsigned long long n = CYCLES * scale, total = 0, max = 0;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (unsigned long long i = 0; i < n; i++) {
+        next.tv_nsec += INTERVAL_NS;
+        if (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, 0))
+            ;
+        unsigned long long late = perf_nsec() - (next.tv_sec * 1000000000ull + next.tv_nsec);
+        total += late;
+        if (late > max)
+            max = late;
+    }
+    perf_report_latency(PROGRAM, "timer_latency", total, n);
+    perf_report(PROGRAM, "timer_latency_max", max, "ns");
+}
+
+static void spin_gap(void)
+{
+    unsigned long long start = perf_nsec(), last = start, max = 0;
+    while (last - start < SPIN_NS * scale) {
+        unsigned long long t = perf_nsec();
+        if (t - last > max)
+            max = t - last;
+        last = t;
+    }
+    perf_report(PROGRAM, "spin_gap_max", max, "ns");
+}
+
+int main(int argc, char **argv)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    scale = perf_scale(argc, argv);
+    int ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpus < 1)
+        ncpus = 1;
+    pthread_t t[LOAD_THREADS];
+    for (int i = 0; i < LOAD_THREADS; i++)
+        if (pthread_create(&t[i], 0, load, 0))
+            perf_fail("pthread_create");
+    pin(ncpus > ISOLATED_CPU ? ISOLATED_CPU : 0);
+    timer_latency();
+    spin_gap();
+    stop = 1;
+    for (int i = 0; i < LOAD_THREADS; i++)
+        pthread_join(t[i], 0);
+    return 0;
+}
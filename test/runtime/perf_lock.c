@@ -0,0 +1,100 @@
+/* kernel lock scaling: syscall rate as the number of contending threads grows */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "perf.h"
+
+#define PROGRAM "perf_lock"
+
+#define LOCK_ITERATIONS 200000ull
+#define MAX_THREADS     64
+
+/* Every syscall takes the kernel lock, and mapping changes also take the
+   vmap and heap locks, so with one thread per cpu the rate is bound by
+   lock handoffs. Threads run for a fixed number of operations each; the
+   spread between the fastest and the slowest thread shows how fairly the
+   lock is granted. Run with "-smp <n>" to scale, and with more threads
+   than vcpus on the host for paravirtual spinlocks to matter. */
+
+static unsigned long long scale;
+static volatile int go;
+
+struct worker {
+    pthread_t t;
+    int op;
+    unsigned long long ns;
+};
+
+enum { OP_GETPID, OP_MMAP };
+
+static void *worker_run(void *arg)
+{
+    struct worker *w = arg;
+    unsigned long long n = LOCK_ITERATIONS * scale;
+    while (!go)
+        ;
+    unsigned long long start = perf_nsec();
+    for (unsigned long long i = 0; i < n; i++) {
+        if (w->op == OP_GETPID) {
+            syscall(SYS_getpid);
+        } else {
+            void *p = mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                perf_fail("mmap");
+            munmap(p, 4096);
+        }
+    }
+    w->ns = perf_nsec() - start;
+    return 0;
+}
+
+static void lock_scaling(const char *name, int op, int nthreads)
+{
+    static struct worker workers[MAX_THREADS];
+    go = 0;
+    for (int i = 0; i < nthreads; i++) {
+        workers[i].op = op;
+        if (pthread_create(&workers[i].t, 0, worker_run, &workers[i]))
+            perf_fail("pthread_create");
+    }
+    unsigned long long start = perf_nsec();
+    go = 1;
+    unsigned long long min = ~0ull, max = 0;
+    for (int i = 0; i < nthreads; i++) {
+        pthread_join(workers[i].t, 0);
+        if (workers[i].ns < min)
+            min = workers[i].ns;
+        if (workers[i].ns > max)
+            max = workers[i].ns;
+    }
+    unsigned long long ns = perf_nsec() - start;
+
+    char metric[64];
+    snprintf(metric, sizeof(metric), "%s_threads_%d_rate", name, nthreads);
+    perf_report_rate(PROGRAM, metric, ns, LOCK_ITERATIONS * scale * nthreads, "ops/s");
+    if (nthreads > 1) {
+        snprintf(metric, sizeof(metric), "%s_threads_%d_spread", name, nthreads);
+        perf_report(PROGRAM, metric, max ? 100.0 * (max - min) / max : 0, "%");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    scale = perf_scale(argc, argv);
+    int ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpus < 1)
+        ncpus = 1;
+    for (int n = 1; n <= MAX_THREADS / 2; n *= 2) {
+        lock_scaling("getpid", OP_GETPID, n);
+        lock_scaling("mmap_munmap", OP_MMAP, n);
+        if (n >= ncpus)
+            break;
+    }
+    /* oversubscribed */
+    if (2 * ncpus <= MAX_THREADS)
+        lock_scaling("getpid", OP_GETPID, 2 * ncpus);
+    return 0;
+}
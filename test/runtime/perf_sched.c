@@ -0,0 +1,295 @@
+/* scheduling policies: real-time and I/O wakeup latency, priority
+   inversion and weighted fair share */
+#define _GNU_SOURCE
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "perf.h"
+
+#define PROGRAM "perf_sched"
+
+#define MAX_CPUS        64
+#define INTERVAL_NS     1000000ull
+#define CYCLES          1000ull
+#define INVERSION_ROUNDS 50ull
+#define HOLD_NS         200000ull
+#define SHARE_NS        1000000000ull
+#define RT_PRIORITY     50
+#define HOGS_PER_CPU    2
+#define SHARE_RATIO     (1024.0 / 335)
+
+/* Cases:
+   - a thread sleeping at fixed absolute intervals, with every cpu kept
+     busy by cpu-bound threads, measures how late it wakes up, under
+     SCHED_FIFO and then SCHED_OTHER; a real-time thread should preempt
+     the busy ones right away, while another one waits for a time slice to
+     end;
+   - a thread blocked reading a pipe, sharing a cpu with cpu-bound
+     threads, measures how long it takes to run once written to from
+     another cpu; being behind them in vruntime, it should preempt them;
+   - a SCHED_FIFO thread waits for a lock held by a nice 19 thread that
+     shares its cpu with cpu-bound nice 0 threads: the wait is a priority
+     inversion, bounded by the share of the cpu the lock holder gets;
+   - two cpu-bound threads at nice 0 and nice 5 share a cpu, and should
+     progress in the ratio of their weights, 1024 / 335; the deviation
+     from that ratio is reported.
+   Threads sharing a cpu are pinned to the last one. Run with "-smp 2" or
+   more. */
+
+static unsigned long long scale;
+static int ncpus;
+static volatile int stop;
+
+static void pin(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set))
+        perf_fail("sched_setaffinity");
+}
+
+static void set_policy(int policy, int priority)
+{
+    struct sched_param param = { .sched_priority = priority };
+    if (sched_setscheduler(0, policy, &param))
+        perf_fail("sched_setscheduler");
+}
+
+static void set_nice(int nice)
+{
+    if (setpriority(PRIO_PROCESS, 0, nice))
+        perf_fail("setpriority");
+}
+
+static void busy(unsigned long long ns)
+{
+    unsigned long long end = perf_nsec() + ns;
+    while (perf_nsec() < end)
+        ;
+}
+
+struct hog {
+    pthread_t t;
+    int cpu;                    /* to pin to, or -1 */
+    int nice;
+    volatile unsigned long long loops;
+};
+
+static void *hog(void *arg)
+{
+    struct hog *h = arg;
+    if (h->cpu >= 0)
+        pin(h->cpu);
+    set_nice(h->nice);
+    while (!stop)
+        h->loops++;
+    return 0;
+}
+
+static void start_hogs(struct hog *hogs, int n, int cpu, int nice)
+{
+    stop = 0;
+    for (int i = 0; i < n; i++) {
+        hogs[i].cpu = cpu;
+        hogs[i].nice = nice;
+        hogs[i].loops = 0;
+        if (pthread_create(&hogs[i].t, 0, hog, &hogs[i]))
+            perf_fail("pthread_create");
+    }
+}
+
+static void stop_hogs(struct hog *hogs, int n)
+{
+    stop = 1;
+    for (int i = 0; i < n; i++)
+        pthread_join(hogs[i].t, 0);
+}
+
+static void *wakeup_thread(void *arg)
+{
+    int policy = (long)arg;
+    const char *name = policy == SCHED_FIFO ? "fifo" : "other";
+    unsigned long long n = CYCLES * scale, total = 0, max = 0;
+    struct timespec next;
+    if (policy == SCHED_FIFO)
+        set_policy(SCHED_FIFO, RT_PRIORITY);
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (unsigned long long i = 0; i < n; i++) {
+        next.tv_nsec += INTERVAL_NS;
+        if (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, 0))
+            ;
+        unsigned long long late = perf_nsec() - (next.tv_sec * 1000000000ull + next.tv_nsec);
+        total += late;
+        if (late > max)
+            max = late;
+    }
+    char metric[64];
+    snprintf(metric, sizeof(metric), "%s_wakeup_latency", name);
+    perf_report_latency(PROGRAM, metric, total, n);
+    snprintf(metric, sizeof(metric), "%s_wakeup_latency_max", name);
+    perf_report(PROGRAM, metric, max, "ns");
+    return 0;
+}
+
+static void wakeup_latency(int policy)
+{
+    struct hog hogs[MAX_CPUS * HOGS_PER_CPU];
+    int nhogs = ncpus * HOGS_PER_CPU;
+    pthread_t t;
+    start_hogs(hogs, nhogs, -1, 0);
+    if (pthread_create(&t, 0, wakeup_thread, (void *)(long)policy))
+        perf_fail("pthread_create");
+    pthread_join(t, 0);
+    stop_hogs(hogs, nhogs);
+}
+
+static int io_pipe[2];
+
+static void *io_reader(void *arg)
+{
+    long cpu = (long)arg;
+    unsigned long long n = CYCLES * scale, total = 0, max = 0, sent;
+    pin(cpu);
+    for (unsigned long long i = 0; i < n; i++) {
+        if (read(io_pipe[0], &sent, sizeof(sent)) != sizeof(sent))
+            perf_fail("read");
+        unsigned long long late = perf_nsec() - sent;
+        total += late;
+        if (late > max)
+            max = late;
+    }
+    perf_report_latency(PROGRAM, "io_wakeup_latency", total, n);
+    perf_report(PROGRAM, "io_wakeup_latency_max", max, "ns");
+    return 0;
+}
+
+static void io_wakeup_latency(void)
+{
+    int cpu = ncpus - 1;
+    unsigned long long n = CYCLES * scale;
+    struct hog hogs[HOGS_PER_CPU];
+    pthread_t reader;
+    if (pipe(io_pipe))
+        perf_fail("pipe");
+    start_hogs(hogs, HOGS_PER_CPU, cpu, 0);
+    if (pthread_create(&reader, 0, io_reader, (void *)(long)cpu))
+        perf_fail("pthread_create");
+    pin(0);
+    for (unsigned long long i = 0; i < n; i++) {
+        struct timespec ts = { .tv_sec = 0, .tv_nsec = INTERVAL_NS };
+        nanosleep(&ts, 0);
+        unsigned long long sent = perf_nsec();
+        if (write(io_pipe[1], &sent, sizeof(sent)) != sizeof(sent))
+            perf_fail("write");
+    }
+    pthread_join(reader, 0);
+    stop_hogs(hogs, HOGS_PER_CPU);
+    close(io_pipe[0]);
+    close(io_pipe[1]);
+}
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int rounds;
+static volatile int held;       /* last round in which the lock was taken by the holder... */
+static volatile int taken;      /* ...and by the waiter */
+
+static void futex_wait(volatile int *w, int v)
+{
+    while (*w == v)
+        syscall(SYS_futex, w, FUTEX_WAIT_PRIVATE, v, 0, 0, 0);
+}
+
+static void futex_wake(volatile int *w, int v)
+{
+    __atomic_store_n(w, v, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, w, FUTEX_WAKE_PRIVATE, 1, 0, 0, 0);
+}
+
+static void *lock_holder(void *arg)
+{
+    long cpu = (long)arg;
+    pin(cpu);
+    set_nice(19);
+    for (int round = 1; round <= rounds; round++) {
+        pthread_mutex_lock(&lock);
+        futex_wake(&held, round);
+        busy(HOLD_NS);
+        pthread_mutex_unlock(&lock);
+        /* let the waiter take the lock before the next round */
+        futex_wait(&taken, round - 1);
+    }
+    return 0;
+}
+
+static void priority_inversion(void)
+{
+    int cpu = ncpus - 1;
+    unsigned long long total = 0, max = 0;
+    struct hog hogs[HOGS_PER_CPU];
+    pthread_t holder;
+    start_hogs(hogs, HOGS_PER_CPU, cpu, 0);
+    rounds = INVERSION_ROUNDS * scale;
+    held = taken = 0;
+    if (pthread_create(&holder, 0, lock_holder, (void *)(long)cpu))
+        perf_fail("pthread_create");
+    /* after creating the other threads, which would inherit the policy */
+    pin(cpu);
+    set_policy(SCHED_FIFO, RT_PRIORITY);
+    for (int round = 1; round <= rounds; round++) {
+        futex_wait(&held, round - 1);
+        unsigned long long start = perf_nsec();
+        pthread_mutex_lock(&lock);
+        unsigned long long wait = perf_nsec() - start;
+        pthread_mutex_unlock(&lock);
+        futex_wake(&taken, round);
+        total += wait;
+        if (wait > max)
+            max = wait;
+        /* as for a periodic task, sleep until the next round */
+        struct timespec ts = { .tv_sec = 0, .tv_nsec = INTERVAL_NS };
+        nanosleep(&ts, 0);
+    }
+    pthread_join(holder, 0);
+    stop_hogs(hogs, HOGS_PER_CPU);
+    set_policy(SCHED_OTHER, 0);
+    perf_report_latency(PROGRAM, "inversion_lock_wait", total, rounds);
+    perf_report(PROGRAM, "inversion_lock_wait_max", max, "ns");
+}
+
+static void fair_share(void)
+{
+    struct hog hogs[2];
+    int cpu = ncpus - 1;
+    start_hogs(hogs, 1, cpu, 0);
+    start_hogs(hogs + 1, 1, cpu, 5);
+    struct timespec ts = { .tv_sec = SHARE_NS * scale / 1000000000ull, .tv_nsec = 0 };
+    nanosleep(&ts, 0);
+    stop_hogs(hogs, 2);
+    double ratio = hogs[1].loops ? (double)hogs[0].loops / hogs[1].loops : 0;
+    double error = ratio / SHARE_RATIO - 1;
+    perf_report(PROGRAM, "nice_share_error", 100 * (error < 0 ? -error : error), "%");
+}
+
+int main(int argc, char **argv)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    scale = perf_scale(argc, argv);
+    ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpus < 1)
+        ncpus = 1;
+    if (ncpus > MAX_CPUS)
+        ncpus = MAX_CPUS;
+    wakeup_latency(SCHED_FIFO);
+    wakeup_latency(SCHED_OTHER);
+    io_wakeup_latency();
+    priority_inversion();
+    fair_share();
+    return 0;
+}
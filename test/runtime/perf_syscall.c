@@ -0,0 +1,159 @@
+/* syscall latency, reads that need not block and context switch cost */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <linux/futex.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include "perf.h"
+
+#define PROGRAM "perf_syscall"
+
+#define SYSCALL_ITERATIONS 1000000ull
+#define SWITCH_ITERATIONS  100000ull
+#define READY_BATCH        1024
+
+static unsigned long long scale;
+
+static int futex(int *uaddr, int op, int val)
+{
+    return syscall(SYS_futex, uaddr, op, val, 0, 0, 0);
+}
+
+static void syscall_latency(void)
+{
+    unsigned long long n = SYSCALL_ITERATIONS * scale;
+    unsigned long long start = perf_nsec();
+    for (unsigned long long i = 0; i < n; i++)
+        syscall(SYS_getpid);
+    perf_report_latency(PROGRAM, "getpid", perf_nsec() - start, n);
+
+    int word = 0;
+    start = perf_nsec();
+    for (unsigned long long i = 0; i < n; i++)
+        futex(&word, FUTEX_WAKE_PRIVATE, 1);
+    perf_report_latency(PROGRAM, "futex_wake_nowaiters", perf_nsec() - start, n);
+
+    start = perf_nsec();
+    for (unsigned long long i = 0; i < n; i++)
+        sched_yield();
+    perf_report_latency(PROGRAM, "sched_yield", perf_nsec() - start, n);
+}
+
+/* Reads of one byte from a descriptor with data already queued, which
+   complete without blocking; the data is written in batches, outside of
+   the timed loops. */
+static void ready_read_latency(const char *metric, int rfd, int wfd)
+{
+    unsigned long long n = SYSCALL_ITERATIONS * scale, ns = 0;
+    char buf[READY_BATCH];
+    memset(buf, 0, sizeof(buf));
+    for (unsigned long long i = 0; i < n; i += READY_BATCH) {
+        if (write(wfd, buf, sizeof(buf)) != sizeof(buf))
+            perf_fail("write");
+        unsigned long long start = perf_nsec();
+        for (int j = 0; j < READY_BATCH; j++)
+            if (read(rfd, buf, 1) != 1)
+                perf_fail("read");
+        ns += perf_nsec() - start;
+    }
+    perf_report_latency(PROGRAM, metric, ns, (n + READY_BATCH - 1) / READY_BATCH * READY_BATCH);
+    close(rfd);
+    close(wfd);
+}
+
+static void read_latency(void)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+        perf_fail("socketpair");
+    ready_read_latency("socket_read_ready", fds[0], fds[1]);
+    if (pipe(fds))
+        perf_fail("pipe");
+    ready_read_latency("pipe_read_ready", fds[0], fds[1]);
+}
+
+/* Two threads hand a token back and forth through a futex word; each
+   handoff requires the waiting thread to be woken and scheduled. In the
+   avx variant, each thread dirties the upper halves of the ymm registers
+   before passing the token, so that every switch has to save and restore
+   the AVX state as well. */
+static volatile int token;
+static int dirty_avx;
+
+#ifdef __x86_64__
+__attribute__((target("avx")))
+static void avx_dirty(void)
+{
+    asm volatile("vpcmpeqd %%ymm0, %%ymm0, %%ymm0\n"
+                 "vmovdqa %%ymm0, %%ymm1\n"
+                 "vmovdqa %%ymm0, %%ymm15\n"
+                 ::: "xmm0", "xmm1", "xmm15");
+}
+
+static int have_avx(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+}
+#else
+static void avx_dirty(void) {}
+static int have_avx(void) { return 0; }
+#endif
+
+static void token_wait(int val)
+{
+    while (__atomic_load_n(&token, __ATOMIC_ACQUIRE) != val)
+        futex((int *)&token, FUTEX_WAIT_PRIVATE, !val);
+}
+
+static void token_pass(int val)
+{
+    if (dirty_avx)
+        avx_dirty();
+    __atomic_store_n(&token, val, __ATOMIC_RELEASE);
+    futex((int *)&token, FUTEX_WAKE_PRIVATE, 1);
+}
+
+static void *switch_partner(void *arg)
+{
+    unsigned long long n = *(unsigned long long *)arg;
+    for (unsigned long long i = 0; i < n; i++) {
+        token_wait(1);
+        token_pass(0);
+    }
+    return 0;
+}
+
+static void context_switch(const char *metric)
+{
+    unsigned long long n = SWITCH_ITERATIONS * scale;
+    pthread_t pt;
+    token = 0;
+    if (pthread_create(&pt, 0, switch_partner, &n))
+        perf_fail("pthread_create");
+    unsigned long long start = perf_nsec();
+    for (unsigned long long i = 0; i < n; i++) {
+        token_pass(1);
+        token_wait(0);
+    }
+    unsigned long long ns = perf_nsec() - start;
+    pthread_join(pt, 0);
+    /* two switches per round trip */
+    perf_report_latency(PROGRAM, metric, ns, n * 2);
+}
+
+int main(int argc, char **argv)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    scale = perf_scale(argc, argv);
+    syscall_latency();
+    read_latency();
+    context_switch("futex_context_switch");
+    if (have_avx()) {
+        dirty_avx = 1;
+        context_switch("futex_context_switch_avx");
+    }
+    return EXIT_SUCCESS;
+}
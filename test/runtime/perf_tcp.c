@@ -0,0 +1,161 @@
+/* TCP request/response rate as the number of connections grows */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "perf.h"
+
+#define PROGRAM "perf_tcp"
+
+#define TCP_PORT        5202
+#define RR_ITERATIONS   20000ull
+
+/* Requests cycle through all connections, so that each segment is for a
+   different connection than the one before. The manifest disables the
+   splicing of local connections, for traffic to go through the stack. */
+static const int conn_counts[] = { 16, 1024, 8192 };
+#define MAX_CONNS       8192
+
+static unsigned long long scale;
+
+static void write_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t rv = write(fd, buf, len);
+        if (rv < 0) {
+            if (errno == EINTR)
+                continue;
+            perf_fail("write");
+        }
+        buf += rv;
+        len -= rv;
+    }
+}
+
+static void read_all(int fd, char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t rv = read(fd, buf, len);
+        if (rv < 0) {
+            if (errno == EINTR)
+                continue;
+            perf_fail("read");
+        }
+        if (rv == 0) {
+            fprintf(stderr, "unexpected EOF\n");
+            exit(EXIT_FAILURE);
+        }
+        buf += rv;
+        len -= rv;
+    }
+}
+
+struct server_args {
+    int *fds;
+    int n;
+};
+
+static void *epoll_echo_server(void *arg)
+{
+    struct server_args *sa = arg;
+    struct epoll_event ev, events[64];
+    int efd = epoll_create1(0);
+    if (efd < 0)
+        perf_fail("epoll_create1");
+    for (int i = 0; i < sa->n; i++) {
+        ev.events = EPOLLIN;
+        ev.data.fd = sa->fds[i];
+        if (epoll_ctl(efd, EPOLL_CTL_ADD, sa->fds[i], &ev) < 0)
+            perf_fail("epoll_ctl");
+    }
+    int nopen = sa->n;
+    while (nopen > 0) {
+        int n = epoll_wait(efd, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perf_fail("epoll_wait");
+        }
+        for (int i = 0; i < n; i++) {
+            char c;
+            int fd = events[i].data.fd;
+            ssize_t rv = read(fd, &c, 1);
+            if (rv == 1) {
+                write_all(fd, &c, 1);
+            } else if (rv == 0 || (rv < 0 && errno != EAGAIN && errno != EINTR)) {
+                epoll_ctl(efd, EPOLL_CTL_DEL, fd, 0);
+                close(fd);
+                nopen--;
+            }
+        }
+    }
+    close(efd);
+    return 0;
+}
+
+static void tcp_conns_rr(int nconns)
+{
+    static int cfds[MAX_CONNS], sfds[MAX_CONNS];
+    int one = 1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(TCP_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (lfd < 0)
+        perf_fail("socket");
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        perf_fail("bind");
+    if (listen(lfd, 16) < 0)
+        perf_fail("listen");
+    for (int i = 0; i < nconns; i++) {
+        cfds[i] = socket(AF_INET, SOCK_STREAM, 0);
+        if (cfds[i] < 0)
+            perf_fail("socket");
+        if (connect(cfds[i], (struct sockaddr *)&addr, sizeof(addr)) < 0)
+            perf_fail("connect");
+        sfds[i] = accept(lfd, 0, 0);
+        if (sfds[i] < 0)
+            perf_fail("accept");
+        setsockopt(cfds[i], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        setsockopt(sfds[i], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    close(lfd);
+
+    pthread_t server;
+    struct server_args sa = { .fds = sfds, .n = nconns };
+    if (pthread_create(&server, 0, epoll_echo_server, &sa))
+        perf_fail("pthread_create");
+    unsigned long long n = RR_ITERATIONS * scale;
+    char c = 'x';
+    unsigned long long start = perf_nsec();
+    for (unsigned long long i = 0; i < n; i++) {
+        int fd = cfds[i % nconns];
+        write_all(fd, &c, 1);
+        read_all(fd, &c, 1);
+    }
+    unsigned long long ns = perf_nsec() - start;
+    for (int i = 0; i < nconns; i++)
+        close(cfds[i]);
+    pthread_join(server, 0);
+
+    char name[64];
+    snprintf(name, sizeof(name), "tcp_conns_%d_rr_rate", nconns);
+    perf_report_rate(PROGRAM, name, ns, n, "req/s");
+}
+
+int main(int argc, char **argv)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    scale = perf_scale(argc, argv);
+    for (int i = 0; i < sizeof(conn_counts) / sizeof(conn_counts[0]); i++)
+        tcp_conns_rr(conn_counts[i]);
+    return 0;
+}
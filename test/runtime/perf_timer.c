@@ -0,0 +1,159 @@
+/* timer interrupt rate: tickless operation and coalescing of nearby timers */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include "perf.h"
+
+#define PROGRAM "perf_timer"
+
+#define MAX_CPUS        64
+#define PERIOD_NS       1000000000ull
+#define SLEEPERS        8
+#define SLEEP_NS        1000000ull
+#define SLEEP_SPREAD_NS 5000ull
+
+/* The local timer interrupts taken by each cpu are read from the LOC line
+   of /proc/interrupts, and each case reports the highest rate among the
+   cpus. A single busy thread, or none, should need no periodic tick at
+   all; threads sleeping for nearly the same time should share interrupts,
+   for less than one interrupt per wakeup. Run with "-smp 2" or more. */
+
+static unsigned long long scale;
+static int ncpus;
+static volatile int stop;
+
+static int timer_interrupts(unsigned long long *counts)
+{
+    char line[1024];
+    int n = 0;
+    FILE *f = fopen("/proc/interrupts", "r");
+    if (!f)
+        perf_fail("/proc/interrupts");
+    while (fgets(line, sizeof(line), f)) {
+        char *p = line;
+        while (*p == ' ')
+            p++;
+        if (strncmp(p, "LOC:", 4))
+            continue;
+        p += 4;
+        while (n < MAX_CPUS) {
+            char *end;
+            unsigned long long v = strtoull(p, &end, 10);
+            if (end == p)
+                break;
+            counts[n++] = v;
+            p = end;
+        }
+    }
+    fclose(f);
+    return n;
+}
+
+/* reports the highest rate, and returns the total, of interrupts since
+   the counts in before */
+static unsigned long long report_interrupts(const char *name, unsigned long long *before,
+                                            unsigned long long ns)
+{
+    unsigned long long after[MAX_CPUS], total = 0, max = 0;
+    int n = timer_interrupts(after);
+    for (int i = 0; i < n; i++) {
+        unsigned long long d = after[i] - before[i];
+        total += d;
+        if (d > max)
+            max = d;
+    }
+    char metric[64];
+    snprintf(metric, sizeof(metric), "%s_irq_per_cpu_sec", name);
+    perf_report(PROGRAM, metric, ns ? max * 1e9 / ns : 0, "irq");
+    return total;
+}
+
+static void sleep_ns(unsigned long long ns)
+{
+    struct timespec ts = { .tv_sec = ns / 1000000000ull, .tv_nsec = ns % 1000000000ull };
+    while (nanosleep(&ts, &ts) && ts.tv_nsec)
+        ;
+}
+
+static void *spinner(void *arg)
+{
+    while (!stop)
+        ;
+    return 0;
+}
+
+/* all cpus idle but for this thread sleeping */
+static void idle(void)
+{
+    unsigned long long before[MAX_CPUS];
+    timer_interrupts(before);
+    unsigned long long start = perf_nsec();
+    sleep_ns(PERIOD_NS * scale);
+    report_interrupts("idle", before, perf_nsec() - start);
+}
+
+/* nthreads threads spinning, plus this one sleeping */
+static void busy(const char *name, int nthreads)
+{
+    pthread_t t[MAX_CPUS * 2];
+    unsigned long long before[MAX_CPUS];
+    stop = 0;
+    for (int i = 0; i < nthreads; i++)
+        if (pthread_create(&t[i], 0, spinner, 0))
+            perf_fail("pthread_create");
+    timer_interrupts(before);
+    unsigned long long start = perf_nsec();
+    sleep_ns(PERIOD_NS * scale);
+    report_interrupts(name, before, perf_nsec() - start);
+    stop = 1;
+    for (int i = 0; i < nthreads; i++)
+        pthread_join(t[i], 0);
+}
+
+static unsigned long long wakeups;
+
+static void *sleeper(void *arg)
+{
+    unsigned long long ns = SLEEP_NS + (unsigned long long)arg * SLEEP_SPREAD_NS;
+    while (!stop) {
+        sleep_ns(ns);
+        __atomic_add_fetch(&wakeups, 1, __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+/* threads sleeping for nearly the same time, over and over */
+static void sleepers(void)
+{
+    pthread_t t[SLEEPERS];
+    unsigned long long before[MAX_CPUS];
+    stop = 0;
+    wakeups = 0;
+    timer_interrupts(before);
+    unsigned long long start = perf_nsec();
+    for (long i = 0; i < SLEEPERS; i++)
+        if (pthread_create(&t[i], 0, sleeper, (void *)i))
+            perf_fail("pthread_create");
+    sleep_ns(PERIOD_NS * scale);
+    stop = 1;
+    for (int i = 0; i < SLEEPERS; i++)
+        pthread_join(t[i], 0);
+    unsigned long long total = report_interrupts("sleepers", before, perf_nsec() - start);
+    perf_report(PROGRAM, "sleepers_irq_per_wakeup", wakeups ? (double)total / wakeups : 0, "irq");
+}
+
+int main(int argc, char **argv)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    scale = perf_scale(argc, argv);
+    ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpus < 1)
+        ncpus = 1;
+    if (ncpus > MAX_CPUS)
+        ncpus = MAX_CPUS;
+    idle();
+    busy("busy_one_thread", 1);
+    /* one thread more than cpus: some cpu has to share, with a tick */
+    busy("busy_overcommitted", ncpus + 1);
+    sleepers();
+    return 0;
+}
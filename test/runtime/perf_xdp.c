@@ -0,0 +1,302 @@
+/* Packet rate of AF_XDP sockets against the socket API */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <arpa/inet.h>
+#include <linux/if_xdp.h>
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <netinet/if_ether.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include "perf.h"
+
+#define PROGRAM "perf_xdp"
+
+/* Small UDP datagrams are sent to the discard port of the user-mode
+   network gateway, once with sendmmsg() and once as frames on the tx ring
+   of an AF_XDP socket bound to the first interface. There is no traffic
+   source in the guest to measure the receive side with. */
+
+#ifndef AF_XDP
+#define AF_XDP  44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+#define XDP_RX_FILTER   64
+
+struct xdp_rx_filter {
+    unsigned short ethertype;
+    unsigned char ip_proto;
+    unsigned char pad;
+    unsigned short dst_port;
+    unsigned short pad2;
+};
+
+#define XDP_IFNAME      "en1"
+#define XDP_GATEWAY     "10.0.2.2"
+#define UDP_DST_PORT    9
+#define UDP_SRC_PORT    5209
+#define PAYLOAD_LEN     18      /* for 64-byte frames with the FCS */
+#define FRAME_SIZE      2048
+#define RING_SIZE       1024
+#define TX_BATCH        32
+#define PACKETS         200000ull
+
+static unsigned long long scale;
+
+struct ring {
+    volatile unsigned int *producer;
+    volatile unsigned int *consumer;
+    void *desc;
+};
+
+static void ring_map(int fd, struct ring *r, struct xdp_ring_offset *off, off_t pgoff,
+                     size_t desc_size)
+{
+    void *m = mmap(NULL, off->desc + RING_SIZE * desc_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, pgoff);
+    if (m == MAP_FAILED)
+        perf_fail("mmap");
+    r->producer = m + off->producer;
+    r->consumer = m + off->consumer;
+    r->desc = m + off->desc;
+}
+
+static int xsk;
+static unsigned char *umem;
+static struct ring rx, tx, fill, comp;
+static unsigned char mac[ETH_ALEN], gw_mac[ETH_ALEN];
+static struct in_addr ip, gw;
+
+static void xsk_setup(void)
+{
+    size_t umem_len = 2 * RING_SIZE * FRAME_SIZE;
+    umem = mmap(NULL, umem_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (umem == MAP_FAILED)
+        perf_fail("mmap");
+    xsk = socket(AF_XDP, SOCK_RAW, 0);
+    if (xsk < 0)
+        perf_fail("socket");
+    struct xdp_umem_reg reg = { .addr = (unsigned long)umem, .len = umem_len,
+                                .chunk_size = FRAME_SIZE };
+    int entries = RING_SIZE;
+    if (setsockopt(xsk, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0 ||
+        setsockopt(xsk, SOL_XDP, XDP_RX_RING, &entries, sizeof(entries)) < 0 ||
+        setsockopt(xsk, SOL_XDP, XDP_TX_RING, &entries, sizeof(entries)) < 0 ||
+        setsockopt(xsk, SOL_XDP, XDP_UMEM_FILL_RING, &entries, sizeof(entries)) < 0 ||
+        setsockopt(xsk, SOL_XDP, XDP_UMEM_COMPLETION_RING, &entries, sizeof(entries)) < 0)
+        perf_fail("setsockopt");
+    struct xdp_mmap_offsets off;
+    socklen_t optlen = sizeof(off);
+    if (getsockopt(xsk, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0)
+        perf_fail("getsockopt");
+    ring_map(xsk, &rx, &off.rx, XDP_PGOFF_RX_RING, sizeof(struct xdp_desc));
+    ring_map(xsk, &tx, &off.tx, XDP_PGOFF_TX_RING, sizeof(struct xdp_desc));
+    ring_map(xsk, &fill, &off.fr, XDP_UMEM_PGOFF_FILL_RING, sizeof(__u64));
+    ring_map(xsk, &comp, &off.cr, XDP_UMEM_PGOFF_COMPLETION_RING, sizeof(__u64));
+
+    /* the first half of the UMEM receives, the second half transmits */
+    for (int i = 0; i < RING_SIZE; i++)
+        ((__u64 *)fill.desc)[i] = (__u64)i * FRAME_SIZE;
+    __atomic_store_n(fill.producer, RING_SIZE, __ATOMIC_RELEASE);
+    struct xdp_rx_filter filter = { .ethertype = ETHERTYPE_ARP };
+    if (setsockopt(xsk, SOL_XDP, XDP_RX_FILTER, &filter, sizeof(filter)) < 0)
+        perf_fail("setsockopt XDP_RX_FILTER");
+    struct sockaddr_xdp sxdp = { .sxdp_family = AF_XDP, .sxdp_flags = XDP_COPY,
+                                 .sxdp_ifindex = if_nametoindex(XDP_IFNAME) };
+    if (bind(xsk, (struct sockaddr *)&sxdp, sizeof(sxdp)) < 0)
+        perf_fail("bind");
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, XDP_IFNAME, IFNAMSIZ - 1);
+    if (ioctl(fd, SIOCGIFHWADDR, &ifr) < 0)
+        perf_fail("SIOCGIFHWADDR");
+    memcpy(mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+    if (ioctl(fd, SIOCGIFADDR, &ifr) < 0)
+        perf_fail("SIOCGIFADDR");
+    ip = ((struct sockaddr_in *)&ifr.ifr_addr)->sin_addr;
+    close(fd);
+    inet_aton(XDP_GATEWAY, &gw);
+}
+
+static void xsk_kick(void)
+{
+    while (sendto(xsk, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0) {
+        if (errno != EAGAIN && errno != ENOBUFS)
+            perf_fail("sendto");
+    }
+}
+
+/* the gateway address, resolved through the socket */
+static void xsk_resolve_gateway(void)
+{
+    __u64 addr = RING_SIZE * FRAME_SIZE;
+    struct ether_header *eh = (struct ether_header *)(umem + addr);
+    memset(eh->ether_dhost, 0xff, ETH_ALEN);
+    memcpy(eh->ether_shost, mac, ETH_ALEN);
+    eh->ether_type = htons(ETHERTYPE_ARP);
+    struct ether_arp *arp = (struct ether_arp *)(eh + 1);
+    memset(arp, 0, 60 - sizeof(*eh));
+    arp->arp_hrd = htons(ARPHRD_ETHER);
+    arp->arp_pro = htons(ETHERTYPE_IP);
+    arp->arp_hln = ETH_ALEN;
+    arp->arp_pln = 4;
+    arp->arp_op = htons(ARPOP_REQUEST);
+    memcpy(arp->arp_sha, mac, ETH_ALEN);
+    memcpy(arp->arp_spa, &ip, 4);
+    memcpy(arp->arp_tpa, &gw, 4);
+    struct xdp_desc *d = tx.desc;
+    d->addr = addr;
+    d->len = 60;
+    __atomic_store_n(tx.producer, 1, __ATOMIC_RELEASE);
+    xsk_kick();
+    *comp.consumer = *comp.producer;
+    for (;;) {
+        struct pollfd pfd = { .fd = xsk, .events = POLLIN };
+        if (poll(&pfd, 1, 5000) != 1) {
+            fprintf(stderr, "no ARP reply from " XDP_GATEWAY "\n");
+            exit(EXIT_FAILURE);
+        }
+        unsigned int cons = *rx.consumer;
+        unsigned int prod = __atomic_load_n(rx.producer, __ATOMIC_ACQUIRE);
+        for (; cons != prod; cons++) {
+            struct xdp_desc *rd = rx.desc + (cons % RING_SIZE) * sizeof(*rd);
+            struct ether_arp *rarp = (struct ether_arp *)(umem + rd->addr + sizeof(*eh));
+            if (rarp->arp_op == htons(ARPOP_REPLY) && !memcmp(rarp->arp_spa, &gw, 4)) {
+                memcpy(gw_mac, rarp->arp_sha, ETH_ALEN);
+                __atomic_store_n(rx.consumer, prod, __ATOMIC_RELEASE);
+                return;
+            }
+        }
+        __atomic_store_n(rx.consumer, cons, __ATOMIC_RELEASE);
+    }
+}
+
+static unsigned short ip_csum(void *hdr, int len)
+{
+    unsigned int sum = 0;
+    unsigned short *w = hdr;
+    for (; len > 1; len -= 2)
+        sum += *w++;
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return ~sum;
+}
+
+static unsigned int udp_frame(unsigned char *frame)
+{
+    struct ether_header *eh = (struct ether_header *)frame;
+    memcpy(eh->ether_dhost, gw_mac, ETH_ALEN);
+    memcpy(eh->ether_shost, mac, ETH_ALEN);
+    eh->ether_type = htons(ETHERTYPE_IP);
+    struct iphdr *iph = (struct iphdr *)(eh + 1);
+    memset(iph, 0, sizeof(*iph));
+    iph->version = 4;
+    iph->ihl = sizeof(*iph) / 4;
+    iph->tot_len = htons(sizeof(*iph) + sizeof(struct udphdr) + PAYLOAD_LEN);
+    iph->ttl = 64;
+    iph->protocol = IPPROTO_UDP;
+    iph->saddr = ip.s_addr;
+    iph->daddr = gw.s_addr;
+    iph->check = ip_csum(iph, sizeof(*iph));
+    struct udphdr *uh = (struct udphdr *)(iph + 1);
+    uh->source = htons(UDP_SRC_PORT);
+    uh->dest = htons(UDP_DST_PORT);
+    uh->len = htons(sizeof(*uh) + PAYLOAD_LEN);
+    uh->check = 0;
+    memset(uh + 1, 'x', PAYLOAD_LEN);
+    return sizeof(*eh) + sizeof(*iph) + sizeof(*uh) + PAYLOAD_LEN;
+}
+
+static void xdp_tx(void)
+{
+    __u64 base = RING_SIZE * FRAME_SIZE;
+    unsigned int len = 0;
+    for (int i = 0; i < RING_SIZE; i++)
+        len = udp_frame(umem + base + (__u64)i * FRAME_SIZE);
+
+    /* frames are taken from the completion ring as soon as they are back */
+    unsigned long long n = PACKETS * scale, sent = 0;
+    unsigned int prod = *tx.producer, comp_cons = *comp.consumer, free_frames = RING_SIZE;
+    __u64 frames[RING_SIZE];
+    for (int i = 0; i < RING_SIZE; i++)
+        frames[i] = base + (__u64)i * FRAME_SIZE;
+    unsigned long long start = perf_nsec();
+    while (sent < n) {
+        unsigned int comp_prod = __atomic_load_n(comp.producer, __ATOMIC_ACQUIRE);
+        for (; comp_cons != comp_prod; comp_cons++)
+            frames[free_frames++] = ((__u64 *)comp.desc)[comp_cons % RING_SIZE];
+        __atomic_store_n(comp.consumer, comp_cons, __ATOMIC_RELEASE);
+        unsigned int batch = TX_BATCH;
+        if (batch > free_frames)
+            batch = free_frames;
+        if (batch > n - sent)
+            batch = n - sent;
+        for (unsigned int i = 0; i < batch; i++, prod++) {
+            struct xdp_desc *d = tx.desc + (prod % RING_SIZE) * sizeof(*d);
+            d->addr = frames[--free_frames];
+            d->len = len;
+        }
+        __atomic_store_n(tx.producer, prod, __ATOMIC_RELEASE);
+        xsk_kick();
+        sent += batch;
+    }
+    unsigned long long ns = perf_nsec() - start;
+    perf_report_rate(PROGRAM, "xdp_tx_64_rate", ns, n, "pkt/s");
+}
+
+static void udp_sendmmsg(void)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        perf_fail("socket");
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(UDP_DST_PORT),
+                                .sin_addr = gw };
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        perf_fail("connect");
+    char payload[PAYLOAD_LEN];
+    memset(payload, 'x', sizeof(payload));
+    struct iovec iov = { .iov_base = payload, .iov_len = sizeof(payload) };
+    struct mmsghdr msgs[TX_BATCH];
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < TX_BATCH; i++) {
+        msgs[i].msg_hdr.msg_iov = &iov;
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    unsigned long long n = PACKETS * scale, sent = 0;
+    unsigned long long start = perf_nsec();
+    while (sent < n) {
+        unsigned int batch = n - sent < TX_BATCH ? n - sent : TX_BATCH;
+        int rv = sendmmsg(fd, msgs, batch, 0);
+        if (rv < 0) {
+            if (errno == ENOBUFS || errno == ENOMEM || errno == EAGAIN)
+                continue;
+            perf_fail("sendmmsg");
+        }
+        sent += rv;
+    }
+    unsigned long long ns = perf_nsec() - start;
+    close(fd);
+    perf_report_rate(PROGRAM, "udp_sendmmsg_64_rate", ns, n, "pkt/s");
+}
+
+int main(int argc, char **argv)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    scale = perf_scale(argc, argv);
+    xsk_setup();
+    xsk_resolve_gateway();
+    udp_sendmmsg();
+    xdp_tx();
+    close(xsk);
+    return 0;
+}
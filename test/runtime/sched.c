@@ -0,0 +1,167 @@
+/* scheduling policies, priorities and nice levels */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#define SPIN_NS         50000000ull
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        printf("assertion failed at line %d: %s\n", __LINE__, #expr); \
+        exit(EXIT_FAILURE); \
+    } \
+} while (0)
+
+static unsigned long long nsec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int set_policy(int policy, int priority)
+{
+    struct sched_param param = { .sched_priority = priority };
+    return syscall(SYS_sched_setscheduler, 0, policy, &param);
+}
+
+static void test_defaults(void)
+{
+    struct sched_param param;
+    test_assert(sched_getscheduler(0) == SCHED_OTHER);
+    test_assert(sched_getparam(0, &param) == 0 && param.sched_priority == 0);
+    errno = 0;
+    test_assert(getpriority(PRIO_PROCESS, 0) == 0 && errno == 0);
+    test_assert(sched_get_priority_min(SCHED_FIFO) == 1);
+    test_assert(sched_get_priority_max(SCHED_FIFO) == 99);
+    test_assert(sched_get_priority_min(SCHED_RR) == 1);
+    test_assert(sched_get_priority_max(SCHED_RR) == 99);
+    test_assert(sched_get_priority_min(SCHED_OTHER) == 0);
+    test_assert(sched_get_priority_max(SCHED_OTHER) == 0);
+    test_assert(sched_get_priority_max(-1) == -1 && errno == EINVAL);
+}
+
+static void test_errors(void)
+{
+    struct sched_param param = { .sched_priority = 1 };
+    /* priorities out of the range of the policy */
+    test_assert(set_policy(SCHED_FIFO, 0) == -1 && errno == EINVAL);
+    test_assert(set_policy(SCHED_RR, 100) == -1 && errno == EINVAL);
+    test_assert(set_policy(SCHED_OTHER, 1) == -1 && errno == EINVAL);
+    test_assert(set_policy(42, 0) == -1 && errno == EINVAL);
+    test_assert(syscall(SYS_sched_setscheduler, -1, SCHED_FIFO, &param) == -1 && errno == EINVAL);
+    test_assert(syscall(SYS_sched_setscheduler, 0x7fffffff, SCHED_FIFO, &param) == -1 &&
+                errno == ESRCH);
+    test_assert(syscall(SYS_sched_setscheduler, 0, SCHED_FIFO, 0) == -1 && errno == EINVAL);
+    test_assert(sched_getscheduler(0) == SCHED_OTHER);
+}
+
+static void test_policies(void)
+{
+    struct sched_param param;
+    struct timespec ts;
+    test_assert(set_policy(SCHED_FIFO, 10) == 0);
+    test_assert(sched_getscheduler(0) == SCHED_FIFO);
+    test_assert(sched_getparam(0, &param) == 0 && param.sched_priority == 10);
+    test_assert(sched_rr_get_interval(0, &ts) == 0 && ts.tv_sec == 0 && ts.tv_nsec == 0);
+
+    param.sched_priority = 20;
+    test_assert(sched_setparam(0, &param) == 0);
+    test_assert(sched_getscheduler(0) == SCHED_FIFO);
+    test_assert(sched_getparam(0, &param) == 0 && param.sched_priority == 20);
+
+    test_assert(set_policy(SCHED_RR, 30) == 0);
+    test_assert(sched_getscheduler(0) == SCHED_RR);
+    test_assert(sched_rr_get_interval(0, &ts) == 0 && (ts.tv_sec || ts.tv_nsec));
+
+    test_assert(set_policy(SCHED_OTHER, 0) == 0);
+    test_assert(sched_getscheduler(0) == SCHED_OTHER);
+    test_assert(set_policy(SCHED_BATCH, 0) == 0);
+    test_assert(sched_getscheduler(0) == SCHED_BATCH);
+    test_assert(set_policy(SCHED_OTHER, 0) == 0);
+}
+
+static void test_nice(void)
+{
+    test_assert(setpriority(PRIO_PROCESS, 0, 5) == 0);
+    errno = 0;
+    test_assert(getpriority(PRIO_PROCESS, 0) == 5 && errno == 0);
+    /* out of range values are clamped */
+    test_assert(setpriority(PRIO_PROCESS, 0, 100) == 0);
+    test_assert(getpriority(PRIO_PROCESS, 0) == 19);
+    test_assert(setpriority(PRIO_PROCESS, 0, -100) == 0);
+    test_assert(getpriority(PRIO_PROCESS, 0) == -20);
+    test_assert(setpriority(PRIO_PROCESS, 0x7fffffff, 0) == -1 && errno == ESRCH);
+    test_assert(setpriority(42, 0, 0) == -1 && errno == EINVAL);
+    test_assert(setpriority(PRIO_PROCESS, 0, 0) == 0);
+}
+
+static void *inherited(void *arg)
+{
+    struct sched_param param;
+    test_assert(sched_getscheduler(0) == SCHED_RR);
+    test_assert(sched_getparam(0, &param) == 0 && param.sched_priority == 5);
+    return 0;
+}
+
+static void test_inherit(void)
+{
+    pthread_t t;
+    test_assert(set_policy(SCHED_RR, 5) == 0);
+    test_assert(pthread_create(&t, 0, inherited, 0) == 0);
+    test_assert(pthread_join(t, 0) == 0);
+    test_assert(set_policy(SCHED_OTHER, 0) == 0);
+}
+
+static volatile unsigned long long low_count;
+static volatile int stop;
+
+static void *low(void *arg)
+{
+    while (!stop)
+        low_count++;
+    return 0;
+}
+
+/* A SCHED_FIFO thread running on a cpu keeps a SCHED_OTHER thread pinned
+   there from running at all. */
+static void test_preemption(void)
+{
+    cpu_set_t set;
+    pthread_t t;
+    CPU_ZERO(&set);
+    CPU_SET(0, &set);
+    test_assert(sched_setaffinity(0, sizeof(set), &set) == 0);
+    test_assert(pthread_create(&t, 0, low, 0) == 0);
+    while (!low_count)
+        sched_yield();
+    test_assert(set_policy(SCHED_FIFO, 50) == 0);
+    unsigned long long count = low_count;
+    unsigned long long end = nsec() + SPIN_NS;
+    while (nsec() < end)
+        test_assert(low_count == count);
+    test_assert(set_policy(SCHED_OTHER, 0) == 0);
+    stop = 1;
+    test_assert(pthread_join(t, 0) == 0);
+}
+
+int main(int argc, char **argv)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    test_defaults();
+    test_errors();
+    test_policies();
+    test_nice();
+    test_inherit();
+    test_preemption();
+    printf("sched test passed\n");
+    return EXIT_SUCCESS;
+}
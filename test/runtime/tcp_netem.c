@@ -0,0 +1,197 @@
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+/* TCP over a loopback interface with emulated latency and loss (see the
+   netem tuple in tcp_netem.manifest): transfers must complete intact with
+   each congestion control algorithm, and the TCP socket options must
+   behave as on Linux. */
+
+#ifndef MSG_FASTOPEN
+#define MSG_FASTOPEN    0x20000000
+#endif
+
+#define TCP_NETEM_PORT      1240
+#define TCP_NETEM_XFER_LEN  (1024 * 1024)
+#define TCP_NETEM_FO_MSG    "fast open"
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        printf("Error: %s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+        exit(EXIT_FAILURE); \
+    } \
+} while (0)
+
+static unsigned char xfer_byte(unsigned long off)
+{
+    return (off * 7 + (off >> 12)) & 0xff;
+}
+
+static int tcp_listen(const char *cc, int port)
+{
+    struct sockaddr_in addr;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    test_assert(fd >= 0);
+    int val = 1;
+    test_assert(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val)) == 0);
+    if (cc)
+        test_assert(setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, cc, strlen(cc)) == 0);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    test_assert(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    test_assert(listen(fd, 1) == 0);
+    return fd;
+}
+
+static void check_cc(int fd, const char *cc)
+{
+    char name[16];
+    socklen_t len = sizeof(name);
+    test_assert(getsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, name, &len) == 0);
+    test_assert(!strncmp(name, cc, len));
+}
+
+static void *xfer_receiver(void *arg)
+{
+    int lfd = (long)arg;
+    int fd = accept(lfd, NULL, NULL);
+    test_assert(fd >= 0);
+    unsigned char buf[8192];
+    unsigned long off = 0;
+    int rx;
+    while ((rx = read(fd, buf, sizeof(buf))) > 0) {
+        for (int i = 0; i < rx; i++, off++)
+            test_assert(buf[i] == xfer_byte(off));
+    }
+    test_assert(rx == 0);
+    test_assert(off == TCP_NETEM_XFER_LEN);
+    test_assert(close(fd) == 0);
+    return NULL;
+}
+
+static void tcp_netem_xfer(const char *cc)
+{
+    pthread_t pt;
+    struct sockaddr_in addr;
+    struct timespec start, end;
+    int lfd = tcp_listen(cc, TCP_NETEM_PORT);
+    test_assert(pthread_create(&pt, NULL, xfer_receiver, (void *)(long)lfd) == 0);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    test_assert(fd >= 0);
+    test_assert(setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, cc, strlen(cc) + 1) == 0);
+    check_cc(fd, cc);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(TCP_NETEM_PORT);
+    test_assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    check_cc(fd, cc);
+
+    unsigned char buf[16384];
+    unsigned long off = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (off < TCP_NETEM_XFER_LEN) {
+        int n = 0;
+        for (; n < sizeof(buf) && off + n < TCP_NETEM_XFER_LEN; n++)
+            buf[n] = xfer_byte(off + n);
+        int tx = write(fd, buf, n);
+        test_assert(tx > 0);
+        off += tx;
+    }
+    test_assert(close(fd) == 0);
+    test_assert(pthread_join(pt, NULL) == 0);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    test_assert(close(lfd) == 0);
+    unsigned long long ns = (end.tv_sec - start.tv_sec) * 1000000000ull +
+        end.tv_nsec - start.tv_nsec;
+    printf("%s: %d bytes in %llu ms\n", cc, TCP_NETEM_XFER_LEN, ns / 1000000);
+}
+
+static void check_opt(int fd, int opt, int val)
+{
+    int ret;
+    socklen_t len = sizeof(ret);
+    test_assert(setsockopt(fd, IPPROTO_TCP, opt, &val, sizeof(val)) == 0);
+    test_assert(getsockopt(fd, IPPROTO_TCP, opt, &ret, &len) == 0);
+    test_assert(len == sizeof(ret) && !!ret == !!val);
+}
+
+static void tcp_netem_opts(void)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    test_assert(fd >= 0);
+    check_opt(fd, TCP_NODELAY, 1);
+    check_opt(fd, TCP_NODELAY, 0);
+    check_opt(fd, TCP_CORK, 1);
+    check_opt(fd, TCP_CORK, 0);
+    check_opt(fd, TCP_QUICKACK, 1);
+    test_assert(setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, "nonexistent", 11) == -1 &&
+                errno == ENOENT);
+    test_assert(close(fd) == 0);
+
+    fd = tcp_listen(0, TCP_NETEM_PORT);
+    check_opt(fd, TCP_FASTOPEN, 16);
+    test_assert(close(fd) == 0);
+}
+
+static void *fastopen_receiver(void *arg)
+{
+    int lfd = (long)arg;
+    int fd = accept(lfd, NULL, NULL);
+    test_assert(fd >= 0);
+    char buf[sizeof(TCP_NETEM_FO_MSG)];
+    int off = 0, rx;
+    while (off < sizeof(buf) && (rx = read(fd, buf + off, sizeof(buf) - off)) > 0)
+        off += rx;
+    test_assert(off == sizeof(buf) && !strcmp(buf, TCP_NETEM_FO_MSG));
+    test_assert(write(fd, buf, sizeof(buf)) == sizeof(buf));
+    test_assert(close(fd) == 0);
+    return NULL;
+}
+
+static void tcp_netem_fastopen(void)
+{
+    pthread_t pt;
+    struct sockaddr_in addr;
+    int lfd = tcp_listen(0, TCP_NETEM_PORT);
+    int qlen = 16;
+    test_assert(setsockopt(lfd, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen)) == 0);
+    test_assert(pthread_create(&pt, NULL, fastopen_receiver, (void *)(long)lfd) == 0);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    test_assert(fd >= 0);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(TCP_NETEM_PORT);
+    test_assert(sendto(fd, TCP_NETEM_FO_MSG, sizeof(TCP_NETEM_FO_MSG), MSG_FASTOPEN,
+                       (struct sockaddr *)&addr, sizeof(addr)) == sizeof(TCP_NETEM_FO_MSG));
+    char buf[sizeof(TCP_NETEM_FO_MSG)];
+    int off = 0, rx;
+    while (off < sizeof(buf) && (rx = read(fd, buf + off, sizeof(buf) - off)) > 0)
+        off += rx;
+    test_assert(off == sizeof(buf) && !strcmp(buf, TCP_NETEM_FO_MSG));
+    test_assert(close(fd) == 0);
+    test_assert(pthread_join(pt, NULL) == 0);
+    test_assert(close(lfd) == 0);
+}
+
+int main(int argc, char **argv)
+{
+    setbuf(stdout, NULL);
+
+    tcp_netem_opts();
+    tcp_netem_fastopen();
+    tcp_netem_xfer("reno");
+    tcp_netem_xfer("cubic");
+    printf("TCP network emulation tests OK\n");
+    return EXIT_SUCCESS;
+}
@@ -1,3 +1,4 @@
+#include <sys/resource.h>
 #include <sys/time.h>
 #include <sys/times.h>
 #include <sys/syscall.h>
@@ -223,6 +224,44 @@ static void test_cputime(void)
     } while ((thread_delta == 0) || (proc_delta == 0));
 }
 
+static long long rusage_nsec(void)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) < 0)
+        fail_perror("getrusage");
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * SECOND_NSEC +
+        (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ull;
+}
+
+static void *cputime_sleeper(void *arg)
+{
+    usleep(3 * SECOND_USEC / 10);
+    return 0;
+}
+
+/* CPU time accrues to threads only while they run. */
+static void test_cputime_accounting(void)
+{
+    pthread_t pt;
+    struct timespec start, tmp_ts;
+    if (pthread_create(&pt, 0, cputime_sleeper, 0))
+        fail_error("%s: pthread_create failed\n", __func__);
+    long long usage = rusage_nsec();
+    usleep(SECOND_USEC / 5);
+    long long idle = rusage_nsec() - usage;
+    if (idle > SECOND_NSEC / 20)
+        fail_error("%s: %lld nsec accounted while sleeping\n", __func__, idle);
+    usage = rusage_nsec();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &tmp_ts);
+    } while (delta_nsec(&start, &tmp_ts) < SECOND_NSEC / 10);
+    long long busy = rusage_nsec() - usage;
+    if (busy < SECOND_NSEC / 20)
+        fail_error("%s: %lld nsec accounted for 100 ms busy\n", __func__, busy);
+    pthread_join(pt, 0);
+}
+
 #define pertest_msg(x, ...) timetest_msg("test %d: " x, test->test_id, ##__VA_ARGS__);
 #define pertest_debug(x, ...) timetest_debug("test %d: " x, test->test_id, ##__VA_ARGS__);
 #define pertest_fail_perror(x, ...) fail_perror("test %d: " x, test->test_id, ##__VA_ARGS__);
@@ -761,6 +800,7 @@ main()
     test_posix_timers();
     test_itimers();
     test_cputime();
+    test_cputime_accounting();
     test_alarm();
     printf("time test passed\n");
     return EXIT_SUCCESS;
@@ -0,0 +1,234 @@
+#include <errno.h>
+#include <arpa/inet.h>
+#include <linux/if_xdp.h>
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <netinet/if_ether.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* AF_XDP socket bound to the receive queue of the first interface, with a
+   filter for ARP frames: an ARP request for the user-mode network gateway
+   is sent through the tx ring, and the reply must come back on the rx
+   ring while IP traffic keeps going to the stack. */
+
+#ifndef AF_XDP
+#define AF_XDP  44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+/* classifier for received frames, an extension of AF_XDP in this kernel */
+#define XDP_RX_FILTER   64
+
+struct xdp_rx_filter {
+    unsigned short ethertype;
+    unsigned char ip_proto;
+    unsigned char pad;
+    unsigned short dst_port;
+    unsigned short pad2;
+};
+
+#define XDP_IFNAME      "en1"
+#define XDP_GATEWAY     "10.0.2.2"
+#define XDP_FRAMES      64
+#define XDP_FRAME_SIZE  2048
+#define XDP_RING_SIZE   32
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        printf("Error: %s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+        exit(EXIT_FAILURE); \
+    } \
+} while (0)
+
+struct ring {
+    volatile unsigned int *producer;
+    volatile unsigned int *consumer;
+    volatile unsigned int *flags;
+    void *desc;
+    unsigned int mask;
+};
+
+static void ring_map(int fd, struct ring *r, struct xdp_ring_offset *off, off_t pgoff,
+                     size_t desc_size)
+{
+    size_t len = off->desc + XDP_RING_SIZE * desc_size;
+    void *m = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, pgoff);
+    test_assert(m != MAP_FAILED);
+    r->producer = m + off->producer;
+    r->consumer = m + off->consumer;
+    r->flags = m + off->flags;
+    r->desc = m + off->desc;
+    r->mask = XDP_RING_SIZE - 1;
+}
+
+int main(int argc, char **argv)
+{
+    setbuf(stdout, NULL);
+
+    int fd = socket(AF_XDP, SOCK_RAW, 0);
+    test_assert(fd >= 0);
+
+    /* bind needs a UMEM and rings */
+    struct sockaddr_xdp sxdp;
+    memset(&sxdp, 0, sizeof(sxdp));
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = if_nametoindex(XDP_IFNAME);
+    test_assert(sxdp.sxdp_ifindex > 0);
+    test_assert(bind(fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) == -1 && errno == EINVAL);
+
+    size_t umem_len = XDP_FRAMES * XDP_FRAME_SIZE;
+    unsigned char *umem = mmap(NULL, umem_len, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    test_assert(umem != MAP_FAILED);
+    struct xdp_umem_reg reg = {
+        .addr = (unsigned long)umem,
+        .len = umem_len,
+        .chunk_size = XDP_FRAME_SIZE - 1,
+    };
+    test_assert(setsockopt(fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) == -1 &&
+                errno == EINVAL);
+    reg.chunk_size = XDP_FRAME_SIZE;
+    test_assert(setsockopt(fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) == 0);
+    test_assert(setsockopt(fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) == -1 &&
+                errno == EBUSY);
+
+    int entries = XDP_RING_SIZE - 1;
+    test_assert(setsockopt(fd, SOL_XDP, XDP_RX_RING, &entries, sizeof(entries)) == -1 &&
+                errno == EINVAL);
+    entries = XDP_RING_SIZE;
+    test_assert(setsockopt(fd, SOL_XDP, XDP_RX_RING, &entries, sizeof(entries)) == 0);
+    test_assert(setsockopt(fd, SOL_XDP, XDP_TX_RING, &entries, sizeof(entries)) == 0);
+    test_assert(setsockopt(fd, SOL_XDP, XDP_UMEM_FILL_RING, &entries, sizeof(entries)) == 0);
+    test_assert(setsockopt(fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &entries,
+                           sizeof(entries)) == 0);
+
+    struct xdp_mmap_offsets off;
+    socklen_t optlen = sizeof(off);
+    test_assert(getsockopt(fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) == 0);
+    test_assert(optlen == sizeof(off));
+    struct ring rx, tx, fill, comp;
+    ring_map(fd, &rx, &off.rx, XDP_PGOFF_RX_RING, sizeof(struct xdp_desc));
+    ring_map(fd, &tx, &off.tx, XDP_PGOFF_TX_RING, sizeof(struct xdp_desc));
+    ring_map(fd, &fill, &off.fr, XDP_UMEM_PGOFF_FILL_RING, sizeof(__u64));
+    ring_map(fd, &comp, &off.cr, XDP_UMEM_PGOFF_COMPLETION_RING, sizeof(__u64));
+
+    /* frames 0 to XDP_RING_SIZE - 1 receive, the next one transmits */
+    for (int i = 0; i < XDP_RING_SIZE; i++)
+        ((__u64 *)fill.desc)[i] = i * XDP_FRAME_SIZE;
+    __atomic_store_n(fill.producer, XDP_RING_SIZE, __ATOMIC_RELEASE);
+
+    struct xdp_rx_filter filter = { .ethertype = ETHERTYPE_ARP };
+    test_assert(setsockopt(fd, SOL_XDP, XDP_RX_FILTER, &filter, sizeof(filter)) == 0);
+
+    sxdp.sxdp_flags = XDP_ZEROCOPY;
+    test_assert(bind(fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) == -1 && errno == EOPNOTSUPP);
+    sxdp.sxdp_flags = XDP_COPY;
+    sxdp.sxdp_queue_id = 1;
+    test_assert(bind(fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) == -1 && errno == EINVAL);
+    sxdp.sxdp_queue_id = 0;
+    test_assert(bind(fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) == 0);
+
+    /* the ARP request, from the interface addresses */
+    int ifd = socket(AF_INET, SOCK_DGRAM, 0);
+    test_assert(ifd >= 0);
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, XDP_IFNAME, IFNAMSIZ - 1);
+    test_assert(ioctl(ifd, SIOCGIFHWADDR, &ifr) == 0);
+    unsigned char mac[ETH_ALEN];
+    memcpy(mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+    test_assert(ioctl(ifd, SIOCGIFADDR, &ifr) == 0);
+    struct in_addr ip = ((struct sockaddr_in *)&ifr.ifr_addr)->sin_addr;
+    close(ifd);
+    struct in_addr gw;
+    test_assert(inet_aton(XDP_GATEWAY, &gw));
+
+    __u64 tx_addr = XDP_RING_SIZE * XDP_FRAME_SIZE;
+    unsigned char *frame = umem + tx_addr;
+    struct ether_header *eh = (struct ether_header *)frame;
+    memset(eh->ether_dhost, 0xff, ETH_ALEN);
+    memcpy(eh->ether_shost, mac, ETH_ALEN);
+    eh->ether_type = htons(ETHERTYPE_ARP);
+    struct ether_arp *arp = (struct ether_arp *)(eh + 1);
+    arp->arp_hrd = htons(ARPHRD_ETHER);
+    arp->arp_pro = htons(ETHERTYPE_IP);
+    arp->arp_hln = ETH_ALEN;
+    arp->arp_pln = 4;
+    arp->arp_op = htons(ARPOP_REQUEST);
+    memcpy(arp->arp_sha, mac, ETH_ALEN);
+    memcpy(arp->arp_spa, &ip, 4);
+    memset(arp->arp_tha, 0, ETH_ALEN);
+    memcpy(arp->arp_tpa, &gw, 4);
+    struct xdp_desc *d = tx.desc;
+    d->addr = tx_addr;
+    d->len = 60;    /* minimum frame size, without the FCS */
+    memset(frame + sizeof(*eh) + sizeof(*arp), 0, d->len - sizeof(*eh) - sizeof(*arp));
+    __atomic_store_n(tx.producer, 1, __ATOMIC_RELEASE);
+    test_assert(sendto(fd, NULL, 0, MSG_DONTWAIT, NULL, 0) == 0);
+    test_assert(*tx.consumer == 1);
+    test_assert(__atomic_load_n(comp.producer, __ATOMIC_ACQUIRE) == 1);
+    test_assert(((__u64 *)comp.desc)[0] == tx_addr);
+    *comp.consumer = 1;
+
+    /* frames other than ARP may arrive, but are not for the socket */
+    int replied = 0;
+    while (!replied) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        test_assert(poll(&pfd, 1, 5000) == 1 && (pfd.revents & POLLIN));
+        unsigned int cons = *rx.consumer;
+        unsigned int prod = __atomic_load_n(rx.producer, __ATOMIC_ACQUIRE);
+        test_assert(prod != cons);
+        for (; cons != prod; cons++) {
+            struct xdp_desc *rd = rx.desc + (cons & rx.mask) * sizeof(*rd);
+            test_assert(rd->addr < tx_addr && rd->len >= sizeof(*eh) + sizeof(*arp));
+            struct ether_header *reh = (struct ether_header *)(umem + rd->addr);
+            test_assert(reh->ether_type == htons(ETHERTYPE_ARP));
+            struct ether_arp *rarp = (struct ether_arp *)(reh + 1);
+            if (rarp->arp_op == htons(ARPOP_REPLY) && !memcmp(rarp->arp_spa, &gw, 4)) {
+                test_assert(!memcmp(rarp->arp_tha, mac, ETH_ALEN));
+                test_assert(!memcmp(reh->ether_dhost, mac, ETH_ALEN));
+                replied = 1;
+            }
+        }
+        __atomic_store_n(rx.consumer, cons, __ATOMIC_RELEASE);
+    }
+
+    struct xdp_statistics stats;
+    optlen = sizeof(stats);
+    test_assert(getsockopt(fd, SOL_XDP, XDP_STATISTICS, &stats, &optlen) == 0);
+    test_assert(stats.rx_dropped == 0 && stats.tx_invalid_descs == 0);
+
+    /* a frame outside of the UMEM is skipped and counted */
+    d = tx.desc + sizeof(*d);
+    d->addr = umem_len;
+    d->len = 60;
+    __atomic_store_n(tx.producer, 2, __ATOMIC_RELEASE);
+    test_assert(sendto(fd, NULL, 0, MSG_DONTWAIT, NULL, 0) == 0);
+    test_assert(*tx.consumer == 2 && *comp.producer == 1);
+    test_assert(getsockopt(fd, SOL_XDP, XDP_STATISTICS, &stats, &optlen) == 0);
+    test_assert(stats.tx_invalid_descs == 1);
+
+    /* the queue can be bound again once the socket is closed */
+    test_assert(close(fd) == 0);
+    fd = socket(AF_XDP, SOCK_RAW, 0);
+    test_assert(fd >= 0);
+    test_assert(setsockopt(fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) == 0);
+    test_assert(setsockopt(fd, SOL_XDP, XDP_TX_RING, &entries, sizeof(entries)) == 0);
+    test_assert(setsockopt(fd, SOL_XDP, XDP_UMEM_FILL_RING, &entries, sizeof(entries)) == 0);
+    test_assert(setsockopt(fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &entries,
+                           sizeof(entries)) == 0);
+    test_assert(bind(fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) == 0);
+    test_assert(close(fd) == 0);
+    test_assert(munmap(umem, umem_len) == 0);
+    printf("AF_XDP tests OK\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,170 @@
+/* extended (FPU / vector) register state test */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifdef __x86_64__
+#include <cpuid.h>
+
+#define ARCH_GET_XCOMP_SUPP 0x1021
+#define ARCH_REQ_XCOMP_PERM 0x1023
+
+#define XCR0_SSE        (1 << 1)
+#define XCR0_AVX        (1 << 2)
+#define XCR0_AVX512     (7 << 5)
+
+#define NTHREADS        4
+#define NROUNDS         2000
+#define SPIN_LOOPS      100000
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        printf("assertion failed at line %d: %s\n", __LINE__, #expr); \
+        exit(EXIT_FAILURE); \
+    } \
+} while (0)
+
+static unsigned long long xcr0;
+static int have_avx, have_avx512;
+
+static unsigned long long xgetbv(void)
+{
+    unsigned int lo, hi;
+    asm volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+static void check_features(void)
+{
+    unsigned int a, b, c, d;
+    __cpuid(1, a, b, c, d);
+    if (!(c & bit_OSXSAVE)) {
+        printf("no OSXSAVE, testing SSE state only\n");
+        return;
+    }
+    xcr0 = xgetbv();
+    printf("xcr0 0x%llx\n", xcr0);
+    test_assert(xcr0 & XCR0_SSE);
+    if (c & bit_AVX) {
+        test_assert(xcr0 & XCR0_AVX);
+        have_avx = 1;
+        __cpuid_count(7, 0, a, b, c, d);
+        if (b & bit_AVX512F) {
+            /* all three AVX-512 components are enabled together */
+            test_assert((xcr0 & XCR0_AVX512) == XCR0_AVX512);
+            have_avx512 = 1;
+        }
+    }
+
+    unsigned long long supp;
+    test_assert(syscall(SYS_arch_prctl, ARCH_GET_XCOMP_SUPP, &supp) == 0);
+    test_assert(supp == xcr0);
+    /* permission for a component that isn't enabled is refused */
+    test_assert(syscall(SYS_arch_prctl, ARCH_REQ_XCOMP_PERM, 63) != 0);
+}
+
+/* new threads start with the default control words */
+static void check_init_state(void)
+{
+    unsigned int mxcsr;
+    unsigned short fcw;
+    asm volatile("stmxcsr %0" : "=m"(mxcsr));
+    asm volatile("fnstcw %0" : "=m"(fcw));
+    test_assert((mxcsr & ~0x3f) == 0x1f80);
+    test_assert(fcw == 0x37f);
+}
+
+/* Each thread keeps its own pattern in a vector register across yields
+   (syscall entries, with other threads running in between) and across
+   busy loops (interrupted and preempted from user mode). zmm17 lives in
+   the Hi16_ZMM component, ymm9 in the AVX one. */
+__attribute__((target("avx512f")))
+static void roundtrip_zmm(unsigned char *in, unsigned char *out, unsigned long loops)
+{
+    unsigned long nr = SYS_sched_yield;
+    asm volatile("vmovdqu64 (%[in]), %%zmm17\n"
+                 "syscall\n"
+                 "1: dec %[loops]\n"
+                 "jns 1b\n"
+                 "vmovdqu64 %%zmm17, (%[out])\n"
+                 : "+a"(nr), [loops] "+r"(loops)
+                 : [in] "r"(in), [out] "r"(out)
+                 : "rcx", "r11", "xmm17", "memory");
+}
+
+__attribute__((target("avx")))
+static void roundtrip_ymm(unsigned char *in, unsigned char *out, unsigned long loops)
+{
+    unsigned long nr = SYS_sched_yield;
+    asm volatile("vmovdqu (%[in]), %%ymm9\n"
+                 "syscall\n"
+                 "1: dec %[loops]\n"
+                 "jns 1b\n"
+                 "vmovdqu %%ymm9, (%[out])\n"
+                 : "+a"(nr), [loops] "+r"(loops)
+                 : [in] "r"(in), [out] "r"(out)
+                 : "rcx", "r11", "xmm9", "memory");
+}
+
+static void roundtrip_xmm(unsigned char *in, unsigned char *out, unsigned long loops)
+{
+    unsigned long nr = SYS_sched_yield;
+    asm volatile("movdqu (%[in]), %%xmm9\n"
+                 "syscall\n"
+                 "1: dec %[loops]\n"
+                 "jns 1b\n"
+                 "movdqu %%xmm9, (%[out])\n"
+                 : "+a"(nr), [loops] "+r"(loops)
+                 : [in] "r"(in), [out] "r"(out)
+                 : "rcx", "r11", "xmm9", "memory");
+}
+
+static void *worker(void *arg)
+{
+    long id = (long)arg;
+    unsigned char in[64] __attribute__((aligned(64)));
+    unsigned char out[64] __attribute__((aligned(64)));
+    int len = have_avx512 ? 64 : have_avx ? 32 : 16;
+    for (int round = 0; round < NROUNDS; round++) {
+        for (int i = 0; i < sizeof(in); i++)
+            in[i] = id * 37 + round + i;
+        memset(out, 0, sizeof(out));
+        unsigned long loops = (round & 1) ? SPIN_LOOPS : 0;
+        if (have_avx512)
+            roundtrip_zmm(in, out, loops);
+        else if (have_avx)
+            roundtrip_ymm(in, out, loops);
+        else
+            roundtrip_xmm(in, out, loops);
+        test_assert(memcmp(in, out, len) == 0);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    check_init_state();
+    check_features();
+
+    pthread_t threads[NTHREADS];
+    for (long i = 0; i < NTHREADS; i++)
+        test_assert(pthread_create(&threads[i], NULL, worker, (void *)i) == 0);
+    for (int i = 0; i < NTHREADS; i++)
+        test_assert(pthread_join(threads[i], NULL) == 0);
+    printf("%s state preserved across %d switches in %d threads\n",
+           have_avx512 ? "zmm" : have_avx ? "ymm" : "xmm", NROUNDS, NTHREADS);
+    printf("xstate test passed\n");
+    return EXIT_SUCCESS;
+}
+#else
+int main(int argc, char *argv[])
+{
+    fprintf(stderr, "xstate test for x86_64 architecture only\n");
+    return EXIT_SUCCESS;
+}
+#endif
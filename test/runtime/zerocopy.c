@@ -0,0 +1,177 @@
+#include <errno.h>
+#include <time.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/* Zero-copy sends (SO_ZEROCOPY, MSG_ZEROCOPY) over TCP and UDP: data must
+   arrive intact even if the buffer is unmapped right after the send, and
+   every send must be reported once on the error queue. The manifest makes
+   loopback traffic go through the stack rather than being spliced. */
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY     60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY    0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY   5
+#endif
+
+#define ZC_TCP_PORT     1241
+#define ZC_UDP_PORT     1242
+#define ZC_SEND_LEN     (256 * 1024)
+#define ZC_SENDS        16
+#define ZC_DGRAM_LEN    1024
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        printf("Error: %s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+        exit(EXIT_FAILURE); \
+    } \
+} while (0)
+
+static unsigned char zc_byte(unsigned long off)
+{
+    return (off * 13 + (off >> 10)) & 0xff;
+}
+
+/* Reads notifications until all of n sends have been reported. */
+static void zc_completions(int fd, unsigned int n)
+{
+    unsigned int next = 0;
+    while (next < n) {
+        char control[64];
+        struct msghdr msg = { .msg_control = control, .msg_controllen = sizeof(control) };
+        int rv = recvmsg(fd, &msg, MSG_ERRQUEUE);
+        if (rv < 0) {
+            test_assert(errno == EAGAIN);
+            struct pollfd pfd = { .fd = fd, .events = 0 };
+            test_assert(poll(&pfd, 1, 5000) == 1 && (pfd.revents & POLLERR));
+            continue;
+        }
+        test_assert(msg.msg_flags & MSG_ERRQUEUE);
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+        test_assert(cm && cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR);
+        struct sock_extended_err *ee = (struct sock_extended_err *)CMSG_DATA(cm);
+        test_assert(ee->ee_errno == 0 && ee->ee_origin == SO_EE_ORIGIN_ZEROCOPY);
+        test_assert(ee->ee_info == next && ee->ee_data >= ee->ee_info && ee->ee_data < n);
+        next = ee->ee_data + 1;
+    }
+    char control[64];
+    struct msghdr msg = { .msg_control = control, .msg_controllen = sizeof(control) };
+    test_assert(recvmsg(fd, &msg, MSG_ERRQUEUE) == -1 && errno == EAGAIN);
+}
+
+static void *tcp_receiver(void *arg)
+{
+    int lfd = (long)arg;
+    int fd = accept(lfd, NULL, NULL);
+    test_assert(fd >= 0);
+    unsigned char buf[8192];
+    unsigned long off = 0;
+    int rx;
+    while ((rx = read(fd, buf, sizeof(buf))) > 0) {
+        for (int i = 0; i < rx; i++, off++)
+            test_assert(buf[i] == zc_byte(off % ZC_SEND_LEN));
+    }
+    test_assert(rx == 0);
+    test_assert(off == (unsigned long)ZC_SEND_LEN * ZC_SENDS);
+    test_assert(close(fd) == 0);
+    return NULL;
+}
+
+static void zc_tcp(void)
+{
+    pthread_t pt;
+    struct sockaddr_in addr;
+    int val = 1;
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    test_assert(lfd >= 0);
+    test_assert(setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val)) == 0);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(ZC_TCP_PORT);
+    test_assert(bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    test_assert(listen(lfd, 1) == 0);
+    test_assert(pthread_create(&pt, NULL, tcp_receiver, (void *)(long)lfd) == 0);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    test_assert(fd >= 0);
+    test_assert(setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &val, sizeof(val)) == 0);
+    socklen_t len = sizeof(val);
+    val = 0;
+    test_assert(getsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &val, &len) == 0 && val == 1);
+    test_assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+    /* Each send is from a fresh mapping, unmapped as soon as the call
+       returns: the pages must stay put until the data has been acked. */
+    unsigned int sends = 0;
+    for (int i = 0; i < ZC_SENDS; i++) {
+        unsigned char *buf = mmap(NULL, ZC_SEND_LEN, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        test_assert(buf != MAP_FAILED);
+        for (int j = 0; j < ZC_SEND_LEN; j++)
+            buf[j] = zc_byte(j);
+        int off = 0;
+        while (off < ZC_SEND_LEN) {
+            int tx = send(fd, buf + off, ZC_SEND_LEN - off, MSG_ZEROCOPY);
+            test_assert(tx > 0);
+            off += tx;
+            sends++;
+        }
+        test_assert(munmap(buf, ZC_SEND_LEN) == 0);
+    }
+    test_assert(shutdown(fd, SHUT_WR) == 0);
+    test_assert(pthread_join(pt, NULL) == 0);
+    zc_completions(fd, sends);
+    test_assert(close(fd) == 0);
+    test_assert(close(lfd) == 0);
+}
+
+static void zc_udp(void)
+{
+    struct sockaddr_in addr;
+    int val = 1;
+    int rfd = socket(AF_INET, SOCK_DGRAM, 0);
+    test_assert(rfd >= 0);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(ZC_UDP_PORT);
+    test_assert(bind(rfd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    test_assert(fd >= 0);
+    test_assert(setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &val, sizeof(val)) == 0);
+    unsigned char buf[ZC_DGRAM_LEN], rbuf[ZC_DGRAM_LEN];
+    for (int i = 0; i < ZC_SENDS; i++) {
+        for (int j = 0; j < ZC_DGRAM_LEN; j++)
+            buf[j] = zc_byte(i + j);
+        test_assert(sendto(fd, buf, sizeof(buf), MSG_ZEROCOPY, (struct sockaddr *)&addr,
+                           sizeof(addr)) == sizeof(buf));
+        test_assert(recv(rfd, rbuf, sizeof(rbuf), 0) == sizeof(rbuf));
+        test_assert(!memcmp(buf, rbuf, sizeof(buf)));
+    }
+    zc_completions(fd, ZC_SENDS);
+    test_assert(close(fd) == 0);
+    test_assert(close(rfd) == 0);
+}
+
+int main(int argc, char **argv)
+{
+    setbuf(stdout, NULL);
+
+    zc_tcp();
+    zc_udp();
+    printf("zero-copy tests OK\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+#
+# Compare two sets of benchmark results produced by the unit benchmark
+# harness (make -C test/unit bench), flagging cases whose median time
+# per operation increased by more than the given threshold.
+#
+# usage: bench-compare.py [-t percent] base.json new.json
+#
+# Exits with status 1 if any regressions are found.
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        results = json.load(f)
+    return {b['name']: b for b in results['benchmarks']}
+
+
+def main():
+    parser = argparse.ArgumentParser(description='compare benchmark results')
+    parser.add_argument('-t', '--threshold', type=float, default=10.0,
+                        help='regression threshold in percent (default 10)')
+    parser.add_argument('base')
+    parser.add_argument('new')
+    args = parser.parse_args()
+
+    base = load(args.base)
+    new = load(args.new)
+    regressions = 0
+    print('%-32s %12s %12s %9s' % ('benchmark', 'base ns/op', 'new ns/op', 'change'))
+    for name in base:
+        if name not in new:
+            print('%-32s %12.3f %12s %9s' % (name, base[name]['ns_per_op']['median'], '-', 'missing'))
+            continue
+        b = base[name]['ns_per_op']['median']
+        n = new[name]['ns_per_op']['median']
+        change = (n - b) * 100.0 / b if b else 0.0
+        flag = ''
+        if change > args.threshold:
+            flag = '  REGRESSION'
+            regressions += 1
+        elif change < -args.threshold:
+            flag = '  improved'
+        print('%-32s %12.3f %12.3f %+8.1f%%%s' % (name, b, n, change, flag))
+    for name in new:
+        if name not in base:
+            print('%-32s %12s %12.3f %9s' % (name, '-', new[name]['ns_per_op']['median'], 'new'))
+
+    if regressions:
+        print('%d regression(s) above %.1f%%' % (regressions, args.threshold))
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,153 @@
+#include <runtime.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define BENCH_DEFAULT_WARMUP     3
+#define BENCH_DEFAULT_ITERATIONS 10
+
+struct bench {
+    heap h;
+    const char *suite;
+    u64 warmup;
+    u64 iterations;
+    u64 scale;
+    const char *filter;
+    FILE *out;
+    boolean summary;
+    int count;
+    u64 *samples;
+};
+
+volatile u64 bench_sink;
+
+static u64 bench_nsec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * BILLION + ts.tv_nsec;
+}
+
+static int u64_compare(const void *a, const void *b)
+{
+    u64 x = *(const u64 *)a, y = *(const u64 *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void bench_usage(const char *prog)
+{
+    const char *p = strrchr(prog, '/');
+    p = p != NULL ? p + 1 : prog;
+    fprintf(stderr, "Usage: %s [-w warmup] [-i iterations] [-s scale] [-f filter] "
+            "[-o output]\n", p);
+    exit(EXIT_FAILURE);
+}
+
+static u64 bench_parse_u64(const char *arg, const char *prog)
+{
+    char *end;
+    long long v = strtoll(arg, &end, 0);
+    if (*end != '\0' || v < 0)
+        bench_usage(prog);
+    return v;
+}
+
+bench allocate_bench(heap h, const char *suite, int argc, char **argv)
+{
+    bench b = allocate(h, sizeof(struct bench));
+    assert(b != INVALID_ADDRESS);
+    b->h = h;
+    b->suite = suite;
+    b->warmup = BENCH_DEFAULT_WARMUP;
+    b->iterations = BENCH_DEFAULT_ITERATIONS;
+    b->scale = 1;
+    b->filter = 0;
+    b->out = stdout;
+    b->summary = false;
+    b->count = 0;
+
+    int c;
+    while ((c = getopt(argc, argv, "w:i:s:f:o:h")) != EOF) {
+        switch (c) {
+        case 'w':
+            b->warmup = bench_parse_u64(optarg, argv[0]);
+            break;
+        case 'i':
+            b->iterations = bench_parse_u64(optarg, argv[0]);
+            break;
+        case 's':
+            b->scale = bench_parse_u64(optarg, argv[0]);
+            break;
+        case 'f':
+            b->filter = optarg;
+            break;
+        case 'o':
+            b->out = fopen(optarg, "w");
+            if (!b->out) {
+                perror("fopen");
+                exit(EXIT_FAILURE);
+            }
+            b->summary = true;
+            break;
+        default:
+            bench_usage(argv[0]);
+        }
+    }
+    if (b->iterations == 0 || b->scale == 0)
+        bench_usage(argv[0]);
+    b->samples = allocate(h, b->iterations * sizeof(u64));
+    assert(b->samples != INVALID_ADDRESS);
+
+    fprintf(b->out, "{\n  \"suite\": \"%s\",\n  \"warmup\": %llu,\n  \"iterations\": %llu,\n"
+            "  \"scale\": %llu,\n  \"benchmarks\": [", suite, (unsigned long long)b->warmup,
+            (unsigned long long)b->iterations, (unsigned long long)b->scale);
+    return b;
+}
+
+u64 bench_ops(bench b, u64 ops)
+{
+    return ops * b->scale;
+}
+
+void bench_run(bench b, const char *name, u64 ops, bench_op op)
+{
+    if (b->filter && !strstr(name, b->filter))
+        return;
+    ops = bench_ops(b, ops);
+    for (u64 i = 0; i < b->warmup; i++)
+        apply(op, ops);
+    u64 total = 0;
+    for (u64 i = 0; i < b->iterations; i++) {
+        u64 start = bench_nsec();
+        apply(op, ops);
+        b->samples[i] = bench_nsec() - start;
+        total += b->samples[i];
+    }
+    qsort(b->samples, b->iterations, sizeof(u64), u64_compare);
+
+    double min = (double)b->samples[0] / ops;
+    double median = (double)b->samples[b->iterations / 2] / ops;
+    double mean = (double)total / b->iterations / ops;
+    double max = (double)b->samples[b->iterations - 1] / ops;
+    fprintf(b->out, "%s\n    {\"name\": \"%s\", \"ops\": %llu, \"ns_per_op\": "
+            "{\"min\": %.3f, \"median\": %.3f, \"mean\": %.3f, \"max\": %.3f}}",
+            b->count++ ? "," : "", name, (unsigned long long)ops, min, median, mean, max);
+    if (b->summary)
+        printf("%-32s %12.3f ns/op (min %.3f, max %.3f)\n", name, median, min, max);
+}
+
+int bench_finish(bench b)
+{
+    fprintf(b->out, "\n  ]\n}\n");
+    int rv = EXIT_SUCCESS;
+    if (b->out != stdout && fclose(b->out) != 0) {
+        perror("fclose");
+        rv = EXIT_FAILURE;
+    }
+    deallocate(b->h, b->samples, b->iterations * sizeof(u64));
+    deallocate(b->h, b, sizeof(struct bench));
+    return rv;
+}
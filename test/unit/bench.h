@@ -0,0 +1,31 @@
+/* Minimal benchmark harness for runtime structures
+
+   A benchmark op is a closure that performs n operations. Each case is
+   sampled a number of times after a few untimed warmup runs, and the
+   per-operation times are reported as JSON, either to stdout or to the
+   file given with -o, in which case a summary is printed to stdout.
+
+   Common options (see bench_usage):
+     -w <n>     warmup runs per case
+     -i <n>     timed runs per case
+     -s <n>     scale the number of operations per run
+     -f <str>   only run cases whose name contains str
+     -o <file>  write JSON results to file
+*/
+typedef closure_type(bench_op, void, u64 n);
+
+typedef struct bench *bench;
+
+bench allocate_bench(heap h, const char *suite, int argc, char **argv);
+
+/* run one case; ops is the number of operations per run before scaling */
+void bench_run(bench b, const char *name, u64 ops, bench_op op);
+
+/* number of operations per run after scaling */
+u64 bench_ops(bench b, u64 ops);
+
+/* finish output and release the harness; returns an exit status */
+int bench_finish(bench b);
+
+/* sink for results that must not be optimized away */
+extern volatile u64 bench_sink;
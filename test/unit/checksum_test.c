@@ -0,0 +1,85 @@
+#include <runtime.h>
+#include <stdlib.h>
+
+#define CSUM_BUF_SIZE   4096
+
+#define test_assert(expr)   do { \
+    if (!(expr)) { \
+        msg_err("%s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+        exit(EXIT_FAILURE); \
+    } \
+} while (0)
+
+/* straightforward RFC 1071 reference, summing big-endian 16-bit words */
+static u16 ref_csum(const u8 *p, bytes len)
+{
+    u32 sum = 0;
+    for (bytes i = 0; i + 1 < len; i += 2)
+        sum += (p[i] << 8) | p[i + 1];
+    if (len & 1)
+        sum += p[len - 1] << 8;
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return ~sum;
+}
+
+static void fill(u8 *buf, bytes len)
+{
+    for (bytes i = 0; i < len; i++)
+        buf[i] = random_u64();
+}
+
+static void test_csum(u8 *buf)
+{
+    for (int offset = 0; offset < 8; offset++) {
+        for (bytes len = 0; len <= 300; len++) {
+            fill(buf + offset, len);
+            test_assert(be16toh(ip_csum(buf + offset, len)) == ref_csum(buf + offset, len));
+        }
+        bytes len = CSUM_BUF_SIZE - offset;
+        fill(buf + offset, len);
+        test_assert(be16toh(ip_csum(buf + offset, len)) == ref_csum(buf + offset, len));
+    }
+
+    /* all ones forces carries out of every add */
+    runtime_memset(buf, 0xff, CSUM_BUF_SIZE);
+    test_assert(be16toh(ip_csum(buf, CSUM_BUF_SIZE)) == ref_csum(buf, CSUM_BUF_SIZE));
+    test_assert(be16toh(ip_csum(buf, CSUM_BUF_SIZE - 1)) == ref_csum(buf, CSUM_BUF_SIZE - 1));
+}
+
+static void test_csum_chained(u8 *buf)
+{
+    /* sums of even-length pieces combine directly */
+    fill(buf, CSUM_BUF_SIZE);
+    u64 sum = 0;
+    for (bytes off = 0; off < CSUM_BUF_SIZE; off += 2 * 71)
+        sum = ip_csum_partial(buf + off, MIN(2 * 71, CSUM_BUF_SIZE - off), sum);
+    test_assert(be16toh((u16)~ip_csum_fold(sum)) == ref_csum(buf, CSUM_BUF_SIZE));
+}
+
+static void test_csum_copy(u8 *src, u8 *dst)
+{
+    for (int soff = 0; soff < 8; soff++) {
+        for (int doff = 0; doff < 8; doff += 3) {
+            for (bytes len = 0; len <= 200; len += 7) {
+                fill(src + soff, len);
+                runtime_memset(dst, 0, CSUM_BUF_SIZE);
+                u16 csum = ~ip_csum_fold(ip_csum_copy(dst + doff, src + soff, len, 0));
+                test_assert(runtime_memcmp(dst + doff, src + soff, len) == 0);
+                test_assert(dst[doff + len] == 0);
+                test_assert(be16toh(csum) == ref_csum(src + soff, len));
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static u8 buf1[CSUM_BUF_SIZE + 8], buf2[CSUM_BUF_SIZE + 8];
+
+    init_process_runtime();
+    test_csum(buf1);
+    test_csum_chained(buf1);
+    test_csum_copy(buf1, buf2);
+    return 0;
+}
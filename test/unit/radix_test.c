@@ -0,0 +1,238 @@
+#include <runtime.h>
+#include <stdlib.h>
+
+//#define RADIXTEST_DEBUG
+#ifdef RADIXTEST_DEBUG
+#define radixtest_debug(x, ...) do {rprintf("RADIXTEST %s: " x, __func__, ##__VA_ARGS__);} while(0)
+#else
+#define radixtest_debug(x, ...)
+#endif
+
+/* items are encoded keys, offset to keep them non-null */
+#define item_from_key(k) pointer_from_u64((k) + 1)
+#define key_from_item(p) (u64_from_pointer(p) - 1)
+
+static boolean test_insert(radix_tree t, u64 key, boolean expect)
+{
+    radixtest_debug("inserting key 0x%lx\n", key);
+    boolean r = radix_insert(t, key, item_from_key(key));
+    if (r != expect) {
+        msg_err("insert of key 0x%lx returned %d\n", key, r);
+        return false;
+    }
+    void *p = radix_lookup(t, key);
+    if (p != item_from_key(key)) {
+        msg_err("lookup of key 0x%lx returned %p\n", key, p);
+        return false;
+    }
+    return true;
+}
+
+static boolean test_remove(radix_tree t, u64 key, boolean expect)
+{
+    radixtest_debug("removing key 0x%lx\n", key);
+    void *p = radix_remove(t, key);
+    if (expect ? p != item_from_key(key) : p != INVALID_ADDRESS) {
+        msg_err("remove of key 0x%lx returned %p\n", key, p);
+        return false;
+    }
+    p = radix_lookup(t, key);
+    if (p != INVALID_ADDRESS) {
+        msg_err("lookup of removed key 0x%lx returned %p\n", key, p);
+        return false;
+    }
+    return true;
+}
+
+closure_function(2, 2, boolean, check_order,
+                 u64 *, last, u64 *, count,
+                 u64, key, void *, p)
+{
+    if (key_from_item(p) != key) {
+        msg_err("item %p mismatch for key 0x%lx\n", p, key);
+        return false;
+    }
+    if (*bound(count) > 0 && key <= *bound(last)) {
+        msg_err("key 0x%lx out of order (last 0x%lx)\n", key, *bound(last));
+        return false;
+    }
+    *bound(last) = key;
+    (*bound(count))++;
+    return true;
+}
+
+static boolean test_traverse(radix_tree t)
+{
+    u64 last = 0, count = 0;
+    if (!radix_traverse(t, stack_closure(check_order, &last, &count)))
+        return false;
+    if (count != radix_get_count(t)) {
+        msg_err("traversed %ld items, tree count %ld\n", count, radix_get_count(t));
+        return false;
+    }
+    return true;
+}
+
+static boolean basic_test(heap h)
+{
+    radix_tree t = allocate_radix_tree(h);
+    if (t == INVALID_ADDRESS) {
+        msg_err("allocate_radix_tree() failed\n");
+        return false;
+    }
+
+    if (radix_lookup(t, 0) != INVALID_ADDRESS) {
+        msg_err("lookup in empty tree succeeded\n");
+        return false;
+    }
+
+    /* dense range spanning several leaves */
+    for (u64 i = 0; i < 1000; i++) {
+        if (!test_insert(t, i, true))
+            return false;
+    }
+
+    /* sparse keys forcing root growth up to the full key width */
+    u64 sparse[] = { 1ull << 20, 1ull << 33, (1ull << 47) + 5, -3ull };
+    for (int i = 0; i < _countof(sparse); i++) {
+        if (!test_insert(t, sparse[i], true))
+            return false;
+    }
+
+    for (u64 i = 0; i < 1000; i++) {
+        if (radix_insert(t, i, item_from_key(i))) {
+            msg_err("duplicate insert of 0x%lx should have failed\n", i);
+            return false;
+        }
+    }
+    if (radix_get_count(t) != 1000 + _countof(sparse)) {
+        msg_err("bad count %ld\n", radix_get_count(t));
+        return false;
+    }
+    if (!test_traverse(t))
+        return false;
+
+    for (u64 i = 0; i < 1000; i++) {
+        if (!test_remove(t, i, true))
+            return false;
+    }
+    if (!test_remove(t, 1000, false))
+        return false;
+    for (int i = 0; i < _countof(sparse); i++) {
+        if (!test_remove(t, sparse[i], true))
+            return false;
+    }
+    if (radix_get_count(t) != 0 || t->root) {
+        msg_err("tree not empty after removals\n");
+        return false;
+    }
+    deallocate_radix_tree(t, 0);
+    return true;
+}
+
+#define GANG_MAX 16
+
+static boolean gang_test(heap h)
+{
+    struct radix_tree t;
+    init_radix_tree(&t, h);
+
+    /* every third key in [0, 3000) */
+    for (u64 i = 0; i < 3000; i += 3) {
+        if (!test_insert(&t, i, true))
+            return false;
+    }
+
+    /* walk [100, 2000) in batches and verify each key is seen once */
+    void *results[GANG_MAX];
+    u64 start = 100, seen = 0;
+    while (1) {
+        u64 n = radix_gang_lookup(&t, irange(start, 2000), results, GANG_MAX);
+        for (u64 i = 0; i < n; i++) {
+            u64 k = key_from_item(results[i]);
+            u64 expect = ((start + 2) / 3) * 3 + i * 3;
+            if (k != expect) {
+                msg_err("gang lookup from 0x%lx index %ld: key 0x%lx, expected 0x%lx\n",
+                        start, i, k, expect);
+                return false;
+            }
+        }
+        seen += n;
+        if (n < GANG_MAX)
+            break;
+        start = key_from_item(results[n - 1]) + 1;
+    }
+    u64 expect_seen = (1998 - 102) / 3 + 1;
+    if (seen != expect_seen) {
+        msg_err("gang lookup saw %ld items, expected %ld\n", seen, expect_seen);
+        return false;
+    }
+
+    if (radix_gang_lookup(&t, irange(3000, -1ull), results, GANG_MAX) != 0) {
+        msg_err("gang lookup past last key returned items\n");
+        return false;
+    }
+    if (radix_gang_lookup(&t, irange(1ull << 40, -1ull), results, GANG_MAX) != 0) {
+        msg_err("gang lookup beyond root coverage returned items\n");
+        return false;
+    }
+    destruct_radix_tree(&t, 0);
+    return true;
+}
+
+#define RANDOM_VEC_ORDER 14
+#define RANDOM_VECLEN    U64_FROM_BIT(RANDOM_VEC_ORDER)
+
+static boolean random_test(heap h)
+{
+    static u64 vec[RANDOM_VECLEN];
+    radix_tree t = allocate_radix_tree(h);
+    if (t == INVALID_ADDRESS) {
+        msg_err("allocate_radix_tree() failed\n");
+        return false;
+    }
+
+    for (int i = 0; i < RANDOM_VECLEN; i++) {
+        do {
+            /* restrict range so as to induce collisions */
+            vec[i] = random_u64() & MASK(RANDOM_VEC_ORDER + 4);
+        } while (!radix_insert(t, vec[i], item_from_key(vec[i])));
+    }
+    if (radix_get_count(t) != RANDOM_VECLEN) {
+        msg_err("bad count %ld\n", radix_get_count(t));
+        return false;
+    }
+    if (!test_traverse(t))
+        return false;
+
+    for (int i = 0; i < RANDOM_VECLEN; i++) {
+        if (!test_remove(t, vec[i], true))
+            return false;
+    }
+    if (radix_get_count(t) != 0) {
+        msg_err("bad count %ld after removals\n", radix_get_count(t));
+        return false;
+    }
+    deallocate_radix_tree(t, 0);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    heap h = init_process_runtime();
+
+    if (!basic_test(h))
+        goto fail;
+
+    if (!gang_test(h))
+        goto fail;
+
+    if (!random_test(h))
+        goto fail;
+
+    msg_debug("test passed\n");
+    exit(EXIT_SUCCESS);
+  fail:
+    msg_err("test failed\n");
+    exit(EXIT_FAILURE);
+}
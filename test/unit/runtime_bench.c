@@ -0,0 +1,466 @@
+#include <runtime.h>
+#include <stdlib.h>
+#include <unix_process_runtime.h>
+#include "bench.h"
+
+#define BENCH_OPS        U64_FROM_BIT(16)
+#define BENCH_PAGESIZE   U64_FROM_BIT(21)
+#define BENCH_BUFSIZE    4096
+
+/* spread sequential indices over the key space */
+static inline u64 bench_key(u64 i)
+{
+    return (i * 0x9e3779b97f4a7c15ull) >> 16;
+}
+
+/* table */
+
+closure_function(1, 1, void, table_insert_op,
+                 heap, h,
+                 u64, n)
+{
+    table t = allocate_table(bound(h), identity_key, pointer_equal);
+    for (u64 i = 0; i < n; i++)
+        table_set(t, pointer_from_u64(bench_key(i) + 1), pointer_from_u64(i + 1));
+    deallocate_table(t);
+}
+
+closure_function(1, 1, void, table_lookup_op,
+                 table, t,
+                 u64, n)
+{
+    u64 sum = 0;
+    for (u64 i = 0; i < n; i++)
+        sum += u64_from_pointer(table_find(bound(t), pointer_from_u64(bench_key(i) + 1)));
+    bench_sink = sum;
+}
+
+static void bench_table(bench b, heap h)
+{
+    bench_run(b, "table_insert", BENCH_OPS, stack_closure(table_insert_op, h));
+    u64 n = bench_ops(b, BENCH_OPS);
+    table t = allocate_table(h, identity_key, pointer_equal);
+    for (u64 i = 0; i < n; i++)
+        table_set(t, pointer_from_u64(bench_key(i) + 1), pointer_from_u64(i + 1));
+    bench_run(b, "table_lookup", BENCH_OPS, stack_closure(table_lookup_op, t));
+    deallocate_table(t);
+}
+
+/* rbtree */
+
+typedef struct bench_rbnode {
+    struct rbnode node;
+    u64 key;
+} *bench_rbnode;
+
+closure_function(0, 2, int, bench_rb_compare,
+                 rbnode, a, rbnode, b)
+{
+    u64 ka = ((bench_rbnode)a)->key, kb = ((bench_rbnode)b)->key;
+    return ka < kb ? -1 : (ka > kb ? 1 : 0);
+}
+
+closure_function(0, 1, boolean, bench_rb_print,
+                 rbnode, n)
+{
+    rprintf(" %ld", ((bench_rbnode)n)->key);
+    return true;
+}
+
+closure_function(4, 1, void, rbtree_insert_op,
+                 rbtree, t, bench_rbnode, nodes, rb_key_compare, compare, rbnode_handler, print,
+                 u64, n)
+{
+    rbtree t = bound(t);
+    bench_rbnode nodes = bound(nodes);
+    init_rbtree(t, bound(compare), bound(print));
+    for (u64 i = 0; i < n; i++) {
+        init_rbnode(&nodes[i].node);
+        rbtree_insert_node(t, &nodes[i].node);
+    }
+}
+
+closure_function(2, 1, void, rbtree_lookup_op,
+                 rbtree, t, bench_rbnode, nodes,
+                 u64, n)
+{
+    u64 found = 0;
+    for (u64 i = 0; i < n; i++)
+        found += rbtree_lookup(bound(t), &bound(nodes)[i].node) != INVALID_ADDRESS;
+    bench_sink = found;
+}
+
+static void bench_rbtree(bench b, heap h)
+{
+    u64 n = bench_ops(b, BENCH_OPS);
+    bench_rbnode nodes = allocate(h, n * sizeof(struct bench_rbnode));
+    assert(nodes != INVALID_ADDRESS);
+    for (u64 i = 0; i < n; i++)
+        nodes[i].key = bench_key(i);
+    struct rbtree t;
+    rb_key_compare compare = stack_closure(bench_rb_compare);
+    rbnode_handler print = stack_closure(bench_rb_print);
+    bench_run(b, "rbtree_insert", BENCH_OPS,
+              stack_closure(rbtree_insert_op, &t, nodes, compare, print));
+    bench_run(b, "rbtree_lookup", BENCH_OPS, stack_closure(rbtree_lookup_op, &t, nodes));
+    deallocate(h, nodes, n * sizeof(struct bench_rbnode));
+}
+
+/* rangemap */
+
+closure_function(0, 1, void, rangemap_release_node,
+                 rmnode, n)
+{
+    /* nodes are owned by the caller */
+}
+
+closure_function(2, 1, void, rangemap_insert_op,
+                 heap, h, rmnode, nodes,
+                 u64, n)
+{
+    rangemap rm = allocate_rangemap(bound(h));
+    rmnode nodes = bound(nodes);
+    for (u64 i = 0; i < n; i++)
+        rangemap_insert(rm, &nodes[i]);
+    deallocate_rangemap(rm, stack_closure(rangemap_release_node));
+}
+
+closure_function(1, 1, void, rangemap_lookup_op,
+                 rangemap, rm,
+                 u64, n)
+{
+    u64 found = 0;
+    for (u64 i = 0; i < n; i++)
+        found += rangemap_lookup(bound(rm), (bench_key(i) % n) * PAGESIZE + 1) != INVALID_ADDRESS;
+    bench_sink = found;
+}
+
+static void bench_rangemap(bench b, heap h)
+{
+    u64 n = bench_ops(b, BENCH_OPS);
+    rmnode nodes = allocate(h, n * sizeof(struct rmnode));
+    assert(nodes != INVALID_ADDRESS);
+
+    /* page-sized ranges, inserted in scattered order */
+    for (u64 i = 0; i < n; i++)
+        nodes[i].r = irangel(i * PAGESIZE, PAGESIZE);
+    for (u64 i = n - 1; i > 0; i--) {
+        u64 j = bench_key(i) % (i + 1);
+        range r = nodes[i].r;
+        nodes[i].r = nodes[j].r;
+        nodes[j].r = r;
+    }
+    bench_run(b, "rangemap_insert", BENCH_OPS, stack_closure(rangemap_insert_op, h, nodes));
+
+    rangemap rm = allocate_rangemap(h);
+    for (u64 i = 0; i < n; i++)
+        rangemap_insert(rm, &nodes[i]);
+    bench_run(b, "rangemap_lookup", BENCH_OPS, stack_closure(rangemap_lookup_op, rm));
+    deallocate_rangemap(rm, stack_closure(rangemap_release_node));
+    deallocate(h, nodes, n * sizeof(struct rmnode));
+}
+
+/* bitmap and id heap */
+
+closure_function(1, 1, void, bitmap_alloc_op,
+                 bitmap, bm,
+                 u64, n)
+{
+    bitmap bm = bound(bm);
+    for (u64 i = 0; i < n; i++) {
+        u64 bit = bitmap_alloc(bm, 1);
+        assert(bit != INVALID_PHYSICAL);
+    }
+    for (u64 i = 0; i < n; i++)
+        bitmap_dealloc(bm, i, 1);
+}
+
+closure_function(2, 1, void, id_heap_alloc_op,
+                 heap, id, u64, size,
+                 u64, n)
+{
+    heap id = bound(id);
+    u64 size = bound(size);
+    for (u64 i = 0; i < n; i++) {
+        u64 a = allocate_u64(id, size);
+        assert(a != INVALID_PHYSICAL);
+        deallocate_u64(id, a, size);
+    }
+}
+
+static void bench_id(bench b, heap h)
+{
+    u64 n = bench_ops(b, BENCH_OPS);
+    bitmap bm = allocate_bitmap(h, h, n);
+    assert(bm != INVALID_ADDRESS);
+    bench_run(b, "bitmap_alloc", BENCH_OPS, stack_closure(bitmap_alloc_op, bm));
+    deallocate_bitmap(bm);
+
+    heap id = (heap)create_id_heap(h, h, PAGESIZE, BENCH_OPS * PAGESIZE, PAGESIZE, false);
+    assert(id != INVALID_ADDRESS);
+    bench_run(b, "id_heap_alloc_page", BENCH_OPS, stack_closure(id_heap_alloc_op, id, PAGESIZE));
+    bench_run(b, "id_heap_alloc_16page", BENCH_OPS,
+              stack_closure(id_heap_alloc_op, id, 16 * PAGESIZE));
+    destroy_heap(id);
+}
+
+/* objcache and mcache */
+
+closure_function(3, 1, void, heap_alloc_op,
+                 heap, h, bytes, size, void **, objs,
+                 u64, n)
+{
+    heap h = bound(h);
+    bytes size = bound(size);
+    void **objs = bound(objs);
+    for (u64 i = 0; i < n; i++) {
+        objs[i] = allocate(h, size);
+        assert(objs[i] != INVALID_ADDRESS);
+    }
+    for (u64 i = 0; i < n; i++)
+        deallocate(h, objs[i], size);
+}
+
+/* malloc-style use as by lwIP: zeroed allocation, free without size */
+closure_function(3, 1, void, heap_alloc_zero_op,
+                 heap, h, bytes, size, void **, objs,
+                 u64, n)
+{
+    heap h = bound(h);
+    bytes size = bound(size);
+    void **objs = bound(objs);
+    for (u64 i = 0; i < n; i++) {
+        objs[i] = allocate_zero(h, size);
+        assert(objs[i] != INVALID_ADDRESS);
+    }
+    for (u64 i = 0; i < n; i++)
+        deallocate(h, objs[i], -1ull);
+}
+
+static void bench_caches(bench b, heap h)
+{
+    u64 n = bench_ops(b, BENCH_OPS);
+    heap m = allocate_mmapheap(h, pad(n * 256, BENCH_PAGESIZE) * 4);
+    heap pageheap = (heap)create_id_heap_backed(h, h, m, BENCH_PAGESIZE, false);
+    assert(pageheap != INVALID_ADDRESS);
+    m = allocate_mmapheap(h, pad(n * 2048, BENCH_PAGESIZE) * 4);
+    heap packetheap = (heap)create_id_heap_backed(h, h, m, BENCH_PAGESIZE, false);
+    assert(packetheap != INVALID_ADDRESS);
+    void **objs = allocate(h, n * sizeof(void *));
+    assert(objs != INVALID_ADDRESS);
+
+    heap oc = allocate_objcache(h, pageheap, 64, BENCH_PAGESIZE);
+    assert(oc != INVALID_ADDRESS);
+    bench_run(b, "objcache_alloc_64", BENCH_OPS, stack_closure(heap_alloc_op, oc, 64, objs));
+    destroy_heap(oc);
+
+    /* packet buffer sized objects, as allocated per packet by the network stack */
+    oc = allocate_objcache(h, packetheap, 1536, BENCH_PAGESIZE);
+    assert(oc != INVALID_ADDRESS);
+    bench_run(b, "objcache_alloc_1536", BENCH_OPS, stack_closure(heap_alloc_op, oc, 1536, objs));
+    destroy_heap(oc);
+
+    heap mc = allocate_mcache(h, packetheap, 5, 11, BENCH_PAGESIZE);
+    assert(mc != INVALID_ADDRESS);
+    bench_run(b, "mcache_alloc_zero_1536", BENCH_OPS, stack_closure(heap_alloc_zero_op, mc, 1536, objs));
+    destroy_heap(mc);
+
+    mc = allocate_mcache(h, pageheap, 5, 11, BENCH_PAGESIZE);
+    assert(mc != INVALID_ADDRESS);
+    bench_run(b, "mcache_alloc_48", BENCH_OPS, stack_closure(heap_alloc_op, mc, 48, objs));
+    bench_run(b, "mcache_alloc_200", BENCH_OPS, stack_closure(heap_alloc_op, mc, 200, objs));
+    destroy_heap(mc);
+
+    deallocate(h, objs, n * sizeof(void *));
+}
+
+/* queue and pqueue */
+
+closure_function(1, 1, void, queue_op,
+                 queue, q,
+                 u64, n)
+{
+    queue q = bound(q);
+    u64 sum = 0;
+    for (u64 i = 0; i < n; i++) {
+        enqueue(q, pointer_from_u64(i + 1));
+        sum += u64_from_pointer(dequeue(q));
+    }
+    bench_sink = sum;
+}
+
+closure_function(1, 1, void, queue_single_op,
+                 queue, q,
+                 u64, n)
+{
+    queue q = bound(q);
+    u64 sum = 0;
+    for (u64 i = 0; i < n; i++) {
+        enqueue_single(q, pointer_from_u64(i + 1));
+        sum += u64_from_pointer(dequeue_single(q));
+    }
+    bench_sink = sum;
+}
+
+static boolean bench_pqueue_order(void *a, void *b)
+{
+    return u64_from_pointer(a) > u64_from_pointer(b);
+}
+
+closure_function(1, 1, void, pqueue_op,
+                 heap, h,
+                 u64, n)
+{
+    pqueue pq = allocate_pqueue(bound(h), bench_pqueue_order);
+    for (u64 i = 0; i < n; i++)
+        pqueue_insert(pq, pointer_from_u64(bench_key(i) + 1));
+    u64 sum = 0;
+    for (u64 i = 0; i < n; i++)
+        sum += u64_from_pointer(pqueue_pop(pq));
+    bench_sink = sum;
+    deallocate_pqueue(pq);
+}
+
+static void bench_queues(bench b, heap h)
+{
+    queue q = allocate_queue(h, 64);
+    assert(q != INVALID_ADDRESS);
+    bench_run(b, "queue_enqueue_dequeue", BENCH_OPS, stack_closure(queue_op, q));
+    bench_run(b, "queue_single_enqueue_dequeue", BENCH_OPS, stack_closure(queue_single_op, q));
+    deallocate_queue(q);
+    bench_run(b, "pqueue_insert_pop", BENCH_OPS, stack_closure(pqueue_op, h));
+}
+
+/* buffer */
+
+closure_function(1, 1, void, buffer_write_op,
+                 buffer, buf,
+                 u64, n)
+{
+    buffer buf = bound(buf);
+    buffer_clear(buf);
+    for (u64 i = 0; i < n; i++)
+        buffer_write_le64(buf, i);
+    bench_sink = buffer_length(buf);
+}
+
+closure_function(1, 1, void, buffer_bprintf_op,
+                 buffer, buf,
+                 u64, n)
+{
+    buffer buf = bound(buf);
+    buffer_clear(buf);
+    for (u64 i = 0; i < n; i++)
+        bprintf(buf, "%ld ", i);
+    bench_sink = buffer_length(buf);
+}
+
+static void bench_buffer(bench b, heap h)
+{
+    buffer buf = allocate_buffer(h, 16);
+    assert(buf != INVALID_ADDRESS);
+    bench_run(b, "buffer_write_le64", BENCH_OPS, stack_closure(buffer_write_op, buf));
+    bench_run(b, "buffer_bprintf", BENCH_OPS / 4, stack_closure(buffer_bprintf_op, buf));
+    deallocate_buffer(buf);
+}
+
+/* memops and sha256 */
+
+closure_function(2, 1, void, memcpy_op,
+                 u8 *, dst, u8 *, src,
+                 u64, n)
+{
+    for (u64 i = 0; i < n; i++)
+        runtime_memcpy(bound(dst) + (i & 7), bound(src), BENCH_BUFSIZE);
+}
+
+closure_function(1, 1, void, memset_op,
+                 u8 *, dst,
+                 u64, n)
+{
+    for (u64 i = 0; i < n; i++)
+        runtime_memset(bound(dst), i, BENCH_BUFSIZE);
+}
+
+closure_function(2, 1, void, memcmp_op,
+                 u8 *, a, u8 *, b,
+                 u64, n)
+{
+    int sum = 0;
+    for (u64 i = 0; i < n; i++)
+        sum += runtime_memcmp(bound(a), bound(b), BENCH_BUFSIZE);
+    bench_sink = sum;
+}
+
+closure_function(2, 1, void, sha256_op,
+                 buffer, dest, buffer, src,
+                 u64, n)
+{
+    for (u64 i = 0; i < n; i++) {
+        buffer_clear(bound(dest));
+        sha256(bound(dest), bound(src));
+    }
+}
+
+closure_function(2, 1, void, csum_op,
+                 u8 *, buf, bytes, len,
+                 u64, n)
+{
+    u64 sum = 0;
+    for (u64 i = 0; i < n; i++)
+        sum += ip_csum(bound(buf), bound(len));
+    bench_sink = sum;
+}
+
+closure_function(2, 1, void, csum_copy_op,
+                 u8 *, dst, u8 *, src,
+                 u64, n)
+{
+    u64 sum = 0;
+    for (u64 i = 0; i < n; i++)
+        sum += ip_csum_copy(bound(dst), bound(src), BENCH_BUFSIZE, 0);
+    bench_sink = sum;
+}
+
+static void bench_memops(bench b, heap h)
+{
+    u8 *src = allocate(h, BENCH_BUFSIZE + 8);
+    u8 *dst = allocate(h, BENCH_BUFSIZE + 8);
+    assert(src != INVALID_ADDRESS && dst != INVALID_ADDRESS);
+    for (int i = 0; i < BENCH_BUFSIZE + 8; i++)
+        src[i] = dst[i] = i;
+    bench_run(b, "memcpy_4k", BENCH_OPS / 16, stack_closure(memcpy_op, dst, src));
+    bench_run(b, "memset_4k", BENCH_OPS / 16, stack_closure(memset_op, dst));
+    runtime_memcpy(dst, src, BENCH_BUFSIZE);
+    bench_run(b, "memcmp_4k", BENCH_OPS / 16, stack_closure(memcmp_op, dst, src));
+    bench_run(b, "csum_4k", BENCH_OPS / 16, stack_closure(csum_op, src, BENCH_BUFSIZE));
+    /* TCP payload of a full ethernet frame, 2-byte aligned as on receive */
+    bench_run(b, "csum_1460", BENCH_OPS / 4, stack_closure(csum_op, src + 2, 1460));
+    bench_run(b, "csum_copy_4k", BENCH_OPS / 16, stack_closure(csum_copy_op, dst, src));
+
+    buffer s = wrap_buffer(h, src, BENCH_BUFSIZE);
+    buffer d = allocate_buffer(h, 32);
+    assert(s != INVALID_ADDRESS && d != INVALID_ADDRESS);
+    bench_run(b, "sha256_4k", BENCH_OPS / 256, stack_closure(sha256_op, d, s));
+    deallocate_buffer(d);
+    unwrap_buffer(h, s);
+    deallocate(h, src, BENCH_BUFSIZE + 8);
+    deallocate(h, dst, BENCH_BUFSIZE + 8);
+}
+
+int main(int argc, char **argv)
+{
+    heap h = init_process_runtime();
+    bench b = allocate_bench(h, "runtime", argc, argv);
+
+    bench_table(b, h);
+    bench_rbtree(b, h);
+    bench_rangemap(b, h);
+    bench_id(b, h);
+    bench_caches(b, h);
+    bench_queues(b, h);
+    bench_buffer(b, h);
+    bench_memops(b, h);
+
+    exit(bench_finish(b));
+}
@@ -14,6 +14,7 @@
 #include <log.h>
 
 #define DUMP_OPT_TREE  (1U << 0)
+#define DUMP_OPT_STATS (1U << 1)
 
 #define TERM_COLOR_BLUE     94
 #define TERM_COLOR_CYAN     96
@@ -152,6 +153,11 @@ closure_function(3, 2, void, fsc,
         bprintf(rb, "\nmetadata\n");
         print_value(rb, root, timm("indent", "0"));
     }
+    if (options & DUMP_OPT_STATS) {
+        u64 total, obsolete;
+        filesystem_get_log_stats(fs, &total, &obsolete);
+        bprintf(rb, "\nlog entries: %ld (%ld obsolete)", total, obsolete);
+    }
     buffer_print(rb);
     rprintf("\n");
     deallocate_buffer(rb);
@@ -238,6 +244,7 @@ static void usage(const char *prog)
             "<fs image> into <target dir>\n");
     fprintf(stderr, "  -t\t\t\tDisplay filesystem from <fs image> as a tree\n");
     fprintf(stderr, "  -l\t\t\tDisplay contents of crash log\n");
+    fprintf(stderr, "  -s\t\t\tDisplay filesystem log statistics\n");
     exit(EXIT_FAILURE);
 }
 
@@ -248,7 +255,7 @@ int main(int argc, char **argv)
     unsigned int options = 0;
     boolean print_klog = false;
 
-    while ((c = getopt(argc, argv, "d:tl")) != EOF) {
+    while ((c = getopt(argc, argv, "d:tls")) != EOF) {
         switch (c) {
         case 'd':
             target_dir = alloca_wrap_buffer(optarg, runtime_strlen(optarg));
@@ -259,6 +266,9 @@ int main(int argc, char **argv)
         case 'l':
             print_klog = true;
             break;
+        case 's':
+            options |= DUMP_OPT_STATS;
+            break;
         default:
             usage(argv[0]);
         }
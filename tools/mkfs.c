@@ -369,7 +369,7 @@ closure_function(4, 2, void, fsc,
             }
         }
     }
-    filesystem_flush(fs, ignore_status);
+    filesystem_flush(fs, 0, ignore_status);
     closure_finish();
 }
 
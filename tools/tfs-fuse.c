@@ -628,7 +628,7 @@ static void tfs_destroy(void *v)
 {
     alarm(0);
     pthread_rwlock_wrlock(&rwlock);
-    filesystem_flush(rootfs, ignore_status);
+    filesystem_flush(rootfs, 0, ignore_status);
     pthread_rwlock_unlock(&rwlock);
     close(dfd);
 }
@@ -966,7 +966,7 @@ void sig_handler(int signum)
 {
     tfs_fuse_debug("flush triggered after timeout\n");
     pthread_rwlock_wrlock(&rwlock);
-    filesystem_flush(rootfs, ignore_status);
+    filesystem_flush(rootfs, 0, ignore_status);
     pthread_rwlock_unlock(&rwlock);
 }
 